@@ -59,6 +59,11 @@ struct CAddressUnspentKey {
         SetNull();
     }
 
+    friend bool operator==(const CAddressUnspentKey& a, const CAddressUnspentKey& b) {
+        return a.type == b.type && a.hashBytes == b.hashBytes && a.asset == b.asset &&
+               a.txhash == b.txhash && a.index == b.index;
+    }
+
     void SetNull() {
         type = 0;
         hashBytes.SetNull();
@@ -170,6 +175,12 @@ struct CAddressIndexKey {
         SetNull();
     }
 
+    friend bool operator==(const CAddressIndexKey& a, const CAddressIndexKey& b) {
+        return a.type == b.type && a.hashBytes == b.hashBytes && a.asset == b.asset &&
+               a.blockHeight == b.blockHeight && a.txindex == b.txindex && a.txhash == b.txhash &&
+               a.index == b.index && a.spending == b.spending;
+    }
+
     void SetNull() {
         type = 0;
         hashBytes.SetNull();
@@ -310,6 +321,42 @@ struct CAddressIndexIteratorHeightKey {
     }
 };
 
+/**
+ * Running totals of one address and asset over the active chain, kept next to the address
+ * index under a CAddressIndexIteratorAssetKey, so a balance is one read instead of a scan of the
+ * address's whole history.
+ */
+struct CAddressBalanceValue {
+    CAmount balance;
+    //! Sum of everything received, including change
+    CAmount received;
+    //! Transactions that paid to or spent from the address
+    int64_t txCount;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(balance);
+        READWRITE(received);
+        READWRITE(txCount);
+    }
+
+    CAddressBalanceValue() {
+        SetNull();
+    }
+
+    void SetNull() {
+        balance = 0;
+        received = 0;
+        txCount = 0;
+    }
+
+    bool IsNull() const {
+        return balance == 0 && received == 0 && txCount == 0;
+    }
+};
+
 struct CMempoolAddressDelta
 {
     int64_t time;
@@ -7,9 +7,11 @@
 #include <consensus/params.h>
 #include <script/ismine.h>
 #include <tinyformat.h>
+#include "clientversion.h"
 #include "assetdb.h"
 #include "assets.h"
 #include "validation.h"
+#include "txdb.h"
 
 #include <boost/thread.hpp>
 
@@ -17,9 +19,15 @@ static const char ASSET_FLAG = 'A';
 static const char ASSET_ADDRESS_QUANTITY_FLAG = 'B';
 static const char ADDRESS_ASSET_QUANTITY_FLAG = 'C';
 static const char MY_ASSET_FLAG = 'M';
-static const char BLOCK_ASSET_UNDO_DATA = 'U';
+static const char BLOCK_ASSET_UNDO_DATA = 'U'; // Legacy encoding, migrated by Upgrade()
+static const char BLOCK_ASSET_UNDO_COMPACT = 'u';
 static const char MEMPOOL_REISSUED_TX = 'Z';
 
+// Asset record under the empty name, which no asset can have. Its value is the compact undo
+// version rather than a CDatabasedAssetData, so binaries from before the compact encoding fail
+// to load the database instead of disconnecting blocks without their asset undo data.
+static const std::string ASSET_UNDO_VERSION_KEY = "";
+
 static size_t MAX_DATABASE_RESULTS = 50000;
 
 CAssetsDB::CAssetsDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "assets", nCacheSize, fMemory, fWipe) {
@@ -86,14 +94,20 @@ bool EraseAddressAssetQuantity(const std::string &address, const std::string &as
 
 bool CAssetsDB::WriteBlockUndoAssetData(const uint256& blockhash, const std::vector<std::pair<std::string, CBlockAssetUndo> >& assetUndoData)
 {
-    return Write(std::make_pair(BLOCK_ASSET_UNDO_DATA, blockhash), assetUndoData);
+    return Write(std::make_pair(BLOCK_ASSET_UNDO_COMPACT, blockhash), CBlockAssetUndoCompressor(REF(assetUndoData)));
 }
 
 bool CAssetsDB::ReadBlockUndoAssetData(const uint256 &blockhash, std::vector<std::pair<std::string, CBlockAssetUndo> > &assetUndoData)
 {
     // If it exists, return the read value.
+    if (Exists(std::make_pair(BLOCK_ASSET_UNDO_COMPACT, blockhash))) {
+        CBlockAssetUndoCompressor compressor(assetUndoData);
+        return Read(std::make_pair(BLOCK_ASSET_UNDO_COMPACT, blockhash), compressor);
+    }
+
+    // Not migrated yet
     if (Exists(std::make_pair(BLOCK_ASSET_UNDO_DATA, blockhash)))
-           return Read(std::make_pair(BLOCK_ASSET_UNDO_DATA, blockhash), assetUndoData);
+        return Read(std::make_pair(BLOCK_ASSET_UNDO_DATA, blockhash), assetUndoData);
 
     // If it doesn't exist, we just return true because we don't want to fail just because it didn't exist in the db
     return true;
@@ -117,6 +131,63 @@ bool CAssetsDB::ReadReissuedMempoolState()
     return rv;
 }
 
+bool CAssetsDB::Upgrade()
+{
+    // Lock older binaries out before the first legacy record goes away. An interrupted
+    // migration is picked up again on the next start, reads fall back to the legacy key meanwhile.
+    if (!Exists(std::make_pair(ASSET_FLAG, ASSET_UNDO_VERSION_KEY))) {
+        CDBBatch batch(*this);
+        batch.Write(std::make_pair(ASSET_FLAG, ASSET_UNDO_VERSION_KEY), BLOCK_ASSET_UNDO_COMPACT_VERSION);
+        if (!WriteBatch(batch, true))
+            return error("%s: failed to write the asset undo version", __func__);
+    }
+
+    CDBBatch batch(*this);
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(std::make_pair(BLOCK_ASSET_UNDO_DATA, uint256()));
+
+    size_t count = 0;
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, uint256> key;
+        if (!pcursor->GetKey(key) || key.first != BLOCK_ASSET_UNDO_DATA)
+            break;
+
+        if (count == 0)
+            LogPrintf("%s: Upgrading asset undo data to the compact encoding\n", __func__);
+
+        std::vector<std::pair<std::string, CBlockAssetUndo> > vUndo;
+        if (!pcursor->GetValue(vUndo))
+            return error("%s: failed to read asset undo data of block %s", __func__, key.second.GetHex());
+
+        batch.Write(std::make_pair(BLOCK_ASSET_UNDO_COMPACT, key.second), CBlockAssetUndoCompressor(vUndo));
+        batch.Erase(key);
+        count++;
+
+        if (batch.SizeEstimate() > nDefaultDbBatchSize) {
+            if (!WriteBatch(batch))
+                return error("%s: failed to write asset undo data", __func__);
+            batch.Clear();
+        }
+        pcursor->Next();
+    }
+
+    if (count == 0)
+        return true;
+    if (!WriteBatch(batch))
+        return error("%s: failed to write asset undo data", __func__);
+
+    LogPrintf("%s: Upgraded asset undo data of %u blocks\n", __func__, count);
+    return true;
+}
+
+bool CAssetsDB::IsUndoVersionKey(const std::vector<unsigned char>& vchKey)
+{
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ssKey << std::make_pair(ASSET_FLAG, ASSET_UNDO_VERSION_KEY);
+    return vchKey.size() == ssKey.size() && std::equal(vchKey.begin(), vchKey.end(), (const unsigned char*)ssKey.data());
+}
+
 bool CAssetsDB::LoadAssets()
 {
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
@@ -128,6 +199,10 @@ bool CAssetsDB::LoadAssets()
         boost::this_thread::interruption_point();
         std::pair<char, std::string> key;
         if (pcursor->GetKey(key) && key.first == ASSET_FLAG) {
+            if (key.second == ASSET_UNDO_VERSION_KEY) {
+                pcursor->Next();
+                continue;
+            }
             CDatabasedAssetData data;
             if (pcursor->GetValue(data)) {
                 passetsCache->Put(data.asset.strName, data);
@@ -197,7 +272,7 @@ bool CAssetsDB::AssetDir(std::vector<CDatabasedAssetData>& assets, const std::st
             boost::this_thread::interruption_point();
 
             std::pair<char, std::string> key;
-            if (pcursor->GetKey(key) && key.first == ASSET_FLAG) {
+            if (pcursor->GetKey(key) && key.first == ASSET_FLAG && key.second != ASSET_UNDO_VERSION_KEY) {
                 if (prefix == "" ||
                     (wildcard && key.second.find(prefix) == 0) ||
                     (!wildcard && key.second == prefix)) {
@@ -220,6 +295,10 @@ bool CAssetsDB::AssetDir(std::vector<CDatabasedAssetData>& assets, const std::st
 
         std::pair<char, std::string> key;
         if (pcursor->GetKey(key) && key.first == ASSET_FLAG) {
+            if (key.second == ASSET_UNDO_VERSION_KEY) {
+                pcursor->Next();
+                continue;
+            }
             if (prefix == "" ||
                     (wildcard && key.second.find(prefix) == 0) ||
                     (!wildcard && key.second == prefix)) {
@@ -30,6 +30,13 @@ struct CBlockAssetUndo
     bool fChangedVerifierString;
     std::string verifierString;
 
+    CBlockAssetUndo() : fChangedIPFS(false), fChangedUnits(false), nUnits(0), version(0), fChangedVerifierString(false) { }
+
+    CBlockAssetUndo(bool fChangedIPFSIn, bool fChangedUnitsIn, const std::string& strIPFSIn, int32_t nUnitsIn, int8_t versionIn,
+                    bool fChangedVerifierStringIn, const std::string& verifierStringIn)
+        : fChangedIPFS(fChangedIPFSIn), fChangedUnits(fChangedUnitsIn), strIPFS(strIPFSIn), nUnits(nUnitsIn), version(versionIn),
+          fChangedVerifierString(fChangedVerifierStringIn), verifierString(verifierStringIn) { }
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
@@ -39,6 +46,9 @@ struct CBlockAssetUndo
         READWRITE(strIPFS);
         READWRITE(nUnits);
         if (ser_action.ForRead()) {
+            // Records from before verifier strings never changed one
+            fChangedVerifierString = false;
+            verifierString.clear();
             if (!s.empty() and s.size() >= 1) {
                 int8_t nVersionCheck;
                 ::Unserialize(s, nVersionCheck);
@@ -57,6 +67,99 @@ struct CBlockAssetUndo
     }
 };
 
+/** Version of the compact encoding of a block's asset undo records */
+static const uint8_t BLOCK_ASSET_UNDO_COMPACT_VERSION = 1;
+
+/**
+ * Compact encoding of a block's asset undo records.
+ *
+ * Every asset name is stored once and referenced by its index, and each
+ * record only carries the fields its reissue actually changed:
+ *
+ *   version, names table, then for every record:
+ *   VARINT(name index), flags, [strIPFS], [nUnits], [verifierString]
+ */
+class CBlockAssetUndoCompressor
+{
+private:
+    std::vector<std::pair<std::string, CBlockAssetUndo> > &vUndo;
+
+    enum : uint8_t {
+        CHANGED_IPFS = 1 << 0,
+        CHANGED_UNITS = 1 << 1,
+        CHANGED_VERIFIER = 1 << 2,
+    };
+
+public:
+    explicit CBlockAssetUndoCompressor(std::vector<std::pair<std::string, CBlockAssetUndo> > &vUndoIn) : vUndo(vUndoIn) { }
+
+    template<typename Stream>
+    void Serialize(Stream &s) const {
+        std::vector<std::string> vNames;
+        std::map<std::string, uint64_t> mapNameIndex;
+        for (const auto& item : vUndo) {
+            if (mapNameIndex.emplace(item.first, vNames.size()).second)
+                vNames.push_back(item.first);
+        }
+
+        ::Serialize(s, BLOCK_ASSET_UNDO_COMPACT_VERSION);
+        ::Serialize(s, vNames);
+        WriteCompactSize(s, vUndo.size());
+        for (const auto& item : vUndo) {
+            const CBlockAssetUndo& undo = item.second;
+            uint64_t nIndex = mapNameIndex.at(item.first);
+            uint8_t nFlags = (undo.fChangedIPFS ? CHANGED_IPFS : 0) | (undo.fChangedUnits ? CHANGED_UNITS : 0) |
+                             (undo.fChangedVerifierString ? CHANGED_VERIFIER : 0);
+            s << VARINT(nIndex);
+            ::Serialize(s, nFlags);
+            if (undo.fChangedIPFS)
+                ::Serialize(s, undo.strIPFS);
+            if (undo.fChangedUnits)
+                ::Serialize(s, (int8_t)undo.nUnits);
+            if (undo.fChangedVerifierString)
+                ::Serialize(s, undo.verifierString);
+        }
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream &s) {
+        uint8_t nVersion;
+        ::Unserialize(s, nVersion);
+        if (nVersion != BLOCK_ASSET_UNDO_COMPACT_VERSION)
+            throw std::ios_base::failure("Unknown asset undo version");
+
+        std::vector<std::string> vNames;
+        ::Unserialize(s, vNames);
+
+        vUndo.clear();
+        vUndo.resize(ReadCompactSize(s));
+        for (auto& item : vUndo) {
+            uint64_t nIndex = 0;
+            uint8_t nFlags;
+            s >> VARINT(nIndex);
+            ::Unserialize(s, nFlags);
+            if (nIndex >= vNames.size())
+                throw std::ios_base::failure("Asset undo name index out of range");
+
+            CBlockAssetUndo& undo = item.second;
+            item.first = vNames[nIndex];
+            undo.version = ASSET_UNDO_INCLUDES_VERIFIER_STRING;
+            undo.fChangedIPFS = nFlags & CHANGED_IPFS;
+            undo.fChangedUnits = nFlags & CHANGED_UNITS;
+            undo.fChangedVerifierString = nFlags & CHANGED_VERIFIER;
+            if (undo.fChangedIPFS)
+                ::Unserialize(s, undo.strIPFS);
+            if (undo.fChangedUnits) {
+                int8_t nUnits;
+                ::Unserialize(s, nUnits);
+                undo.nUnits = nUnits;
+            }
+            if (undo.fChangedVerifierString)
+                ::Unserialize(s, undo.verifierString);
+        }
+    }
+};
+
 /** Access to the block database (blocks/index/) */
 class CAssetsDB : public CDBWrapper
 {
@@ -88,6 +191,9 @@ public:
 
     // Helper functions
     bool LoadAssets();
+    bool Upgrade();
+    //! Whether a raw key is the asset undo version marker rather than asset state
+    static bool IsUndoVersionKey(const std::vector<unsigned char>& vchKey);
     bool AssetDir(std::vector<CDatabasedAssetData>& assets, const std::string filter, const size_t count, const long start);
     bool AssetDir(std::vector<CDatabasedAssetData>& assets);
 
@@ -11,6 +11,7 @@
 #include "messages.h"
 #include "myassetsdb.h"
 #include <primitives/block.h>
+#include <crypto/common.h>
 
 
 std::set<COutPoint> setDirtyMessagesRemove;
@@ -19,7 +20,8 @@ std::map<COutPoint, CMessage> mapDirtyMessagesOrphaned;
 
 std::set<std::string> setDirtyChannelsAdd;
 std::set<std::string> setDirtyChannelsRemove;
-std::set<std::string> setSubscribedChannelsAskedForFalse;
+
+std::unordered_set<std::string> setSubscribedChannels;
 
 std::set<std::string> setDirtySeenAddressAdd;
 std::set<std::string> setAddressAskedForFalse;
@@ -65,37 +67,30 @@ CMessage::CMessage(const COutPoint& out, const std::string& strName, const std::
     status = MessageStatus::UNREAD;
 }
 
-bool IsChannelSubscribed(const std::string &name)
+bool LoadSubscribedChannels()
 {
-    if (!pMessageSubscribedChannelsCache || !pmessagechanneldb)
+    setSubscribedChannels.clear();
+    if (!pmessagechanneldb)
         return false;
 
-    // Check Dirty Cache for newly added channel additions
-    if (setDirtyChannelsAdd.count(name))
-        return true;
-
-    // Check Dirty Cache for newly removed channels
-    if (setDirtyChannelsRemove.count(name))
+    std::set<std::string> setChannels;
+    if (!pmessagechanneldb->LoadMyMessageChannels(setChannels))
         return false;
 
-    // Check the Channel Cache and see if it is in the Cache
-    if (pMessageSubscribedChannelsCache->Exists(name))
-        return true;
+    setSubscribedChannels.insert(setChannels.begin(), setChannels.end());
+    for (auto name : setDirtyChannelsRemove)
+        setSubscribedChannels.erase(name);
+    setSubscribedChannels.insert(setDirtyChannelsAdd.begin(), setDirtyChannelsAdd.end());
 
-    // Check if we have already searched for this before
-    if (setSubscribedChannelsAskedForFalse.count(name))
-        return false;
-
-    // Check to see if the message database contains the asset
-    if (pmessagechanneldb->ReadMyMessageChannel(name)) {
-        pMessageSubscribedChannelsCache->Put(name, 1);
-        return true;
-    }
+    return true;
+}
 
-    // Help prevent spam and unneeded database reads
-    setSubscribedChannelsAskedForFalse.insert(name);
+bool IsChannelSubscribed(const std::string &name)
+{
+    if (!pmessagechanneldb)
+        return false;
 
-    return false;
+    return setSubscribedChannels.count(name) > 0;
 }
 
 bool GetMessage(const COutPoint& out, CMessage& message)
@@ -135,7 +130,8 @@ void AddChannel(const std::string &name)
 
     // If the channel name is in the dirty remove cache. Remove it so it doesn't get deleted on flush
     setDirtyChannelsRemove.erase(name);
-    setSubscribedChannelsAskedForFalse.erase(name);
+
+    setSubscribedChannels.insert(name);
 }
 
 void RemoveChannel(const std::string &name)
@@ -145,6 +141,8 @@ void RemoveChannel(const std::string &name)
 
     // If the channel name is in the dirty add cache. Remove it so it doesn't get added on flush
     setDirtyChannelsAdd.erase(name);
+
+    setSubscribedChannels.erase(name);
 }
 
 void AddMessage(const CMessage& message)
@@ -187,6 +185,103 @@ void OrphanMessage(const CMessage& message)
     mapDirtyMessagesAdd.erase(message.out);
 }
 
+// Order of a message within the results of query, matching the database iteration order
+static bool MessageQueryLess(const CMessageQuery& query, const CMessage& a, int64_t nTimeB, const COutPoint& b)
+{
+    if (!query.channel.empty() && a.time != nTimeB)
+        return a.time < nTimeB;
+
+    if (a.out.hash != b.hash)
+        return a.out.hash < b.hash;
+
+    // The outpoint database key stores n little endian, the channel index big endian
+    if (query.channel.empty()) {
+        unsigned char na[4], nb[4];
+        WriteLE32(na, a.out.n);
+        WriteLE32(nb, b.n);
+        return memcmp(na, nb, sizeof(na)) < 0;
+    }
+    return a.out.n < b.n;
+}
+
+static bool MessageMatchesQuery(const CMessageQuery& query, const CMessage& message)
+{
+    if (!query.channel.empty() && message.strName != query.channel)
+        return false;
+    if (message.time < query.nStartTime || message.time > query.nEndTime)
+        return false;
+    if (query.fAfter && !MessageQueryLess(query, CMessage(query.after, "", "", 0, query.nAfterTime), message.time, message.out))
+        return false;
+    return true;
+}
+
+bool GetMessages(const CMessageQuery& query, std::vector<CMessage>& vMessages, bool& fMore)
+{
+    AssertLockHeld(cs_messaging);
+    vMessages.clear();
+    fMore = false;
+
+    if (!pmessagedb)
+        return false;
+
+    // Read enough from the database that the dirty removals can't shrink the page below the limit
+    size_t nDbLimit = query.nLimit ? query.nLimit + setDirtyMessagesRemove.size() : 0;
+    std::vector<CMessage> vDbMessages;
+    bool fDbMore = false;
+    if (query.channel.empty()) {
+        if (!pmessagedb->ReadMessages(query.fAfter ? &query.after : nullptr, query.nStartTime, query.nEndTime, nDbLimit, vDbMessages, fDbMore))
+            return false;
+    } else {
+        CMessageChannelKey after(query.channel, query.nAfterTime, query.after);
+        if (!pmessagedb->ReadChannelMessages(query.channel, query.nStartTime, query.nEndTime, query.fAfter ? &after : nullptr, nDbLimit, vDbMessages, fDbMore))
+            return false;
+    }
+
+    // Overlay the dirty caches that haven't been flushed yet
+    std::set<COutPoint> setSeen;
+    for (auto message : vDbMessages) {
+        setSeen.insert(message.out);
+        if (setDirtyMessagesRemove.count(message.out))
+            continue;
+
+        if (mapDirtyMessagesAdd.count(message.out)) {
+            message = mapDirtyMessagesAdd.at(message.out);
+        } else if (mapDirtyMessagesOrphaned.count(message.out)) {
+            message = mapDirtyMessagesOrphaned.at(message.out);
+            message.status = MessageStatus::ORPHAN;
+        }
+        vMessages.push_back(message);
+    }
+
+    auto addDirty = [&](CMessage message, bool fOrphan) {
+        if (setSeen.count(message.out) || !MessageMatchesQuery(query, message))
+            return;
+        // Past the last database entry read, there may be database entries ordered before this one
+        if (fDbMore && MessageQueryLess(query, vDbMessages.back(), message.time, message.out))
+            return;
+        if (fOrphan)
+            message.status = MessageStatus::ORPHAN;
+        setSeen.insert(message.out);
+        vMessages.push_back(message);
+    };
+    for (auto pair : mapDirtyMessagesAdd)
+        addDirty(pair.second, false);
+    for (auto pair : mapDirtyMessagesOrphaned)
+        addDirty(pair.second, true);
+
+    std::sort(vMessages.begin(), vMessages.end(), [&query](const CMessage& a, const CMessage& b) {
+        return MessageQueryLess(query, a, b.time, b.out);
+    });
+
+    fMore = fDbMore;
+    if (query.nLimit && vMessages.size() > query.nLimit) {
+        vMessages.resize(query.nLimit);
+        fMore = true;
+    }
+
+    return true;
+}
+
 #ifdef ENABLE_WALLET
 bool ScanForMessageChannels(std::string& strError)
 {
@@ -296,7 +391,7 @@ bool IsAddressSeen(const std::string &address)
 void AddAddressSeen(const std::string &address)
 {
     setDirtySeenAddressAdd.insert(address);
-    setSubscribedChannelsAskedForFalse.erase(address);
+    setAddressAskedForFalse.erase(address);
 }
 
 size_t GetMessageDirtyCacheSize()
@@ -323,7 +418,6 @@ size_t GetMessageDirtyCacheSize()
     // Message Channel Caches
     size += 32 * setDirtyChannelsAdd.size();
     size += 32 * setDirtyChannelsRemove.size();
-    size += 32 * setSubscribedChannelsAskedForFalse.size();
 
     // Address Seen Caches
     size += 32 * setDirtySeenAddressAdd.size();
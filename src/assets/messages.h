@@ -9,9 +9,12 @@
 
 #include <uint256.h>
 #include <serialize.h>
+#include <primitives/transaction.h>
+
+#include <limits>
+#include <unordered_set>
 
 class CMessage;
-class COutPoint;
 
 // Message Database caches
 extern std::set<COutPoint> setDirtyMessagesRemove;
@@ -21,7 +24,9 @@ extern std::map<COutPoint, CMessage> mapDirtyMessagesOrphaned;
 // Message Channel Database caches
 extern std::set<std::string> setDirtyChannelsAdd;
 extern std::set<std::string> setDirtyChannelsRemove;
-extern std::set<std::string> setSubscribedChannelsAskedForFalse;
+
+// All subscribed channels, including the dirty additions
+extern std::unordered_set<std::string> setSubscribedChannels;
 
 // Spam prevention address index
 extern std::set<std::string> setDirtySeenAddressAdd;
@@ -31,6 +36,7 @@ extern std::set<std::string> setAddressAskedForFalse;
 extern CCriticalSection cs_messaging;
 
 size_t GetMessageDirtyCacheSize();
+bool LoadSubscribedChannels(); // Fill setSubscribedChannels from the channel database
 bool IsChannelSubscribed(const std::string &name); // Is this channel marked as spamA
 
 bool GetMessage(const COutPoint &out, CMessage &message);
@@ -47,6 +53,20 @@ void RemoveMessage(const COutPoint &out);
 void OrphanMessage(const CMessage &message);
 void OrphanMessage(const COutPoint &out);
 
+/** Filter and position of a paged message read, see GetMessages */
+struct CMessageQuery {
+    std::string channel; //!< Only this channel, ordered by time. Empty for all messages, ordered by outpoint
+    int64_t nStartTime = 0;
+    int64_t nEndTime = std::numeric_limits<int64_t>::max();
+    size_t nLimit = 0; //!< 0 for no limit
+
+    bool fAfter = false; //!< Continue after (nAfterTime, after) from a previous page
+    int64_t nAfterTime = 0;
+    COutPoint after;
+};
+
+bool GetMessages(const CMessageQuery &query, std::vector<CMessage> &vMessages, bool &fMore);
+
 #ifdef ENABLE_WALLET
 bool ScanForMessageChannels(std::string& strError);
 #endif
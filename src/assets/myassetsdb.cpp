@@ -5,11 +5,12 @@
 #include "validation.h"
 #include "myassetsdb.h"
 #include "messages.h"
-#include <boost/thread.hpp>
+#include "txdb.h"
 
 #include <boost/thread.hpp>
 
 static const char MESSAGE_FLAG = 'Z'; // Message
+static const char MESSAGE_CHANNEL_FLAG = 'H'; // Message channel index, by channel and time
 static const char MY_MESSAGE_CHANNEL = 'C'; // My followed Channels
 static const char MY_SEEN_ADDRESSES = 'S'; // Addresses that have been seen on the chain
 static const char DB_FLAG = 'D'; // Database Flags
@@ -20,9 +21,23 @@ static const char MY_RESTRICTED_ADDRESSES = 'R'; // Addresses that have been res
 CMessageDB::CMessageDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "messages" / "messages", nCacheSize, fMemory, fWipe) {
 }
 
+static void BatchWriteMessage(CDBBatch& batch, const CMessage& message)
+{
+    batch.Write(std::make_pair(MESSAGE_FLAG, message.out), message);
+    batch.Write(std::make_pair(MESSAGE_CHANNEL_FLAG, CMessageChannelKey(message.strName, message.time, message.out)), '1');
+}
+
+static void BatchEraseMessage(CDBBatch& batch, const CMessage& message)
+{
+    batch.Erase(std::make_pair(MESSAGE_FLAG, message.out));
+    batch.Erase(std::make_pair(MESSAGE_CHANNEL_FLAG, CMessageChannelKey(message.strName, message.time, message.out)));
+}
+
 bool CMessageDB::WriteMessage(const CMessage &message)
 {
-    return Write(std::make_pair(MESSAGE_FLAG, message.out), message);
+    CDBBatch batch(*this);
+    BatchWriteMessage(batch, message);
+    return WriteBatch(batch);
 }
 
 bool CMessageDB::ReadMessage(const COutPoint &out, CMessage &message)
@@ -32,89 +47,179 @@ bool CMessageDB::ReadMessage(const COutPoint &out, CMessage &message)
 
 bool CMessageDB::EraseMessage(const COutPoint &out)
 {
-    return Erase(std::make_pair(MESSAGE_FLAG, out));
+    CMessage message;
+    if (!ReadMessage(out, message))
+        return Erase(std::make_pair(MESSAGE_FLAG, out));
+
+    CDBBatch batch(*this);
+    BatchEraseMessage(batch, message);
+    return WriteBatch(batch);
 }
 
-bool CMessageDB::LoadMessages(std::set<CMessage>& setMessages)
+bool CMessageDB::ReadMessages(const COutPoint* pAfter, int64_t nStartTime, int64_t nEndTime, size_t nLimit, std::vector<CMessage>& vMessages, bool& fMore)
 {
+    fMore = false;
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
-    pcursor->Seek(std::make_pair(MESSAGE_FLAG, COutPoint()));
+    pcursor->Seek(std::make_pair(MESSAGE_FLAG, pAfter ? *pAfter : COutPoint(uint256(), 0)));
 
-    // Load messages
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         std::pair<char, COutPoint> key;
-        if (pcursor->GetKey(key) && key.first == MESSAGE_FLAG) {
-            CMessage message;
-            if (pcursor->GetValue(message)) {
-                setMessages.insert(message);
-                pcursor->Next();
-            } else {
-                LogPrintf("%s: failed to read message\n", __func__);
-                pcursor->Next();
+        if (!pcursor->GetKey(key) || key.first != MESSAGE_FLAG)
+            break;
+
+        if (pAfter && key.second == *pAfter) {
+            pcursor->Next();
+            continue;
+        }
+
+        CMessage message;
+        if (!pcursor->GetValue(message)) {
+            LogPrintf("%s: failed to read message\n", __func__);
+        } else if (message.time >= nStartTime && message.time <= nEndTime) {
+            if (nLimit && vMessages.size() >= nLimit) {
+                fMore = true;
+                break;
             }
-        } else {
+            vMessages.push_back(message);
+        }
+        pcursor->Next();
+    }
+
+    return true;
+}
+
+bool CMessageDB::ReadChannelMessages(const std::string& channel, int64_t nStartTime, int64_t nEndTime, const CMessageChannelKey* pAfter, size_t nLimit, std::vector<CMessage>& vMessages, bool& fMore)
+{
+    fMore = false;
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+
+    CMessageChannelKey start(channel, nStartTime, COutPoint(uint256(), 0));
+    if (pAfter && pAfter->time >= nStartTime)
+        start = CMessageChannelKey(channel, pAfter->time, pAfter->out);
+    pcursor->Seek(std::make_pair(MESSAGE_CHANNEL_FLAG, start));
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, CMessageChannelKey> key;
+        if (!pcursor->GetKey(key) || key.first != MESSAGE_CHANNEL_FLAG || key.second.channel != channel || key.second.time > nEndTime)
+            break;
+
+        if (pAfter && !(*pAfter < key.second)) {
+            pcursor->Next();
+            continue;
+        }
+
+        if (nLimit && vMessages.size() >= nLimit) {
+            fMore = true;
             break;
         }
+
+        CMessage message;
+        if (ReadMessage(key.second.out, message))
+            vMessages.push_back(message);
+        else
+            LogPrintf("%s: failed to read indexed message %s\n", __func__, key.second.out.ToString());
+        pcursor->Next();
     }
+
     return true;
 }
 
 bool CMessageDB::EraseAllMessages(int& count)
 {
-    std::set<CMessage> setMessages;
+    CDBBatch batch(*this);
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
-    pcursor->Seek(std::make_pair(MESSAGE_FLAG, COutPoint()));
+    pcursor->Seek(std::make_pair(MESSAGE_FLAG, COutPoint(uint256(), 0)));
 
-    // Load messages
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         std::pair<char, COutPoint> key;
         if (pcursor->GetKey(key) && key.first == MESSAGE_FLAG) {
             CMessage message;
             if (pcursor->GetValue(message)) {
-                setMessages.insert(message);
-                pcursor->Next();
+                BatchEraseMessage(batch, message);
+                count++;
             } else {
                 LogPrintf("%s: failed to read message\n", __func__);
-                pcursor->Next();
+                batch.Erase(key);
             }
+            pcursor->Next();
         } else {
             break;
         }
     }
 
-    count += setMessages.size();
-    for (auto message : setMessages)
-        EraseMessage(message.out);
+    return WriteBatch(batch);
+}
+
+bool CMessageDB::Upgrade()
+{
+    bool fIndexed = false;
+    if (ReadFlag("channelindex", fIndexed) && fIndexed)
+        return true;
+
+    LogPrintf("%s: Building message channel index\n", __func__);
+
+    CDBBatch batch(*this);
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(std::make_pair(MESSAGE_FLAG, COutPoint(uint256(), 0)));
+
+    size_t count = 0;
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, COutPoint> key;
+        if (!pcursor->GetKey(key) || key.first != MESSAGE_FLAG)
+            break;
+
+        CMessage message;
+        if (pcursor->GetValue(message)) {
+            batch.Write(std::make_pair(MESSAGE_CHANNEL_FLAG, CMessageChannelKey(message.strName, message.time, message.out)), '1');
+            count++;
+        }
+
+        if (batch.SizeEstimate() > nDefaultDbBatchSize) {
+            if (!WriteBatch(batch))
+                return error("%s: failed to write message channel index", __func__);
+            batch.Clear();
+        }
+        pcursor->Next();
+    }
+
+    batch.Write(std::make_pair(DB_FLAG, std::string("channelindex")), '1');
+    if (!WriteBatch(batch))
+        return error("%s: failed to write message channel index", __func__);
 
+    LogPrintf("%s: Indexed %u messages\n", __func__, count);
     return true;
 }
 
 bool CMessageDB::Flush() {
     try {
+        CDBBatch batch(*this);
 
         for (auto messageRemove : setDirtyMessagesRemove) {
-            if (!EraseMessage(messageRemove))
-                return error("%s: failed to erase message %s", __func__, messageRemove.ToString());
+            CMessage message;
+            if (ReadMessage(messageRemove, message))
+                BatchEraseMessage(batch, message);
         }
 
         for (auto messageAdd : mapDirtyMessagesAdd) {
-            if (!WriteMessage(messageAdd.second))
-                return error("%s: failed to write message %s", __func__, messageAdd.second.ToString());
-
+            BatchWriteMessage(batch, messageAdd.second);
             mapDirtyMessagesOrphaned.erase(messageAdd.first);
         }
 
         for (auto orphans : mapDirtyMessagesOrphaned) {
             CMessage msg = orphans.second;
             msg.status = MessageStatus::ORPHAN;
-            if (!WriteMessage(msg))
-                return error("%s: failed to write message orphan %s", __func__, msg.ToString());
+            BatchWriteMessage(batch, msg);
         }
 
+        if (!WriteBatch(batch))
+            return error("%s: failed to write messages", __func__);
+
         setDirtyMessagesRemove.clear();
         mapDirtyMessagesAdd.clear();
         mapDirtyMessagesOrphaned.clear();
@@ -231,7 +336,6 @@ bool CMessageChannelDB::Flush() {
         setDirtyChannelsRemove.clear();
         setDirtyChannelsAdd.clear();
         setDirtySeenAddressAdd.clear();
-        setSubscribedChannelsAskedForFalse.clear();
         setAddressAskedForFalse.clear();
     } catch (const std::runtime_error& e) {
         return error("%s : %s ", __func__, std::string("System error while flushing messagechannels: ") + e.what());
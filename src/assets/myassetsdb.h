@@ -7,9 +7,42 @@
 #define AIDPCOIN_MYASSETSDB_H
 
 #include <dbwrapper.h>
+#include <primitives/transaction.h>
 
 class CMessage;
-class COutPoint;
+
+/** Key of the message channel index, ordered by channel, then time, then outpoint */
+struct CMessageChannelKey {
+    std::string channel;
+    int64_t time;
+    COutPoint out;
+
+    CMessageChannelKey() : time(0) {}
+    CMessageChannelKey(const std::string& channelIn, int64_t timeIn, const COutPoint& outIn) : channel(channelIn), time(timeIn), out(outIn) {}
+
+    bool operator<(const CMessageChannelKey& rhs) const {
+        if (time != rhs.time)
+            return time < rhs.time;
+        return out < rhs.out;
+    }
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        ::Serialize(s, channel);
+        // Big endian so LevelDB iterates a channel in time order
+        ser_writedata64be(s, (uint64_t)time);
+        ::Serialize(s, out.hash);
+        ser_writedata32be(s, out.n);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        ::Unserialize(s, channel);
+        time = (int64_t)ser_readdata64be(s);
+        ::Unserialize(s, out.hash);
+        out.n = ser_readdata32be(s);
+    }
+};
 
 class CMessageDB  : public CDBWrapper {
 
@@ -23,9 +56,15 @@ public:
     bool WriteMessage(const CMessage& message);
     bool ReadMessage(const COutPoint& out, CMessage& message);
     bool EraseMessage(const COutPoint& out);
-    bool LoadMessages(std::set<CMessage>& setMessages);
     bool EraseAllMessages(int& count);
 
+    // Paged reads straight from the database. fMore is set when more than nLimit (0 for no limit) messages match
+    bool ReadMessages(const COutPoint* pAfter, int64_t nStartTime, int64_t nEndTime, size_t nLimit, std::vector<CMessage>& vMessages, bool& fMore);
+    bool ReadChannelMessages(const std::string& channel, int64_t nStartTime, int64_t nEndTime, const CMessageChannelKey* pAfter, size_t nLimit, std::vector<CMessage>& vMessages, bool& fMore);
+
+    // Build the channel index for databases created before it existed
+    bool Upgrade();
+
     // Write / Read Database flags
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
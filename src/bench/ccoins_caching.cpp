@@ -6,6 +6,7 @@
 
 #include "bench.h"
 #include "coins.h"
+#include "crypto/common.h"
 #include "policy/policy.h"
 #include "wallet/crypter.h"
 
@@ -87,3 +88,71 @@ static void CCoinsCaching(benchmark::State& state)
 }
 
 BENCHMARK(CCoinsCaching);
+
+// Number of coins used by the large cache benchmarks; big enough that the
+// map's node allocations dominate.
+static const uint32_t LARGE_CACHE_COINS = 100000;
+
+static COutPoint BenchOutPoint(uint32_t i)
+{
+    uint256 hash;
+    WriteLE32(hash.begin(), i / 4);
+    return COutPoint(hash, i % 4);
+}
+
+static Coin BenchCoin()
+{
+    CTxOut out(CENT, CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 1) << OP_EQUALVERIFY << OP_CHECKSIG);
+    return Coin(std::move(out), 1, false);
+}
+
+// Fill a cache, then spend every coin in it: the insert/erase churn seen while
+// connecting blocks.
+static void CCoinsCacheInsertErase(benchmark::State& state)
+{
+    CCoinsView coinsDummy;
+    while (state.KeepRunning()) {
+        CCoinsViewCache coins(&coinsDummy);
+        for (uint32_t i = 0; i < LARGE_CACHE_COINS; i++) {
+            coins.AddCoin(BenchOutPoint(i), BenchCoin(), false);
+        }
+        for (uint32_t i = 0; i < LARGE_CACHE_COINS; i++) {
+            coins.SpendCoin(BenchOutPoint(i));
+        }
+    }
+}
+
+static void CCoinsCacheLookup(benchmark::State& state)
+{
+    CCoinsView coinsDummy;
+    CCoinsViewCache coins(&coinsDummy);
+    for (uint32_t i = 0; i < LARGE_CACHE_COINS; i++) {
+        coins.AddCoin(BenchOutPoint(i), BenchCoin(), false);
+    }
+
+    uint32_t i = 0;
+    while (state.KeepRunning()) {
+        bool found = coins.HaveCoinInCache(BenchOutPoint(i));
+        assert(found);
+        i = (i + 7919) % LARGE_CACHE_COINS;
+    }
+}
+
+// Flush a child cache into its parent, as done after every connected block.
+static void CCoinsCacheFlush(benchmark::State& state)
+{
+    CCoinsView coinsDummy;
+    CCoinsViewCache base(&coinsDummy);
+    while (state.KeepRunning()) {
+        CCoinsViewCache coins(&base);
+        for (uint32_t i = 0; i < LARGE_CACHE_COINS; i++) {
+            coins.AddCoin(BenchOutPoint(i), BenchCoin(), true);
+        }
+        bool success = coins.Flush();
+        assert(success);
+    }
+}
+
+BENCHMARK(CCoinsCacheInsertErase);
+BENCHMARK(CCoinsCacheLookup);
+BENCHMARK(CCoinsCacheFlush);
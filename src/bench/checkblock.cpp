@@ -35,6 +35,21 @@ static void DeserializeBlockTest(benchmark::State& state)
     }
 }
 
+static void DeserializeBlockArenaTest(benchmark::State& state)
+{
+    CDataStream stream((const char*)block_bench::block566553,
+            (const char*)&block_bench::block566553[sizeof(block_bench::block566553)],
+            SER_NETWORK, PROTOCOL_VERSION);
+    char a = '\0';
+    stream.write(&a, 1); // Prevent compaction
+
+    while (state.KeepRunning()) {
+        CBlock block;
+        UnserializeBlockInArena(stream, block);
+        assert(stream.Rewind(sizeof(block_bench::block566553)));
+    }
+}
+
 static void DeserializeAndCheckBlockTest(benchmark::State& state)
 {
     CDataStream stream((const char*)block_bench::block566553,
@@ -56,4 +71,5 @@ static void DeserializeAndCheckBlockTest(benchmark::State& state)
 }
 
 BENCHMARK(DeserializeBlockTest);
+BENCHMARK(DeserializeBlockArenaTest);
 BENCHMARK(DeserializeAndCheckBlockTest);
@@ -63,7 +63,7 @@ static void CCheckQueueSpeed(benchmark::State& state)
 // This Benchmark tests the CheckQueue with a slightly realistic workload,
 // where checks all contain a prevector that is indirect 50% of the time
 // and there is a little bit of work done between calls to Add.
-static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
+static void CCheckQueuePrevectorJob(benchmark::State& state, int nThreads)
 {
     struct PrevectorJob {
         prevector<PREVECTOR_SIZE, uint8_t> p;
@@ -80,7 +80,7 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
     };
     CCheckQueue<PrevectorJob> queue {QUEUE_BATCH_SIZE};
     boost::thread_group tg;
-    for (auto x = 0; x < std::max(MIN_CORES, GetNumCores()); ++x) {
+    for (auto x = 0; x < nThreads; ++x) {
        tg.create_thread([&]{queue.Thread();});
     }
     while (state.KeepRunning()) {
@@ -101,5 +101,31 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
     tg.interrupt_all();
     tg.join_all();
 }
+
+static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
+{
+    CCheckQueuePrevectorJob(state, std::max(MIN_CORES, GetNumCores()));
+}
+
+// Scaling of the same workload with the worker counts of large validation
+// machines, whatever the number of cores this runs on.
+static void CCheckQueueSpeedPrevectorJob4(benchmark::State& state)
+{
+    CCheckQueuePrevectorJob(state, 4);
+}
+
+static void CCheckQueueSpeedPrevectorJob16(benchmark::State& state)
+{
+    CCheckQueuePrevectorJob(state, 16);
+}
+
+static void CCheckQueueSpeedPrevectorJob64(benchmark::State& state)
+{
+    CCheckQueuePrevectorJob(state, 64);
+}
+
 BENCHMARK(CCheckQueueSpeed);
 BENCHMARK(CCheckQueueSpeedPrevectorJob);
+BENCHMARK(CCheckQueueSpeedPrevectorJob4);
+BENCHMARK(CCheckQueueSpeedPrevectorJob16);
+BENCHMARK(CCheckQueueSpeedPrevectorJob64);
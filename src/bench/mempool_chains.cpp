@@ -0,0 +1,81 @@
+// Copyright (c) 2023-2024 The Aidp Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "policy/policy.h"
+#include "txmempool.h"
+
+#include <vector>
+
+static const int CHAIN_DEEP_LENGTH = 25;
+static const int CHAIN_WIDE_COUNT = 1000;
+
+static void AddTx(const CTransactionRef& tx, CTxMemPool& pool)
+{
+    LockPoints lp;
+    pool.addUnchecked(tx->GetHash(), CTxMemPoolEntry(tx, 1000LL, 0, 1, false, 4, lp));
+}
+
+static CTransactionRef MakeTx(const std::vector<COutPoint>& vPrevouts, int nOutputs)
+{
+    CMutableTransaction tx;
+    for (const COutPoint& prevout : vPrevouts) {
+        tx.vin.emplace_back(prevout);
+        tx.vin.back().scriptSig = CScript() << OP_1;
+    }
+    tx.vout.resize(nOutputs);
+    for (CTxOut& txout : tx.vout) {
+        txout.scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        txout.nValue = COIN;
+    }
+    return MakeTransactionRef(tx);
+}
+
+// Add the transactions to the mempool in order, then take them out once as a block
+// confirming them would and once as a conflict with the first of them would.
+static void RunChain(benchmark::State& state, const std::vector<CTransactionRef>& vtx)
+{
+    CTxMemPool pool;
+
+    while (state.KeepRunning()) {
+        for (const CTransactionRef& tx : vtx)
+            AddTx(tx, pool);
+        pool.removeForBlock(vtx, 2);
+        assert(pool.size() == 0);
+
+        for (const CTransactionRef& tx : vtx)
+            AddTx(tx, pool);
+        pool.removeRecursive(*vtx.front());
+        assert(pool.size() == 0);
+    }
+}
+
+// A chain of transactions each spending the change of the one before, as a payout
+// run sending from the same wallet produces, up to the default ancestor limit.
+static void MempoolChainDeep(benchmark::State& state)
+{
+    std::vector<CTransactionRef> vtx;
+    vtx.push_back(MakeTx(std::vector<COutPoint>(1, COutPoint(uint256S("01"), 0)), 2));
+    for (int i = 1; i < CHAIN_DEEP_LENGTH; i++)
+        vtx.push_back(MakeTx(std::vector<COutPoint>(1, COutPoint(vtx.back()->GetHash(), 1)), 2));
+    RunChain(state, vtx);
+}
+
+// A transaction with many outputs and a child spending each of them, with a last
+// transaction gathering the outputs of all the children.
+static void MempoolChainWide(benchmark::State& state)
+{
+    std::vector<CTransactionRef> vtx;
+    vtx.push_back(MakeTx(std::vector<COutPoint>(1, COutPoint(uint256S("01"), 0)), CHAIN_WIDE_COUNT));
+    std::vector<COutPoint> vChildOutputs;
+    for (int i = 0; i < CHAIN_WIDE_COUNT; i++) {
+        vtx.push_back(MakeTx(std::vector<COutPoint>(1, COutPoint(vtx.front()->GetHash(), i)), 1));
+        vChildOutputs.emplace_back(vtx.back()->GetHash(), 0);
+    }
+    vtx.push_back(MakeTx(vChildOutputs, 1));
+    RunChain(state, vtx);
+}
+
+BENCHMARK(MempoolChainDeep);
+BENCHMARK(MempoolChainWide);
@@ -0,0 +1,64 @@
+// Copyright (c) 2023-2024 The Aidp Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "policy/policy.h"
+#include "txmempool.h"
+
+#include <vector>
+
+static const int RESTRICTED_TX_COUNT = 1000;
+static const int RESTRICTED_ASSET_COUNT = 20;
+static const int RESTRICTED_ADDRESS_COUNT = 100;
+
+static void AddTx(const CTransactionRef& tx, CTxMemPool& pool)
+{
+    LockPoints lp;
+    pool.addUnchecked(tx->GetHash(), CTxMemPoolEntry(tx, 1000LL, 0, 1, false, 4, lp));
+}
+
+// Fill a mempool with transactions that each carry the restricted asset records
+// AcceptToMemoryPool would create for a restricted transfer and a tag change, then
+// remove them all the way a connected block does.
+static void MempoolRestrictedAssets(benchmark::State& state)
+{
+    std::vector<CTransactionRef> vtx;
+    for (int i = 0; i < RESTRICTED_TX_COUNT; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].scriptSig = CScript() << i;
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        tx.vout[0].nValue = 10 * COIN;
+        vtx.push_back(MakeTransactionRef(tx));
+    }
+
+    CTxMemPool pool;
+
+    while (state.KeepRunning()) {
+        for (int i = 0; i < RESTRICTED_TX_COUNT; i++) {
+            const uint256& hash = vtx[i]->GetHash();
+            std::string asset = "$ASSET" + std::to_string(i % RESTRICTED_ASSET_COUNT);
+            std::string address = "address" + std::to_string(i % RESTRICTED_ADDRESS_COUNT);
+
+            AddTx(vtx[i], pool);
+            pool.addRestrictedEntry(hash, MempoolRestrictedType::ASSET_GLOBAL_FROZEN, asset);
+            pool.addRestrictedEntry(hash, MempoolRestrictedType::ADDRESS_FROZEN, asset, address);
+            pool.addRestrictedEntry(hash, MempoolRestrictedType::QUALIFIERS_CHANGED, "", address);
+            pool.addRestrictedEntry(hash, MempoolRestrictedType::VERIFIER_CHANGED, asset);
+            if (!pool.hasRestrictedAddressEntry(MempoolRestrictedType::ADDED_TAG, address, "#TAG"))
+                pool.addRestrictedEntry(hash, MempoolRestrictedType::ADDED_TAG, "#TAG", address);
+        }
+
+        std::vector<uint256> txids;
+        for (int i = 0; i < RESTRICTED_ASSET_COUNT; i++)
+            pool.getRestrictedTxids(MempoolRestrictedType::VERIFIER_CHANGED, "$ASSET" + std::to_string(i), txids);
+        assert(txids.size() == RESTRICTED_TX_COUNT);
+
+        pool.removeForBlock(vtx, 2);
+        assert(pool.size() == 0);
+    }
+}
+
+BENCHMARK(MempoolRestrictedAssets);
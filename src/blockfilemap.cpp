@@ -0,0 +1,76 @@
+// Copyright (c) 2023-2024 The Aidp Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilemap.h"
+
+#include "util.h"
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::shared_ptr<const CMappedBlockFile> CMappedBlockFile::Open(const fs::path& path)
+{
+#ifndef WIN32
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd == -1)
+        return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+    void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+    if (addr == MAP_FAILED) {
+        LogPrint(BCLog::BENCH, "%s: mmap of %s failed\n", __func__, path.string());
+        return nullptr;
+    }
+    return std::shared_ptr<const CMappedBlockFile>(new CMappedBlockFile(static_cast<const unsigned char*>(addr), st.st_size));
+#else
+    return nullptr;
+#endif
+}
+
+CMappedBlockFile::~CMappedBlockFile()
+{
+#ifndef WIN32
+    munmap(const_cast<unsigned char*>(pdata), nSize);
+#endif
+}
+
+std::shared_ptr<const CMappedBlockFile> CBlockFileMapCache::Get(int nFile, const fs::path& path)
+{
+    std::lock_guard<std::mutex> lock(cs);
+    for (auto it = listFiles.begin(); it != listFiles.end(); ++it) {
+        if (it->first == nFile) {
+            listFiles.splice(listFiles.begin(), listFiles, it);
+            return it->second;
+        }
+    }
+
+    std::shared_ptr<const CMappedBlockFile> mapped = CMappedBlockFile::Open(path);
+    if (!mapped)
+        return nullptr;
+    listFiles.emplace_front(nFile, mapped);
+    if (listFiles.size() > nMaxFiles)
+        listFiles.pop_back();
+    return mapped;
+}
+
+void CBlockFileMapCache::Erase(int nFile)
+{
+    std::lock_guard<std::mutex> lock(cs);
+    listFiles.remove_if([nFile](const std::pair<int, std::shared_ptr<const CMappedBlockFile> >& entry) { return entry.first == nFile; });
+}
+
+void CBlockFileMapCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(cs);
+    listFiles.clear();
+}
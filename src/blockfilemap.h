@@ -0,0 +1,65 @@
+// Copyright (c) 2023-2024 The Aidp Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef AIDP_BLOCKFILEMAP_H
+#define AIDP_BLOCKFILEMAP_H
+
+#include "fs.h"
+
+#include <stddef.h>
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+//! -mmapblocks default: only where address space is plentiful
+static const bool DEFAULT_MMAP_BLOCKS = sizeof(void*) > 4;
+//! Block files kept mapped at once (each at most MAX_BLOCKFILE_SIZE)
+static const size_t MAX_MAPPED_BLOCK_FILES = 64;
+
+/** A read-only memory mapping of a block file that is no longer written to. */
+class CMappedBlockFile
+{
+public:
+    //! Map the whole file, or return nullptr if that is not possible
+    static std::shared_ptr<const CMappedBlockFile> Open(const fs::path& path);
+
+    ~CMappedBlockFile();
+
+    CMappedBlockFile(const CMappedBlockFile&) = delete;
+    CMappedBlockFile& operator=(const CMappedBlockFile&) = delete;
+
+    const unsigned char* data() const { return pdata; }
+    size_t size() const { return nSize; }
+
+private:
+    CMappedBlockFile(const unsigned char* pdataIn, size_t nSizeIn) : pdata(pdataIn), nSize(nSizeIn) {}
+
+    const unsigned char* pdata;
+    size_t nSize;
+};
+
+/**
+ * The most recently used block file mappings. Readers hold on to the shared_ptr they get for
+ * as long as they read, so a file can be dropped from the cache (or unlinked by pruning)
+ * while it is being read; it is unmapped when the last reader lets go.
+ */
+class CBlockFileMapCache
+{
+public:
+    explicit CBlockFileMapCache(size_t nMaxFilesIn) : nMaxFiles(nMaxFilesIn) {}
+
+    std::shared_ptr<const CMappedBlockFile> Get(int nFile, const fs::path& path);
+    void Erase(int nFile);
+    void Clear();
+
+private:
+    const size_t nMaxFiles;
+    std::mutex cs;
+    //! Most recently used first
+    std::list<std::pair<int, std::shared_ptr<const CMappedBlockFile> > > listFiles;
+};
+
+#endif // AIDP_BLOCKFILEMAP_H
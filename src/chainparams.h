@@ -33,6 +33,9 @@ struct CCheckpointData {
     MapCheckpoints mapCheckpoints;
 };
 
+/** Snapshot hashes (see dumptxoutset) that loadtxoutset trusts without an operator supplied hash, by base height. */
+typedef std::map<int, uint256> MapTxOutSnapshotHashes;
+
 struct ChainTxData {
     int64_t nTime;
     int64_t nTxCount;
@@ -80,6 +83,7 @@ public:
     const std::vector<SeedSpec6>& FixedSeeds() const { return vFixedSeeds; }
     const CCheckpointData& Checkpoints() const { return checkpointData; }
     const ChainTxData& TxData() const { return chainTxData; }
+    const MapTxOutSnapshotHashes& TxOutSnapshotHashes() const { return mapTxOutSnapshotHashes; }
     void UpdateVersionBitsParameters(Consensus::DeploymentPos d, int64_t nStartTime, int64_t nTimeout);
     void TurnOffSegwit();
     void TurnOffCSV();
@@ -166,6 +170,7 @@ protected:
     bool fMineBlocksOnDemand;
     bool fMiningRequiresPeers;
     CCheckpointData checkpointData;
+    MapTxOutSnapshotHashes mapTxOutSnapshotHashes;
     ChainTxData chainTxData;
 
     /** AIDP Start **/
@@ -10,6 +10,10 @@
 #include "sync.h"
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 #include <boost/thread/condition_variable.hpp>
@@ -18,6 +22,9 @@
 template <typename T>
 class CCheckQueueControl;
 
+//! Maximum number of per-worker deques; further workers share them
+static const unsigned int MAX_CHECKQUEUE_DEQUES = 128;
+
 /** 
  * Queue for verifications that have to be performed.
   * The verifications are represented by a type T, which must provide an
@@ -27,12 +34,28 @@ class CCheckQueueControl;
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
   * as an N'th worker, until all jobs are done.
+  *
+  * Verifications are handed out in batches of up to nBatchSize. Every
+  * worker has a deque of batches of its own that the master deals them
+  * into, so workers do not meet on a single lock; a worker whose deque
+  * runs dry steals from the front of the others. Batch vectors are kept
+  * and reused, so a steady stream of blocks does not allocate.
   */
 template <typename T>
 class CCheckQueue
 {
 private:
-    //! Mutex to protect the inner state
+    typedef std::vector<T> Batch;
+
+    struct WorkerDeque {
+        std::mutex mutex;
+        //! The owner takes from the back, thieves from the front
+        std::deque<Batch*> batches;
+        //! batches.size(), readable without the lock to skip empty deques
+        std::atomic<size_t> nSize{0};
+    };
+
+    //! Mutex for sleeping and waking up; the deques have their own
     boost::mutex mutex;
 
     //! Worker threads block on this when out of work
@@ -41,90 +64,155 @@ private:
     //! Master thread blocks on this when out of work
     boost::condition_variable condMaster;
 
-    //! The queue of elements to be processed.
-    //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
-    std::vector<T> queue;
+    //! Deque 0 is the master's; workers get the following ones in the order they start
+    std::vector<std::unique_ptr<WorkerDeque> > vDeques;
+
+    //! The number of worker threads (excluding the master).
+    std::atomic<unsigned int> nWorkers;
 
-    //! The number of workers (including the master) that are idle.
-    int nIdle;
+    //! The number of workers that are idle.
+    std::atomic<int> nIdle;
 
-    //! The total number of workers (including the master).
-    int nTotal;
+    //! Batches in the deques that no worker has taken yet.
+    std::atomic<int> nQueued;
 
     //! The temporary evaluation result.
-    bool fAllOk;
+    std::atomic<bool> fAllOk;
 
     /**
      * Number of verifications that haven't completed yet.
      * This includes elements that are no longer queued, but still in the
      * worker's own batches.
      */
-    unsigned int nTodo;
-
-    //! Whether we're shutting down.
-    bool fQuit;
+    std::atomic<unsigned int> nTodo;
 
     //! The maximum number of elements to be processed in one batch
     unsigned int nBatchSize;
 
+    //! Batch being filled by Add, only touched by the master
+    Batch* pOpenBatch;
+
+    //! Next deque to deal a batch into, only touched by the master
+    unsigned int nNextDeque;
+
+    //! Every batch ever allocated, and the empty ones ready for reuse
+    std::mutex mutexBatches;
+    std::vector<std::unique_ptr<Batch> > vAllBatches;
+    std::vector<Batch*> vFreeBatches;
+
+    unsigned int NumDeques() const
+    {
+        return std::min(nWorkers.load() + 1, MAX_CHECKQUEUE_DEQUES);
+    }
+
+    Batch* GetBatch()
+    {
+        std::lock_guard<std::mutex> lock(mutexBatches);
+        if (vFreeBatches.empty()) {
+            vAllBatches.emplace_back(new Batch());
+            vAllBatches.back()->reserve(nBatchSize);
+            return vAllBatches.back().get();
+        }
+        Batch* pBatch = vFreeBatches.back();
+        vFreeBatches.pop_back();
+        return pBatch;
+    }
+
+    void ReleaseBatch(Batch* pBatch)
+    {
+        std::lock_guard<std::mutex> lock(mutexBatches);
+        vFreeBatches.push_back(pBatch);
+    }
+
+    //! Hand the open batch to the workers
+    void Publish()
+    {
+        unsigned int nDeques = NumDeques();
+        // Keep the master's own deque for when it has no workers.
+        WorkerDeque& deque = *vDeques[nDeques > 1 ? 1 + nNextDeque++ % (nDeques - 1) : 0];
+        nQueued++;
+        {
+            std::lock_guard<std::mutex> lock(deque.mutex);
+            deque.batches.push_back(pOpenBatch);
+            deque.nSize = deque.batches.size();
+        }
+        pOpenBatch = nullptr;
+        if (nIdle > 0) {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            condWorker.notify_one();
+        }
+    }
+
+    //! Take a batch from our own deque, or else steal one from another
+    Batch* Take(unsigned int nSlot)
+    {
+        unsigned int nDeques = NumDeques();
+        for (unsigned int i = 0; i < nDeques && nQueued > 0; i++) {
+            WorkerDeque& deque = *vDeques[(nSlot + i) % nDeques];
+            if (deque.nSize == 0)
+                continue;
+            std::lock_guard<std::mutex> lock(deque.mutex);
+            if (deque.batches.empty())
+                continue;
+            Batch* pBatch;
+            if (i == 0) {
+                pBatch = deque.batches.back();
+                deque.batches.pop_back();
+            } else {
+                pBatch = deque.batches.front();
+                deque.batches.pop_front();
+            }
+            deque.nSize = deque.batches.size();
+            nQueued--;
+            return pBatch;
+        }
+        return nullptr;
+    }
+
     /** Internal function that does bulk of the verification work. */
-    bool Loop(bool fMaster = false)
+    bool Loop(unsigned int nSlot, bool fMaster = false)
     {
-        boost::condition_variable& cond = fMaster ? condMaster : condWorker;
-        std::vector<T> vChecks;
-        vChecks.reserve(nBatchSize);
-        unsigned int nNow = 0;
-        bool fOk = true;
         do {
-            {
-                boost::unique_lock<boost::mutex> lock(mutex);
-                // first do the clean-up of the previous loop run (allowing us to do it in the same critsect)
-                if (nNow) {
-                    fAllOk &= fOk;
-                    nTodo -= nNow;
-                    if (nTodo == 0 && !fMaster)
-                        // We processed the last element; inform the master it can exit and return the result
-                        condMaster.notify_one();
-                } else {
-                    // first iteration
-                    nTotal++;
-                }
-                // logically, the do loop starts here
-                while (queue.empty()) {
-                    if ((fMaster || fQuit) && nTodo == 0) {
-                        nTotal--;
-                        bool fRet = fAllOk;
-                        // reset the status for new work later
-                        if (fMaster)
-                            fAllOk = true;
-                        // return the current status
-                        return fRet;
-                    }
-                    nIdle++;
-                    cond.wait(lock); // wait
-                    nIdle--;
+            Batch* pBatch = Take(nSlot);
+            if (pBatch) {
+                // Check whether we need to do work at all
+                bool fOk = fAllOk;
+                for (T& check : *pBatch)
+                    if (fOk)
+                        fOk = check();
+                unsigned int nNow = pBatch->size();
+                // The checks are destroyed before they count as done.
+                pBatch->clear();
+                ReleaseBatch(pBatch);
+                if (!fOk)
+                    fAllOk = false;
+                if ((nTodo -= nNow) == 0 && !fMaster) {
+                    // We processed the last element; inform the master it can exit and return the result
+                    boost::unique_lock<boost::mutex> lock(mutex);
+                    condMaster.notify_one();
                 }
-                // Decide how many work units to process now.
-                // * Do not try to do everything at once, but aim for increasingly smaller batches so
-                //   all workers finish approximately simultaneously.
-                // * Try to account for idle jobs which will instantly start helping.
-                // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
-                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() / (nTotal + nIdle + 1)));
-                vChecks.resize(nNow);
-                for (unsigned int i = 0; i < nNow; i++) {
-                    // We want the lock on the mutex to be as short as possible, so swap jobs from the global
-                    // queue to the local batch vector instead of copying.
-                    vChecks[i].swap(queue.back());
-                    queue.pop_back();
+                continue;
+            }
+
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (fMaster) {
+                if (nTodo == 0) {
+                    bool fRet = fAllOk;
+                    // reset the status for new work later
+                    fAllOk = true;
+                    // return the current status
+                    return fRet;
                 }
-                // Check whether we need to do work at all
-                fOk = fAllOk;
+                // Everything left is being worked on by others.
+                if (nQueued == 0)
+                    condMaster.wait(lock);
+            } else {
+                nIdle++;
+                // Publish checks nIdle after queueing, so one of us sees the other.
+                if (nQueued == 0)
+                    condWorker.wait(lock); // wait
+                nIdle--;
             }
-            // execute work
-            for (T& check : vChecks)
-                if (fOk)
-                    fOk = check();
-            vChecks.clear();
         } while (true);
     }
 
@@ -133,33 +221,42 @@ public:
     boost::mutex ControlMutex;
 
     //! Create a new check queue
-    explicit CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), fQuit(false), nBatchSize(nBatchSizeIn) {}
+    explicit CCheckQueue(unsigned int nBatchSizeIn) : nWorkers(0), nIdle(0), nQueued(0), fAllOk(true), nTodo(0), nBatchSize(std::max(1U, nBatchSizeIn)), pOpenBatch(nullptr), nNextDeque(0)
+    {
+        for (unsigned int i = 0; i < MAX_CHECKQUEUE_DEQUES; i++)
+            vDeques.emplace_back(new WorkerDeque());
+    }
 
     //! Worker thread
     void Thread()
     {
-        Loop();
+        unsigned int nSlot = 1 + nWorkers++ % (MAX_CHECKQUEUE_DEQUES - 1);
+        Loop(nSlot);
     }
 
     //! Wait until execution finishes, and return whether all evaluations were successful.
     bool Wait()
     {
-        return Loop(true);
+        if (pOpenBatch)
+            Publish();
+        return Loop(0, true);
     }
 
     //! Add a batch of checks to the queue
     void Add(std::vector<T>& vChecks)
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
+        nTodo += vChecks.size();
         for (T& check : vChecks) {
-            queue.push_back(T());
-            check.swap(queue.back());
+            if (!pOpenBatch)
+                pOpenBatch = GetBatch();
+            pOpenBatch->emplace_back();
+            check.swap(pOpenBatch->back());
+            if (pOpenBatch->size() >= nBatchSize)
+                Publish();
         }
-        nTodo += vChecks.size();
-        if (vChecks.size() == 1)
-            condWorker.notify_one();
-        else if (vChecks.size() > 1)
-            condWorker.notify_all();
+        // Don't keep idle workers waiting for a batch to fill up.
+        if (pOpenBatch && nIdle > 0)
+            Publish();
     }
 
     ~CCheckQueue()
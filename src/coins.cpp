@@ -42,7 +42,8 @@ size_t CCoinsViewBacked::EstimateSize() const { return base->EstimateSize(); }
 
 SaltedOutpointHasher::SaltedOutpointHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
 
-CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), cachedCoinsUsage(0) {}
+CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn),
+    cacheCoins(0, SaltedOutpointHasher(), CCoinsMap::key_equal(), &m_cache_coins_memory_resource), cachedCoinsUsage(0) {}
 
 size_t CCoinsViewCache::DynamicMemoryUsage() const {
     return memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage;
@@ -280,7 +281,7 @@ void AddCoins(CCoinsViewCache& cache, const CTransaction &tx, int nHeight, uint2
 
                         /** Subscribe to new message channels if they are sent to a new address, or they are the owner token or message channel */
 #ifdef ENABLE_WALLET
-                        if (fMessaging && pMessageSubscribedChannelsCache) {
+                        if (fMessaging && pmessagechanneldb) {
                             LOCK(cs_messaging);
                             if (vpwallets.size() && vpwallets[0]->IsMine(tx.vout[i]) == ISMINE_SPENDABLE) {
                                 AssetType aType;
@@ -303,7 +304,7 @@ void AddCoins(CCoinsViewCache& cache, const CTransaction &tx, int nHeight, uint2
                     } else if (assetData.type == TX_NEW_ASSET) {
                         /** Subscribe to new message channels if they are assets you created, or are new msgchannels of channels already being watched */
 #ifdef ENABLE_WALLET
-                        if (fMessaging && pMessageSubscribedChannelsCache) {
+                        if (fMessaging && pmessagechanneldb) {
                             LOCK(cs_messaging);
                             if (vpwallets.size()) {
                                 AssetType aType;
@@ -482,6 +483,7 @@ bool CCoinsViewCache::Flush() {
     bool fOk = base->BatchWrite(cacheCoins, hashBlock);
     cacheCoins.clear();
     cachedCoinsUsage = 0;
+    ReallocateCache();
     return fOk;
 }
 
@@ -494,6 +496,24 @@ void CCoinsViewCache::Uncache(const COutPoint& hash)
     }
 }
 
+void CCoinsViewCache::AddFetchedCoin(const COutPoint& outpoint, Coin&& coin)
+{
+    assert(!coin.IsSpent());
+    std::pair<CCoinsMap::iterator, bool> ret = cacheCoins.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::forward_as_tuple(std::move(coin)));
+    if (ret.second)
+        cachedCoinsUsage += ret.first->second.coin.DynamicMemoryUsage();
+}
+
+void CCoinsViewCache::ReallocateCache()
+{
+    // The map must be destroyed before its memory resource, and rebuilt on top of a fresh one.
+    assert(cacheCoins.empty());
+    cacheCoins.~CCoinsMap();
+    m_cache_coins_memory_resource.~CCoinsMapMemoryResource();
+    ::new (&m_cache_coins_memory_resource) CCoinsMapMemoryResource{};
+    ::new (&cacheCoins) CCoinsMap{0, SaltedOutpointHasher{}, CCoinsMap::key_equal{}, &m_cache_coins_memory_resource};
+}
+
 unsigned int CCoinsViewCache::GetCacheSize() const {
     return cacheCoins.size();
 }
@@ -535,3 +555,45 @@ const Coin& AccessByTxid(const CCoinsViewCache& view, const uint256& txid)
     }
     return coinEmpty;
 }
+
+CCoinsSetHasher::CCoinsSetHasher(const uint256& hashBlock) : nTransactions(0), nTransactionOutputs(0), nBogoSize(0), nTotalAmount(0),
+    ss(SER_GETHASH, PROTOCOL_VERSION)
+{
+    ss << hashBlock;
+}
+
+void CCoinsSetHasher::Add(const COutPoint& outpoint, const Coin& coin)
+{
+    if (!outputs.empty() && outpoint.hash != hashPrev) {
+        ApplyOutputs();
+    }
+    hashPrev = outpoint.hash;
+    outputs[outpoint.n] = coin;
+}
+
+void CCoinsSetHasher::ApplyOutputs()
+{
+    assert(!outputs.empty());
+    ss << hashPrev;
+    ss << VARINT(outputs.begin()->second.nHeight * 2 + outputs.begin()->second.fCoinBase);
+    nTransactions++;
+    for (const auto& output : outputs) {
+        ss << VARINT(output.first + 1);
+        ss << output.second.out.scriptPubKey;
+        ss << VARINT(output.second.out.nValue);
+        nTransactionOutputs++;
+        nTotalAmount += output.second.out.nValue;
+        nBogoSize += 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
+                     2 /* scriptPubKey len */ + output.second.out.scriptPubKey.size() /* scriptPubKey */;
+    }
+    ss << VARINT(0);
+    outputs.clear();
+}
+
+uint256 CCoinsSetHasher::GetHash()
+{
+    if (!outputs.empty()) {
+        ApplyOutputs();
+    }
+    return ss.GetHash();
+}
@@ -14,11 +14,15 @@
 #include "hash.h"
 #include "memusage.h"
 #include "serialize.h"
+#include "support/allocators/pool.h"
 #include "uint256.h"
 
 #include <assert.h>
 #include <stdint.h>
 
+#include <functional>
+#include <map>
+
 #include <unordered_map>
 #include <assets/assets.h>
 #include <assets/assetdb.h>
@@ -127,7 +131,17 @@ struct CCoinsCacheEntry
     explicit CCoinsCacheEntry(Coin&& coin_) : coin(std::move(coin_)), flags(0) {}
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
+/**
+ * The coins cache is a node based map whose nodes come from a PoolResource instead of the
+ * general purpose heap. Nodes keep a stable address (AccessCoin hands out references into
+ * the map), while insert/erase churn during block connection reuses pooled memory. The
+ * block size covers the key/value pair plus the node's next pointer and cached hash.
+ */
+typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher, std::equal_to<COutPoint>,
+                           PoolAllocator<std::pair<const COutPoint, CCoinsCacheEntry>,
+                                         sizeof(std::pair<const COutPoint, CCoinsCacheEntry>) + sizeof(void*) * 4>> CCoinsMap;
+
+typedef CCoinsMap::allocator_type::ResourceType CCoinsMapMemoryResource;
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
@@ -214,6 +228,8 @@ protected:
      * declared as "const".  
      */
     mutable uint256 hashBlock;
+    /* Backing memory for cacheCoins; must be declared (and so destroyed) before (after) it. */
+    mutable CCoinsMapMemoryResource m_cache_coins_memory_resource;
     mutable CCoinsMap cacheCoins;
 
     /* Cached dynamic memory usage for the inner Coin objects. */
@@ -282,6 +298,19 @@ public:
      */
     void Uncache(const COutPoint &outpoint);
 
+    /**
+     * Add an unspent coin that was read from the backing view elsewhere (see CCoinsPrefetcher),
+     * unless the cache already has an entry for the outpoint. The backing view must not have
+     * been written to since the coin was read.
+     */
+    void AddFetchedCoin(const COutPoint &outpoint, Coin&& coin);
+
+    /**
+     * Force a reallocation of the cache map. Clearing the map keeps its bucket array and
+     * pooled chunks alive; this is the only way to give that memory back.
+     */
+    void ReallocateCache();
+
     //! Calculate the size of the cache (in number of transaction outputs)
     unsigned int GetCacheSize() const;
 
@@ -319,4 +348,31 @@ void AddCoins(CCoinsViewCache& cache, const CTransaction& tx, int nHeight, uint2
 // lookups to database, so it should be used with care.
 const Coin& AccessByTxid(const CCoinsViewCache& cache, const uint256& txid);
 
+/**
+ * Hash and statistics of a UTXO set, as reported by gettxoutsetinfo (hash_serialized_2).
+ * Coins must be added in database order, i.e. grouped by transaction.
+ */
+class CCoinsSetHasher
+{
+public:
+    uint64_t nTransactions;
+    uint64_t nTransactionOutputs;
+    uint64_t nBogoSize;
+    CAmount nTotalAmount;
+
+    explicit CCoinsSetHasher(const uint256& hashBlock);
+
+    void Add(const COutPoint& outpoint, const Coin& coin);
+
+    //! Only call once: invalidates the hasher.
+    uint256 GetHash();
+
+private:
+    CHashWriter ss;
+    uint256 hashPrev;
+    std::map<uint32_t, Coin> outputs;
+
+    void ApplyOutputs();
+};
+
 #endif // AIDP_COINS_H
@@ -0,0 +1,164 @@
+// Copyright (c) 2023-2024 The Aidp Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coinsprefetch.h"
+
+#include "primitives/block.h"
+#include "util.h"
+#include "validation.h"
+#include "assets/assetdb.h"
+#include "assets/assets.h"
+
+#include <functional>
+
+CCoinsPrefetcher* pcoinsprefetcher = nullptr;
+
+CCoinsPrefetcher::CCoinsPrefetcher(CCoinsView* baseIn, int nThreads) : base(baseIn), nEpoch(0), fStop(false)
+{
+    for (int i = 0; i < nThreads; i++) {
+        threads.emplace_back(&TraceThread<std::function<void()> >, "prefetch",
+            std::function<void()>(std::bind(&CCoinsPrefetcher::ThreadFetch, this)));
+    }
+}
+
+CCoinsPrefetcher::~CCoinsPrefetcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        fStop = true;
+    }
+    condWork.notify_all();
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+void CCoinsPrefetcher::Prefetch(const CBlock& block, const CCoinsViewCache& view)
+{
+    std::shared_ptr<Job> job = std::make_shared<Job>();
+    job->hashBlock = block.GetHash();
+
+    // Outputs created earlier in the block are not in any database yet.
+    std::set<uint256> setBlockTxids;
+    for (const auto& tx : block.vtx) {
+        if (!tx->IsCoinBase()) {
+            for (const CTxIn& txin : tx->vin) {
+                if (!setBlockTxids.count(txin.prevout.hash) && !view.HaveCoinInCache(txin.prevout))
+                    job->vOutPoints.push_back(txin.prevout);
+            }
+        }
+        setBlockTxids.insert(tx->GetHash());
+
+        if (passetsdb) {
+            for (const CTxOut& txout : tx->vout) {
+                std::string strName;
+                CAmount nAmount;
+                if (GetAssetInfoFromScript(txout.scriptPubKey, strName, nAmount))
+                    job->setAssetNames.insert(strName);
+            }
+        }
+    }
+    if (job->vOutPoints.empty() && job->setAssetNames.empty())
+        return;
+
+    std::lock_guard<std::mutex> lock(cs);
+    if (mapJobs.size() >= MAX_PREFETCH_BLOCKS || !mapJobs.emplace(job->hashBlock, job).second)
+        return;
+    job->nEpoch = nEpoch;
+    job->nBatchesLeft = 0;
+    size_t nBegin = 0;
+    do {
+        queue.emplace_back(job, nBegin);
+        job->nBatchesLeft++;
+        nBegin += PREFETCH_BATCH_SIZE;
+    } while (nBegin < job->vOutPoints.size());
+    condWork.notify_all();
+}
+
+void CCoinsPrefetcher::Apply(const uint256& hashBlock, CCoinsViewCache& view)
+{
+    std::shared_ptr<Job> job;
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        std::map<uint256, std::shared_ptr<Job> >::iterator it = mapJobs.find(hashBlock);
+        if (it == mapJobs.end())
+            return;
+        job = it->second;
+        mapJobs.erase(it);
+        condDone.wait(lock, [&job] { return job->nBatchesLeft == 0; });
+        if (job->nEpoch != nEpoch)
+            return;
+    }
+
+    for (auto& coin : job->vCoins)
+        view.AddFetchedCoin(coin.first, std::move(coin.second));
+    if (passetsCache) {
+        for (const auto& asset : job->mapAssets) {
+            if (!passetsCache->Exists(asset.first))
+                passetsCache->Put(asset.first, asset.second);
+        }
+    }
+}
+
+void CCoinsPrefetcher::Invalidate()
+{
+    std::lock_guard<std::mutex> lock(cs);
+    // Workers skip the queued batches of older epochs; results still being read are dropped by Apply.
+    nEpoch++;
+    mapJobs.clear();
+}
+
+void CCoinsPrefetcher::ReadBatch(Job& job, size_t nBegin, std::vector<std::pair<COutPoint, Coin> >& vCoins,
+                                 std::map<std::string, CDatabasedAssetData>& mapAssets)
+{
+    std::set<std::string> setAssetNames;
+    if (nBegin == 0)
+        setAssetNames = job.setAssetNames;
+
+    size_t nEnd = std::min(nBegin + PREFETCH_BATCH_SIZE, job.vOutPoints.size());
+    for (size_t i = nBegin; i < nEnd; i++) {
+        Coin coin;
+        if (!base->GetCoin(job.vOutPoints[i], coin))
+            continue;
+        std::string strName;
+        CAmount nAmount;
+        if (passetsdb && GetAssetInfoFromScript(coin.out.scriptPubKey, strName, nAmount))
+            setAssetNames.insert(strName);
+        vCoins.emplace_back(job.vOutPoints[i], std::move(coin));
+    }
+
+    for (const std::string& strName : setAssetNames) {
+        CNewAsset asset;
+        int nHeight;
+        uint256 blockHash;
+        if (passetsdb->ReadAssetData(strName, asset, nHeight, blockHash))
+            mapAssets.emplace(strName, CDatabasedAssetData(asset, nHeight, blockHash));
+    }
+}
+
+void CCoinsPrefetcher::ThreadFetch()
+{
+    std::unique_lock<std::mutex> lock(cs);
+    while (true) {
+        condWork.wait(lock, [this] { return fStop || !queue.empty(); });
+        if (fStop)
+            return;
+        std::shared_ptr<Job> job = queue.front().first;
+        size_t nBegin = queue.front().second;
+        queue.pop_front();
+
+        std::vector<std::pair<COutPoint, Coin> > vCoins;
+        std::map<std::string, CDatabasedAssetData> mapAssets;
+        if (job->nEpoch == nEpoch) {
+            lock.unlock();
+            ReadBatch(*job, nBegin, vCoins, mapAssets);
+            lock.lock();
+        }
+
+        for (auto& coin : vCoins)
+            job->vCoins.push_back(std::move(coin));
+        job->mapAssets.insert(mapAssets.begin(), mapAssets.end());
+        if (--job->nBatchesLeft == 0)
+            condDone.notify_all();
+    }
+}
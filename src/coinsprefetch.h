@@ -0,0 +1,91 @@
+// Copyright (c) 2023-2024 The Aidp Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef AIDP_COINSPREFETCH_H
+#define AIDP_COINSPREFETCH_H
+
+#include "coins.h"
+#include "uint256.h"
+#include "assets/assettypes.h"
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class CBlock;
+
+//! -prefetchthreads default
+static const int DEFAULT_PREFETCH_THREADS = 4;
+//! Maximum -prefetchthreads
+static const int MAX_PREFETCH_THREADS = 16;
+//! Outpoints read by a worker in one go
+static const size_t PREFETCH_BATCH_SIZE = 64;
+//! Blocks whose prefetched data is kept waiting for ConnectTip
+static const size_t MAX_PREFETCH_BLOCKS = 32;
+
+/**
+ * Reads the coins spent by a block, and the metadata of the assets it touches, from the
+ * databases on a small pool of I/O threads while the block waits to be connected, so
+ * ConnectBlock finds them in pcoinsTip and passetsCache instead of reading LevelDB one
+ * key at a time on the validation thread.
+ *
+ * Reads go straight to the databases and never take cs_main. Results are kept aside and
+ * only moved into the caches by Apply(), under cs_main, for entries the caches do not have
+ * yet. A database write (FlushStateToDisk) makes everything read before it stale, so it
+ * calls Invalidate() first.
+ */
+class CCoinsPrefetcher
+{
+public:
+    CCoinsPrefetcher(CCoinsView* baseIn, int nThreads);
+    ~CCoinsPrefetcher();
+
+    //! Start reading the inputs of block that view does not have. Requires cs_main.
+    void Prefetch(const CBlock& block, const CCoinsViewCache& view);
+
+    //! Move the data read for a block into view and passetsCache, waiting for reads still in flight. Requires cs_main.
+    void Apply(const uint256& hashBlock, CCoinsViewCache& view);
+
+    //! Throw away everything read so far. Requires cs_main.
+    void Invalidate();
+
+private:
+    struct Job {
+        uint256 hashBlock;
+        uint64_t nEpoch;
+        std::vector<COutPoint> vOutPoints;
+        std::set<std::string> setAssetNames;
+        size_t nBatchesLeft;
+        std::vector<std::pair<COutPoint, Coin> > vCoins;
+        std::map<std::string, CDatabasedAssetData> mapAssets;
+    };
+
+    CCoinsView* base;
+
+    std::mutex cs;
+    std::condition_variable condWork;
+    std::condition_variable condDone;
+    //! Jobs by block hash, until applied or invalidated
+    std::map<uint256, std::shared_ptr<Job> > mapJobs;
+    //! Batches to read: a job and the offset of the batch in its outpoints
+    std::deque<std::pair<std::shared_ptr<Job>, size_t> > queue;
+    uint64_t nEpoch;
+    bool fStop;
+    std::vector<std::thread> threads;
+
+    void ThreadFetch();
+    void ReadBatch(Job& job, size_t nBegin, std::vector<std::pair<COutPoint, Coin> >& vCoins,
+                   std::map<std::string, CDatabasedAssetData>& mapAssets);
+};
+
+extern CCoinsPrefetcher* pcoinsprefetcher;
+
+#endif // AIDP_COINSPREFETCH_H
@@ -7,9 +7,13 @@
 
 #include "compressor.h"
 
+#include "amount.h"
 #include "hash.h"
 #include "pubkey.h"
 #include "script/standard.h"
+#include "streams.h"
+#include "version.h"
+#include "assets/assets.h"
 
 bool CScriptCompressor::IsToKeyID(CKeyID &hash) const
 {
@@ -47,6 +51,63 @@ bool CScriptCompressor::IsToPubKey(CPubKey &pubkey) const
     return false;
 }
 
+bool CScriptCompressor::IsToAsset(unsigned int &nCode, uint160 &hash, unsigned char &type, std::string &name, uint64_t &nAmount, std::vector<unsigned char> &vData) const
+{
+    unsigned int nPrefix;
+    if (script.size() > 25 && script[0] == OP_DUP && script[1] == OP_HASH160
+                           && script[2] == 20 && script[23] == OP_EQUALVERIFY
+                           && script[24] == OP_CHECKSIG) {
+        nCode = nSpecialScripts;
+        nPrefix = 25;
+        memcpy(hash.begin(), &script[3], 20);
+    } else if (script.size() > 23 && script[0] == OP_HASH160 && script[1] == 20
+                                  && script[22] == OP_EQUAL) {
+        nCode = nSpecialScripts + 1;
+        nPrefix = 23;
+        memcpy(hash.begin(), &script[2], 20);
+    } else {
+        return false;
+    }
+
+    if (script[nPrefix] != OP_AIDP_ASSET)
+        return false;
+
+    CScript::const_iterator pc = script.begin() + nPrefix + 1;
+    opcodetype opcode;
+    std::vector<unsigned char> vchAsset;
+    if (!script.GetOp(pc, opcode, vchAsset) || pc == script.end() || *pc != OP_DROP || pc + 1 != script.end())
+        return false;
+
+    if (vchAsset.size() < 5 || vchAsset[0] != AIDP_R || vchAsset[1] != AIDP_V || vchAsset[2] != AIDP_N)
+        return false;
+
+    type = vchAsset[3];
+    if (type != AIDP_T && type != AIDP_Q && type != AIDP_O)
+        return false;
+
+    try {
+        CDataStream ssAsset((const char*)vchAsset.data() + 4, (const char*)vchAsset.data() + vchAsset.size(), SER_NETWORK, PROTOCOL_VERSION);
+        ssAsset >> name;
+        nAmount = 0;
+        if (type != AIDP_O) {
+            CAmount amount;
+            ssAsset >> amount;
+            if (!MoneyRange(amount))
+                return false;
+            nAmount = CTxOutCompressor::CompressAmount(amount);
+        }
+        vData.assign(ssAsset.begin(), ssAsset.end());
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    // Only use the compact form if it gives back the exact same script,
+    // e.g. not for scripts with non-minimal pushes
+    CScript rebuilt;
+    CScriptCompressor(rebuilt, true).DecompressAsset(nCode, hash, type, name, nAmount, vData);
+    return rebuilt == script;
+}
+
 bool CScriptCompressor::Compress(std::vector<unsigned char> &out) const
 {
     CKeyID keyID;
@@ -132,6 +193,24 @@ bool CScriptCompressor::Decompress(unsigned int nSize, const std::vector<unsigne
     return false;
 }
 
+void CScriptCompressor::DecompressAsset(unsigned int nCode, const uint160 &hash, unsigned char type, const std::string &name, uint64_t nAmount, const std::vector<unsigned char> &vData)
+{
+    CDataStream ssAsset(SER_NETWORK, PROTOCOL_VERSION);
+    ssAsset << name;
+    if (type != AIDP_O)
+        ssAsset << (CAmount)CTxOutCompressor::DecompressAmount(nAmount);
+
+    std::vector<unsigned char> vchAsset = {AIDP_R, AIDP_V, AIDP_N, type};
+    vchAsset.insert(vchAsset.end(), ssAsset.begin(), ssAsset.end());
+    vchAsset.insert(vchAsset.end(), vData.begin(), vData.end());
+
+    if (nCode == nSpecialScripts)
+        script = GetScriptForDestination(CKeyID(hash));
+    else
+        script = GetScriptForDestination(CScriptID(hash));
+    script << OP_AIDP_ASSET << vchAsset << OP_DROP;
+}
+
 // Amount compression:
 // * If the amount is 0, output 0
 // * first, divide the amount (in base units) by the largest power of 10 possible; call the exponent e (e is max 9)
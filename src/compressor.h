@@ -11,6 +11,7 @@
 #include "primitives/transaction.h"
 #include "script/script.h"
 #include "serialize.h"
+#include "uint256.h"
 
 class CKeyID;
 class CPubKey;
@@ -26,6 +27,12 @@ class CScriptID;
  *
  *  Other scripts up to 121 bytes require 1 byte + script length. Above
  *  that, scripts up to 16505 bytes require 2 bytes + script length.
+ *
+ *  With fAssets set (used by the chainstate database only) 2 more special
+ *  cases are defined, for asset transfer, issue and owner scripts paying to a
+ *  pubkey hash or a script hash. They are encoded as the 20 byte hash, the
+ *  asset type, the asset name, the compressed amount and whatever other
+ *  asset data follows. Raw scripts are then offset by 8 instead of 6.
  */
 class CScriptCompressor
 {
@@ -38,7 +45,13 @@ private:
      */
     static const unsigned int nSpecialScripts = 6;
 
+    /** Special scripts when asset scripts are compressed as well */
+    static const unsigned int nSpecialScriptsAssets = 8;
+
     CScript &script;
+    bool fAssets;
+
+    unsigned int SpecialScripts() const { return fAssets ? nSpecialScriptsAssets : nSpecialScripts; }
 protected:
     /**
      * These check for scripts for which a special case with a shorter encoding is defined.
@@ -50,12 +63,14 @@ protected:
     bool IsToKeyID(CKeyID &hash) const;
     bool IsToScriptID(CScriptID &hash) const;
     bool IsToPubKey(CPubKey &pubkey) const;
+    bool IsToAsset(unsigned int &nCode, uint160 &hash, unsigned char &type, std::string &name, uint64_t &nAmount, std::vector<unsigned char> &vData) const;
 
     bool Compress(std::vector<unsigned char> &out) const;
     unsigned int GetSpecialSize(unsigned int nSize) const;
     bool Decompress(unsigned int nSize, const std::vector<unsigned char> &out);
+    void DecompressAsset(unsigned int nCode, const uint160 &hash, unsigned char type, const std::string &name, uint64_t nAmount, const std::vector<unsigned char> &vData);
 public:
-    explicit CScriptCompressor(CScript &scriptIn) : script(scriptIn) { }
+    explicit CScriptCompressor(CScript &scriptIn, bool fAssetsIn = false) : script(scriptIn), fAssets(fAssetsIn) { }
 
     template<typename Stream>
     void Serialize(Stream &s) const {
@@ -64,7 +79,18 @@ public:
             s << CFlatData(compr);
             return;
         }
-        unsigned int nSize = script.size() + nSpecialScripts;
+        unsigned int nCode;
+        uint160 hash;
+        unsigned char type;
+        std::string name;
+        uint64_t nAmount;
+        std::vector<unsigned char> vData;
+        if (fAssets && IsToAsset(nCode, hash, type, name, nAmount, vData)) {
+            s << VARINT(nCode);
+            s << hash << type << name << VARINT(nAmount) << vData;
+            return;
+        }
+        unsigned int nSize = script.size() + SpecialScripts();
         s << VARINT(nSize);
         s << CFlatData(script);
     }
@@ -79,7 +105,17 @@ public:
             Decompress(nSize, vch);
             return;
         }
-        nSize -= nSpecialScripts;
+        if (nSize < SpecialScripts()) {
+            uint160 hash;
+            unsigned char type;
+            std::string name;
+            uint64_t nAmount = 0;
+            std::vector<unsigned char> vData;
+            s >> hash >> type >> name >> VARINT(nAmount) >> vData;
+            DecompressAsset(nSize, hash, type, name, nAmount, vData);
+            return;
+        }
+        nSize -= SpecialScripts();
         if (nSize > MAX_SCRIPT_SIZE) {
             // Overly long script, replace with a short invalid one
             script << OP_RETURN;
@@ -96,12 +132,13 @@ class CTxOutCompressor
 {
 private:
     CTxOut &txout;
+    bool fAssets;
 
 public:
     static uint64_t CompressAmount(uint64_t nAmount);
     static uint64_t DecompressAmount(uint64_t nAmount);
 
-    explicit CTxOutCompressor(CTxOut &txoutIn) : txout(txoutIn) { }
+    explicit CTxOutCompressor(CTxOut &txoutIn, bool fAssetsIn = false) : txout(txoutIn), fAssets(fAssetsIn) { }
 
     ADD_SERIALIZE_METHODS;
 
@@ -115,7 +152,7 @@ public:
             READWRITE(VARINT(nVal));
             txout.nValue = DecompressAmount(nVal);
         }
-        CScriptCompressor cscript(REF(txout.scriptPubKey));
+        CScriptCompressor cscript(REF(txout.scriptPubKey), fAssets);
         READWRITE(cscript);
     }
 };
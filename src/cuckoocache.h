@@ -475,6 +475,25 @@ public:
             }
         return false;
     }
+
+    /** for_each calls f on every element that has not been marked for
+     * collection, elements of older epochs first, so that inserting them in
+     * the order visited into a fresh cache keeps the newest ones if it fills.
+     *
+     * Like contains, this must not run concurrently with insert.
+     *
+     * @param f called as f(const Element&)
+     */
+    template <typename F>
+    void for_each(F f) const
+    {
+        for (bool epoch : {false, true}) {
+            for (uint32_t i = 0; i < size; ++i) {
+                if (!collection_flags.bit_is_set(i) && epoch_flags[i] == epoch)
+                    f(table[i]);
+            }
+        }
+    }
 };
 } // namespace CuckooCache
 
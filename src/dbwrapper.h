@@ -116,6 +116,30 @@ public:
     size_t SizeEstimate() const { return size_estimate; }
 };
 
+/**
+ * Undecoded database key or value. Written as its bytes, without a length prefix, and read
+ * from whatever is left in the stream, so it round-trips any record unchanged.
+ */
+struct CDBRawData
+{
+    std::vector<unsigned char> data;
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        if (!data.empty())
+            s.write((const char*)data.data(), data.size());
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        data.resize(s.size());
+        if (!data.empty())
+            s.read((char*)data.data(), data.size());
+    }
+};
+
 class CDBIterator
 {
 private:
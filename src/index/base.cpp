@@ -0,0 +1,313 @@
+// Copyright (c) 2023-2024 The Aidp Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "index/base.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "init.h"
+#include "txdb.h"
+#include "ui_interface.h"
+#include "undo.h"
+#include "util.h"
+#include "utiltime.h"
+#include "validation.h"
+#include "warnings.h"
+
+#include <functional>
+
+//! How often the background sync reports its progress, in seconds
+static const int64_t INDEX_SYNC_LOG_INTERVAL = 30;
+
+BaseIndex::~BaseIndex()
+{
+    Stop();
+}
+
+void BaseIndex::Start(bool fWasEnabled)
+{
+    LOCK(cs_main);
+
+    CBlockLocator locator;
+    const CBlockIndex* pindexBest = nullptr;
+    if (pblocktree->ReadIndexBestBlock(GetName(), locator)) {
+        for (const uint256& hash : locator.vHave) {
+            BlockMap::const_iterator it = mapBlockIndex.find(hash);
+            if (it != mapBlockIndex.end()) {
+                pindexBest = it->second;
+                break;
+            }
+        }
+    } else if (fWasEnabled && chainActive.Tip()) {
+        // Older versions wrote the index while connecting blocks, so it matches the chain.
+        pindexBest = chainActive.Tip();
+        CDBBatch batch(*pblocktree);
+        pblocktree->WriteIndexBestBlock(batch, GetName(), CBlockLocator(std::vector<uint256>(1, pindexBest->GetBlockHash())));
+        pblocktree->WriteBatch(batch);
+    }
+    m_best_block_index = pindexBest;
+    m_synced = false;
+    m_interrupt = false;
+    if (!Init()) {
+        FatalError(strprintf("%s: failed to initialize %s", __func__, GetName()));
+        return;
+    }
+
+    StartSyncThread();
+}
+
+void BaseIndex::Stop()
+{
+    m_interrupt = true;
+    if (m_thread_sync.joinable())
+        m_thread_sync.join();
+}
+
+void BaseIndex::StartSyncThread()
+{
+    if (m_thread_sync.joinable())
+        m_thread_sync.join();
+    m_thread_sync = std::thread(&TraceThread<std::function<void()> >, GetName(),
+        std::function<void()>(std::bind(&BaseIndex::ThreadSync, this)));
+}
+
+bool BaseIndex::ApplyBlock(const CBlockIndex* pindex, const CBlock* pblock, bool fConnect)
+{
+    CBlock block;
+    if (!pblock) {
+        if (!ReadBlockFromDisk(block, pindex, GetParams().GetConsensus()))
+            return error("%s: %s: failed to read block %s from disk", __func__, GetName(), pindex->GetBlockHash().ToString());
+        pblock = &block;
+    }
+
+    // The genesis block's outputs cannot be spent and are not indexed.
+    CBlockUndo blockUndo;
+    if (pindex->pprev && !UndoReadFromDisk(blockUndo, pindex->GetUndoPos(), pindex->pprev->GetBlockHash()))
+        return error("%s: %s: failed to read undo data of block %s", __func__, GetName(), pindex->GetBlockHash().ToString());
+
+    CDBBatch batch(*pblocktree);
+    if (!WriteBlockToBatch(batch, *pblock, blockUndo, pindex, fConnect))
+        return false;
+    if (!pblocktree->WriteBatch(batch))
+        return error("%s: %s: failed to write block %s", __func__, GetName(), pindex->GetBlockHash().ToString());
+    BlockToBatchWritten(*pblock, pindex, fConnect);
+    return true;
+}
+
+bool BaseIndex::WriteBlockToBatch(CDBBatch& batch, const CBlock& block, const CBlockUndo& blockUndo,
+                                  const CBlockIndex* pindex, bool fConnect)
+{
+    if (pindex->pprev) {
+        if (blockUndo.vtxundo.size() + 1 != block.vtx.size())
+            return error("%s: %s: block %s and undo data inconsistent", __func__, GetName(), pindex->GetBlockHash().ToString());
+        if (!WriteBlock(batch, block, blockUndo, pindex, fConnect))
+            return false;
+    }
+
+    const CBlockIndex* pindexBest = fConnect ? pindex : pindex->pprev;
+    if (pindexBest)
+        pblocktree->WriteIndexBestBlock(batch, GetName(), CBlockLocator(std::vector<uint256>(1, pindexBest->GetBlockHash())));
+    return true;
+}
+
+void BaseIndex::BlockToBatchWritten(const CBlock& block, const CBlockIndex* pindex, bool fConnect)
+{
+    if (pindex->pprev)
+        BlockWritten(block, pindex, fConnect);
+    m_best_block_index = fConnect ? pindex : pindex->pprev;
+}
+
+bool BaseIndex::Rewind(const CBlockIndex* pindexFork)
+{
+    const CBlockIndex* pindexBest;
+    while ((pindexBest = m_best_block_index) != pindexFork) {
+        if (!ApplyBlock(pindexBest, nullptr, false))
+            return false;
+    }
+    return true;
+}
+
+void BaseIndex::ThreadSync()
+{
+    if (!Upgrade()) {
+        FatalError(strprintf("%s: failed to upgrade %s", __func__, GetName()));
+        return;
+    }
+
+    int64_t nLastLog = 0;
+    while (!m_interrupt) {
+        if (ShutdownRequested())
+            return;
+
+        const CBlockIndex* pindex;
+        bool fConnect = true;
+        {
+            LOCK(cs_main);
+            const CBlockIndex* pindexBest = m_best_block_index;
+            const CBlockIndex* pindexTip = chainActive.Tip();
+            if (pindexTip == nullptr) {
+                pindex = nullptr;
+            } else if (pindexBest == nullptr) {
+                pindex = chainActive.Genesis();
+            } else if (chainActive.Contains(pindexBest)) {
+                pindex = chainActive.Next(pindexBest);
+            } else if (pindexBest->GetAncestor(pindexTip->nHeight) == pindexTip) {
+                // Ahead of the chain, which is catching up (for instance with -reindex-chainstate):
+                // the blocks it connects up to pindexBest are already in the index.
+                pindex = nullptr;
+            } else {
+                // Built on blocks that have left the active chain: take them out first.
+                pindex = pindexBest;
+                fConnect = false;
+            }
+
+            if (pindex == nullptr) {
+                m_synced = true;
+                LogPrintf("%s is enabled at height %d\n", GetName(), pindexBest ? pindexBest->nHeight : -1);
+                return;
+            }
+        }
+
+        if (!ApplyBlock(pindex, nullptr, fConnect)) {
+            FatalError(strprintf("%s: failed to build %s", __func__, GetName()));
+            return;
+        }
+
+        int64_t nNow = GetTime();
+        if (nNow - nLastLog >= INDEX_SYNC_LOG_INTERVAL) {
+            LogPrintf("Syncing %s with block chain from height %d\n", GetName(), pindex->nHeight);
+            nLastLog = nNow;
+        }
+    }
+}
+
+bool BaseIndex::PrepareBlockConnected(const CBlockIndex* pindex)
+{
+    if (!m_synced)
+        return false;
+
+    const CBlockIndex* pindexBest = m_best_block_index;
+    // The chain catching up with an index that is ahead of it
+    if (pindexBest && pindexBest->GetAncestor(pindex->nHeight) == pindex)
+        return false;
+
+    if (pindexBest && pindex->pprev) {
+        const CBlockIndex* pindexFork = LastCommonAncestor(pindexBest, pindex->pprev);
+        if (!Rewind(pindexFork)) {
+            FatalError(strprintf("%s: failed to rewind %s", __func__, GetName()));
+            return false;
+        }
+    }
+
+    if (m_best_block_index != pindex->pprev) {
+        // Blocks are missing in between: let the sync thread fill them in.
+        LogPrintf("%s: %s is behind block %s, syncing again\n", __func__, GetName(), pindex->GetBlockHash().ToString());
+        m_synced = false;
+        StartSyncThread();
+        return false;
+    }
+    return true;
+}
+
+void BaseIndex::FatalError(const std::string& strMessage)
+{
+    SetMiscWarning(strMessage);
+    LogPrintf("*** %s\n", strMessage);
+    uiInterface.ThreadSafeMessageBox(
+        _("Error: A fatal internal error occurred, see debug.log for details"),
+        "", CClientUIInterface::MSG_ERROR);
+    StartShutdown();
+}
+
+void CIndexChainFollower::KeepBlockUndo(const CBlockIndex* pindex, CBlockUndo&& blockUndo)
+{
+    AssertLockHeld(cs_main);
+    m_block_undo[pindex] = std::make_shared<const CBlockUndo>(std::move(blockUndo));
+}
+
+void CIndexChainFollower::BlockConnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex, const std::vector<CTransactionRef> &txnConflicted)
+{
+    std::shared_ptr<const CBlockUndo> pblockUndo;
+    std::map<const CBlockIndex*, std::shared_ptr<const CBlockUndo> >::iterator itUndo = m_block_undo.find(pindex);
+    if (itUndo != m_block_undo.end())
+        pblockUndo = itUndo->second;
+    // Blocks are handed over in the order they were connected; anything at or below this one
+    // was connected by a caller that does not notify (like -checklevel=4), or was replaced.
+    for (itUndo = m_block_undo.begin(); itUndo != m_block_undo.end(); ) {
+        if (itUndo->first->nHeight <= pindex->nHeight)
+            itUndo = m_block_undo.erase(itUndo);
+        else
+            ++itUndo;
+    }
+
+    std::vector<BaseIndex*> vIndexes;
+    for (BaseIndex* index : m_indexes) {
+        if (index->PrepareBlockConnected(pindex))
+            vIndexes.push_back(index);
+    }
+    if (vIndexes.empty())
+        return;
+
+    if (!pblockUndo && pindex->pprev) {
+        CBlockUndo blockUndo;
+        if (!UndoReadFromDisk(blockUndo, pindex->GetUndoPos(), pindex->pprev->GetBlockHash())) {
+            vIndexes.front()->FatalError(strprintf("%s: failed to read undo data of block %s", __func__, pindex->GetBlockHash().ToString()));
+            return;
+        }
+        pblockUndo = std::make_shared<const CBlockUndo>(std::move(blockUndo));
+    } else if (!pblockUndo) {
+        pblockUndo = std::make_shared<const CBlockUndo>();
+    }
+
+    CDBBatch batch(*pblocktree);
+    for (BaseIndex* index : vIndexes) {
+        if (!index->WriteBlockToBatch(batch, *block, *pblockUndo, pindex, true)) {
+            index->FatalError(strprintf("%s: failed to write block %s to %s", __func__, pindex->GetBlockHash().ToString(), index->GetName()));
+            return;
+        }
+    }
+    if (!pblocktree->WriteBatch(batch)) {
+        vIndexes.front()->FatalError(strprintf("%s: failed to write block %s to the indexes", __func__, pindex->GetBlockHash().ToString()));
+        return;
+    }
+    for (BaseIndex* index : vIndexes)
+        index->BlockToBatchWritten(*block, pindex, true);
+}
+
+void CIndexChainFollower::BlockDisconnected(const std::shared_ptr<const CBlock> &block)
+{
+    // Blocks below an index's best block, if any, are taken out when the chain moves on.
+    BlockMap::const_iterator it = mapBlockIndex.find(block->GetHash());
+    if (it == mapBlockIndex.end())
+        return;
+    const CBlockIndex* pindex = it->second;
+
+    std::vector<BaseIndex*> vIndexes;
+    for (BaseIndex* index : m_indexes) {
+        if (index->m_synced && index->m_best_block_index == pindex)
+            vIndexes.push_back(index);
+    }
+    if (vIndexes.empty())
+        return;
+
+    CBlockUndo blockUndo;
+    if (pindex->pprev && !UndoReadFromDisk(blockUndo, pindex->GetUndoPos(), pindex->pprev->GetBlockHash())) {
+        vIndexes.front()->FatalError(strprintf("%s: failed to read undo data of block %s", __func__, pindex->GetBlockHash().ToString()));
+        return;
+    }
+
+    CDBBatch batch(*pblocktree);
+    for (BaseIndex* index : vIndexes) {
+        if (!index->WriteBlockToBatch(batch, *block, blockUndo, pindex, false)) {
+            index->FatalError(strprintf("%s: failed to take block %s out of %s", __func__, pindex->GetBlockHash().ToString(), index->GetName()));
+            return;
+        }
+    }
+    if (!pblocktree->WriteBatch(batch)) {
+        vIndexes.front()->FatalError(strprintf("%s: failed to take block %s out of the indexes", __func__, pindex->GetBlockHash().ToString()));
+        return;
+    }
+    for (BaseIndex* index : vIndexes)
+        index->BlockToBatchWritten(*block, pindex, false);
+}
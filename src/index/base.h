@@ -0,0 +1,121 @@
+// Copyright (c) 2023-2024 The Aidp Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef AIDP_INDEX_BASE_H
+#define AIDP_INDEX_BASE_H
+
+#include "dbwrapper.h"
+#include "validationinterface.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+class CBlock;
+class CBlockIndex;
+class CBlockUndo;
+
+/**
+ * An optional index kept in the block tree database, built from the block and undo files.
+ *
+ * An index records the block it is built up to under its name, in the same database batch as
+ * the entries of that block, so it always knows where to pick up. When started behind the
+ * active chain (because it was just turned on, or the node stopped between connecting a block
+ * and indexing it) a background thread reads the missing blocks from disk, while the node runs
+ * as usual. Once caught up it follows the chain through CIndexChainFollower, which is called
+ * under cs_main as blocks are connected, so what RPCs read is in step with the tip.
+ *
+ * Blocks that are no longer on the active chain are taken out again from their undo data.
+ */
+class BaseIndex
+{
+    friend class CIndexChainFollower;
+
+public:
+    virtual ~BaseIndex();
+
+    //! Name of the index, as in its -<name> option and its entries in getindexinfo
+    virtual const char* GetName() const = 0;
+
+    //! Find where the index was left and start following the chain. fWasEnabled tells whether the
+    //! index was kept by a version that wrote it while connecting blocks and recorded no best block.
+    void Start(bool fWasEnabled);
+
+    //! Stop the background thread. Must not be called with cs_main held.
+    void Stop();
+
+    //! Whether the index has caught up with the active chain
+    bool IsSynced() const { return m_synced; }
+
+    //! The last block written to the index, or nullptr for none
+    const CBlockIndex* GetBestBlock() const { return m_best_block_index; }
+
+protected:
+    //! Set up in-memory state from the best block of the index. Called under cs_main by Start().
+    virtual bool Init() { return true; }
+
+    //! Bring entries written in an older format up to date. Runs on the sync thread before it syncs.
+    virtual bool Upgrade() { return true; }
+
+    /**
+     * Add the entries of a block (fConnect) or take them out again (!fConnect) through batch.
+     * pindex->pprev is the last block of the index before, respectively after, the change.
+     */
+    virtual bool WriteBlock(CDBBatch& batch, const CBlock& block, const CBlockUndo& blockUndo,
+                            const CBlockIndex* pindex, bool fConnect) = 0;
+
+    //! Called once the changes WriteBlock made for a block are in the database
+    virtual void BlockWritten(const CBlock& block, const CBlockIndex* pindex, bool fConnect) {}
+
+private:
+    std::atomic<bool> m_synced{false};
+    std::atomic<bool> m_interrupt{false};
+    std::atomic<const CBlockIndex*> m_best_block_index{nullptr};
+    std::thread m_thread_sync;
+
+    //! Read pindex's block and undo data from disk and apply them to the index
+    bool ApplyBlock(const CBlockIndex* pindex, const CBlock* pblock, bool fConnect);
+    //! Add the entries of a block and the new best block to batch. blockUndo is unused for the genesis block.
+    bool WriteBlockToBatch(CDBBatch& batch, const CBlock& block, const CBlockUndo& blockUndo,
+                           const CBlockIndex* pindex, bool fConnect);
+    //! Take note of a block WriteBlockToBatch added, once batch is written
+    void BlockToBatchWritten(const CBlock& block, const CBlockIndex* pindex, bool fConnect);
+    //! Take blocks out of the index until its best block is pindexFork
+    bool Rewind(const CBlockIndex* pindexFork);
+    //! Get the index to where pindex, connected to the active chain, extends its best block.
+    //! False if the index does not take pindex: it is still syncing, already has it, or has
+    //! been left to the sync thread because blocks are missing in between.
+    bool PrepareBlockConnected(const CBlockIndex* pindex);
+    void StartSyncThread();
+    void ThreadSync();
+    void FatalError(const std::string& strMessage);
+};
+
+/**
+ * Keeps the running indexes in step with the active chain. A block that is connected or
+ * disconnected is written to all synced indexes in one database batch, from one copy of its
+ * undo data. For a block that is connected that is the copy ConnectBlock has just built.
+ */
+class CIndexChainFollower final : public CValidationInterface
+{
+public:
+    explicit CIndexChainFollower(const std::vector<BaseIndex*>& vIndexes) : m_indexes(vIndexes) {}
+
+    //! Keep the undo data of a block ConnectBlock connected until it reaches the indexes
+    void KeepBlockUndo(const CBlockIndex* pindex, CBlockUndo&& blockUndo);
+
+protected:
+    void BlockConnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex, const std::vector<CTransactionRef> &txnConflicted) override;
+    void BlockDisconnected(const std::shared_ptr<const CBlock> &block) override;
+
+private:
+    const std::vector<BaseIndex*> m_indexes;
+    //! Undo data of blocks connected whose BlockConnected has not come yet. Guarded by cs_main.
+    std::map<const CBlockIndex*, std::shared_ptr<const CBlockUndo> > m_block_undo;
+};
+
+#endif // AIDP_INDEX_BASE_H
@@ -0,0 +1,429 @@
+// Copyright (c) 2023-2024 The Aidp Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "index/chainindexes.h"
+
+#include "addressindex.h"
+#include "chain.h"
+#include "hash.h"
+#include "init.h"
+#include "memusage.h"
+#include "spentindex.h"
+#include "timestampindex.h"
+#include "txdb.h"
+#include "undo.h"
+#include "util.h"
+#include "validation.h"
+#include "assets/assets.h"
+
+#include <algorithm>
+
+CAddressIndexer* paddressindexer = nullptr;
+CSpentIndexer* pspentindexer = nullptr;
+CTimestampIndexer* ptimestampindexer = nullptr;
+CIndexChainFollower* pindexchainfollower = nullptr;
+
+static std::vector<BaseIndex*> GetRunningIndexes()
+{
+    std::vector<BaseIndex*> vIndexes;
+    if (paddressindexer)
+        vIndexes.push_back(paddressindexer);
+    if (pspentindexer)
+        vIndexes.push_back(pspentindexer);
+    if (ptimestampindexer)
+        vIndexes.push_back(ptimestampindexer);
+    return vIndexes;
+}
+
+/**
+ * The address an output pays to, as the address index keys it: type 2 for script hashes, 1 for
+ * key hashes (and asset transfers), with the asset and its amount. False if it is none of these.
+ */
+static bool GetIndexAddress(const CTxOut& out, bool fAssets, uint160& hashBytes, int& type, std::string& assetName, CAmount& amount)
+{
+    const CScript& script = out.scriptPubKey;
+    if (script.IsPayToScriptHash()) {
+        hashBytes = uint160(std::vector<unsigned char>(script.begin()+2, script.begin()+22));
+        type = 2;
+    } else if (script.IsPayToPublicKeyHash()) {
+        hashBytes = uint160(std::vector<unsigned char>(script.begin()+3, script.begin()+23));
+        type = 1;
+    } else if (script.IsPayToPublicKey()) {
+        hashBytes = Hash160(script.begin()+1, script.end()-1);
+        type = 1;
+    } else if (fAssets && ParseAssetScript(script, hashBytes, assetName, amount)) {
+        type = 1;
+        return true;
+    } else {
+        hashBytes.SetNull();
+        type = 0;
+        return false;
+    }
+    assetName = AIDP;
+    amount = out.nValue;
+    return true;
+}
+
+bool CAddressIndexer::Upgrade()
+{
+    if (!pblocktree->UpgradeAddressIndex())
+        return false;
+    if (ShutdownRequested())
+        return true;
+
+    // Address indexes from before the balance totals existed get them computed once
+    bool fAddressBalances = false;
+    pblocktree->ReadFlag("addressbalances", fAddressBalances);
+    if (!fAddressBalances) {
+        LogPrintf("%s: computing address balances from the address index...\n", __func__);
+        if (!pblocktree->BuildAddressBalances())
+            return error("%s: failed to compute address balances", __func__);
+        pblocktree->WriteFlag("addressbalances", true);
+    }
+    return true;
+}
+
+bool CAddressIndexer::WriteBlock(CDBBatch& batch, const CBlock& block, const CBlockUndo& blockUndo,
+                                 const CBlockIndex* pindex, bool fConnect)
+{
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
+    bool fAssets = AreAssetsDeployed();
+
+    uint160 hashBytes;
+    int type;
+    std::string assetName;
+    CAmount amount;
+    // Outputs spent later in the block cancel out in the unspent index as long as connecting
+    // goes through the block forwards, spends before outputs, and disconnecting backwards.
+    for (size_t n = 0; n < block.vtx.size(); n++) {
+        size_t i = fConnect ? n : block.vtx.size() - 1 - n;
+        const CTransaction& tx = *block.vtx[i];
+        const uint256& txhash = tx.GetHash();
+
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vSpends;
+        if (i > 0) {
+            const CTxUndo& txundo = blockUndo.vtxundo[i-1];
+            if (txundo.vprevout.size() != tx.vin.size())
+                return error("%s: transaction and undo data inconsistent", __func__);
+            for (size_t j = 0; j < tx.vin.size(); j++) {
+                const Coin& coin = txundo.vprevout[j];
+                if (!GetIndexAddress(coin.out, fAssets, hashBytes, type, assetName, amount))
+                    continue;
+                addressIndex.push_back(std::make_pair(CAddressIndexKey(type, hashBytes, assetName, pindex->nHeight, i, txhash, j, true), amount * -1));
+                CAddressUnspentKey key(type, hashBytes, assetName, tx.vin[j].prevout.hash, tx.vin[j].prevout.n);
+                vSpends.push_back(std::make_pair(key, fConnect ? CAddressUnspentValue() : CAddressUnspentValue(amount, coin.out.scriptPubKey, coin.nHeight)));
+            }
+        }
+
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vOutputs;
+        for (size_t k = 0; k < tx.vout.size(); k++) {
+            const CTxOut& out = tx.vout[k];
+            if (!GetIndexAddress(out, fAssets, hashBytes, type, assetName, amount))
+                continue;
+            addressIndex.push_back(std::make_pair(CAddressIndexKey(type, hashBytes, assetName, pindex->nHeight, i, txhash, k, false), amount));
+            CAddressUnspentKey key(type, hashBytes, assetName, txhash, k);
+            vOutputs.push_back(std::make_pair(key, fConnect ? CAddressUnspentValue(amount, out.scriptPubKey, pindex->nHeight) : CAddressUnspentValue()));
+        }
+
+        if (fConnect) {
+            addressUnspentIndex.insert(addressUnspentIndex.end(), vSpends.begin(), vSpends.end());
+            addressUnspentIndex.insert(addressUnspentIndex.end(), vOutputs.begin(), vOutputs.end());
+        } else {
+            addressUnspentIndex.insert(addressUnspentIndex.end(), vOutputs.begin(), vOutputs.end());
+            addressUnspentIndex.insert(addressUnspentIndex.end(), vSpends.begin(), vSpends.end());
+        }
+    }
+
+    if (fConnect) {
+        pblocktree->WriteAddressIndex(batch, addressIndex);
+    } else {
+        pblocktree->EraseAddressIndex(batch, addressIndex);
+    }
+    pblocktree->UpdateAddressUnspentIndex(batch, addressUnspentIndex);
+    return true;
+}
+
+bool CSpentIndexer::WriteBlock(CDBBatch& batch, const CBlock& block, const CBlockUndo& blockUndo,
+                               const CBlockIndex* pindex, bool fConnect)
+{
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
+    bool fAssets = AreAssetsDeployed();
+
+    uint160 hashBytes;
+    int type;
+    std::string assetName;
+    CAmount amount;
+    for (size_t i = 1; i < block.vtx.size(); i++) {
+        const CTransaction& tx = *block.vtx[i];
+        const CTxUndo& txundo = blockUndo.vtxundo[i-1];
+        if (txundo.vprevout.size() != tx.vin.size())
+            return error("%s: transaction and undo data inconsistent", __func__);
+        for (size_t j = 0; j < tx.vin.size(); j++) {
+            CSpentIndexKey key(tx.vin[j].prevout.hash, tx.vin[j].prevout.n);
+            if (!fConnect) {
+                spentIndex.push_back(std::make_pair(key, CSpentIndexValue()));
+                continue;
+            }
+            const Coin& coin = txundo.vprevout[j];
+            GetIndexAddress(coin.out, fAssets, hashBytes, type, assetName, amount);
+            spentIndex.push_back(std::make_pair(key, CSpentIndexValue(tx.GetHash(), j, pindex->nHeight, coin.out.nValue, type, hashBytes)));
+        }
+    }
+
+    pblocktree->UpdateSpentIndex(batch, spentIndex);
+    return true;
+}
+
+//! Approximate memory taken by an entry of the spent index cache
+static size_t SpentCacheEntryUsage()
+{
+    return memusage::MallocUsage(sizeof(std::pair<CSpentIndexKey, CSpentIndexValue>) + 2 * sizeof(void*)) +
+           memusage::MallocUsage(sizeof(memusage::unordered_node<std::pair<const CSpentIndexKey, void*> >)) + sizeof(void*);
+}
+
+bool CSpentIndexer::Init()
+{
+    int64_t nCacheSize = std::max<int64_t>(0, gArgs.GetArg("-spentindexcache", DEFAULT_SPENT_INDEX_CACHE)) << 20;
+    LOCK(cs_cache);
+    m_cache_max_entries = nCacheSize / SpentCacheEntryUsage();
+    return true;
+}
+
+bool CSpentIndexer::Upgrade()
+{
+    return pblocktree->UpgradeSpentIndex();
+}
+
+bool CSpentIndexer::Lookup(const CSpentIndexKey& key, CSpentIndexValue& value)
+{
+    uint64_t nGeneration;
+    {
+        LOCK(cs_cache);
+        auto it = m_cache_map.find(key);
+        if (it != m_cache_map.end()) {
+            m_cache_list.splice(m_cache_list.begin(), m_cache_list, it->second);
+            if (it->second->second.IsNull())
+                return false;
+            value = it->second->second;
+            return true;
+        }
+        nGeneration = m_cache_generation;
+    }
+
+    CSpentIndexKey keyRead = key;
+    CSpentIndexValue valueRead;
+    bool fSpent = pblocktree->ReadSpentIndex(keyRead, valueRead);
+    if (!fSpent)
+        valueRead.SetNull();
+
+    {
+        LOCK(cs_cache);
+        // Skip caching if a block was written meanwhile: what was read may be out of date.
+        if (m_cache_max_entries > 0 && nGeneration == m_cache_generation && !m_cache_map.count(key)) {
+            m_cache_list.emplace_front(key, valueRead);
+            m_cache_map.emplace(key, m_cache_list.begin());
+            if (m_cache_map.size() > m_cache_max_entries) {
+                m_cache_map.erase(m_cache_list.back().first);
+                m_cache_list.pop_back();
+            }
+        }
+    }
+
+    if (fSpent)
+        value = valueRead;
+    return fSpent;
+}
+
+void CSpentIndexer::BlockWritten(const CBlock& block, const CBlockIndex* pindex, bool fConnect)
+{
+    LOCK(cs_cache);
+    m_cache_generation++;
+    if (m_cache_map.empty())
+        return;
+    for (size_t i = 1; i < block.vtx.size(); i++) {
+        for (const CTxIn& txin : block.vtx[i]->vin) {
+            auto it = m_cache_map.find(CSpentIndexKey(txin.prevout.hash, txin.prevout.n));
+            if (it != m_cache_map.end()) {
+                m_cache_list.erase(it->second);
+                m_cache_map.erase(it);
+            }
+        }
+    }
+}
+
+void CTimestampIndexer::SetChainTip(const CBlockIndex* pindex)
+{
+    m_chain_timestamps.assign(pindex ? pindex->nHeight + 1 : 0, 0);
+    for (const CBlockIndex* pwalk = pindex; pwalk && pwalk->pprev; pwalk = pwalk->pprev)
+        m_chain_timestamps[pwalk->nHeight] = pwalk->nTime;
+    for (size_t i = 1; i < m_chain_timestamps.size(); i++) {
+        if (m_chain_timestamps[i] <= m_chain_timestamps[i-1])
+            m_chain_timestamps[i] = m_chain_timestamps[i-1] + 1;
+    }
+    m_chain_tip = pindex;
+}
+
+bool CTimestampIndexer::Init()
+{
+    AssertLockHeld(cs_main);
+    LOCK(cs_timestamps);
+    SetChainTip(GetBestBlock());
+
+    m_stale_blocks.clear();
+    for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex) {
+        const CBlockIndex* pindex = item.second;
+        if (!pindex->pprev || !pindex->IsValid(BLOCK_VALID_SCRIPTS))
+            continue;
+        if (m_chain_tip && m_chain_tip->GetAncestor(pindex->nHeight) == pindex)
+            continue;
+        unsigned int logicalTS;
+        if (pblocktree->ReadTimestampBlockIndex(item.first, logicalTS))
+            m_stale_blocks.insert(std::make_pair(logicalTS, item.first));
+    }
+    return true;
+}
+
+bool CTimestampIndexer::WriteBlock(CDBBatch& batch, const CBlock& block, const CBlockUndo& blockUndo,
+                                   const CBlockIndex* pindex, bool fConnect)
+{
+    unsigned int logicalTS = pindex->nTime;
+    {
+        LOCK(cs_timestamps);
+        if (!fConnect) {
+            // The entries stay in the database.
+            if (m_chain_tip != pindex)
+                SetChainTip(pindex);
+            m_stale_blocks.insert(std::make_pair(m_chain_timestamps.back(), pindex->GetBlockHash()));
+            m_chain_timestamps.pop_back();
+            m_chain_tip = pindex->pprev;
+            return true;
+        }
+
+        if (m_chain_tip != pindex->pprev)
+            SetChainTip(pindex->pprev);
+        unsigned int prevLogicalTS = m_chain_timestamps.back();
+        if (logicalTS <= prevLogicalTS) {
+            logicalTS = prevLogicalTS + 1;
+            LogPrintf("%s: Previous logical timestamp is newer Actual[%d] prevLogical[%d] Logical[%d]\n", __func__, pindex->nTime, prevLogicalTS, logicalTS);
+        }
+        m_chain_timestamps.push_back(logicalTS);
+        m_chain_tip = pindex;
+        m_stale_blocks.erase(std::make_pair(logicalTS, pindex->GetBlockHash()));
+    }
+
+    pblocktree->WriteTimestampIndex(batch, CTimestampIndexKey(logicalTS, pindex->GetBlockHash()));
+    pblocktree->WriteTimestampBlockIndex(batch, CTimestampBlockIndexKey(pindex->GetBlockHash()), CTimestampBlockIndexValue(logicalTS));
+    return true;
+}
+
+void CTimestampIndexer::GetBlockHashes(unsigned int high, unsigned int low, bool fActiveOnly,
+                                       std::vector<std::pair<uint256, unsigned int> >& hashes) const
+{
+    LOCK(cs_timestamps);
+    size_t nStart = hashes.size();
+
+    // Logical timestamps increase along the chain.
+    if (m_chain_timestamps.size() > 1) {
+        std::vector<unsigned int>::const_iterator first = std::lower_bound(m_chain_timestamps.begin() + 1, m_chain_timestamps.end(), low);
+        std::vector<unsigned int>::const_iterator last = std::lower_bound(first, m_chain_timestamps.end(), high);
+        if (first != last) {
+            hashes.resize(nStart + (last - first));
+            const CBlockIndex* pindex = m_chain_tip->GetAncestor(last - m_chain_timestamps.begin() - 1);
+            for (size_t i = hashes.size(); i > nStart; i--, pindex = pindex->pprev)
+                hashes[i-1] = std::make_pair(pindex->GetBlockHash(), m_chain_timestamps[pindex->nHeight]);
+        }
+    }
+
+    if (fActiveOnly)
+        return;
+
+    bool fStale = false;
+    for (std::set<std::pair<unsigned int, uint256> >::const_iterator it = m_stale_blocks.lower_bound(std::make_pair(low, uint256()));
+         it != m_stale_blocks.end() && it->first < high; it++) {
+        hashes.push_back(std::make_pair(it->second, it->first));
+        fStale = true;
+    }
+    // Same order as the database: by timestamp, then hash
+    if (fStale) {
+        std::sort(hashes.begin() + nStart, hashes.end(),
+            [](const std::pair<uint256, unsigned int>& a, const std::pair<uint256, unsigned int>& b) {
+                return a.second < b.second || (a.second == b.second && a.first < b.first);
+            });
+    }
+}
+
+/**
+ * Turn an index on or off as its option says. fIndex starts out as the flag stored in the block
+ * tree database, which tells whether the index was kept before, and fWasEnabled is set to it.
+ */
+template<typename Indexer>
+static void CreateChainIndex(Indexer*& pindexer, bool& fIndex, bool fDefault, bool& fWasEnabled)
+{
+    Indexer indexer;
+    fWasEnabled = fIndex;
+    fIndex = gArgs.GetBoolArg(std::string("-") + indexer.GetName(), fDefault);
+    pblocktree->WriteFlag(indexer.GetName(), fIndex);
+    if (fIndex)
+        pindexer = new Indexer();
+}
+
+void StartChainIndexes()
+{
+    bool fAddressIndexWasEnabled, fSpentIndexWasEnabled, fTimestampIndexWasEnabled;
+    CreateChainIndex(paddressindexer, fAddressIndex, DEFAULT_ADDRESSINDEX, fAddressIndexWasEnabled);
+    // An address index built from scratch computes its balances as it goes.
+    if (fAddressIndex && !fAddressIndexWasEnabled)
+        pblocktree->WriteFlag("addressbalances", true);
+    CreateChainIndex(pspentindexer, fSpentIndex, DEFAULT_SPENTINDEX, fSpentIndexWasEnabled);
+    CreateChainIndex(ptimestampindexer, fTimestampIndex, DEFAULT_TIMESTAMPINDEX, fTimestampIndexWasEnabled);
+
+    std::vector<BaseIndex*> vIndexes = GetRunningIndexes();
+    if (vIndexes.empty())
+        return;
+
+    // Registered before the indexes start, so no block is connected between an index catching
+    // up and it following the chain.
+    {
+        LOCK(cs_main);
+        pindexchainfollower = new CIndexChainFollower(vIndexes);
+    }
+    RegisterValidationInterface(pindexchainfollower);
+
+    if (paddressindexer)
+        paddressindexer->Start(fAddressIndexWasEnabled);
+    if (pspentindexer)
+        pspentindexer->Start(fSpentIndexWasEnabled);
+    if (ptimestampindexer)
+        ptimestampindexer->Start(fTimestampIndexWasEnabled);
+}
+
+template<typename Indexer>
+static void StopChainIndex(Indexer*& pindexer)
+{
+    if (pindexer) {
+        pindexer->Stop();
+        delete pindexer;
+        pindexer = nullptr;
+    }
+}
+
+void StopChainIndexes()
+{
+    if (pindexchainfollower) {
+        UnregisterValidationInterface(pindexchainfollower);
+        LOCK(cs_main);
+        delete pindexchainfollower;
+        pindexchainfollower = nullptr;
+    }
+    StopChainIndex(paddressindexer);
+    StopChainIndex(pspentindexer);
+    StopChainIndex(ptimestampindexer);
+}
+
+std::vector<const BaseIndex*> GetChainIndexes()
+{
+    std::vector<BaseIndex*> vIndexes = GetRunningIndexes();
+    return std::vector<const BaseIndex*>(vIndexes.begin(), vIndexes.end());
+}
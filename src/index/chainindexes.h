@@ -0,0 +1,122 @@
+// Copyright (c) 2023-2024 The Aidp Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef AIDP_INDEX_CHAININDEXES_H
+#define AIDP_INDEX_CHAININDEXES_H
+
+#include "index/base.h"
+#include "spentindex.h"
+#include "sync.h"
+#include "txmempool.h"
+#include "uint256.h"
+
+#include <list>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+//! -spentindexcache default (MiB)
+static const int64_t DEFAULT_SPENT_INDEX_CACHE = 16;
+
+/** -addressindex: the history, unspent outputs and balances of every address */
+class CAddressIndexer : public BaseIndex
+{
+public:
+    const char* GetName() const override { return "addressindex"; }
+
+protected:
+    bool Upgrade() override;
+    bool WriteBlock(CDBBatch& batch, const CBlock& block, const CBlockUndo& blockUndo,
+                    const CBlockIndex* pindex, bool fConnect) override;
+};
+
+/**
+ * -spentindex: the input that spends each output.
+ *
+ * Recent lookups, including those of outputs that are not spent, are kept in a least recently
+ * used cache of -spentindexcache MiB. Entries are dropped once a block spending their output is
+ * written to or taken out of the index.
+ */
+class CSpentIndexer : public BaseIndex
+{
+public:
+    const char* GetName() const override { return "spentindex"; }
+
+    //! Read the spending input of an output in the block chain. False if it is not spent.
+    bool Lookup(const CSpentIndexKey& key, CSpentIndexValue& value);
+
+protected:
+    bool Init() override;
+    bool Upgrade() override;
+    bool WriteBlock(CDBBatch& batch, const CBlock& block, const CBlockUndo& blockUndo,
+                    const CBlockIndex* pindex, bool fConnect) override;
+    void BlockWritten(const CBlock& block, const CBlockIndex* pindex, bool fConnect) override;
+
+private:
+    typedef std::list<std::pair<CSpentIndexKey, CSpentIndexValue> > spentCacheList;
+
+    CCriticalSection cs_cache;
+    //! Most recently used first; a null value means the output is not spent
+    spentCacheList m_cache_list;
+    std::unordered_map<CSpentIndexKey, spentCacheList::iterator, SaltedSpentIndexKeyHasher> m_cache_map;
+    size_t m_cache_max_entries{0};
+    //! Bumped on every change to the index, so lookups do not cache what they read before it
+    uint64_t m_cache_generation{0};
+};
+
+/**
+ * -timestampindex: blocks by a timestamp that grows along the chain. Entries of blocks that
+ * leave the chain stay, and are told apart by looking the block up in the active chain.
+ *
+ * Logical timestamps follow from the block times alone, so the index keeps those of its chain
+ * in memory, one per height, and answers queries without reading the database. Entries of
+ * blocks off that chain are kept in memory too; there are few of them.
+ */
+class CTimestampIndexer : public BaseIndex
+{
+public:
+    const char* GetName() const override { return "timestampindex"; }
+
+    //! Hashes and logical timestamps of the blocks with a logical timestamp in [low, high)
+    void GetBlockHashes(unsigned int high, unsigned int low, bool fActiveOnly,
+                        std::vector<std::pair<uint256, unsigned int> >& hashes) const;
+
+protected:
+    bool Init() override;
+    bool WriteBlock(CDBBatch& batch, const CBlock& block, const CBlockUndo& blockUndo,
+                    const CBlockIndex* pindex, bool fConnect) override;
+
+private:
+    mutable CCriticalSection cs_timestamps;
+    //! Logical timestamps of the blocks up to m_chain_tip by height. The genesis block is not
+    //! indexed, its entry is 0.
+    std::vector<unsigned int> m_chain_timestamps;
+    const CBlockIndex* m_chain_tip{nullptr};
+    //! Logical timestamps and hashes of indexed blocks that are not on that chain
+    std::set<std::pair<unsigned int, uint256> > m_stale_blocks;
+
+    //! Compute the logical timestamps up to pindex
+    void SetChainTip(const CBlockIndex* pindex);
+};
+
+extern CAddressIndexer* paddressindexer;
+extern CSpentIndexer* pspentindexer;
+extern CTimestampIndexer* ptimestampindexer;
+//! Writes the blocks the active chain connects and disconnects to the running indexes, if any
+extern CIndexChainFollower* pindexchainfollower;
+
+/**
+ * Start the indexes turned on by -addressindex, -spentindex and -timestampindex, which build
+ * themselves in the background if they are behind. Requires the chain to be loaded.
+ */
+void StartChainIndexes();
+
+/** Stop and delete the running indexes. Must not be called with cs_main held. */
+void StopChainIndexes();
+
+/** The running indexes, for reporting */
+std::vector<const BaseIndex*> GetChainIndexes();
+
+#endif // AIDP_INDEX_CHAININDEXES_H
@@ -15,12 +15,15 @@
 #include "amount.h"
 #include "chain.h"
 #include "chainparams.h"
+#include "blockfilemap.h"
 #include "checkpoints.h"
+#include "coinsprefetch.h"
 #include "compat/sanity.h"
 #include "consensus/validation.h"
 #include "fs.h"
 #include "httpserver.h"
 #include "httprpc.h"
+#include "index/chainindexes.h"
 #include "key.h"
 #include "validation.h"
 #include "miner.h"
@@ -74,6 +77,7 @@ using namespace boost::placeholders;
 #include <openssl/crypto.h>
 
 #if ENABLE_ZMQ
+#include "zmq/zmqabstractnotifier.h"
 #include "zmq/zmqnotificationinterface.h"
 #endif
 
@@ -128,6 +132,7 @@ static const char* FEE_ESTIMATES_FILENAME="fee_estimates.dat";
 std::atomic<bool> fRequestShutdown(false);
 std::atomic<bool> fRequestRestart(false);
 std::atomic<bool> fDumpMempoolLater(false);
+std::atomic<bool> fDumpSigCacheLater(false);
 
 void StartShutdown()
 {
@@ -216,10 +221,22 @@ void PrepareShutdown()
     peerLogic.reset();
     g_connman.reset();
 
+    StopChainIndexes();
+
+    if (pblocktemplatemanager) {
+        UnregisterValidationInterface(pblocktemplatemanager);
+        delete pblocktemplatemanager;
+        pblocktemplatemanager = nullptr;
+    }
+
     if (fDumpMempoolLater && gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
         DumpMempool();
     }
 
+    if (fDumpSigCacheLater) {
+        DumpSignatureCaches();
+    }
+
     if (fFeeEstimatesInitialized)
     {
         ::feeEstimator.FlushUnconfirmed(::mempool);
@@ -252,12 +269,18 @@ void PrepareShutdown()
         if (pcoinsTip != nullptr) {
             FlushStateToDisk();
         }
+        delete pcoinsprefetcher;
+        pcoinsprefetcher = nullptr;
+
         delete pcoinsTip;
         pcoinsTip = nullptr;
 
         delete pcoinscatcher;
         pcoinscatcher = nullptr;
 
+        delete pcoinsflushview;
+        pcoinsflushview = nullptr;
+
         delete pcoinsdbview;
         pcoinsdbview = nullptr;
 
@@ -277,9 +300,6 @@ void PrepareShutdown()
         delete pMessagesCache;
         pMessagesCache = nullptr;
 
-        delete pMessageSubscribedChannelsCache;
-        pMessageSubscribedChannelsCache = nullptr;
-
         delete pMessagesSeenAddressCache;
         pMessagesSeenAddressCache = nullptr;
 
@@ -432,6 +452,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-?", _("Print this help message and exit"));
     strUsage += HelpMessageOpt("-version", _("Print version and exit"));
     strUsage += HelpMessageOpt("-alertnotify=<cmd>", _("Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)"));
+    strUsage += HelpMessageOpt("-backgroundflush", strprintf(_("Write coin database flushes from a background thread instead of blocking block processing (default: %u)"), DEFAULT_BACKGROUND_FLUSH));
     strUsage += HelpMessageOpt("-blocknotify=<cmd>", _("Execute command when the best block changes (%s in cmd is replaced by block hash)"));
     if (showDebug)
         strUsage += HelpMessageOpt("-blocksonly", strprintf(_("Whether to operate in a blocks only mode (default: %u)"), DEFAULT_BLOCKSONLY));
@@ -462,15 +483,18 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-minimumchainwork=<hex>", strprintf("Minimum work assumed to exist on a valid chain in hex (default: %s, testnet: %s)", defaultChainParams->GetConsensus().nMinimumChainWork.GetHex(), testnetChainParams->GetConsensus().nMinimumChainWork.GetHex()));
     }
     strUsage += HelpMessageOpt("-persistmempool", strprintf(_("Whether to save the mempool on shutdown and load on restart (default: %u)"), DEFAULT_PERSIST_MEMPOOL));
+    strUsage += HelpMessageOpt("-persistsigcache", strprintf(_("Whether to save the signature and script execution caches on shutdown and load them on restart (default: %u)"), DEFAULT_PERSIST_SIGCACHE));
     strUsage += HelpMessageOpt("-blockreconstructionextratxn=<n>", strprintf(_("Extra transactions to keep in memory for compact block reconstructions (default: %u)"), DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN));
     strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
         -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS));
+    strUsage += HelpMessageOpt("-mmapblocks", strprintf(_("Read finished block files through memory mappings when serving blocks and transactions (default: %u)"), DEFAULT_MMAP_BLOCKS));
+    strUsage += HelpMessageOpt("-prefetchthreads=<n>", strprintf(_("Number of threads reading the coins of received blocks ahead of connecting them (0 to %d, default: %d)"), MAX_PREFETCH_THREADS, DEFAULT_PREFETCH_THREADS));
     strUsage += HelpMessageOpt("-autofixmempool", strprintf(_("When set, if the CreateNewBlock fails because of a transaction. The mempool will be cleared. (default: %d)"), false));
     strUsage += HelpMessageOpt("-bypassdownload", strprintf(_("When set, if the chain is in initialblockdownload the getblocktemplate rpc call will still return block data (default: %d)"), false));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file (default: %s)"), AIDP_PID_FILENAME));
 #endif
-    strUsage += HelpMessageOpt("-prune=<n>", strprintf(_("Reduce storage requirements by enabling pruning (deleting) of old blocks. This allows the pruneblockchain RPC to be called to delete specific blocks, and enables automatic pruning of old blocks if a target size in MiB is provided. This mode is incompatible with -txindex and -rescan. "
+    strUsage += HelpMessageOpt("-prune=<n>", strprintf(_("Reduce storage requirements by enabling pruning (deleting) of old blocks. This allows the pruneblockchain RPC to be called to delete specific blocks, and enables automatic pruning of old blocks if a target size in MiB is provided. This mode is incompatible with -txindex, -addressindex, -spentindex, -timestampindex and -rescan. "
             "Warning: Reverting this setting requires re-downloading the entire blockchain. "
             "(default: 0 = disable pruning blocks, 1 = allow manual pruning via RPC, >%u = automatically prune block files to stay under the specified target size in MiB)"), MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024));
     strUsage += HelpMessageOpt("-reindex-chainstate", _("Rebuild chain state from the currently indexed blocks"));
@@ -484,6 +508,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-addressindex", strprintf(_("Maintain a full address index, used to query for the balance, txids and unspent outputs for addresses (default: %u)"), DEFAULT_ADDRESSINDEX));
     strUsage += HelpMessageOpt("-timestampindex", strprintf(_("Maintain a timestamp index for block hashes, used to query blocks hashes by a range of timestamps (default: %u)"), DEFAULT_TIMESTAMPINDEX));
     strUsage += HelpMessageOpt("-spentindex", strprintf(_("Maintain a full spent index, used to query the spending txid and input index for an outpoint (default: %u)"), DEFAULT_SPENTINDEX));
+    strUsage += HelpMessageOpt("-spentindexcache=<n>", strprintf(_("Size of the cache of spent index lookups in megabytes (default: %u)"), DEFAULT_SPENT_INDEX_CACHE));
 
     strUsage += HelpMessageGroup(_("Connection options:"));
     strUsage += HelpMessageOpt("-addnode=<ip>", _("Add a node to connect to and attempt to keep the connection open (see the `addnode` RPC command help for more info)"));
@@ -536,6 +561,12 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-zmqpubrawblock=<address>", _("Enable publish raw block in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtx=<address>", _("Enable publish raw transaction in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawmessage=<address>", _("Enable publish raw asset messages in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubassetissue=<address>", _("Enable publish asset issuances in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubassetreissue=<address>", _("Enable publish asset reissuances in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubassettransfer=<address>", _("Enable publish asset transfers in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubassetrestriction=<address>", _("Enable publish tag, freeze and verifier changes of restricted assets in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubhwm=<n>", strprintf(_("Set the outbound message high water mark of every publish socket, can be overridden per topic with -zmqpub<topic>hwm (default: %d)"), DEFAULT_ZMQ_SNDHWM));
+    strUsage += HelpMessageOpt("-zmqqueuesize=<n>", strprintf(_("Maximum number of notifications waiting to be published, further notifications are dropped (default: %u)"), DEFAULT_ZMQ_QUEUE_SIZE));
 #endif
 
     strUsage += HelpMessageGroup(_("Debugging/Testing options:"));
@@ -1008,10 +1039,16 @@ bool AppInitParameterInteraction()
 
     // also see: InitParameterInteraction()
 
-    // if using block pruning, then disallow txindex
+    // if using block pruning, then disallow txindex and the indexes built from the block files
     if (gArgs.GetArg("-prune", 0)) {
         if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX))
             return InitError(_("Prune mode is incompatible with -txindex."));
+        if (gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX))
+            return InitError(_("Prune mode is incompatible with -addressindex."));
+        if (gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX))
+            return InitError(_("Prune mode is incompatible with -spentindex."));
+        if (gArgs.GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX))
+            return InitError(_("Prune mode is incompatible with -timestampindex."));
     }
 
     // -bind and -whitebind can't be set when not listening
@@ -1088,6 +1125,7 @@ bool AppInitParameterInteraction()
     }
     fCheckBlockIndex = gArgs.GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
     fCheckpointsEnabled = gArgs.GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
+    fMmapBlocks = gArgs.GetBoolArg("-mmapblocks", DEFAULT_MMAP_BLOCKS);
 
     hashAssumeValid = uint256S(gArgs.GetArg("-assumevalid", chainparams.GetConsensus().defaultAssumeValid.GetHex()));
     if (!hashAssumeValid.IsNull())
@@ -1348,6 +1386,10 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
 
     InitSignatureCache();
     InitScriptExecutionCache();
+    if (gArgs.GetBoolArg("-persistsigcache", DEFAULT_PERSIST_SIGCACHE)) {
+        LoadSignatureCaches();
+        fDumpSigCacheLater = true;
+    }
 
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
@@ -1537,7 +1579,10 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
         do {
             try {
                 UnloadBlockIndex();
+                delete pcoinsprefetcher;
+                pcoinsprefetcher = nullptr;
                 delete pcoinsTip;
+                delete pcoinsflushview;
                 delete pcoinsdbview;
                 delete pcoinscatcher;
                 delete pblocktree;
@@ -1555,7 +1600,6 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
                     delete pmessagechanneldb;
                     delete pMessagesCache;
                     delete pMessagesSeenAddressCache;
-                    delete pMessageSubscribedChannelsCache;
 
                     // My restricted assets
                     delete pmyrestricteddb;
@@ -1574,15 +1618,26 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
 
                     // Basic assets
                     passetsdb = new CAssetsDB(nBlockTreeDBCache, false, fReset);
+                    if (!passetsdb->Upgrade()) {
+                        strLoadError = _("Error upgrading the assets database");
+                        break;
+                    }
                     passets = new CAssetsCache();
                     passetsCache = new CLRUCache<std::string, CDatabasedAssetData>(MAX_CACHE_ASSETS_SIZE);
 
                     // Messaging assets
                     pMessagesCache = new CLRUCache<std::string, CMessage>(1000);
-                    pMessageSubscribedChannelsCache = new CLRUCache<std::string, int>(1000);
                     pMessagesSeenAddressCache = new CLRUCache<std::string, int>(1000);
                     pmessagedb = new CMessageDB(nBlockTreeDBCache, false, false);
                     pmessagechanneldb = new CMessageChannelDB(nBlockTreeDBCache, false, false);
+                    if (!pmessagedb->Upgrade()) {
+                        strLoadError = _("Error upgrading the messages database");
+                        break;
+                    }
+                    if (!LoadSubscribedChannels()) {
+                        strLoadError = _("Failed to load subscribed message channels");
+                        break;
+                    }
 
                     // My restricted assets
                     pmyrestricteddb = new CMyRestrictedDB(nBlockTreeDBCache, false, false);
@@ -1655,24 +1710,6 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
                     break;
                 }
 
-                // Check for changed -addressindex state
-                if (fAddressIndex != gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX)) {
-                    strLoadError = _("You need to rebuild the database using -reindex-chainstate to change -addressindex");
-                    break;
-                }
-
-                // Check for changed -spentindex state
-                if (fSpentIndex != gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX)) {
-                    strLoadError = _("You need to rebuild the database using -reindex-chainstate to change -spentindex");
-                    break;
-                }
-
-                // Check for changed -timestampindex state
-                if (fTimestampIndex != gArgs.GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX)) {
-                    strLoadError = _("You need to rebuild the database using -reindex-chainstate to change -timestampindex");
-                    break;
-                }
-
                 // Check for changed -prune state.  What we are concerned about is a user who has pruned blocks
                 // in the past, but is now trying to run unpruned.
                 if (fHavePruned && !fPruneMode) {
@@ -1693,7 +1730,8 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
                 // block tree into mapBlockIndex!
 
                 pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fReset || fReindexChainState);
-                pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
+                pcoinsflushview = new CCoinsViewBackgroundFlush(pcoinsdbview);
+                pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsflushview);
 
                 // If necessary, upgrade from older database format.
                 // This is a no-op if we cleared the coinsviewdb with -reindex or -reindex-chainstate
@@ -1710,6 +1748,9 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
 
                 // The on-disk coinsdb is now in a good state, create the cache
                 pcoinsTip = new CCoinsViewCache(pcoinscatcher);
+                int nPrefetchThreads = std::min(std::max((int)gArgs.GetArg("-prefetchthreads", DEFAULT_PREFETCH_THREADS), 0), MAX_PREFETCH_THREADS);
+                if (nPrefetchThreads > 0)
+                    pcoinsprefetcher = new CCoinsPrefetcher(pcoinscatcher, nPrefetchThreads);
 
                 bool is_coinsview_empty = fReset || fReindexChainState || pcoinsTip->GetBestBlock().IsNull();
                 if (!is_coinsview_empty) {
@@ -1805,6 +1846,16 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
         ::feeEstimator.Read(est_filein);
     fFeeEstimatesInitialized = true;
 
+    // ********************************************************* Step 7b: start indexes
+
+    // The address, spent and timestamp indexes catch up with the chain in the background
+    // when they are behind, as after being turned on, so changing them needs no reindex.
+    StartChainIndexes();
+
+    // The getblocktemplate template follows the chain and the mempool from here on.
+    pblocktemplatemanager = new CBlockTemplateManager();
+    RegisterValidationInterface(pblocktemplatemanager);
+
     // ********************************************************* Step 8: load wallet
 #ifdef ENABLE_WALLET
     if (!OpenWallets())
@@ -39,6 +39,9 @@
 #include <queue>
 #include <utility>
 
+// Fixing Boost 1.73 compile errors
+#include <boost/bind/bind.hpp>
+using namespace boost::placeholders;
 
 extern std::vector<CWalletRef> vpwallets;
 //////////////////////////////////////////////////////////////////////////////
@@ -503,6 +506,175 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
     }
 }
 
+//! Seconds an outdated block template is handed out for before it is assembled again
+static const int64_t BLOCK_TEMPLATE_REFRESH_INTERVAL = 5;
+
+CBlockTemplateManager* pblocktemplatemanager = nullptr;
+
+CBlockTemplateManager::CBlockTemplateManager()
+{
+    mempool.NotifyEntryRemoved.connect(boost::bind(&CBlockTemplateManager::TransactionRemovedFromMempool, this, _1, _2));
+}
+
+CBlockTemplateManager::~CBlockTemplateManager()
+{
+    mempool.NotifyEntryRemoved.disconnect(boost::bind(&CBlockTemplateManager::TransactionRemovedFromMempool, this, _1, _2));
+}
+
+std::shared_ptr<const CBlockTemplate> CBlockTemplateManager::GetTemplate(const CScript& scriptPubKeyIn, bool fMineWitnessTx, unsigned int& nTransactionsUpdated)
+{
+    AssertLockHeld(cs_main);
+    LOCK(mempool.cs);
+    LOCK(cs_template);
+
+    int64_t nNow = GetTime();
+    if (mempool.GetTransactionsUpdated() != m_transactions_updated)
+        m_outdated = true;
+
+    if (!m_template || m_pindex_prev != chainActive.Tip() || m_script != scriptPubKeyIn ||
+        m_mine_witness_tx != fMineWitnessTx ||
+        (m_outdated && nNow - m_time_created > BLOCK_TEMPLATE_REFRESH_INTERVAL)) {
+        CreateTemplate(scriptPubKeyIn, fMineWitnessTx);
+    } else if (!m_validated) {
+        // Appended transactions were only checked against the mempool
+        CValidationState state;
+        if (!TestBlockValidity(state, GetParams(), m_template->block, chainActive.Tip(), false, false)) {
+            LogPrintf("%s: appended block template failed to validate, assembling a new one: %s\n", __func__, FormatStateMessage(state));
+            CreateTemplate(scriptPubKeyIn, fMineWitnessTx);
+        }
+        m_validated = true;
+    }
+
+    nTransactionsUpdated = m_transactions_updated;
+    return m_template;
+}
+
+void CBlockTemplateManager::CreateTemplate(const CScript& scriptPubKeyIn, bool fMineWitnessTx)
+{
+    // Nothing is handed out should this fail.
+    m_template.reset();
+    m_txids.clear();
+
+    m_transactions_updated = mempool.GetTransactionsUpdated();
+    m_outdated = false;
+    m_time_created = GetTime();
+    m_pindex_prev = chainActive.Tip();
+    m_script = scriptPubKeyIn;
+    m_mine_witness_tx = fMineWitnessTx;
+
+    const CChainParams& chainparams = GetParams();
+    BlockAssembler assembler(chainparams);
+    std::shared_ptr<CBlockTemplate> pblocktemplate = assembler.CreateNewBlock(scriptPubKeyIn, fMineWitnessTx);
+    if (!pblocktemplate)
+        throw std::runtime_error(strprintf("%s: out of memory", __func__));
+
+    const CBlock& block = pblocktemplate->block;
+    m_block_weight = 4000;
+    m_block_sigops_cost = 400;
+    for (size_t i = 1; i < block.vtx.size(); i++) {
+        m_txids.insert(block.vtx[i]->GetHash());
+        m_block_weight += GetTransactionWeight(*block.vtx[i]);
+        m_block_sigops_cost += pblocktemplate->vTxSigOpsCost[i];
+    }
+    m_block_max_weight = assembler.GetBlockMaxWeight();
+    m_block_min_fee_rate = assembler.GetBlockMinFeeRate();
+    m_lock_time_cutoff = (STANDARD_LOCKTIME_VERIFY_FLAGS & LOCKTIME_MEDIAN_TIME_PAST)
+                         ? m_pindex_prev->GetMedianTimePast()
+                         : block.GetBlockTime();
+    m_include_witness = IsWitnessEnabled(m_pindex_prev, chainparams.GetConsensus()) && fMineWitnessTx;
+    // CreateNewBlock checked it with TestBlockValidity
+    m_validated = true;
+    m_template = pblocktemplate;
+}
+
+bool CBlockTemplateManager::AppendTransaction(CTxMemPool::txiter it)
+{
+    // The same checks as package selection, for a package of one: all its ancestors are in the
+    // block. The mempool accepted the transaction on top of the same tip and its parents, so it
+    // needs no further validation.
+    for (CTxMemPool::txiter parent : mempool.GetMemPoolParents(it)) {
+        if (!m_txids.count(parent->GetTx().GetHash()))
+            return false;
+    }
+    if (it->GetModifiedFee() < m_block_min_fee_rate.GetFee(it->GetTxSize()))
+        return false;
+    if (m_block_weight + WITNESS_SCALE_FACTOR * it->GetTxSize() >= m_block_max_weight)
+        return false;
+    if (m_block_sigops_cost + it->GetSigOpCost() >= MAX_BLOCK_SIGOPS_COST)
+        return false;
+    const CTransaction& tx = it->GetTx();
+    if (!IsFinalTx(tx, m_pindex_prev->nHeight + 1, m_lock_time_cutoff))
+        return false;
+    if (!m_include_witness && tx.HasWitness())
+        return false;
+
+    // Templates already handed out stay as they are.
+    std::shared_ptr<CBlockTemplate> pblocktemplate = std::make_shared<CBlockTemplate>(*m_template);
+    CBlock& block = pblocktemplate->block;
+    block.vtx.push_back(it->GetSharedTx());
+    pblocktemplate->vTxFees.push_back(it->GetFee());
+    pblocktemplate->vTxSigOpsCost.push_back(it->GetSigOpCost());
+    pblocktemplate->vTxFees[0] -= it->GetFee();
+
+    // The fee goes to the miner, and the witness commitment covers the new transaction.
+    CMutableTransaction coinbaseTx(*block.vtx[0]);
+    coinbaseTx.vout[0].nValue += it->GetFee();
+    if (!pblocktemplate->vchCoinbaseCommitment.empty()) {
+        assert(coinbaseTx.vout.back().scriptPubKey == CScript(pblocktemplate->vchCoinbaseCommitment.begin(), pblocktemplate->vchCoinbaseCommitment.end()));
+        coinbaseTx.vout.pop_back();
+    }
+    block.vtx[0] = MakeTransactionRef(std::move(coinbaseTx));
+    pblocktemplate->vchCoinbaseCommitment = GenerateCoinbaseCommitment(block, m_pindex_prev, GetParams().GetConsensus());
+
+    m_txids.insert(tx.GetHash());
+    m_block_weight += it->GetTxWeight();
+    m_block_sigops_cost += it->GetSigOpCost();
+    m_validated = false;
+    m_template = pblocktemplate;
+    return true;
+}
+
+void CBlockTemplateManager::TransactionAddedToMempool(const CTransactionRef &ptx)
+{
+    LOCK2(cs_main, mempool.cs);
+    LOCK(cs_template);
+
+    // Adding the transaction counted as one change; anything else went unnoticed.
+    unsigned int nTransactionsUpdated = mempool.GetTransactionsUpdated();
+    if (++m_transactions_updated != nTransactionsUpdated) {
+        m_transactions_updated = nTransactionsUpdated;
+        m_outdated = true;
+    }
+
+    if (!m_template || m_pindex_prev != chainActive.Tip())
+        return;
+    CTxMemPool::txiter it = mempool.mapTx.find(ptx->GetHash());
+    if (it == mempool.mapTx.end())
+        return;
+    if (!AppendTransaction(it))
+        m_outdated = true;
+}
+
+void CBlockTemplateManager::TransactionRemovedFromMempool(CTransactionRef ptx, MemPoolRemovalReason reason)
+{
+    LOCK(cs_template);
+
+    // Called under mempool.cs just before the mempool counts the removal
+    ++m_transactions_updated;
+    if (m_template && m_txids.count(ptx->GetHash())) {
+        m_template.reset();
+        m_txids.clear();
+    }
+}
+
+void CBlockTemplateManager::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    // The template on the new tip is assembled by the next request, not here under cs_main.
+    LOCK(cs_template);
+    m_template.reset();
+    m_txids.clear();
+}
+
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
 {
     // Update nExtraNonce
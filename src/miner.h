@@ -8,17 +8,21 @@
 #ifndef AIDP_MINER_H
 #define AIDP_MINER_H
 
+#include "policy/feerate.h"
 #include "primitives/block.h"
+#include "script/script.h"
+#include "sync.h"
 #include "txmempool.h"
+#include "validationinterface.h"
 
 #include <stdint.h>
 #include <memory>
+#include <set>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 
 class CBlockIndex;
 class CChainParams;
-class CScript;
 
 namespace Consensus { struct Params; };
 
@@ -169,6 +173,9 @@ public:
     /** Construct a new block template with coinbase to scriptPubKeyIn */
     std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn, bool fMineWitnessTx=true);
 
+    unsigned int GetBlockMaxWeight() const { return nBlockMaxWeight; }
+    const CFeeRate& GetBlockMinFeeRate() const { return blockMinFeeRate; }
+
 private:
     // utility functions
     /** Clear the block's state and prepare for assembling a new block */
@@ -203,6 +210,67 @@ private:
     int UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded, indexed_modified_transaction_set &mapModifiedTx);
 };
 
+/**
+ * Keeps the block template handed out by getblocktemplate up to date as the chain and the
+ * mempool change, so that asking for it again rarely means assembling a block from scratch.
+ *
+ * A transaction that enters the mempool is appended to the template when the block has room
+ * for it and all its unconfirmed parents are in it already, which is where package selection
+ * would put it as well. A template with appended transactions is checked with
+ * TestBlockValidity once before it is handed out. Other changes (a transaction that does not
+ * fit, fee deltas, a cleared mempool) make the template outdated, and it is assembled again
+ * once it is a few seconds old, as before. It is thrown away when one of its transactions
+ * leaves the mempool or the tip changes; the next request then assembles a new one.
+ */
+class CBlockTemplateManager : public CValidationInterface
+{
+public:
+    CBlockTemplateManager();
+    virtual ~CBlockTemplateManager();
+
+    /**
+     * The template of a block on the tip paying to scriptPubKeyIn. nTransactionsUpdated is set to
+     * the mempool's count of changes that the template takes into account. Requires cs_main.
+     * Throws std::runtime_error like CreateNewBlock when a new template fails to validate.
+     */
+    std::shared_ptr<const CBlockTemplate> GetTemplate(const CScript& scriptPubKeyIn, bool fMineWitnessTx, unsigned int& nTransactionsUpdated);
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+    void TransactionAddedToMempool(const CTransactionRef &ptx) override;
+
+private:
+    CCriticalSection cs_template;
+    std::shared_ptr<const CBlockTemplate> m_template;
+    const CBlockIndex* m_pindex_prev{nullptr};
+    CScript m_script;
+    bool m_mine_witness_tx{true};
+    int64_t m_time_created{0};
+    //! Whether the template passed TestBlockValidity since a transaction was last appended
+    bool m_validated{false};
+    //! The mempool's count of changes, as far as the template follows them
+    unsigned int m_transactions_updated{0};
+    //! Whether the mempool has changed in a way the template does not reflect
+    bool m_outdated{false};
+
+    // What BlockAssembler would check a transaction against when adding it to the template
+    std::set<uint256> m_txids;
+    uint64_t m_block_weight{0};
+    int64_t m_block_sigops_cost{0};
+    unsigned int m_block_max_weight{0};
+    CFeeRate m_block_min_fee_rate;
+    int64_t m_lock_time_cutoff{0};
+    bool m_include_witness{false};
+
+    void TransactionRemovedFromMempool(CTransactionRef ptx, MemPoolRemovalReason reason);
+    //! Assemble a new template. Requires cs_main, mempool.cs and cs_template.
+    void CreateTemplate(const CScript& scriptPubKeyIn, bool fMineWitnessTx);
+    //! Add a mempool transaction at the end of the template. False if it does not belong there.
+    bool AppendTransaction(CTxMemPool::txiter it);
+};
+
+extern CBlockTemplateManager* pblocktemplatemanager;
+
 /** Modify the extranonce in a block */
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
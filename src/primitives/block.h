@@ -11,6 +11,7 @@
 #include "primitives/transaction.h"
 #include "serialize.h"
 #include "uint256.h"
+#include "support/allocators/monotonic.h"
 
 /** Nodes collect new transactions into a block, hash them into a hash tree,
  * and scan through nonce values to make the block's hash satisfy proof-of-work
@@ -174,6 +175,37 @@ public:
     std::string ToString() const;
 };
 
+/** Bytes of arena reserved per transaction: the transaction and its shared_ptr control block */
+static const size_t BLOCK_ARENA_BYTES_PER_TX = sizeof(CTransaction) + 4 * sizeof(void*);
+
+/**
+ * Deserialize a block like s >> block, but create all of its transactions in one
+ * MonotonicResource instead of with a heap allocation each. The arena is freed when the last
+ * of the block's transactions is, so callers that keep a single transaction for a long time
+ * (the wallet) should keep a copy of their own rather than pin the whole block's arena.
+ *
+ * Only the transaction objects move into the arena; their input, output and script storage
+ * is still allocated by the containers inside CTransaction.
+ */
+template <typename Stream>
+void UnserializeBlockInArena(Stream& s, CBlock& block)
+{
+    block.SetNull();
+    s >> *(CBlockHeader*)&block;
+
+    unsigned int nTx = ReadCompactSize(s);
+    // Sized from the announced count, but no more than a full block's worth, so a bogus count
+    // cannot make us reserve memory the stream does not back.
+    unsigned int nReserve = std::min(nTx, 5000000U / (unsigned int)BLOCK_ARENA_BYTES_PER_TX);
+    std::shared_ptr<MonotonicResource> arena = std::make_shared<MonotonicResource>(
+        std::max<size_t>(nReserve * BLOCK_ARENA_BYTES_PER_TX, MonotonicResource::DEFAULT_CHUNK_SIZE_BYTES));
+    MonotonicAllocator<CTransaction> alloc(arena);
+
+    block.vtx.reserve(nReserve);
+    for (unsigned int i = 0; i < nTx; i++)
+        block.vtx.push_back(std::allocate_shared<const CTransaction>(alloc, deserialize, s));
+}
+
 /** Describes a place in the block chain to another node such that if the
  * other node doesn't have the same branch, it can find a recent common trunk.
  * The further back it is, the further before the fork it may be.
@@ -209,6 +209,9 @@ static bool rest_block(HTTPRequest* req,
 
     CBlock block;
     CBlockIndex* pblockindex = nullptr;
+    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+    // Binary and hex replies with witness data are the serialization on disk, so they skip deserializing
+    bool fRaw = rf != RF_JSON && RPCSerializationFlags() == 0;
     {
         LOCK(cs_main);
         if (mapBlockIndex.count(hash) == 0)
@@ -218,12 +221,18 @@ static bool rest_block(HTTPRequest* req,
         if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (pruned data)");
 
-        if (!ReadBlockFromDisk(block, pblockindex, GetParams().GetConsensus()))
+        if (fRaw) {
+            std::vector<unsigned char> vchBlock;
+            if (!ReadRawBlockFromDisk(vchBlock, pblockindex, GetParams().MessageStart()))
+                return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+            ssBlock.write((const char*)vchBlock.data(), vchBlock.size());
+        } else if (!ReadBlockFromDisk(block, pblockindex, GetParams().GetConsensus())) {
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        }
     }
 
-    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-    ssBlock << block;
+    if (!fRaw)
+        ssBlock << block;
 
     switch (rf) {
     case RF_BINARY: {
@@ -345,11 +345,11 @@ UniValue UpdateGlobalRestrictedAsset(const JSONRPCRequest &request, const int8_t
         throw JSONRPCError(RPC_INVALID_PARAMETER, std::string("Unsupported asset type: ") + AssetTypeToString(assetType));
     }
 
-    if (flag == 1 && mempool.mapGlobalFreezingAssetTransactions.count(restricted_name)){
+    if (flag == 1 && mempool.hasRestrictedEntry(MempoolRestrictedType::GLOBAL_FREEZING, restricted_name)){
         throw JSONRPCError(RPC_TRANSACTION_REJECTED, std::string("Freezing transaction already in mempool"));
     }
 
-    if (flag == 0 && mempool.mapGlobalUnFreezingAssetTransactions.count(restricted_name)){
+    if (flag == 0 && mempool.hasRestrictedEntry(MempoolRestrictedType::GLOBAL_UNFREEZING, restricted_name)){
         throw JSONRPCError(RPC_TRANSACTION_REJECTED, std::string("Unfreezing transaction already in mempool"));
     }
 
@@ -815,6 +815,102 @@ UniValue listassetbalancesbyaddress(const JSONRPCRequest& request)
     return result;
 }
 
+UniValue listassetbalancesbyaddresses(const JSONRPCRequest& request)
+{
+    if (!fAssetIndex) {
+        return "_This rpc call is not functional unless -assetindex is enabled. To enable, please run the wallet with -assetindex, this will require a reindex to occur";
+    }
+
+    if (request.fHelp || !AreAssetsDeployed() || request.params.size() != 1)
+        throw std::runtime_error(
+            "listassetbalancesbyaddresses [\"address\",...]\n"
+            + AssetActivationWarning() +
+            "\nReturns the asset balances of many addresses at once, see listassetbalancesbyaddress\n"
+
+            "\nArguments:\n"
+            "1. \"addresses\"                (array, required) the aidp addresses\n"
+            "    [\n"
+            "      \"address\"                 (string) an aidp address\n"
+            "      ,...\n"
+            "    ]\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  (address) : {\n"
+            "    (asset_name) : (quantity),\n"
+            "    ...\n"
+            "  },\n"
+            "  ...\n"
+            "}\n"
+
+            "\nExamples:\n"
+            + HelpExampleCli("listassetbalancesbyaddresses", "'[\"myaddress\",\"otheraddress\"]'")
+            + HelpExampleRpc("listassetbalancesbyaddresses", "[\"myaddress\",\"otheraddress\"]")
+        );
+
+    ObserveSafeMode();
+
+    const UniValue& addresses = request.params[0].get_array();
+
+    // Walk the address index in key order so the database reads are sequential
+    std::set<std::string> setAddresses;
+    for (unsigned int i = 0; i < addresses.size(); i++) {
+        std::string address = addresses[i].get_str();
+        if (!IsValidDestination(DecodeDestination(address)))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, std::string("Invalid Aidp address: ") + address);
+        setAddresses.insert(address);
+    }
+
+    if (!passetsdb)
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "asset db unavailable.");
+
+    LOCK(cs_main);
+    UniValue result(UniValue::VOBJ);
+    for (const auto& address : setAddresses) {
+        std::vector<std::pair<std::string, CAmount> > vecAssetAmounts;
+        int nTotalEntries = 0;
+        if (!passetsdb->AddressDir(vecAssetAmounts, nTotalEntries, false, address, INT_MAX, 0))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "couldn't retrieve address asset directory.");
+
+        UniValue balances(UniValue::VOBJ);
+        for (auto& pair : vecAssetAmounts) {
+            balances.push_back(Pair(pair.first, UnitValueFromAmount(pair.second, pair.first)));
+        }
+        result.push_back(Pair(address, balances));
+    }
+
+    return result;
+}
+
+static UniValue AssetDataToJSON(CAssetsCache* cache, const std::string& asset_name)
+{
+    CNewAsset asset;
+    if (!cache->GetAssetMetaDataIfExists(asset_name, asset))
+        return NullUniValue;
+
+    UniValue result (UniValue::VOBJ);
+    result.push_back(Pair("name", asset.strName));
+    result.push_back(Pair("amount", UnitValueFromAmount(asset.nAmount, asset.strName)));
+    result.push_back(Pair("units", asset.units));
+    result.push_back(Pair("reissuable", asset.nReissuable));
+    result.push_back(Pair("has_ipfs", asset.nHasIPFS));
+
+    if (asset.nHasIPFS) {
+        if (asset.strIPFSHash.size() == 32) {
+            result.push_back(Pair("txid", EncodeAssetData(asset.strIPFSHash)));
+        } else {
+            result.push_back(Pair("ipfs_hash", EncodeAssetData(asset.strIPFSHash)));
+        }
+    }
+
+    CNullAssetTxVerifierString verifier;
+    if (cache->GetAssetVerifierStringIfExists(asset.strName, verifier)) {
+        result.push_back(Pair("verifier_string", verifier.verifier_string));
+    }
+
+    return result;
+}
+
 UniValue getassetdata(const JSONRPCRequest& request)
 {
     if (request.fHelp || !AreAssetsDeployed() || request.params.size() != 1)
@@ -847,37 +943,61 @@ UniValue getassetdata(const JSONRPCRequest& request)
     std::string asset_name = request.params[0].get_str();
 
     LOCK(cs_main);
-    UniValue result (UniValue::VOBJ);
 
     auto currentActiveAssetCache = GetCurrentAssetCache();
-    if (currentActiveAssetCache) {
-        CNewAsset asset;
-        if (!currentActiveAssetCache->GetAssetMetaDataIfExists(asset_name, asset))
-            return NullUniValue;
-
-        result.push_back(Pair("name", asset.strName));
-        result.push_back(Pair("amount", UnitValueFromAmount(asset.nAmount, asset.strName)));
-        result.push_back(Pair("units", asset.units));
-        result.push_back(Pair("reissuable", asset.nReissuable));
-        result.push_back(Pair("has_ipfs", asset.nHasIPFS));
-
-        if (asset.nHasIPFS) {
-            if (asset.strIPFSHash.size() == 32) {
-                result.push_back(Pair("txid", EncodeAssetData(asset.strIPFSHash)));
-            } else {
-                result.push_back(Pair("ipfs_hash", EncodeAssetData(asset.strIPFSHash)));
-            }
-        }
+    if (currentActiveAssetCache)
+        return AssetDataToJSON(currentActiveAssetCache, asset_name);
 
-        CNullAssetTxVerifierString verifier;
-        if (currentActiveAssetCache->GetAssetVerifierStringIfExists(asset.strName, verifier)) {
-            result.push_back(Pair("verifier_string", verifier.verifier_string));
-        }
+    return NullUniValue;
+}
 
-        return result;
-    }
+UniValue getassetdatamulti(const JSONRPCRequest& request)
+{
+    if (request.fHelp || !AreAssetsDeployed() || request.params.size() != 1)
+        throw std::runtime_error(
+                "getassetdatamulti [\"asset_name\",...]\n"
+                + AssetActivationWarning() +
+                "\nReturns the metadata of many assets at once, see getassetdata\n"
 
-    return NullUniValue;
+                "\nArguments:\n"
+                "1. \"asset_names\"              (array, required) the names of the assets\n"
+                "    [\n"
+                "      \"asset_name\"              (string) an asset name\n"
+                "      ,...\n"
+                "    ]\n"
+
+                "\nResult:\n"
+                "{\n"
+                "  (asset_name) : { (object) the getassetdata result, or null if the asset doesn't exist\n"
+                "    name: (string),\n"
+                "    ...\n"
+                "  },\n"
+                "  ...\n"
+                "}\n"
+
+                "\nExamples:\n"
+                + HelpExampleCli("getassetdatamulti", "'[\"ASSET_NAME\",\"OTHER_ASSET\"]'")
+                + HelpExampleRpc("getassetdatamulti", "[\"ASSET_NAME\",\"OTHER_ASSET\"]")
+        );
+
+    const UniValue& names = request.params[0].get_array();
+
+    // Look the assets up in key order so the database reads are sequential
+    std::set<std::string> setNames;
+    for (unsigned int i = 0; i < names.size(); i++)
+        setNames.insert(names[i].get_str());
+
+    LOCK(cs_main);
+
+    auto currentActiveAssetCache = GetCurrentAssetCache();
+    if (!currentActiveAssetCache)
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Asset cache not available");
+
+    UniValue result(UniValue::VOBJ);
+    for (const auto& name : setNames)
+        result.push_back(Pair(name, AssetDataToJSON(currentActiveAssetCache, name)));
+
+    return result;
 }
 
 template <class Iter, class Incr>
@@ -2291,6 +2411,143 @@ UniValue checkaddressrestriction(const JSONRPCRequest& request)
     return passets->CheckForAddressRestriction(restricted_name, address);
 }
 
+/** Parse [{"address": .., key: ..},...] into (address, name) pairs, keeping the request order */
+static std::vector<std::pair<std::string, std::string>> ParseAddressNamePairs(const UniValue& params, const std::string& key)
+{
+    const UniValue& pairs = params.get_array();
+
+    std::vector<std::pair<std::string, std::string>> vPairs;
+    vPairs.reserve(pairs.size());
+    for (unsigned int i = 0; i < pairs.size(); i++) {
+        const UniValue& pair = pairs[i].get_obj();
+        RPCTypeCheckObj(pair,
+            {
+                {"address", UniValueType(UniValue::VSTR)},
+                {key, UniValueType(UniValue::VSTR)},
+            }, false, true);
+
+        std::string address = find_value(pair, "address").get_str();
+        if (!IsValidDestination(DecodeDestination(address)))
+            throw JSONRPCError(RPC_INVALID_PARAMETER, std::string("Not valid AIDP address: ") + address);
+
+        vPairs.emplace_back(address, find_value(pair, key).get_str());
+    }
+
+    return vPairs;
+}
+
+/** Run fCheck once per distinct pair, in (address, name) order, and return the results in the request order */
+static UniValue CheckAddressNamePairs(const std::vector<std::pair<std::string, std::string>>& vPairs, std::function<bool(const std::string&, const std::string&)> fCheck)
+{
+    // The restricted database is keyed by address first, so sorting the pairs
+    // turns the cache misses into a forward walk through the database
+    std::map<std::pair<std::string, std::string>, bool> mapChecked;
+    for (const auto& pair : vPairs)
+        mapChecked.emplace(pair, false);
+
+    {
+        LOCK(cs_main);
+        for (auto& checked : mapChecked)
+            checked.second = fCheck(checked.first.second, checked.first.first);
+    }
+
+    UniValue result(UniValue::VARR);
+    for (const auto& pair : vPairs)
+        result.push_back(mapChecked.at(pair));
+
+    return result;
+}
+
+UniValue checkaddresstags(const JSONRPCRequest& request)
+{
+    if (request.fHelp || !AreRestrictedAssetsDeployed() || request.params.size() != 1)
+        throw std::runtime_error(
+                "checkaddresstags [{\"address\":\"address\",\"tag_name\":\"tag_name\"},...]\n"
+                + RestrictedActivationWarning() +
+                "\nChecks many (address, tag) pairs at once, see checkaddresstag\n"
+
+                "\nArguments:\n"
+                "1. \"pairs\"            (array, required) the pairs to check\n"
+                "    [\n"
+                "      {\n"
+                "        \"address\":\"address\",    (string, required) the AIDP address to search\n"
+                "        \"tag_name\":\"tag_name\"   (string, required) the tag to search\n"
+                "      }\n"
+                "      ,...\n"
+                "    ]\n"
+
+                "\nResult:\n"
+                "[\n"
+                "  true/false,       (boolean) If the address has the tag, in the order of the pairs\n"
+                "  ...\n"
+                "]\n"
+
+                "\nExamples:\n"
+                + HelpExampleCli("checkaddresstags", "'[{\"address\":\"address\",\"tag_name\":\"#TAG\"}]'")
+                + HelpExampleRpc("checkaddresstags", "[{\"address\":\"address\",\"tag_name\":\"#TAG\"}]")
+        );
+
+    if (!prestricteddb)
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Restricted asset database not available");
+
+    if (!passetsQualifierCache)
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Qualifier cache not available");
+
+    if (!passets)
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Asset cache not available");
+
+    std::vector<std::pair<std::string, std::string>> vPairs = ParseAddressNamePairs(request.params[0], "tag_name");
+
+    return CheckAddressNamePairs(vPairs, [](const std::string& tag_name, const std::string& address) {
+        return passets->CheckForAddressQualifier(tag_name, address);
+    });
+}
+
+UniValue checkaddressrestrictions(const JSONRPCRequest& request)
+{
+    if (request.fHelp || !AreRestrictedAssetsDeployed() || request.params.size() != 1)
+        throw std::runtime_error(
+                "checkaddressrestrictions [{\"address\":\"address\",\"restricted_name\":\"restricted_name\"},...]\n"
+                + RestrictedActivationWarning() +
+                "\nChecks many (address, restricted asset) pairs at once, see checkaddressrestriction\n"
+
+                "\nArguments:\n"
+                "1. \"pairs\"            (array, required) the pairs to check\n"
+                "    [\n"
+                "      {\n"
+                "        \"address\":\"address\",                  (string, required) the AIDP address to search\n"
+                "        \"restricted_name\":\"restricted_name\"   (string, required) the restricted asset to search\n"
+                "      }\n"
+                "      ,...\n"
+                "    ]\n"
+
+                "\nResult:\n"
+                "[\n"
+                "  true/false,       (boolean) If the address is frozen, in the order of the pairs\n"
+                "  ...\n"
+                "]\n"
+
+                "\nExamples:\n"
+                + HelpExampleCli("checkaddressrestrictions", "'[{\"address\":\"address\",\"restricted_name\":\"$RESTRICTED\"}]'")
+                + HelpExampleRpc("checkaddressrestrictions", "[{\"address\":\"address\",\"restricted_name\":\"$RESTRICTED\"}]")
+        );
+
+    if (!prestricteddb)
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Restricted asset database not available");
+
+    if (!passetsRestrictionCache)
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Restriction cache not available");
+
+    if (!passets)
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Asset cache not available");
+
+    std::vector<std::pair<std::string, std::string>> vPairs = ParseAddressNamePairs(request.params[0], "restricted_name");
+
+    return CheckAddressNamePairs(vPairs, [](const std::string& restricted_name, const std::string& address) {
+        return passets->CheckForAddressRestriction(restricted_name, address);
+    });
+}
+
 UniValue checkglobalrestriction(const JSONRPCRequest& request)
 {
     if (request.fHelp || !AreRestrictedAssetsDeployed() || request.params.size() != 1)
@@ -3043,6 +3300,8 @@ static const CRPCCommand commands[] =
 #endif
     { "assets",   "listassetbalancesbyaddress", &listassetbalancesbyaddress, {"address", "onlytotal", "count", "start"} },
     { "assets",   "getassetdata",               &getassetdata,               {"asset_name"}},
+    { "assets",   "getassetdatamulti",          &getassetdatamulti,          {"asset_names"}},
+    { "assets",   "listassetbalancesbyaddresses", &listassetbalancesbyaddresses, {"addresses"}},
     { "assets",   "listaddressesbyasset",       &listaddressesbyasset,       {"asset_name", "onlytotal", "count", "start"}},
 #ifdef ENABLE_WALLET
     { "assets",   "transferfromaddress",        &transferfromaddress,        {"asset_name", "from_address", "qty", "to_address", "message", "expire_time", "aidp_change_address", "asset_change_address"}},
@@ -3072,6 +3331,8 @@ static const CRPCCommand commands[] =
     { "restricted assets",   "getverifierstring",          &getverifierstring,          {"restricted_name"}},
     { "restricted assets",   "checkaddresstag",            &checkaddresstag,            {"address", "tag_name"}},
     { "restricted assets",   "checkaddressrestriction",    &checkaddressrestriction,    {"address", "restricted_name"}},
+    { "restricted assets",   "checkaddresstags",           &checkaddresstags,           {"pairs"}},
+    { "restricted assets",   "checkaddressrestrictions",   &checkaddressrestrictions,   {"pairs"}},
     { "restricted assets",   "checkglobalrestriction",     &checkglobalrestriction,     {"restricted_name"}},
     { "restricted assets",   "isvalidverifierstring",      &isvalidverifierstring,      {"verifier_string"}},
 
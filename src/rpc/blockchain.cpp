@@ -28,6 +28,7 @@
 #include "sync.h"
 #include "txdb.h"
 #include "txmempool.h"
+#include "txoutsnapshot.h"
 #include "util.h"
 #include "utilstrencodings.h"
 #include "hash.h"
@@ -1002,6 +1003,14 @@ UniValue getblock(const JSONRPCRequest& request)
     if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
         throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
 
+    if (verbosity <= 0 && RPCSerializationFlags() == 0) {
+        // The serialization on disk is what was asked for
+        std::vector<unsigned char> vchBlock;
+        if (!ReadRawBlockFromDisk(vchBlock, pblockindex, GetParams().MessageStart()))
+            throw JSONRPCError(RPC_MISC_ERROR, "Block not found on disk");
+        return HexStr(vchBlock.begin(), vchBlock.end());
+    }
+
     if (!ReadBlockFromDisk(block, pblockindex, GetParams().GetConsensus()))
         // Block not found on disk. This could be because we have the block
         // header in our index but don't have the block (for example if a
@@ -1074,59 +1083,34 @@ struct CCoinsStats
     CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nBogoSize(0), nDiskSize(0), nTotalAmount(0) {}
 };
 
-static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
-{
-    assert(!outputs.empty());
-    ss << hash;
-    ss << VARINT(outputs.begin()->second.nHeight * 2 + outputs.begin()->second.fCoinBase);
-    stats.nTransactions++;
-    for (const auto output : outputs) {
-        ss << VARINT(output.first + 1);
-        ss << output.second.out.scriptPubKey;
-        ss << VARINT(output.second.out.nValue);
-        stats.nTransactionOutputs++;
-        stats.nTotalAmount += output.second.out.nValue;
-        stats.nBogoSize += 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
-                           2 /* scriptPubKey len */ + output.second.out.scriptPubKey.size() /* scriptPubKey */;
-    }
-    ss << VARINT(0);
-}
-
 //! Calculate statistics about the unspent transaction output set
 static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
 {
     std::unique_ptr<CCoinsViewCursor> pcursor(view->Cursor());
     assert(pcursor);
 
-    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
     stats.hashBlock = pcursor->GetBestBlock();
     {
         LOCK(cs_main);
         stats.nHeight = mapBlockIndex.find(stats.hashBlock)->second->nHeight;
     }
-    ss << stats.hashBlock;
-    uint256 prevkey;
-    std::map<uint32_t, Coin> outputs;
+    CCoinsSetHasher hasher(stats.hashBlock);
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         COutPoint key;
         Coin coin;
         if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
-            if (!outputs.empty() && key.hash != prevkey) {
-                ApplyStats(stats, ss, prevkey, outputs);
-                outputs.clear();
-            }
-            prevkey = key.hash;
-            outputs[key.n] = std::move(coin);
+            hasher.Add(key, coin);
         } else {
             return error("%s: unable to read value", __func__);
         }
         pcursor->Next();
     }
-    if (!outputs.empty()) {
-        ApplyStats(stats, ss, prevkey, outputs);
-    }
-    stats.hashSerialized = ss.GetHash();
+    stats.hashSerialized = hasher.GetHash();
+    stats.nTransactions = hasher.nTransactions;
+    stats.nTransactionOutputs = hasher.nTransactionOutputs;
+    stats.nBogoSize = hasher.nBogoSize;
+    stats.nTotalAmount = hasher.nTotalAmount;
     stats.nDiskSize = view->EstimateSize();
     return true;
 }
@@ -1222,6 +1206,105 @@ UniValue gettxoutsetinfo(const JSONRPCRequest& request)
     return ret;
 }
 
+UniValue dumptxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrites the unspent transaction output set and the asset state at the current tip to a snapshot file\n"
+            "that another node can bootstrap from with loadtxoutset.\n"
+            "Note this call may take some time.\n"
+            "\nArguments:\n"
+            "1. \"path\"           (string, required) The file to write, relative to the data directory unless absolute\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"base_hash\": \"hash\",     (string) The block the snapshot was taken at\n"
+            "  \"base_height\": n,        (numeric) The height of that block\n"
+            "  \"coins_written\": n,      (numeric) The number of unspent outputs in the snapshot\n"
+            "  \"asset_records\": n,      (numeric) The number of asset database records in the snapshot\n"
+            "  \"txoutset_hash\": \"hash\", (string) The hash of the outputs, as hash_serialized_2 in gettxoutsetinfo\n"
+            "  \"assets_hash\": \"hash\",   (string) The hash of the asset records\n"
+            "  \"snapshot_hash\": \"hash\", (string) The hash loadtxoutset checks the snapshot against\n"
+            "  \"path\": \"path\"           (string) The absolute path of the snapshot\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("dumptxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("dumptxoutset", "\"utxo.dat\"")
+        );
+
+    fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+    if (fs::exists(path))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists");
+
+    CTxOutSnapshotMetadata metadata;
+    CTxOutSnapshotHashes hashes;
+    std::string strError;
+    if (!DumpTxOutSnapshot(path, metadata, hashes, strError))
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("base_hash", metadata.hashBase.GetHex()));
+    ret.push_back(Pair("base_height", (int64_t)metadata.nHeight));
+    ret.push_back(Pair("coins_written", (int64_t)hashes.nCoins));
+    ret.push_back(Pair("asset_records", (int64_t)hashes.nAssetRecords));
+    ret.push_back(Pair("txoutset_hash", hashes.hashSerialized.GetHex()));
+    ret.push_back(Pair("assets_hash", hashes.hashAssets.GetHex()));
+    ret.push_back(Pair("snapshot_hash", hashes.GetSnapshotHash().GetHex()));
+    ret.push_back(Pair("path", path.string()));
+    return ret;
+}
+
+UniValue loadtxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw std::runtime_error(
+            "loadtxoutset \"path\" ( \"snapshot_hash\" )\n"
+            "\nLoads a snapshot written by dumptxoutset and makes its base block the chain tip, so the node\n"
+            "continues syncing from there instead of from the genesis block.\n"
+            "The node must still be at the genesis block and must already have the headers up to the snapshot's\n"
+            "base block. Blocks below the base are not downloaded: the node cannot serve them, and wallets cannot\n"
+            "rescan them, so the node must run with -prune. -txindex, -addressindex, -spentindex and -timestampindex\n"
+            "cannot be used.\n"
+            "\nArguments:\n"
+            "1. \"path\"            (string, required) The snapshot file, relative to the data directory unless absolute\n"
+            "2. \"snapshot_hash\"   (string, optional) The snapshot_hash reported by dumptxoutset on a trusted node.\n"
+            "                       Required unless the snapshot's height has a hash built into the client.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"base_hash\": \"hash\",     (string) The new chain tip\n"
+            "  \"base_height\": n,        (numeric) The height of the new chain tip\n"
+            "  \"coins_loaded\": n,       (numeric) The number of unspent outputs loaded\n"
+            "  \"asset_records\": n,      (numeric) The number of asset database records loaded\n"
+            "  \"snapshot_hash\": \"hash\"  (string) The hash of the snapshot\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("loadtxoutset", "\"utxo.dat\" \"snapshot_hash\"")
+            + HelpExampleRpc("loadtxoutset", "\"utxo.dat\", \"snapshot_hash\"")
+        );
+
+    fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+    uint256 hashExpected;
+    if (!request.params[1].isNull())
+        hashExpected = ParseHashV(request.params[1], "snapshot_hash");
+
+    CTxOutSnapshotMetadata metadata;
+    CTxOutSnapshotHashes hashes;
+    std::string strError;
+    if (!LoadTxOutSnapshot(GetParams(), path, hashExpected, metadata, hashes, strError))
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+
+    CValidationState state;
+    ActivateBestChain(state, GetParams());
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("base_hash", metadata.hashBase.GetHex()));
+    ret.push_back(Pair("base_height", (int64_t)metadata.nHeight));
+    ret.push_back(Pair("coins_loaded", (int64_t)hashes.nCoins));
+    ret.push_back(Pair("asset_records", (int64_t)hashes.nAssetRecords));
+    ret.push_back(Pair("snapshot_hash", hashes.GetSnapshotHash().GetHex()));
+    return ret;
+}
+
 UniValue gettxout(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() < 2 || request.params.size() > 3)
@@ -1904,6 +1987,7 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getbestblockhash",       &getbestblockhash,       {} },
     { "blockchain",         "getblockcount",          &getblockcount,          {} },
     { "blockchain",         "getblock",               &getblock,               {"blockhash","verbosity|verbose"} },
+    { "blockchain",         "dumptxoutset",           &dumptxoutset,           {"path"} },
     { "blockchain",         "decodeblock",            &decodeblock,               {"blockhex"} },
     { "blockchain",         "getblockdeltas",         &getblockdeltas,         {} },
     { "blockchain",         "getblockhashes",         &getblockhashes,         {} },
@@ -1918,6 +2002,7 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getrawmempool",          &getrawmempool,          {"verbose"} },
     { "blockchain",         "gettxout",               &gettxout,               {"txid","n","include_mempool"} },
     { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {} },
+    { "blockchain",         "loadtxoutset",           &loadtxoutset,           {"path","snapshot_hash"} },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        {"height"} },
     { "blockchain",         "savemempool",            &savemempool,            {} },
     { "blockchain",         "verifychain",            &verifychain,            {"checklevel","nblocks"} },
@@ -14,9 +14,6 @@ class CBlockIndex;
 class UniValue;
 
 
-// To be used by local rpc GPU mining only
-extern std::map<std::string, CBlock> mapAIDPKAWBlockTemplates;
-
 /**
  * Get the difficulty of the net wrt to the given block index, or the chain tip if
  * not provided.
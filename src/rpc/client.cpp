@@ -65,6 +65,9 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "listassets", 1, "verbose" },
     { "listassets", 2, "count" },
     { "listassets", 3, "start" },
+    { "viewallmessages", 1, "start_time" },
+    { "viewallmessages", 2, "end_time" },
+    { "viewallmessages", 3, "count" },
     { "setmocktime", 0, "timestamp" },
     { "generate", 0, "nblocks" },
     { "generate", 1, "maxtries" },
@@ -204,6 +207,10 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "listassetbalancesbyaddress", 1, "totalonly"},
     { "listassetbalancesbyaddress", 2, "count"},
     { "listassetbalancesbyaddress", 3, "start"},
+    { "listassetbalancesbyaddresses", 0, "addresses"},
+    { "getassetdatamulti", 0, "asset_names"},
+    { "checkaddresstags", 0, "pairs"},
+    { "checkaddressrestrictions", 0, "pairs"},
     { "sendmessage", 2, "expire_time"},
     { "requestsnapshot", 1, "block_height"},
     { "getsnapshotrequest", 1, "block_height"},
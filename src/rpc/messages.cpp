@@ -39,14 +39,43 @@ std::string MessageActivationWarning()
     return AreMessagesDeployed() ? "" : "\nTHIS COMMAND IS NOT YET ACTIVE!\nhttps://github.com/AidpProject/rips/blob/master/rip-0005.mediawiki\n";
 }
 
+static UniValue MessageToJSON(const CMessage& message)
+{
+    UniValue obj(UniValue::VOBJ);
+
+    obj.push_back(Pair("Asset Name", message.strName));
+    obj.push_back(Pair("Message", EncodeAssetData(message.ipfsHash)));
+    obj.push_back(Pair("Time", DateTimeStrFormat("%Y-%m-%d %H:%M:%S", message.time)));
+    obj.push_back(Pair("Block Height", message.nBlockHeight));
+    obj.push_back(Pair("Status", MessageStatusToString(message.status)));
+    try {
+        std::string date = DateTimeStrFormat("%Y-%m-%d %H:%M:%S", message.nExpiredTime);
+        if (message.nExpiredTime)
+            obj.push_back(Pair("Expire Time", date));
+    } catch (...) {
+        obj.push_back(Pair("Expire UTC Time", message.nExpiredTime));
+    }
+
+    return obj;
+}
+
 UniValue viewallmessages(const JSONRPCRequest& request) {
-    if (request.fHelp || !AreMessagesDeployed() || request.params.size() != 0)
+    if (request.fHelp || !AreMessagesDeployed() || request.params.size() > 5)
         throw std::runtime_error(
-                "viewallmessages \n"
+                "viewallmessages ( \"channel\" start_time end_time count \"start_after\" )\n"
                 + MessageActivationWarning() +
                 "\nView all messages that the wallet contains\n"
 
-                "\nResult:\n"
+                "\nArguments:\n"
+                "1. \"channel\"                     (string, optional, default=\"\") only show messages of this channel, ordered by time\n"
+                "2. start_time                    (integer, optional, default=0) only show messages with a time at or after this unix time\n"
+                "3. end_time                      (integer, optional, default=no limit) only show messages with a time at or before this unix time\n"
+                "4. count                         (integer, optional, default=ALL) return at most count messages and a continuation token\n"
+                "5. \"start_after\"                 (string, optional) the \"next\" token of a previous call, to continue after its last message\n"
+
+                "\nResult (without count):\n"
+                "[\n"
+                "  {\n"
                 "\"Asset Name:\"                     (string) The name of the asset the message was sent on\n"
                 "\"Message:\"                        (string) The IPFS hash of the message\n"
                 "\"Time:\"                           (Date) The time as a date in the format (YY-mm-dd Hour-minute-second)\n"
@@ -54,10 +83,18 @@ UniValue viewallmessages(const JSONRPCRequest& request) {
                 "\"Status:\"                         (string) Status of the message (READ, UNREAD, ORPHAN, EXPIRED, SPAM, HIDDEN, ERROR)\n"
                 "\"Expire Time:\"                    (Date, optional) If the message had an expiration date assigned, it will be shown here in the format (YY-mm-dd Hour-minute-second)\n"
                 "\"Expire UTC Time:\"                (Date, optional) If the message contains an expire date that is too large, the UTC number will be displayed\n"
+                "  },...\n"
+                "]\n"
 
+                "\nResult (with count):\n"
+                "{\n"
+                "  \"messages\": [...]            (array) The messages, as above\n"
+                "  \"next\": \"token\"              (string, optional) Pass as start_after to get the next page, only present if there are more messages\n"
+                "}\n"
 
                 "\nExamples:\n"
                 + HelpExampleCli("viewallmessages", "")
+                + HelpExampleCli("viewallmessages", "\"ASSET_NAME!\" 1577836800 0 100")
                 + HelpExampleRpc("viewallmessages", "")
         );
 
@@ -73,52 +110,62 @@ UniValue viewallmessages(const JSONRPCRequest& request) {
         return ret;
     }
 
-    std::set<CMessage> setMessages;
+    CMessageQuery query;
+    if (request.params.size() > 0)
+        query.channel = request.params[0].get_str();
 
-    pmessagedb->LoadMessages(setMessages);
+    if (request.params.size() > 1)
+        query.nStartTime = request.params[1].get_int64();
 
-    for (auto pair : mapDirtyMessagesOrphaned) {
-        CMessage message = pair.second;
-        message.status = MessageStatus::ORPHAN;
-        if (setMessages.count(message))
-            setMessages.erase(message);
-        setMessages.insert(message);
-    }
+    if (request.params.size() > 2 && request.params[2].get_int64() > 0)
+        query.nEndTime = request.params[2].get_int64();
 
-    for (auto out : setDirtyMessagesRemove) {
-        CMessage message;
-        message.out = out;
-        setMessages.erase(message);
+    bool fPaged = false;
+    if (request.params.size() > 3) {
+        if (request.params[3].get_int() < 1)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "count must be greater than 0.");
+        query.nLimit = request.params[3].get_int();
+        fPaged = true;
     }
 
-    for (auto pair : mapDirtyMessagesAdd) {
-        setMessages.erase(pair.second);
-        setMessages.insert(pair.second);
-    }
-
-    UniValue messages(UniValue::VARR);
-
-    for (auto message : setMessages) {
-        UniValue obj(UniValue::VOBJ);
-
-        obj.push_back(Pair("Asset Name", message.strName));
-        obj.push_back(Pair("Message", EncodeAssetData(message.ipfsHash)));
-        obj.push_back(Pair("Time", DateTimeStrFormat("%Y-%m-%d %H:%M:%S", message.time)));
-        obj.push_back(Pair("Block Height", message.nBlockHeight));
-        obj.push_back(Pair("Status", MessageStatusToString(message.status)));
+    if (request.params.size() > 4 && !request.params[4].get_str().empty()) {
+        std::string strAfter = request.params[4].get_str();
+        if (!IsHex(strAfter))
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "start_after must be a token returned as next by a previous call");
+        std::vector<unsigned char> data(ParseHex(strAfter));
+        CDataStream ssAfter(data, SER_NETWORK, PROTOCOL_VERSION);
         try {
-            std::string date = DateTimeStrFormat("%Y-%m-%d %H:%M:%S", message.nExpiredTime);
-            if (message.nExpiredTime)
-                obj.push_back(Pair("Expire Time", date));
-        } catch (...) {
-            obj.push_back(Pair("Expire UTC Time", message.nExpiredTime));
+            ssAfter >> query.nAfterTime >> query.after;
+        } catch (const std::exception&) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "start_after must be a token returned as next by a previous call");
         }
+        query.fAfter = true;
+    }
 
-        messages.push_back(obj);
+    std::vector<CMessage> vMessages;
+    bool fMore = false;
+    {
+        LOCK(cs_messaging);
+        if (!GetMessages(query, vMessages, fMore))
+            throw JSONRPCError(RPC_DATABASE_ERROR, "Failed to read messages from the database");
     }
 
+    UniValue messages(UniValue::VARR);
+    for (const auto& message : vMessages)
+        messages.push_back(MessageToJSON(message));
+
+    if (!fPaged)
+        return messages;
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("messages", messages));
+    if (fMore && !vMessages.empty()) {
+        CDataStream ssNext(SER_NETWORK, PROTOCOL_VERSION);
+        ssNext << vMessages.back().time << vMessages.back().out;
+        result.push_back(Pair("next", HexStr(ssNext.begin(), ssNext.end())));
+    }
 
-    return messages;
+    return result;
 }
 
 UniValue viewallmessagechannels(const JSONRPCRequest& request) {
@@ -142,7 +189,7 @@ UniValue viewallmessagechannels(const JSONRPCRequest& request) {
         return ret;
     }
 
-    if (!pMessageSubscribedChannelsCache || !pmessagechanneldb) {
+    if (!pmessagechanneldb) {
         UniValue ret(UniValue::VSTR);
         ret.push_back("Messaging channel database and cache are having problems (a wallet restart might fix this issue)");
         return ret;
@@ -192,7 +239,7 @@ UniValue subscribetochannel(const JSONRPCRequest& request) {
         throw JSONRPCError(RPC_DATABASE_ERROR, "Messaging is disabled. To enable messaging, run the wallet without -disablemessaging or remove disablemessaging from your aidp.conf");
     }
 
-    if (!pMessageSubscribedChannelsCache || !pmessagechanneldb) {
+    if (!pmessagechanneldb) {
         throw JSONRPCError(RPC_DATABASE_ERROR, "Message database isn't setup");
     }
 
@@ -242,7 +289,7 @@ UniValue unsubscribefromchannel(const JSONRPCRequest& request) {
         throw JSONRPCError(RPC_DATABASE_ERROR, "Messaging is disabled. To enable messaging, run the wallet without -disablemessaging or remove disablemessaging from your aidp.conf");
     }
 
-    if (!pMessageSubscribedChannelsCache || !pmessagechanneldb) {
+    if (!pmessagechanneldb) {
         throw JSONRPCError(RPC_DATABASE_ERROR, "Message database isn't setup");
     }
 
@@ -489,7 +536,7 @@ UniValue viewmyrestrictedaddresses(const JSONRPCRequest& request) {
 static const CRPCCommand commands[] =
     {           //  category    name                          actor (function)             argNames
                 //  ----------- ------------------------      -----------------------      ----------
-            { "messages",       "viewallmessages",            &viewallmessages,            {}},
+            { "messages",       "viewallmessages",            &viewallmessages,            {"channel", "start_time", "end_time", "count", "start_after"}},
             { "messages",       "viewallmessagechannels",     &viewallmessagechannels,     {}},
             { "messages",       "subscribetochannel",         &subscribetochannel,         {"channel_name"}},
             { "messages",       "unsubscribefromchannel",     &unsubscribefromchannel,     {"channel_name"}},
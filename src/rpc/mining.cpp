@@ -28,6 +28,7 @@
 #include "validationinterface.h"
 #include "warnings.h"
 
+#include <deque>
 #include <memory>
 #include <stdint.h>
 
@@ -38,7 +39,52 @@
 
 extern uint64_t nHashesPerSec;
 
-std::map<std::string, CBlock> mapAIDPKAWBlockTemplates;
+//! Most KAWPOW blocks handed out by getblocktemplate that pprpcsb can still complete
+static const size_t MAX_KAWPOW_BLOCK_TEMPLATES = 100;
+
+/**
+ * Blocks handed out to KAWPOW miners by getblocktemplate, by their pprpcheader, so that pprpcsb
+ * can fill in the nonce and mix hash and submit them. Only the most recent ones on the current
+ * tip are kept. All of them passed CheckBlock, except for the proof of work, when they were
+ * added.
+ */
+class CKAWPOWBlockTemplates
+{
+public:
+    void Add(const uint256& hashHeader, const std::shared_ptr<const CBlock>& pblock)
+    {
+        LOCK(cs);
+        if (!mapBlocks.emplace(hashHeader, pblock).second)
+            return;
+        vOrder.push_back(hashHeader);
+        if (vOrder.size() > MAX_KAWPOW_BLOCK_TEMPLATES) {
+            mapBlocks.erase(vOrder.front());
+            vOrder.pop_front();
+        }
+    }
+
+    std::shared_ptr<const CBlock> Get(const uint256& hashHeader) const
+    {
+        LOCK(cs);
+        std::map<uint256, std::shared_ptr<const CBlock> >::const_iterator it = mapBlocks.find(hashHeader);
+        return it == mapBlocks.end() ? nullptr : it->second;
+    }
+
+    void Clear()
+    {
+        LOCK(cs);
+        mapBlocks.clear();
+        vOrder.clear();
+    }
+
+private:
+    mutable CCriticalSection cs;
+    std::map<uint256, std::shared_ptr<const CBlock> > mapBlocks;
+    //! Header hashes, oldest first
+    std::deque<uint256> vOrder;
+};
+
+static CKAWPOWBlockTemplates kawpowBlockTemplates;
 
 unsigned int ParseConfirmTarget(const UniValue& value)
 {
@@ -525,51 +571,34 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
     // don't).
     bool fSupportsSegwit = GetParams().GetConsensus().nSegwitEnabled;
 
-    // Update block
-    static CBlockIndex* pindexPrev;
-    static int64_t nStart;
-    static std::unique_ptr<CBlockTemplate> pblocktemplate;
-    // Cache whether the last invocation was with segwit support, to avoid returning
-    // a segwit-block to a non-segwit caller.
-    static bool fLastTemplateSupportsSegwit = true;
-    if (pindexPrev != chainActive.Tip() ||
-        (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 5) ||
-        fLastTemplateSupportsSegwit != fSupportsSegwit)
-    {
-        // Clear pindexPrev so future calls make a new block, despite any failures from here on
-        pindexPrev = nullptr;
-        mapAIDPKAWBlockTemplates.clear();
-
-        // Store the pindexBest used before CreateNewBlock, to avoid races
-        nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
-        CBlockIndex* pindexPrevNew = chainActive.Tip();
-        nStart = GetTime();
-        fLastTemplateSupportsSegwit = fSupportsSegwit;
-
-        // Create new block
-        // Get mining address if it is set
-        CScript script;
-        std::string address = gArgs.GetArg("-miningaddress", "");
-        if (!address.empty()) {
-            CTxDestination dest = DecodeDestination(address);
+    // Get mining address if it is set
+    CScript script;
+    std::string address = gArgs.GetArg("-miningaddress", "");
+    if (!address.empty()) {
+        CTxDestination dest = DecodeDestination(address);
 
-            if (IsValidDestination(dest)) {
-                script = GetScriptForDestination(dest);
-            } else {
-                throw JSONRPCError(RPC_INVALID_PARAMETER, "-miningaddress is not a valid address. Please use a valid address");
-            }
+        if (IsValidDestination(dest)) {
+            script = GetScriptForDestination(dest);
         } else {
-            script = CScript() << OP_TRUE;
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "-miningaddress is not a valid address. Please use a valid address");
         }
+    } else {
+        script = CScript() << OP_TRUE;
+    }
 
-        pblocktemplate = BlockAssembler(GetParams()).CreateNewBlock(script, fSupportsSegwit);
-        if (!pblocktemplate)
-            throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
-
-        // Need to update only after we know CreateNewBlock succeeded
-        pindexPrev = pindexPrevNew;
+    // Update block: the template follows the mempool, and is only assembled anew on a new tip or
+    // when it has fallen behind for a few seconds
+    std::shared_ptr<const CBlockTemplate> pblocktemplate = pblocktemplatemanager->GetTemplate(script, fSupportsSegwit, nTransactionsUpdatedLast);
+    const CBlockIndex* pindexPrev = chainActive.Tip();
+    static const CBlockIndex* pindexPrevLast = nullptr;
+    if (pindexPrev != pindexPrevLast) {
+        kawpowBlockTemplates.Clear();
+        pindexPrevLast = pindexPrev;
     }
-    CBlock* pblock = &pblocktemplate->block; // pointer for convenience
+
+    // The template is shared, fill in this copy
+    CBlock block(pblocktemplate->block);
+    CBlock* pblock = &block; // pointer for convenience
     const Consensus::Params& consensusParams = GetParams().GetConsensus();
 
     // Update nTime
@@ -722,20 +751,25 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
     if (pblock->nTime >= nKAWPOWActivationTime) {
         std::string address = gArgs.GetArg("-miningaddress", "");
         if (IsValidDestinationString(address)) {
-            static std::string lastheader = "";
-            if (mapAIDPKAWBlockTemplates.count(lastheader)) {
-                if (pblock->nTime - 30 < mapAIDPKAWBlockTemplates.at(lastheader).nTime) {
-                    result.pushKV("pprpcheader", lastheader);
-                    result.pushKV("pprpcepoch", ethash::get_epoch_number(pblock->nHeight));
-                    return result;
-                }
+            static uint256 hashLastHeader;
+            std::shared_ptr<const CBlock> plastblock = kawpowBlockTemplates.Get(hashLastHeader);
+            if (plastblock && pblock->nTime - 30 < plastblock->nTime) {
+                result.pushKV("pprpcheader", hashLastHeader.GetHex());
+                result.pushKV("pprpcepoch", ethash::get_epoch_number(pblock->nHeight));
+                return result;
             }
 
+            // Check the block now, so that pprpcsb only has to check the proof of work.
             pblock->hashMerkleRoot = BlockMerkleRoot(*pblock);
-            result.pushKV("pprpcheader", pblock->GetKAWPOWHeaderHash().GetHex());
+            CValidationState state;
+            if (!CheckBlock(*pblock, state, consensusParams, false, true))
+                throw JSONRPCError(RPC_VERIFY_ERROR, strprintf("Block template failed CheckBlock: %s", FormatStateMessage(state)));
+
+            uint256 hashHeader = pblock->GetKAWPOWHeaderHash();
+            result.pushKV("pprpcheader", hashHeader.GetHex());
             result.pushKV("pprpcepoch", ethash::get_epoch_number(pblock->nHeight));
-            mapAIDPKAWBlockTemplates[pblock->GetKAWPOWHeaderHash().GetHex()] = *pblock;
-            lastheader = pblock->GetKAWPOWHeaderHash().GetHex();
+            kawpowBlockTemplates.Add(hashHeader, std::make_shared<const CBlock>(std::move(block)));
+            hashLastHeader = hashHeader;
         }
     }
 
@@ -863,11 +897,12 @@ static UniValue pprpcsb(const JSONRPCRequest& request) {
     if (!ParseUInt64(str_nonce, &nonce, 16))
         throw JSONRPCError(RPC_INVALID_PARAMS, "Invalid hex nonce");
 
-    if (!mapAIDPKAWBlockTemplates.count(header_hash))
+    std::shared_ptr<const CBlock> ptemplate = kawpowBlockTemplates.Get(uint256S(header_hash));
+    if (!ptemplate)
         throw JSONRPCError(RPC_INVALID_PARAMS, "Block header hash not found in block data");
 
-    std::shared_ptr<CBlock> blockptr = std::make_shared<CBlock>();
-    *blockptr = mapAIDPKAWBlockTemplates.at(header_hash);
+    // The block shares its transactions with the template, only the header is filled in.
+    std::shared_ptr<CBlock> blockptr = std::make_shared<CBlock>(*ptemplate);
 
     blockptr->nNonce64 = nonce;
     blockptr->mix_hash = uint256S(mix_hash);
@@ -876,12 +911,21 @@ static UniValue pprpcsb(const JSONRPCRequest& request) {
         throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Block does not start with a coinbase");
     }
 
+    // The hash from the claimed mix hash is cheap, and turns away shares that do not meet the
+    // block target before the full KAWPOW hash is computed.
+    uint256 hash = blockptr->GetHash();
+    if (!CheckProofOfWork(hash, blockptr->nBits, GetParams().GetConsensus()))
+        throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Block does not solve the boundary");
+
     uint256 retMixHash;
     if (!CheckProofOfWork(blockptr->GetHashFull(retMixHash), blockptr->nBits, GetParams().GetConsensus()))
         throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Block does not solve the boundary");
+    if (retMixHash != blockptr->mix_hash)
+        return "invalid-mix-hash";
 
-
-    uint256 hash = blockptr->GetHash();
+    // The rest of CheckBlock passed with the template: spare ProcessNewBlock checking the
+    // proof of work again.
+    blockptr->fChecked = true;
 
     bool fBlockPresent = false;
     {
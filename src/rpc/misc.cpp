@@ -12,11 +12,13 @@
 #include "init.h"
 #include "validation.h"
 #include "httpserver.h"
+#include "index/chainindexes.h"
 #include "net.h"
 #include "netbase.h"
 #include "rpc/blockchain.h"
 #include "rpc/server.h"
 #include "timedata.h"
+#include "txdb.h"
 #include "txmempool.h"
 #include "util.h"
 #include "utilstrencodings.h"
@@ -698,6 +700,61 @@ bool getAddressesFromParams(const UniValue& params, std::vector<std::pair<uint16
     return true;
 }
 
+/**
+ * Read the "limit" and "cursor" members of a paginated address index request. A cursor is the
+ * hex serialization of the last index key of the previous page; it is decoded into after and
+ * the position in addresses of the address it belongs to, where reading resumes, is returned.
+ */
+template<typename Key>
+size_t getAddressPageFromParams(const UniValue& params, const std::vector<std::pair<uint160, int> > &addresses,
+                                size_t &limit, Key &after, bool &fAfter)
+{
+    limit = 0;
+    fAfter = false;
+    if (!params[0].isObject())
+        return 0;
+
+    UniValue limitValue = find_value(params[0].get_obj(), "limit");
+    if (!limitValue.isNull()) {
+        if (!limitValue.isNum() || limitValue.get_int64() <= 0) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Limit is expected to be greater than zero");
+        }
+        limit = limitValue.get_int64();
+    }
+
+    UniValue cursorValue = find_value(params[0].get_obj(), "cursor");
+    if (cursorValue.isNull())
+        return 0;
+    if (!cursorValue.isStr() || !IsHex(cursorValue.get_str())) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+    CDataStream ssCursor(ParseHex(cursorValue.get_str()), SER_DISK, CLIENT_VERSION);
+    try {
+        ssCursor >> after;
+    } catch (const std::exception&) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+    if (!ssCursor.empty()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+
+    for (size_t i = 0; i < addresses.size(); i++) {
+        if (addresses[i].first == after.hashBytes && (unsigned int)addresses[i].second == after.type) {
+            fAfter = true;
+            return i;
+        }
+    }
+    throw JSONRPCError(RPC_INVALID_PARAMETER, "Cursor does not belong to the requested addresses");
+}
+
+template<typename Key>
+std::string getAddressCursor(const Key &key)
+{
+    CDataStream ssCursor(SER_DISK, CLIENT_VERSION);
+    ssCursor << key;
+    return HexStr(ssCursor.begin(), ssCursor.end());
+}
+
 bool heightSort(std::pair<CAddressUnspentKey, CAddressUnspentValue> a,
                 std::pair<CAddressUnspentKey, CAddressUnspentValue> b) {
     return a.second.blockHeight < b.second.blockHeight;
@@ -814,6 +871,8 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
             "    ],\n"
             "  \"chainInfo\",  (boolean, optional, default false) Include chain info with results\n"
             "  \"assetName\"   (string, optional) Get UTXOs for a particular asset instead of AIDP ('*' for all assets).\n"
+            "  \"limit\"       (number, optional) Return at most this many outputs, in index order, with a cursor for the next page\n"
+            "  \"cursor\"      (string, optional) The cursor returned with the previous page\n"
             "}\n"
             "\nResult\n"
             "[\n"
@@ -827,6 +886,13 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
             "    \"satoshis\"  (number) The number of satoshis of the output\n"
             "  }\n"
             "]\n"
+            "\nResult (with chainInfo or limit):\n"
+            "{\n"
+            "  \"utxos\"  (array) The outputs, as above\n"
+            "  \"hash\"  (string) The hash of the chain tip, with chainInfo\n"
+            "  \"height\"  (number) The height of the chain tip, with chainInfo\n"
+            "  \"cursor\"  (string) Pass as cursor to get the next page, absent on the last page\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"12c6DSiU4Rq3P4ZxziKxzrL5LmMBrzjrJX\"]}'")
             + HelpExampleRpc("getaddressutxos", "{\"addresses\": [\"12c6DSiU4Rq3P4ZxziKxzrL5LmMBrzjrJX\"]}")
@@ -855,21 +921,32 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    size_t limit;
+    CAddressUnspentKey after;
+    bool fAfter;
+    size_t nFirst = getAddressPageFromParams(request.params, addresses, limit, after, fAfter);
+
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+    for (size_t i = nFirst; i < addresses.size(); i++) {
+        size_t nLeft = limit > 0 ? limit - unspentOutputs.size() : 0;
+        const CAddressUnspentKey *pAfter = fAfter && i == nFirst ? &after : nullptr;
         if (assetName == "*") {
-            if (!GetAddressUnspent((*it).first, (*it).second, unspentOutputs)) {
+            if (!GetAddressUnspent(addresses[i].first, addresses[i].second, unspentOutputs, nLeft, pAfter)) {
                 throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
             }
         } else {
-            if (!GetAddressUnspent((*it).first, (*it).second, assetName, unspentOutputs)) {
+            if (!GetAddressUnspent(addresses[i].first, addresses[i].second, assetName, unspentOutputs, nLeft, pAfter)) {
                 throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
             }
         }
+        if (limit > 0 && unspentOutputs.size() >= limit)
+            break;
     }
 
-    std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
+    // Pages are returned in index order so that the cursor can pick up where they end.
+    if (limit == 0)
+        std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
 
     UniValue utxos(UniValue::VARR);
 
@@ -898,13 +975,18 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
         utxos.push_back(output);
     }
 
-    if (includeChainInfo) {
+    if (includeChainInfo || limit > 0) {
         UniValue result(UniValue::VOBJ);
         result.push_back(Pair("utxos", utxos));
 
-        LOCK(cs_main);
-        result.push_back(Pair("hash", chainActive.Tip()->GetBlockHash().GetHex()));
-        result.push_back(Pair("height", (int)chainActive.Height()));
+        if (includeChainInfo) {
+            LOCK(cs_main);
+            result.push_back(Pair("hash", chainActive.Tip()->GetBlockHash().GetHex()));
+            result.push_back(Pair("height", (int)chainActive.Height()));
+        }
+        if (limit > 0 && unspentOutputs.size() >= limit) {
+            result.push_back(Pair("cursor", getAddressCursor(unspentOutputs.back().first)));
+        }
         return result;
     } else {
         return utxos;
@@ -928,6 +1010,8 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
             "  \"end\" (number) The end block height\n"
             "  \"chainInfo\" (boolean) Include chain info in results, only applies if start and end specified\n"
             "  \"assetName\"   (string, optional) Get deltas for a particular asset instead of AIDP.\n"
+            "  \"limit\"   (number, optional) Return at most this many deltas, with a cursor for the next page\n"
+            "  \"cursor\"   (string, optional) The cursor returned with the previous page\n"
             "}\n"
             "\nResult:\n"
             "[\n"
@@ -940,6 +1024,13 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
             "    \"address\"  (string) The base58check encoded address\n"
             "  }\n"
             "]\n"
+            "\nResult (with chainInfo or limit):\n"
+            "{\n"
+            "  \"deltas\"  (array) The deltas, as above\n"
+            "  \"start\"  (object) The hash and height of the start block, with chainInfo\n"
+            "  \"end\"  (object) The hash and height of the end block, with chainInfo\n"
+            "  \"cursor\"  (string) Pass as cursor to get the next page, absent on the last page\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"12c6DSiU4Rq3P4ZxziKxzrL5LmMBrzjrJX\"]}'")
             + HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"12c6DSiU4Rq3P4ZxziKxzrL5LmMBrzjrJX\"]}")
@@ -985,18 +1076,21 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    size_t limit;
+    CAddressIndexKey after;
+    bool fAfter;
+    size_t nFirst = getAddressPageFromParams(request.params, addresses, limit, after, fAfter);
+
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, assetName, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, assetName, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
+    for (size_t i = nFirst; i < addresses.size(); i++) {
+        size_t nLeft = limit > 0 ? limit - addressIndex.size() : 0;
+        const CAddressIndexKey *pAfter = fAfter && i == nFirst ? &after : nullptr;
+        if (!GetAddressIndex(addresses[i].first, addresses[i].second, assetName, addressIndex, start, end, nLeft, pAfter)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
+        if (limit > 0 && addressIndex.size() >= limit)
+            break;
     }
 
     UniValue deltas(UniValue::VARR);
@@ -1020,28 +1114,34 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
 
     UniValue result(UniValue::VOBJ);
 
-    if (includeChainInfo && start > 0 && end > 0) {
-        LOCK(cs_main);
+    if ((includeChainInfo && start > 0 && end > 0) || limit > 0) {
+        result.push_back(Pair("deltas", deltas));
 
-        if (start > chainActive.Height() || end > chainActive.Height()) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Start or end is outside chain range");
-        }
+        if (includeChainInfo && start > 0 && end > 0) {
+            LOCK(cs_main);
 
-        CBlockIndex* startIndex = chainActive[start];
-        CBlockIndex* endIndex = chainActive[end];
+            if (start > chainActive.Height() || end > chainActive.Height()) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Start or end is outside chain range");
+            }
 
-        UniValue startInfo(UniValue::VOBJ);
-        UniValue endInfo(UniValue::VOBJ);
+            CBlockIndex* startIndex = chainActive[start];
+            CBlockIndex* endIndex = chainActive[end];
 
-        startInfo.push_back(Pair("hash", startIndex->GetBlockHash().GetHex()));
-        startInfo.push_back(Pair("height", start));
+            UniValue startInfo(UniValue::VOBJ);
+            UniValue endInfo(UniValue::VOBJ);
 
-        endInfo.push_back(Pair("hash", endIndex->GetBlockHash().GetHex()));
-        endInfo.push_back(Pair("height", end));
+            startInfo.push_back(Pair("hash", startIndex->GetBlockHash().GetHex()));
+            startInfo.push_back(Pair("height", start));
 
-        result.push_back(Pair("deltas", deltas));
-        result.push_back(Pair("start", startInfo));
-        result.push_back(Pair("end", endInfo));
+            endInfo.push_back(Pair("hash", endIndex->GetBlockHash().GetHex()));
+            endInfo.push_back(Pair("height", end));
+
+            result.push_back(Pair("start", startInfo));
+            result.push_back(Pair("end", endInfo));
+        }
+        if (limit > 0 && addressIndex.size() >= limit) {
+            result.push_back(Pair("cursor", getAddressCursor(addressIndex.back().first)));
+        }
 
         return result;
     } else {
@@ -1069,6 +1169,7 @@ UniValue getaddressbalance(const JSONRPCRequest& request)
             "{\n"
             "  \"balance\"  (string) The current balance in satoshis\n"
             "  \"received\"  (string) The total number of satoshis received (including change)\n"
+            "  \"txcount\"  (number) The number of transactions paying to or spending from the address(es), counted per address\n"
             "}\n"
             "OR\n"
             "[\n"
@@ -1076,6 +1177,7 @@ UniValue getaddressbalance(const JSONRPCRequest& request)
             "    \"assetName\"  (string) The asset associated with the balance (AIDP for Aidpcoin)\n"
             "    \"balance\"  (string) The current balance in satoshis\n"
             "    \"received\"  (string) The total number of satoshis received (including change)\n"
+            "    \"txcount\"  (number) The number of transactions with this asset, counted per address\n"
             "  },...\n"
             "\n]"
             "\nExamples:\n"
@@ -1100,65 +1202,53 @@ UniValue getaddressbalance(const JSONRPCRequest& request)
         if (!AreAssetsDeployed())
             throw JSONRPCError(RPC_INVALID_PARAMETER, "Assets aren't active.  includeAssets can't be true.");
 
-        std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+        //assetName -> totals over all the addresses
+        std::map<std::string, CAddressBalanceValue> balances;
 
         for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
+            std::map<std::string, CAddressBalanceValue> addressBalances;
+            if (!GetAddressBalances((*it).first, (*it).second, addressBalances)) {
                 throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
             }
-        }
-
-        //assetName -> (received, balance)
-        std::map<std::string, std::pair<CAmount, CAmount>> balances;
-
-        for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it = addressIndex.begin();
-             it != addressIndex.end(); it++) {
-            std::string assetName = it->first.asset;
-            if (balances.count(assetName) == 0) {
-                balances[assetName] = std::make_pair(0, 0);
+            for (const auto& addressBalance : addressBalances) {
+                CAddressBalanceValue& total = balances[addressBalance.first];
+                total.balance += addressBalance.second.balance;
+                total.received += addressBalance.second.received;
+                total.txCount += addressBalance.second.txCount;
             }
-            if (it->second > 0) {
-                balances[assetName].first += it->second;
-            }
-            balances[assetName].second += it->second;
         }
 
         UniValue result(UniValue::VARR);
 
-        for (std::map<std::string, std::pair<CAmount, CAmount>>::const_iterator it = balances.begin();
+        for (std::map<std::string, CAddressBalanceValue>::const_iterator it = balances.begin();
                 it != balances.end(); it++) {
             UniValue balance(UniValue::VOBJ);
             balance.push_back(Pair("assetName", it->first));
-            balance.push_back(Pair("balance", it->second.second));
-            balance.push_back(Pair("received", it->second.first));
+            balance.push_back(Pair("balance", it->second.balance));
+            balance.push_back(Pair("received", it->second.received));
+            balance.push_back(Pair("txcount", it->second.txCount));
             result.push_back(balance);
         }
 
         return result;
 
     } else {
-        std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+        CAddressBalanceValue total;
 
         for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-            if (!GetAddressIndex((*it).first, (*it).second, AIDP, addressIndex)) {
+            CAddressBalanceValue addressBalance;
+            if (!GetAddressBalance((*it).first, (*it).second, AIDP, addressBalance)) {
                 throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
             }
-        }
-
-        CAmount balance = 0;
-        CAmount received = 0;
-
-        for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it = addressIndex.begin();
-             it != addressIndex.end(); it++) {
-            if (it->second > 0) {
-                received += it->second;
-            }
-            balance += it->second;
+            total.balance += addressBalance.balance;
+            total.received += addressBalance.received;
+            total.txCount += addressBalance.txCount;
         }
 
         UniValue result(UniValue::VOBJ);
-        result.push_back(Pair("balance", balance));
-        result.push_back(Pair("received", received));
+        result.push_back(Pair("balance", total.balance));
+        result.push_back(Pair("received", total.received));
+        result.push_back(Pair("txcount", total.txCount));
 
         return result;
     }
@@ -1180,6 +1270,8 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
             "    ]\n"
             "  \"start\" (number, optional) The start block height\n"
             "  \"end\" (number, optional) The end block height\n"
+            "  \"limit\" (number, optional) Read at most this many index entries, with a cursor for the next page\n"
+            "  \"cursor\" (string, optional) The cursor returned with the previous page\n"
             "},\n"
             "\"includeAssets\" (boolean, optional, default false)  If true this will return an expanded result which includes asset transactions\n"
             "\nResult:\n"
@@ -1187,6 +1279,13 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
             "  \"transactionid\"  (string) The transaction id\n"
             "  ,...\n"
             "]\n"
+            "\nResult (with limit):\n"
+            "{\n"
+            "  \"txids\"  (array) The transaction ids, address by address and, with includeAssets, asset by asset\n"
+            "            within an address, each in block order. A transaction is listed once per page, but comes up\n"
+            "            again on a later page if it also involves another address or asset of the query\n"
+            "  \"cursor\"  (string) Pass as cursor to get the next page, absent on the last page\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"12c6DSiU4Rq3P4ZxziKxzrL5LmMBrzjrJX\"]}'")
             + HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"12c6DSiU4Rq3P4ZxziKxzrL5LmMBrzjrJX\"]}")
@@ -1220,30 +1319,53 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
         if (!AreAssetsDeployed())
             throw JSONRPCError(RPC_INVALID_PARAMETER, "Assets aren't active.  includeAssets can't be true.");
 
+    size_t limit;
+    CAddressIndexKey after;
+    bool fAfter;
+    size_t nFirst = getAddressPageFromParams(request.params, addresses, limit, after, fAfter);
+
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (includeAssets) {
-            if (start > 0 && end > 0) {
-                if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                    throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-                }
-            } else {
-                if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                    throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-                }
-            }
-        } else {
-            if (start > 0 && end > 0) {
-                if (!GetAddressIndex((*it).first, (*it).second, AIDP, addressIndex, start, end)) {
-                    throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-                }
-            } else {
-                if (!GetAddressIndex((*it).first, (*it).second, AIDP, addressIndex)) {
-                    throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-                }
-            }
+    for (size_t i = nFirst; i < addresses.size(); i++) {
+        size_t nLeft = limit > 0 ? limit - addressIndex.size() : 0;
+        const CAddressIndexKey *pAfter = fAfter && i == nFirst ? &after : nullptr;
+        if (!GetAddressIndex(addresses[i].first, addresses[i].second, includeAssets ? "" : AIDP, addressIndex, start, end, nLeft, pAfter)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+        if (limit > 0 && addressIndex.size() >= limit)
+            break;
+    }
+
+    if (limit > 0) {
+        bool fMore = addressIndex.size() >= limit;
+        if (fMore) {
+            // The entries of a transaction are next to each other in the index; end the page
+            // before a transaction that may continue on the next one, unless it fills the page.
+            const CAddressIndexKey& last = addressIndex.back().first;
+            size_t nKeep = addressIndex.size();
+            while (nKeep > 0 && addressIndex[nKeep - 1].first.txhash == last.txhash &&
+                   addressIndex[nKeep - 1].first.hashBytes == last.hashBytes && addressIndex[nKeep - 1].first.asset == last.asset)
+                nKeep--;
+            if (nKeep > 0)
+                addressIndex.resize(nKeep);
+        }
+
+        // With includeAssets the entries of a transaction for different assets are not next
+        // to each other, so deduplicate over the whole page as the unpaged result does. The
+        // cursor is only a position in the index, so a later page can list a transaction again.
+        std::set<uint256> setSeen;
+        UniValue txids(UniValue::VARR);
+        for (size_t i = 0; i < addressIndex.size(); i++) {
+            if (setSeen.insert(addressIndex[i].first.txhash).second)
+                txids.push_back(addressIndex[i].first.txhash.GetHex());
+        }
+
+        UniValue result(UniValue::VOBJ);
+        result.push_back(Pair("txids", txids));
+        if (fMore) {
+            result.push_back(Pair("cursor", getAddressCursor(addressIndex.back().first)));
         }
+        return result;
     }
 
     std::set<std::pair<int, std::string> > txids;
@@ -1272,6 +1394,48 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
 
 }
 
+UniValue getindexinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 1)
+        throw std::runtime_error(
+            "getindexinfo ( \"index_name\" )\n"
+            "\nReturns the status of the running optional indexes (addressindex, spentindex, timestampindex).\n"
+            "\nArguments:\n"
+            "1. \"index_name\"  (string, optional) Only return the status of this index\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"name\" : {               (object) The name of the index\n"
+            "    \"synced\" : true|false,  (boolean) Whether the index has caught up with the chain and can be queried\n"
+            "    \"best_block_height\" : n, (numeric) The height the index is built up to\n"
+            "    \"size_on_disk\" : n       (numeric) The estimated size of the index in the block tree database\n"
+            "  }\n"
+            "  ,...\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getindexinfo", "")
+            + HelpExampleRpc("getindexinfo", "")
+            + HelpExampleCli("getindexinfo", "addressindex")
+        );
+
+    std::string strName;
+    if (!request.params[0].isNull())
+        strName = request.params[0].get_str();
+
+    LOCK(cs_main);
+    UniValue result(UniValue::VOBJ);
+    for (const BaseIndex* index : GetChainIndexes()) {
+        if (!strName.empty() && strName != index->GetName())
+            continue;
+        const CBlockIndex* pindexBest = index->GetBestBlock();
+        UniValue entry(UniValue::VOBJ);
+        entry.push_back(Pair("synced", index->IsSynced()));
+        entry.push_back(Pair("best_block_height", pindexBest ? pindexBest->nHeight : -1));
+        entry.push_back(Pair("size_on_disk", pblocktree->EstimateIndexSize(index->GetName())));
+        result.push_back(Pair(index->GetName(), entry));
+    }
+    return result;
+}
+
 UniValue getspentinfo(const JSONRPCRequest& request)
 {
 
@@ -1329,6 +1493,7 @@ static const CRPCCommand commands[] =
     { "util",               "createmultisig",         &createmultisig,         {"nrequired","keys"} },
     { "util",               "verifymessage",          &verifymessage,          {"address","signature","message"} },
     { "util",               "signmessagewithprivkey", &signmessagewithprivkey, {"privkey","message"} },
+    { "util",               "getindexinfo",           &getindexinfo,           {"index_name"} },
 
     /* Address index */
     { "addressindex",       "getaddressmempool",      &getaddressmempool,      {"addresses","includeAssets"} },
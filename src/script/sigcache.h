@@ -55,4 +55,13 @@ public:
 
 void InitSignatureCache();
 
+/** Get the nonce and the live entries of the signature cache, to save it across restarts. */
+void GetSignatureCacheEntries(uint256& nonce, std::vector<uint256>& entries);
+
+/**
+ * Restore entries saved by GetSignatureCacheEntries, switching to their nonce. Must be called
+ * before any signature is checked.
+ */
+void LoadSignatureCacheEntries(const uint256& nonce, const std::vector<uint256>& entries);
+
 #endif // AIDP_SCRIPT_SIGCACHE_H
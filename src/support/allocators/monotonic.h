@@ -0,0 +1,142 @@
+// Copyright (c) 2023-2024 The Aidp Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef AIDP_SUPPORT_ALLOCATORS_MONOTONIC_H
+#define AIDP_SUPPORT_ALLOCATORS_MONOTONIC_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+/**
+ * A memory resource for objects that all die together.
+ *
+ * Memory is handed out by bumping a pointer through chunks taken from the system. Freeing
+ * does nothing; every chunk is returned at once when the resource is destroyed. This suits
+ * data such as the transactions of a block, which are read in one go and usually dropped in
+ * one go, and saves a malloc/free pair per object.
+ *
+ * Allocating is not thread safe. Destruction happens when the last MonotonicAllocator
+ * referring to the resource goes away, on whichever thread that is.
+ */
+class MonotonicResource final
+{
+    static constexpr std::size_t CHUNK_ALIGN_BYTES = alignof(std::max_align_t);
+
+    const std::size_t m_chunk_size_bytes;
+    std::vector<std::byte*> m_allocated_chunks;
+    std::byte* m_available_memory_it = nullptr;
+    std::byte* m_available_memory_end = nullptr;
+    std::size_t m_allocated_bytes = 0;
+
+    std::byte* AllocateChunk(std::size_t bytes)
+    {
+        std::byte* chunk = static_cast<std::byte*>(::operator new (bytes, std::align_val_t{CHUNK_ALIGN_BYTES}));
+        m_allocated_chunks.push_back(chunk);
+        return chunk;
+    }
+
+public:
+    /** Default chunk size: 64 KiB. */
+    static constexpr std::size_t DEFAULT_CHUNK_SIZE_BYTES = 65536;
+
+    explicit MonotonicResource(std::size_t chunk_size_bytes = DEFAULT_CHUNK_SIZE_BYTES)
+        : m_chunk_size_bytes(std::max<std::size_t>(chunk_size_bytes, CHUNK_ALIGN_BYTES)) {}
+
+    MonotonicResource(const MonotonicResource&) = delete;
+    MonotonicResource& operator=(const MonotonicResource&) = delete;
+
+    ~MonotonicResource()
+    {
+        for (std::byte* chunk : m_allocated_chunks) {
+            ::operator delete (static_cast<void*>(chunk), std::align_val_t{CHUNK_ALIGN_BYTES});
+        }
+    }
+
+    void* Allocate(std::size_t bytes, std::size_t alignment)
+    {
+        if (alignment > CHUNK_ALIGN_BYTES) {
+            throw std::bad_alloc();
+        }
+        m_allocated_bytes += bytes;
+
+        // Requests that would take a large part of a chunk get a chunk of their own, so the
+        // rest of the current one is not wasted.
+        if (bytes > m_chunk_size_bytes / 4) {
+            return AllocateChunk(bytes);
+        }
+
+        std::size_t misalignment = reinterpret_cast<std::uintptr_t>(m_available_memory_it) & (alignment - 1);
+        std::byte* p = m_available_memory_it + (misalignment ? alignment - misalignment : 0);
+        if (m_available_memory_it == nullptr || bytes > static_cast<std::size_t>(m_available_memory_end - p)) {
+            p = AllocateChunk(m_chunk_size_bytes);
+            m_available_memory_end = p + m_chunk_size_bytes;
+        }
+        m_available_memory_it = p + bytes;
+        return p;
+    }
+
+    /** Number of chunks requested from the system so far. */
+    std::size_t NumAllocatedChunks() const
+    {
+        return m_allocated_chunks.size();
+    }
+
+    /** Sum of the sizes of all allocations made so far. */
+    std::size_t AllocatedBytes() const
+    {
+        return m_allocated_bytes;
+    }
+};
+
+/**
+ * Allocator that hands out memory from a shared MonotonicResource. Every copy keeps the
+ * resource alive, so objects created through std::allocate_shared keep their memory valid
+ * however long they outlive the code that created them.
+ */
+template <class T>
+class MonotonicAllocator
+{
+    std::shared_ptr<MonotonicResource> m_resource;
+
+    template <typename U>
+    friend class MonotonicAllocator;
+
+public:
+    typedef T value_type;
+
+    explicit MonotonicAllocator(std::shared_ptr<MonotonicResource> resource) noexcept : m_resource(std::move(resource)) {}
+
+    template <class U>
+    MonotonicAllocator(const MonotonicAllocator<U>& other) noexcept : m_resource(other.m_resource) {}
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(m_resource->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept {}
+
+    const std::shared_ptr<MonotonicResource>& resource() const noexcept
+    {
+        return m_resource;
+    }
+};
+
+template <class T1, class T2>
+bool operator==(const MonotonicAllocator<T1>& a, const MonotonicAllocator<T2>& b) noexcept
+{
+    return a.resource() == b.resource();
+}
+
+template <class T1, class T2>
+bool operator!=(const MonotonicAllocator<T1>& a, const MonotonicAllocator<T2>& b) noexcept
+{
+    return !(a == b);
+}
+
+#endif // AIDP_SUPPORT_ALLOCATORS_MONOTONIC_H
@@ -4,6 +4,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <assets/assets.h>
+#include <validation.h>
 
 #include <test/test_aidp.h>
 
@@ -78,5 +79,52 @@ BOOST_FIXTURE_TEST_SUITE(messaging_tests, BasicTestingSetup)
 
     }
 
+    BOOST_FIXTURE_TEST_CASE(message_db_paging_test, TestingSetup)
+    {
+        CMessageDB db(1 << 20, true);
+
+        // Three messages on one channel written out of time order, one on another channel
+        uint256 txid = uint256S("0x1");
+        BOOST_CHECK(db.WriteMessage(CMessage(COutPoint(txid, 300), "CHANNEL!", "", 0, 30)));
+        BOOST_CHECK(db.WriteMessage(CMessage(COutPoint(txid, 1), "CHANNEL!", "", 0, 10)));
+        BOOST_CHECK(db.WriteMessage(CMessage(COutPoint(txid, 2), "CHANNEL!", "", 0, 20)));
+        BOOST_CHECK(db.WriteMessage(CMessage(COutPoint(txid, 3), "OTHER!", "", 0, 15)));
+
+        std::vector<CMessage> vMessages;
+        bool fMore;
+        BOOST_CHECK(db.ReadChannelMessages("CHANNEL!", 0, std::numeric_limits<int64_t>::max(), nullptr, 2, vMessages, fMore));
+        BOOST_CHECK_EQUAL(vMessages.size(), 2);
+        BOOST_CHECK(fMore);
+        BOOST_CHECK_EQUAL(vMessages[0].time, 10);
+        BOOST_CHECK_EQUAL(vMessages[1].time, 20);
+
+        // Continue after the last message of the first page
+        CMessageChannelKey after("CHANNEL!", vMessages[1].time, vMessages[1].out);
+        vMessages.clear();
+        BOOST_CHECK(db.ReadChannelMessages("CHANNEL!", 0, std::numeric_limits<int64_t>::max(), &after, 2, vMessages, fMore));
+        BOOST_CHECK_EQUAL(vMessages.size(), 1);
+        BOOST_CHECK(!fMore);
+        BOOST_CHECK(vMessages[0].out == COutPoint(txid, 300));
+
+        // Time range
+        vMessages.clear();
+        BOOST_CHECK(db.ReadChannelMessages("CHANNEL!", 15, 25, nullptr, 0, vMessages, fMore));
+        BOOST_CHECK_EQUAL(vMessages.size(), 1);
+        BOOST_CHECK_EQUAL(vMessages[0].time, 20);
+
+        // All channels, then erasing drops the channel index entry as well
+        vMessages.clear();
+        BOOST_CHECK(db.ReadMessages(nullptr, 0, std::numeric_limits<int64_t>::max(), 0, vMessages, fMore));
+        BOOST_CHECK_EQUAL(vMessages.size(), 4);
+
+        BOOST_CHECK(db.EraseMessage(COutPoint(txid, 3)));
+        vMessages.clear();
+        BOOST_CHECK(db.ReadChannelMessages("OTHER!", 0, std::numeric_limits<int64_t>::max(), nullptr, 0, vMessages, fMore));
+        BOOST_CHECK(vMessages.empty());
+
+        BOOST_CHECK(db.Upgrade());
+        bool fIndexed = false;
+        BOOST_CHECK(db.ReadFlag("channelindex", fIndexed) && fIndexed);
+    }
 
 BOOST_AUTO_TEST_SUITE_END()
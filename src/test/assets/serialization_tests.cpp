@@ -4,6 +4,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <assets/assets.h>
+#include <assets/assetdb.h>
 
 #include <test/test_aidp.h>
 
@@ -176,4 +177,78 @@ BOOST_FIXTURE_TEST_SUITE(serialization_tests, BasicTestingSetup)
         BOOST_CHECK_MESSAGE(IsScriptNewMsgChannelAsset(scriptPubKey), "Script wasn't a message channel");
     }
 
+    BOOST_AUTO_TEST_CASE(block_asset_undo_compact_serialization)
+    {
+        BOOST_TEST_MESSAGE("Running Block Asset Undo Compact Serialization Test");
+
+        std::vector<std::pair<std::string, CBlockAssetUndo> > vUndo;
+        vUndo.emplace_back("$RESTRICTED", CBlockAssetUndo {true, true, DecodeAssetData("QmRAQB6YaCyidP37UdDnjFY5vQuiBrcqdyoW1CuDgwxkD4"), 4, ASSET_UNDO_INCLUDES_VERIFIER_STRING, true, "#KYC & !#BLOCKED"});
+        vUndo.emplace_back("ASSET", CBlockAssetUndo {false, true, "", 2, ASSET_UNDO_INCLUDES_VERIFIER_STRING, false, ""});
+        vUndo.emplace_back("$RESTRICTED", CBlockAssetUndo {false, false, "", 0, ASSET_UNDO_INCLUDES_VERIFIER_STRING, false, ""});
+
+        CDataStream ssCompact(SER_DISK, CLIENT_VERSION);
+        ssCompact << CBlockAssetUndoCompressor(vUndo);
+
+        CDataStream ssLegacy(SER_DISK, CLIENT_VERSION);
+        ssLegacy << vUndo;
+        BOOST_CHECK(ssCompact.size() < ssLegacy.size());
+
+        std::vector<std::pair<std::string, CBlockAssetUndo> > vRead;
+        CBlockAssetUndoCompressor compressor(vRead);
+        ssCompact >> compressor;
+        BOOST_CHECK(ssCompact.empty());
+
+        BOOST_REQUIRE_EQUAL(vRead.size(), vUndo.size());
+        for (unsigned int i = 0; i < vUndo.size(); i++) {
+            const CBlockAssetUndo& expected = vUndo[i].second;
+            const CBlockAssetUndo& read = vRead[i].second;
+            BOOST_CHECK_EQUAL(vRead[i].first, vUndo[i].first);
+            BOOST_CHECK_EQUAL(read.fChangedIPFS, expected.fChangedIPFS);
+            BOOST_CHECK_EQUAL(read.fChangedUnits, expected.fChangedUnits);
+            BOOST_CHECK_EQUAL(read.fChangedVerifierString, expected.fChangedVerifierString);
+            BOOST_CHECK(read.strIPFS == expected.strIPFS);
+            BOOST_CHECK_EQUAL(read.nUnits, expected.nUnits);
+            BOOST_CHECK_EQUAL(read.verifierString, expected.verifierString);
+            BOOST_CHECK_EQUAL(read.version, ASSET_UNDO_INCLUDES_VERIFIER_STRING);
+        }
+
+        // Unknown versions are rejected rather than misread
+        CDataStream ssBad(SER_DISK, CLIENT_VERSION);
+        ssBad << (uint8_t)(BLOCK_ASSET_UNDO_COMPACT_VERSION + 1);
+        BOOST_CHECK_THROW(ssBad >> compressor, std::ios_base::failure);
+    }
+
+    BOOST_AUTO_TEST_CASE(block_asset_undo_legacy_upgrade)
+    {
+        BOOST_TEST_MESSAGE("Running Block Asset Undo Legacy Upgrade Test");
+
+        // A record from before verifier strings: units changed, nothing after the units
+        CDataStream ssLegacy(SER_DISK, CLIENT_VERSION);
+        ssLegacy << true << false << std::string() << (int32_t)3;
+
+        std::vector<std::pair<std::string, CBlockAssetUndo> > vUndo(1);
+        vUndo[0].first = "ASSET";
+        vUndo[0].second.fChangedVerifierString = true;
+        ssLegacy >> vUndo[0].second;
+        BOOST_CHECK(!vUndo[0].second.fChangedVerifierString);
+        BOOST_CHECK(vUndo[0].second.verifierString.empty());
+
+        // Re-encoding it as the upgrade does carries no verifier change over
+        CDataStream ssCompact(SER_DISK, CLIENT_VERSION);
+        ssCompact << CBlockAssetUndoCompressor(vUndo);
+        std::vector<std::pair<std::string, CBlockAssetUndo> > vRead;
+        CBlockAssetUndoCompressor compressor(vRead);
+        ssCompact >> compressor;
+        BOOST_REQUIRE_EQUAL(vRead.size(), 1U);
+        BOOST_CHECK(vRead[0].second.fChangedUnits);
+        BOOST_CHECK(!vRead[0].second.fChangedIPFS);
+        BOOST_CHECK(!vRead[0].second.fChangedVerifierString);
+        BOOST_CHECK_EQUAL(vRead[0].second.nUnits, 3);
+
+        // A default constructed record changes nothing
+        CBlockAssetUndo undo;
+        BOOST_CHECK(!undo.fChangedIPFS && !undo.fChangedUnits && !undo.fChangedVerifierString);
+        BOOST_CHECK_EQUAL(undo.nUnits, 0);
+    }
+
 BOOST_AUTO_TEST_SUITE_END()
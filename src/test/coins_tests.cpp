@@ -5,7 +5,9 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "coins.h"
+#include "coinsprefetch.h"
 #include "script/standard.h"
+#include "txdb.h"
 #include "uint256.h"
 #include "undo.h"
 #include "utilstrencodings.h"
@@ -665,7 +667,8 @@ BOOST_FIXTURE_TEST_SUITE(coins_tests, BasicTestingSetup)
 
     void WriteCoinsViewEntry(CCoinsView &view, CAmount value, char flags)
     {
-        CCoinsMap map;
+        CCoinsMapMemoryResource resource;
+        CCoinsMap map{0, CCoinsMap::hasher{}, CCoinsMap::key_equal{}, &resource};
         InsertCoinsMapEntry(map, value, flags);
         view.BatchWrite(map, {});
     }
@@ -946,4 +949,109 @@ BOOST_FIXTURE_TEST_SUITE(coins_tests, BasicTestingSetup)
                         CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
     }
 
+    BOOST_AUTO_TEST_CASE(ccoins_background_flush_test)
+    {
+        CCoinsViewDB db(1 << 20, true, true);
+        CCoinsViewBackgroundFlush flushview(&db);
+        CCoinsViewCache cache(&flushview);
+
+        COutPoint spent(InsecureRand256(), 0);
+        COutPoint unspent(InsecureRand256(), 1);
+        CTxOut txout(CENT, CScript() << OP_TRUE);
+
+        // A first, synchronous flush puts a coin on disk.
+        uint256 hashFirst = InsecureRand256();
+        cache.AddCoin(spent, Coin(CTxOut(txout), 1, false), false);
+        cache.SetBestBlock(hashFirst);
+        BOOST_CHECK(cache.Flush());
+        BOOST_CHECK(db.GetBestBlock() == hashFirst);
+        BOOST_CHECK(db.HaveCoin(spent));
+
+        // Spend it and add another one, then hand the changes to the writer thread.
+        uint256 hashSecond = InsecureRand256();
+        BOOST_CHECK(cache.SpendCoin(spent));
+        cache.AddCoin(unspent, Coin(CTxOut(txout), 2, false), false);
+        cache.SetBestBlock(hashSecond);
+        BOOST_CHECK(flushview.FlushInBackground(cache));
+        BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+
+        // Whether or not the write has finished, the view shows the flushed state.
+        BOOST_CHECK(flushview.GetBestBlock() == hashSecond);
+        BOOST_CHECK(!flushview.HaveCoin(spent));
+        BOOST_CHECK(flushview.HaveCoin(unspent));
+        BOOST_CHECK(cache.AccessCoin(unspent).nHeight == 2);
+
+        BOOST_CHECK(flushview.WaitForIdle());
+        BOOST_CHECK(db.GetBestBlock() == hashSecond);
+        BOOST_CHECK(db.GetHeadBlocks().empty());
+        BOOST_CHECK(!db.HaveCoin(spent));
+        Coin coin;
+        BOOST_CHECK(db.GetCoin(unspent, coin));
+        BOOST_CHECK(coin.out == txout);
+
+        // Before a write is handed over the database is marked as in transition, so an
+        // interrupted background write is replayed rather than silently lost.
+        uint256 hashThird = InsecureRand256();
+        BOOST_CHECK(db.StartWrite(hashThird));
+        BOOST_CHECK(db.GetBestBlock().IsNull());
+        std::vector<uint256> vHeads = db.GetHeadBlocks();
+        BOOST_CHECK(vHeads.size() == 2 && vHeads[0] == hashThird && vHeads[1] == hashSecond);
+        cache.SetBestBlock(hashThird);
+        BOOST_CHECK(cache.Flush());
+        BOOST_CHECK(db.GetBestBlock() == hashThird);
+        BOOST_CHECK(db.GetHeadBlocks().empty());
+    }
+
+    BOOST_AUTO_TEST_CASE(ccoins_prefetch_test)
+    {
+        CCoinsViewDB db(1 << 20, true, true);
+        CCoinsViewCache cache(&db);
+        CTxOut txout(CENT, CScript() << OP_TRUE);
+
+        // Three coins on disk, one of them already spent in the cache.
+        std::vector<COutPoint> outpoints;
+        for (int i = 0; i < 3; i++) {
+            outpoints.emplace_back(InsecureRand256(), i);
+            cache.AddCoin(outpoints.back(), Coin(CTxOut(txout), 1, false), false);
+        }
+        cache.SetBestBlock(InsecureRand256());
+        BOOST_CHECK(cache.Flush());
+        BOOST_CHECK(cache.SpendCoin(outpoints[2]));
+
+        CBlock block;
+        CMutableTransaction coinbase;
+        coinbase.vin.resize(1);
+        coinbase.vout.push_back(txout);
+        block.vtx.push_back(MakeTransactionRef(coinbase));
+        CMutableTransaction spend;
+        for (const COutPoint& outpoint : outpoints)
+            spend.vin.emplace_back(outpoint);
+        spend.vout.push_back(txout);
+        block.vtx.push_back(MakeTransactionRef(spend));
+        CMutableTransaction child;
+        child.vin.emplace_back(spend.GetHash(), 0);
+        child.vout.push_back(txout);
+        block.vtx.push_back(MakeTransactionRef(child));
+
+        {
+            CCoinsPrefetcher prefetcher(&db, 2);
+            prefetcher.Prefetch(block, cache);
+            prefetcher.Apply(block.GetHash(), cache);
+        }
+        BOOST_CHECK(cache.HaveCoinInCache(outpoints[0]));
+        BOOST_CHECK(cache.HaveCoinInCache(outpoints[1]));
+        // The cached spend is not overwritten by the copy on disk.
+        BOOST_CHECK(!cache.HaveCoin(outpoints[2]));
+
+        // A flush in between makes the data read before it unusable.
+        cache.Uncache(outpoints[0]);
+        {
+            CCoinsPrefetcher prefetcher(&db, 2);
+            prefetcher.Prefetch(block, cache);
+            prefetcher.Invalidate();
+            prefetcher.Apply(block.GetHash(), cache);
+        }
+        BOOST_CHECK(!cache.HaveCoinInCache(outpoints[0]));
+    }
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -6,6 +6,9 @@
 
 #include "compressor.h"
 #include "util.h"
+#include "streams.h"
+#include "script/standard.h"
+#include "assets/assets.h"
 #include "test/test_aidp.h"
 
 #include <stdint.h>
@@ -69,4 +72,77 @@ BOOST_FIXTURE_TEST_SUITE(compress_tests, BasicTestingSetup)
             BOOST_CHECK(TestDecode(i));
     }
 
+    static size_t CheckScriptRoundTrip(const CScript& script, bool fAssets)
+    {
+        CDataStream ss(SER_DISK, 0);
+        ss << CScriptCompressor(REF(script), fAssets);
+        size_t nSize = ss.size();
+
+        CScript read;
+        CScriptCompressor compressor(read, fAssets);
+        ss >> compressor;
+        BOOST_CHECK(ss.empty());
+        BOOST_CHECK(read == script);
+        return nSize;
+    }
+
+    BOOST_AUTO_TEST_CASE(compress_asset_scripts_test)
+    {
+        BOOST_TEST_MESSAGE("Running Compress Asset Scripts Test");
+
+        CKeyID keyID;
+        keyID.SetHex("0102030405060708090a0b0c0d0e0f1011121314");
+        CScriptID scriptID;
+        scriptID.SetHex("1413121110090807060504030201000f0e0d0c0b");
+
+        std::vector<CScript> vScripts;
+
+        CScript transfer = GetScriptForDestination(keyID);
+        CAssetTransfer("TRANSFER_ASSET", 1234 * COIN).ConstructTransaction(transfer);
+        vScripts.push_back(transfer);
+
+        CScript transferP2SH = GetScriptForDestination(scriptID);
+        CAssetTransfer("TRANSFER_ASSET", 5 * COIN).ConstructTransaction(transferP2SH);
+        vScripts.push_back(transferP2SH);
+
+        CScript transferMessage = GetScriptForDestination(keyID);
+        CAssetTransfer("TRANSFER_ASSET", COIN, DecodeAssetData("QmacSRmrkVmvJfbCpmU6pK72furJ8E8fbKHindrLxmYMQo"), 1600000000).ConstructTransaction(transferMessage);
+        vScripts.push_back(transferMessage);
+
+        CNewAsset asset("ISSUED_ASSET", 1000 * COIN, 2, 1, 1, DecodeAssetData("QmacSRmrkVmvJfbCpmU6pK72furJ8E8fbKHindrLxmYMQo"));
+        CScript issue = GetScriptForDestination(keyID);
+        asset.ConstructTransaction(issue);
+        vScripts.push_back(issue);
+
+        CScript owner = GetScriptForDestination(keyID);
+        asset.ConstructOwnerTransaction(owner);
+        vScripts.push_back(owner);
+
+        for (const auto& script : vScripts) {
+            size_t nLegacy = CheckScriptRoundTrip(script, false);
+            size_t nCompact = CheckScriptRoundTrip(script, true);
+            BOOST_CHECK(nCompact < nLegacy);
+        }
+
+        // Without fAssets the encoding is unchanged: raw scripts are offset by 6
+        CDataStream ss(SER_DISK, 0);
+        ss << CScriptCompressor(REF(transfer));
+        unsigned int nSize = 0;
+        ss >> VARINT(nSize);
+        BOOST_CHECK_EQUAL(nSize, transfer.size() + 6);
+
+        // Scripts the compact form can't reproduce exactly are stored raw
+        CScript nonMinimal = GetScriptForDestination(keyID);
+        std::vector<unsigned char> vchAsset(transfer.begin() + 27, transfer.end() - 1);
+        nonMinimal << OP_AIDP_ASSET;
+        nonMinimal.push_back(OP_PUSHDATA1);
+        nonMinimal.push_back(vchAsset.size());
+        nonMinimal.insert(nonMinimal.end(), vchAsset.begin(), vchAsset.end());
+        nonMinimal << OP_DROP;
+        BOOST_CHECK_EQUAL(CheckScriptRoundTrip(nonMinimal, true), nonMinimal.size() + 1);
+
+        CScript garbage = GetScriptForDestination(keyID) << OP_AIDP_ASSET << std::vector<unsigned char>{AIDP_R, AIDP_V, AIDP_N, AIDP_T, 0xff} << OP_DROP;
+        BOOST_CHECK_EQUAL(CheckScriptRoundTrip(garbage, true), garbage.size() + 1);
+    }
+
 BOOST_AUTO_TEST_SUITE_END()
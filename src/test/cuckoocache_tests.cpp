@@ -403,4 +403,35 @@ BOOST_AUTO_TEST_SUITE(cuckoocache_tests);
         test_cache_generations<CuckooCache::cache<uint256, SignatureCacheHasher>>();
     }
 
+/* Test that for_each visits exactly the live elements, and that they can
+ * rebuild an equivalent cache (as when the caches are saved across restarts).
+ */
+    BOOST_AUTO_TEST_CASE(cuckoocache_for_each_test)
+    {
+        BOOST_TEST_MESSAGE("Running CuckooCache For Each Test");
+
+        local_rand_ctx = FastRandomContext(true);
+        CuckooCache::cache<uint256, SignatureCacheHasher> cc{};
+        cc.setup_bytes(1 << 20);
+        std::vector<uint256> hashes(1000);
+        for (uint256& h : hashes) {
+            insecure_GetRandHash(h);
+            cc.insert(h);
+        }
+        // Erased elements are no longer live.
+        for (size_t i = 0; i < hashes.size(); i += 2)
+            cc.contains(hashes[i], true);
+
+        std::vector<uint256> live;
+        cc.for_each([&live](const uint256& h) { live.push_back(h); });
+        BOOST_CHECK_EQUAL(live.size(), hashes.size() / 2);
+
+        CuckooCache::cache<uint256, SignatureCacheHasher> cc2{};
+        cc2.setup_bytes(1 << 20);
+        for (const uint256& h : live)
+            cc2.insert(h);
+        for (size_t i = 0; i < hashes.size(); ++i)
+            BOOST_CHECK_EQUAL(cc2.contains(hashes[i], false), i % 2 == 1);
+    }
+
 BOOST_AUTO_TEST_SUITE_END();
@@ -598,4 +598,116 @@ BOOST_FIXTURE_TEST_SUITE(mempool_tests, TestingSetup)
         SetMockTime(0);
     }
 
+    BOOST_AUTO_TEST_CASE(mempool_restricted_entries_test)
+    {
+        BOOST_TEST_MESSAGE("Running Mempool Restricted Entries Test");
+
+        CTxMemPool pool;
+        TestMemPoolEntryHelper entry;
+
+        CMutableTransaction tx1 = CMutableTransaction();
+        tx1.vin.resize(1);
+        tx1.vin[0].scriptSig = CScript() << OP_1;
+        tx1.vout.resize(1);
+        tx1.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        tx1.vout[0].nValue = 10 * COIN;
+        pool.addUnchecked(tx1.GetHash(), entry.FromTx(tx1));
+
+        CMutableTransaction tx2 = CMutableTransaction();
+        tx2.vin.resize(1);
+        tx2.vin[0].scriptSig = CScript() << OP_2;
+        tx2.vout.resize(1);
+        tx2.vout[0].scriptPubKey = CScript() << OP_2 << OP_EQUAL;
+        tx2.vout[0].nValue = 10 * COIN;
+        pool.addUnchecked(tx2.GetHash(), entry.FromTx(tx2));
+
+        pool.addRestrictedEntry(tx1.GetHash(), MempoolRestrictedType::ADDRESS_FROZEN, "$RESTRICTED", "address1");
+        pool.addRestrictedEntry(tx1.GetHash(), MempoolRestrictedType::ADDRESS_FROZEN, "$RESTRICTED", "address1");
+        pool.addRestrictedEntry(tx1.GetHash(), MempoolRestrictedType::VERIFIER_CHANGED, "$RESTRICTED");
+        pool.addRestrictedEntry(tx2.GetHash(), MempoolRestrictedType::VERIFIER_CHANGED, "$RESTRICTED");
+        pool.addRestrictedEntry(tx2.GetHash(), MempoolRestrictedType::GLOBAL_FREEZING, "$OTHER");
+        pool.addRestrictedEntry(tx2.GetHash(), MempoolRestrictedType::ADDED_TAG, "#TAG", "address2");
+
+        std::vector<uint256> txids;
+        pool.getRestrictedAddressTxids(MempoolRestrictedType::ADDRESS_FROZEN, "address1", "$RESTRICTED", txids);
+        BOOST_CHECK_EQUAL(txids.size(), 1);
+        txids.clear();
+        pool.getRestrictedTxids(MempoolRestrictedType::VERIFIER_CHANGED, "$RESTRICTED", txids);
+        BOOST_CHECK_EQUAL(txids.size(), 2);
+
+        BOOST_CHECK(pool.hasRestrictedEntry(MempoolRestrictedType::GLOBAL_FREEZING, "$OTHER"));
+        BOOST_CHECK(!pool.hasRestrictedEntry(MempoolRestrictedType::GLOBAL_UNFREEZING, "$OTHER"));
+        BOOST_CHECK(pool.hasRestrictedAddressEntry(MempoolRestrictedType::ADDED_TAG, "address2", "#TAG"));
+        BOOST_CHECK(!pool.hasRestrictedAddressEntry(MempoolRestrictedType::REMOVED_TAG, "address2", "#TAG"));
+
+        // Removing a transaction drops all of its records and leaves the others
+        pool.removeRecursive(tx2);
+        BOOST_CHECK(!pool.hasRestrictedEntry(MempoolRestrictedType::GLOBAL_FREEZING, "$OTHER"));
+        BOOST_CHECK(!pool.hasRestrictedAddressEntry(MempoolRestrictedType::ADDED_TAG, "address2", "#TAG"));
+        txids.clear();
+        pool.getRestrictedTxids(MempoolRestrictedType::VERIFIER_CHANGED, "$RESTRICTED", txids);
+        BOOST_CHECK_EQUAL(txids.size(), 1);
+        BOOST_CHECK(txids[0] == tx1.GetHash());
+
+        pool.removeRecursive(tx1);
+        BOOST_CHECK(pool.mapRestricted.empty());
+
+        // Records are carved out of the mempool's pool, and the nodes freed by a removal
+        // are handed out again instead of growing it
+        pool.addUnchecked(tx1.GetHash(), entry.FromTx(tx1));
+        for (int i = 0; i < 2000; i++)
+            pool.addRestrictedEntry(tx1.GetHash(), MempoolRestrictedType::ADDRESS_FROZEN, "$RESTRICTED", strprintf("address%d", i));
+        size_t nChunks = pool.m_restricted_memory_resource.NumAllocatedChunks();
+        BOOST_CHECK(nChunks > 1);
+        pool.removeRecursive(tx1);
+        pool.addUnchecked(tx1.GetHash(), entry.FromTx(tx1));
+        for (int i = 0; i < 2000; i++)
+            pool.addRestrictedEntry(tx1.GetHash(), MempoolRestrictedType::ADDRESS_FROZEN, "$RESTRICTED", strprintf("address%d", i));
+        BOOST_CHECK_EQUAL(pool.m_restricted_memory_resource.NumAllocatedChunks(), nChunks);
+    }
+
+    BOOST_AUTO_TEST_CASE(mempool_address_index_test)
+    {
+        CTxMemPool pool;
+        TestMemPoolEntryHelper entry;
+        CCoinsView coinsDummy;
+        CCoinsViewCache view(&coinsDummy);
+
+        uint160 hashBytes;
+        hashBytes.SetHex("01");
+        CScript script = CScript() << OP_DUP << OP_HASH160 << ToByteVector(hashBytes) << OP_EQUALVERIFY << OP_CHECKSIG;
+
+        // Three transactions paying the same address, the second one twice
+        std::vector<CMutableTransaction> vtx(3);
+        for (unsigned int i = 0; i < vtx.size(); i++) {
+            vtx[i].vin.resize(1);
+            vtx[i].vin[0].prevout = COutPoint(uint256S("02"), i);
+            vtx[i].vout.resize(i == 1 ? 2 : 1);
+            for (CTxOut& out : vtx[i].vout) {
+                out.scriptPubKey = script;
+                out.nValue = (i + 1) * COIN;
+            }
+            pool.addAddressIndex(entry.FromTx(vtx[i]), view);
+        }
+
+        std::vector<std::pair<uint160, int> > addresses(1, std::make_pair(hashBytes, 1));
+        std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > results;
+        pool.getAddressIndex(addresses, results);
+        BOOST_CHECK_EQUAL(results.size(), 4U);
+
+        // Taking out the middle transaction leaves the others in the order they came in
+        pool.removeAddressIndex(vtx[1].GetHash());
+        results.clear();
+        pool.getAddressIndex(addresses, AIDP, results);
+        BOOST_CHECK_EQUAL(results.size(), 2U);
+        BOOST_CHECK(results[0].first.txhash == vtx[0].GetHash());
+        BOOST_CHECK(results[1].first.txhash == vtx[2].GetHash());
+
+        pool.removeAddressIndex(vtx[0].GetHash());
+        pool.removeAddressIndex(vtx[2].GetHash());
+        results.clear();
+        pool.getAddressIndex(addresses, results);
+        BOOST_CHECK(results.empty());
+    }
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -658,4 +658,85 @@ BOOST_FIXTURE_TEST_SUITE(miner_tests, TestingSetup)
         fCheckpointsEnabled = true;
     }
 
+    BOOST_AUTO_TEST_CASE(blocktemplatemanager_test)
+    {
+        // Transactions are appended to the template as they enter the mempool, and the template
+        // is validated before it is handed out, so they spend coins put into the chainstate here.
+        // Time stands still, so the template is never outdated for long enough to be assembled
+        // again from this mempool.
+        CScript scriptPubKey = CScript() << OP_TRUE;
+        CBlockTemplateManager manager;
+        RegisterValidationInterface(&manager);
+        TestMemPoolEntryHelper entry;
+        LOCK(cs_main);
+        SetMockTime(GetTime());
+        pcoinsTip->AddCoin(COutPoint(uint256S("01"), 0), Coin(CTxOut(50 * COIN, scriptPubKey), 1, false), false);
+        pcoinsTip->AddCoin(COutPoint(uint256S("02"), 0), Coin(CTxOut(50 * COIN, scriptPubKey), 1, false), false);
+
+        unsigned int nTransactionsUpdated;
+        std::shared_ptr<const CBlockTemplate> pblocktemplate = manager.GetTemplate(scriptPubKey, true, nTransactionsUpdated);
+        BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 1U);
+        CAmount nCoinbaseValue = pblocktemplate->block.vtx[0]->vout[0].nValue;
+
+        // A new transaction goes at the end of the template, its fee to the miner
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(uint256S("01"), 0);
+        tx.vin[0].scriptSig = CScript() << OP_1;
+        tx.vout.resize(1);
+        tx.vout[0].nValue = 10 * COIN;
+        tx.vout[0].scriptPubKey = scriptPubKey;
+        CTransactionRef parent = MakeTransactionRef(tx);
+        mempool.addUnchecked(parent->GetHash(), entry.Fee(10000).FromTx(*parent));
+        GetMainSignals().TransactionAddedToMempool(parent);
+        std::shared_ptr<const CBlockTemplate> pblocktemplate2 = manager.GetTemplate(scriptPubKey, true, nTransactionsUpdated);
+        BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 1U);
+        BOOST_CHECK_EQUAL(pblocktemplate2->block.vtx.size(), 2U);
+        BOOST_CHECK(pblocktemplate2->block.vtx[1]->GetHash() == parent->GetHash());
+        BOOST_CHECK_EQUAL(pblocktemplate2->vTxFees[1], 10000);
+        BOOST_CHECK_EQUAL(pblocktemplate2->block.vtx[0]->vout[0].nValue, nCoinbaseValue + 10000);
+        BOOST_CHECK_EQUAL(nTransactionsUpdated, mempool.GetTransactionsUpdated());
+
+        // So does its child
+        tx.vin[0].prevout = COutPoint(parent->GetHash(), 0);
+        tx.vout[0].nValue = 9 * COIN;
+        CTransactionRef child = MakeTransactionRef(tx);
+        mempool.addUnchecked(child->GetHash(), entry.Fee(20000).FromTx(*child));
+        GetMainSignals().TransactionAddedToMempool(child);
+        pblocktemplate = manager.GetTemplate(scriptPubKey, true, nTransactionsUpdated);
+        BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 3U);
+        BOOST_CHECK(pblocktemplate->block.vtx[2]->GetHash() == child->GetHash());
+        BOOST_CHECK_EQUAL(pblocktemplate->block.vtx[0]->vout[0].nValue, nCoinbaseValue + 30000);
+
+        // One below the minimum fee rate leaves the template as it is
+        tx.vin[0].prevout = COutPoint(uint256S("02"), 0);
+        CTransactionRef freeTx = MakeTransactionRef(tx);
+        mempool.addUnchecked(freeTx->GetHash(), entry.Fee(0).FromTx(*freeTx));
+        GetMainSignals().TransactionAddedToMempool(freeTx);
+        pblocktemplate2 = manager.GetTemplate(scriptPubKey, true, nTransactionsUpdated);
+        BOOST_CHECK(pblocktemplate2 == pblocktemplate);
+
+        // A transaction the block cannot have is caught before the template is handed out. The
+        // template is assembled again, which takes the transaction out of the mempool.
+        tx.vin[0].prevout = COutPoint(uint256S("03"), 0);
+        CTransactionRef badTx = MakeTransactionRef(tx);
+        mempool.addUnchecked(badTx->GetHash(), entry.Fee(10000).FromTx(*badTx));
+        GetMainSignals().TransactionAddedToMempool(badTx);
+        BOOST_CHECK_THROW(manager.GetTemplate(scriptPubKey, true, nTransactionsUpdated), std::runtime_error);
+        BOOST_CHECK(!mempool.exists(badTx->GetHash()));
+        pblocktemplate = manager.GetTemplate(scriptPubKey, true, nTransactionsUpdated);
+        BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 3U);
+        BOOST_CHECK(pblocktemplate->block.vtx[2]->GetHash() == child->GetHash());
+
+        // Taking a transaction of the template out of the mempool means a new one
+        mempool.removeRecursive(*parent, MemPoolRemovalReason::CONFLICT);
+        pblocktemplate = manager.GetTemplate(scriptPubKey, true, nTransactionsUpdated);
+        BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 1U);
+        BOOST_CHECK_EQUAL(pblocktemplate->block.vtx[0]->vout[0].nValue, nCoinbaseValue);
+
+        mempool.clear();
+        SetMockTime(0);
+        UnregisterValidationInterface(&manager);
+    }
+
 BOOST_AUTO_TEST_SUITE_END()
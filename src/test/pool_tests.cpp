@@ -0,0 +1,166 @@
+// Copyright (c) 2022 The Bitcoin Core developers
+// Copyright (c) 2023-2024 The Aidp Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coins.h"
+#include "memusage.h"
+#include "primitives/block.h"
+#include "streams.h"
+#include "support/allocators/monotonic.h"
+#include "support/allocators/pool.h"
+#include "test/test_aidp.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(pool_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(pool_resource_reuses_freed_blocks)
+{
+    PoolResource<128, 8> resource(1024);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+    BOOST_CHECK_EQUAL(resource.ChunkSizeBytes(), 1024U);
+
+    // A freed block is handed out again for the next request of the same size.
+    void* block = resource.Allocate(24, 8);
+    resource.Deallocate(block, 24, 8);
+    BOOST_CHECK(resource.Allocate(24, 8) == block);
+
+    // Sizes rounding up to the same multiple of the alignment share a free list.
+    resource.Deallocate(block, 24, 8);
+    BOOST_CHECK(resource.Allocate(17, 8) == block);
+    resource.Deallocate(block, 17, 8);
+
+    // Different sizes never share blocks.
+    void* other = resource.Allocate(32, 8);
+    BOOST_CHECK(other != block);
+    resource.Deallocate(other, 32, 8);
+}
+
+BOOST_AUTO_TEST_CASE(pool_resource_chunks)
+{
+    PoolResource<128, 8> resource(1024);
+
+    // 1024 / 128 blocks fill the first chunk exactly.
+    std::vector<void*> blocks;
+    for (int i = 0; i < 8; i++) {
+        blocks.push_back(resource.Allocate(128, 8));
+    }
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+    blocks.push_back(resource.Allocate(128, 8));
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 2U);
+
+    // Oversized requests bypass the pool.
+    void* big = resource.Allocate(4096, 8);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 2U);
+    resource.Deallocate(big, 4096, 8);
+
+    for (void* p : blocks) {
+        resource.Deallocate(p, 128, 8);
+    }
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(pool_allocator_unordered_map)
+{
+    typedef std::unordered_map<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>,
+                               PoolAllocator<std::pair<const uint64_t, uint64_t>, sizeof(std::pair<const uint64_t, uint64_t>) + sizeof(void*) * 4>> Map;
+
+    Map::allocator_type::ResourceType resource;
+    {
+        Map map{0, Map::hasher{}, Map::key_equal{}, &resource};
+        for (uint64_t i = 0; i < 10000; i++) {
+            map[i] = i * 2;
+        }
+        for (uint64_t i = 0; i < 10000; i += 2) {
+            map.erase(i);
+        }
+        BOOST_CHECK_EQUAL(map.size(), 5000U);
+        for (uint64_t i = 1; i < 10000; i += 2) {
+            BOOST_CHECK_EQUAL(map.at(i), i * 2);
+        }
+
+        // Re-inserting the erased keys reuses the freed nodes without new chunks.
+        size_t chunks = resource.NumAllocatedChunks();
+        for (uint64_t i = 0; i < 10000; i += 2) {
+            map[i] = i;
+        }
+        BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), chunks);
+
+        // Usage accounts for every chunk plus the bucket array.
+        BOOST_CHECK(memusage::DynamicUsage(map) >= resource.NumAllocatedChunks() * resource.ChunkSizeBytes());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(monotonic_resource_chunks)
+{
+    std::shared_ptr<MonotonicResource> resource = std::make_shared<MonotonicResource>(1024);
+    BOOST_CHECK_EQUAL(resource->NumAllocatedChunks(), 0U);
+
+    // Allocations are packed into one chunk, each properly aligned.
+    MonotonicAllocator<uint64_t> alloc(resource);
+    uint64_t* a = alloc.allocate(1);
+    char* b = MonotonicAllocator<char>(alloc).allocate(3);
+    uint64_t* c = alloc.allocate(2);
+    BOOST_CHECK_EQUAL(resource->NumAllocatedChunks(), 1U);
+    BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(c) % alignof(uint64_t), 0U);
+    BOOST_CHECK((char*)b >= (char*)(a + 1) && (char*)c >= b + 3);
+    BOOST_CHECK_EQUAL(resource->AllocatedBytes(), 8U * 3 + 3);
+
+    // Large requests get a chunk of their own, and filling the current chunk starts a new one.
+    alloc.allocate(1000 / sizeof(uint64_t));
+    BOOST_CHECK_EQUAL(resource->NumAllocatedChunks(), 2U);
+    for (int i = 0; i < 40; i++) {
+        alloc.allocate(200 / sizeof(uint64_t));
+    }
+    BOOST_CHECK(resource->NumAllocatedChunks() > 2U);
+    BOOST_CHECK(alloc == MonotonicAllocator<char>(resource));
+}
+
+BOOST_AUTO_TEST_CASE(block_arena_deserialize)
+{
+    CBlock block;
+    block.nTime = 1234;
+    for (int i = 0; i < 50; i++) {
+        CMutableTransaction mtx;
+        mtx.vin.resize(i % 3 + 1);
+        mtx.vin[0].prevout = COutPoint(uint256S("01"), i);
+        mtx.vin[0].scriptSig = CScript() << std::vector<unsigned char>(40 + i, i);
+        mtx.vout.resize(2);
+        mtx.vout[0].nValue = i;
+        if (i % 2)
+            mtx.vin[0].scriptWitness.stack.push_back(std::vector<unsigned char>(i, 1));
+        block.vtx.push_back(MakeTransactionRef(std::move(mtx)));
+    }
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << block;
+    CDataStream ss2(ss);
+
+    CBlock blockHeap, blockArena;
+    ss >> blockHeap;
+    UnserializeBlockInArena(ss2, blockArena);
+    BOOST_CHECK(ss2.empty());
+    BOOST_CHECK(blockArena.GetHash() == block.GetHash());
+    BOOST_REQUIRE_EQUAL(blockArena.vtx.size(), block.vtx.size());
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        BOOST_CHECK(blockArena.vtx[i]->GetWitnessHash() == block.vtx[i]->GetWitnessHash());
+    }
+
+    // A transaction keeps the arena alive after the block is gone.
+    CTransactionRef tx = blockArena.vtx[7];
+    blockArena.SetNull();
+    BOOST_CHECK(tx->GetHash() == blockHeap.vtx[7]->GetHash());
+
+    // A truncated block throws instead of reading past the end.
+    CDataStream ss3(SER_NETWORK, PROTOCOL_VERSION);
+    ss3 << block;
+    ss3.resize(ss3.size() - 10);
+    BOOST_CHECK_THROW(UnserializeBlockInArena(ss3, blockArena), std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,104 @@
+// Copyright (c) 2023-2024 The Aidp Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "fs.h"
+#include "hash.h"
+#include "util.h"
+#include "validation.h"
+#include "script/sigcache.h"
+#include "test/test_aidp.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(sigcache_tests, TestingSetup)
+
+static std::vector<unsigned char> ReadFile(const fs::path& path)
+{
+    std::vector<unsigned char> vch(fs::file_size(path));
+    FILE* file = fsbridge::fopen(path, "rb");
+    BOOST_REQUIRE(file != nullptr);
+    BOOST_REQUIRE_EQUAL(fread(vch.data(), 1, vch.size(), file), vch.size());
+    fclose(file);
+    return vch;
+}
+
+static void WriteFile(const fs::path& path, const std::vector<unsigned char>& vch)
+{
+    FILE* file = fsbridge::fopen(path, "wb");
+    BOOST_REQUIRE(file != nullptr);
+    BOOST_REQUIRE_EQUAL(fwrite(vch.data(), 1, vch.size(), file), vch.size());
+    fclose(file);
+}
+
+static bool HaveEntries(const uint256& nonceExpected, const std::vector<uint256>& vExpected)
+{
+    uint256 nonce;
+    std::vector<uint256> entries;
+    GetSignatureCacheEntries(nonce, entries);
+    if (nonce != nonceExpected)
+        return false;
+    for (const uint256& entry : vExpected) {
+        if (std::find(entries.begin(), entries.end(), entry) == entries.end())
+            return false;
+    }
+    return true;
+}
+
+BOOST_AUTO_TEST_CASE(sigcache_dump_load)
+{
+    const fs::path pathCache = GetDataDir() / "sigcache.dat";
+    const fs::path pathKey = GetDataDir() / "sigcache.key";
+    const uint256 nonce = InsecureRand256();
+    const std::vector<uint256> vEntries{InsecureRand256(), InsecureRand256()};
+
+    LoadSignatureCacheEntries(nonce, vEntries);
+    BOOST_CHECK(DumpSignatureCaches());
+    BOOST_CHECK(fs::exists(pathKey));
+
+    // Empty the caches, then get the entries back from disk.
+    InitSignatureCache();
+    InitScriptExecutionCache();
+    uint256 nonceEmpty;
+    std::vector<uint256> vEmpty;
+    GetSignatureCacheEntries(nonceEmpty, vEmpty);
+    BOOST_CHECK(vEmpty.empty());
+    BOOST_CHECK(LoadSignatureCaches());
+    BOOST_CHECK(HaveEntries(nonce, vEntries));
+
+    // The key is kept across dumps.
+    std::vector<unsigned char> vchKey = ReadFile(pathKey);
+    BOOST_CHECK(DumpSignatureCaches());
+    BOOST_CHECK(ReadFile(pathKey) == vchKey);
+
+    // A file with a changed entry (the first one starts at byte 52) fails to load, even with
+    // its plain hash recomputed.
+    std::vector<unsigned char> vchCache = ReadFile(pathCache);
+    BOOST_REQUIRE(vchCache.size() > 64);
+    std::vector<unsigned char> vchForged(vchCache.begin(), vchCache.end() - 32);
+    vchForged[60] ^= 1;
+    uint256 hash = Hash(vchForged.begin(), vchForged.end());
+    vchForged.insert(vchForged.end(), hash.begin(), hash.end());
+    WriteFile(pathCache, vchForged);
+    InitSignatureCache();
+    BOOST_CHECK(!LoadSignatureCaches());
+
+    // So does the original file under another key, or without one.
+    WriteFile(pathCache, vchCache);
+    BOOST_CHECK(LoadSignatureCaches());
+    std::vector<unsigned char> vchOtherKey(vchKey);
+    vchOtherKey[0] ^= 1;
+    WriteFile(pathKey, vchOtherKey);
+    BOOST_CHECK(!LoadSignatureCaches());
+    fs::remove(pathKey);
+    BOOST_CHECK(!LoadSignatureCaches());
+
+    InitSignatureCache();
+    InitScriptExecutionCache();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -75,6 +75,35 @@ BOOST_FIXTURE_TEST_SUITE(streams_tests, BasicTestingSetup)
         vch.clear();
     }
 
+    BOOST_AUTO_TEST_CASE(streams_span_reader)
+    {
+        std::vector<unsigned char> vch = {1, 255, 3, 4, 5, 6};
+        CSpanReader reader(SER_NETWORK, INIT_PROTO_VERSION, vch.data(), vch.data() + vch.size());
+        BOOST_CHECK_EQUAL(reader.size(), 6U);
+
+        unsigned char a(0);
+        unsigned char b(0);
+        reader >> a >> b;
+        BOOST_CHECK_EQUAL(a, 1);
+        BOOST_CHECK_EQUAL(b, 255);
+        BOOST_CHECK_EQUAL(reader.size(), 4U);
+
+        reader.ignore(1);
+        BOOST_CHECK(reader.data() == vch.data() + 3);
+
+        uint16_t c(0);
+        reader >> c;
+        BOOST_CHECK_EQUAL(c, 0x0504);
+        BOOST_CHECK_EQUAL(reader.size(), 1U);
+
+        // Reading past the end throws and leaves the rest untouched
+        BOOST_CHECK_THROW(reader >> c, std::ios_base::failure);
+        BOOST_CHECK_THROW(reader.ignore(2), std::ios_base::failure);
+        reader >> a;
+        BOOST_CHECK_EQUAL(a, 6);
+        BOOST_CHECK_EQUAL(reader.size(), 0U);
+    }
+
     BOOST_AUTO_TEST_CASE(streams_serializedata_xor_test)
     {
         BOOST_TEST_MESSAGE("Running Streams SerializeData Xor Test");
@@ -0,0 +1,127 @@
+// Copyright (c) 2023-2024 The Aidp Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "txdb.h"
+
+#include "addressindex.h"
+#include "spentindex.h"
+#include "test/test_aidp.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(txdb_tests, BasicTestingSetup)
+
+static uint256 TxHash(int nHeight, int nTxIndex)
+{
+    uint256 hash;
+    *(uint32_t*)hash.begin() = nHeight;
+    *(uint32_t*)(hash.begin() + 4) = nTxIndex;
+    return hash;
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_compact_roundtrip)
+{
+    CBlockTreeDB db(1 << 20, true);
+    uint160 hashAddress;
+    hashAddress.SetHex("0123456789abcdef0123456789abcdef01234567");
+
+    // Heights around the sizes of the key number encoding, to check that they sort in order
+    std::vector<int> vHeights = {1, 127, 128, 16383, 16384, 2097151, 2097152, 268435456};
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vEntries;
+    for (int nHeight : vHeights) {
+        vEntries.push_back(std::make_pair(CAddressIndexKey(1, hashAddress, AIDP, nHeight, 2, TxHash(nHeight, 2), 0, false), 5 * COIN));
+        vEntries.push_back(std::make_pair(CAddressIndexKey(1, hashAddress, AIDP, nHeight, 300, TxHash(nHeight, 300), 200, true), -3 * COIN));
+        vEntries.push_back(std::make_pair(CAddressIndexKey(1, hashAddress, "ASSET", nHeight, 3, TxHash(nHeight, 3), 1, false), 7));
+    }
+    CDBBatch batch(db);
+    db.WriteAddressIndex(batch, vEntries);
+    BOOST_CHECK(db.WriteBatch(batch));
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vRead;
+    BOOST_CHECK(db.ReadAddressIndex(hashAddress, 1, AIDP, vRead));
+    BOOST_CHECK_EQUAL(vRead.size(), 2 * vHeights.size());
+    for (size_t i = 0; i < vRead.size(); i++) {
+        const std::pair<CAddressIndexKey, CAmount>& expected = vEntries[3 * (i / 2) + i % 2];
+        BOOST_CHECK(vRead[i].first == expected.first);
+        BOOST_CHECK_EQUAL(vRead[i].second, expected.second);
+    }
+
+    // Height ranges, pages and all assets
+    vRead.clear();
+    BOOST_CHECK(db.ReadAddressIndex(hashAddress, 1, "ASSET", vRead, 128, 2097151));
+    BOOST_CHECK_EQUAL(vRead.size(), 4U);
+    BOOST_CHECK_EQUAL(vRead.front().first.blockHeight, 128);
+    BOOST_CHECK_EQUAL(vRead.back().first.blockHeight, 2097151);
+    vRead.clear();
+    BOOST_CHECK(db.ReadAddressIndex(hashAddress, 1, vRead, 16384, 0, 3));
+    BOOST_CHECK_EQUAL(vRead.size(), 3U);
+    CAddressIndexKey after = vRead.back().first;
+    vRead.clear();
+    BOOST_CHECK(db.ReadAddressIndex(hashAddress, 1, vRead, 16384, 0, 0, &after));
+    BOOST_CHECK_EQUAL(vRead.size(), 9U);
+    BOOST_CHECK_EQUAL(vRead.back().first.asset, "ASSET");
+    vRead.clear();
+    BOOST_CHECK(db.ReadAddressIndex(hashAddress, 2, vRead));
+    BOOST_CHECK(vRead.empty());
+
+    CAddressBalanceValue balance;
+    BOOST_CHECK(db.ReadAddressBalance(hashAddress, 1, AIDP, balance));
+    BOOST_CHECK_EQUAL(balance.balance, 2 * COIN * (CAmount)vHeights.size());
+    BOOST_CHECK_EQUAL(balance.txCount, 2 * (int64_t)vHeights.size());
+
+    batch.Clear();
+    db.EraseAddressIndex(batch, vEntries);
+    BOOST_CHECK(db.WriteBatch(batch));
+    vRead.clear();
+    BOOST_CHECK(db.ReadAddressIndex(hashAddress, 1, vRead));
+    BOOST_CHECK(vRead.empty());
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_compact_upgrade)
+{
+    CBlockTreeDB db(1 << 20, true);
+    uint160 hashAddress;
+    hashAddress.SetHex("00112233445566778899aabbccddeeff00112233");
+
+    // Entries as the format before the compact one stored them
+    CAddressIndexKey key(2, hashAddress, "ASSET", 1000, 4, TxHash(1000, 4), 1, true);
+    CAddressUnspentKey unspentKey(2, hashAddress, "ASSET", TxHash(900, 1), 0);
+    CAddressUnspentValue unspentValue(42, CScript() << OP_TRUE, 900);
+    CSpentIndexKey spentKey(TxHash(900, 1), 0);
+    CSpentIndexValue spentValue(TxHash(1000, 4), 1, 1000, 42, 2, hashAddress);
+    BOOST_CHECK(db.Write(std::make_pair('a', key), (CAmount)-42));
+    BOOST_CHECK(db.Write(std::make_pair('u', unspentKey), unspentValue));
+    BOOST_CHECK(db.Write(std::make_pair('p', spentKey), spentValue));
+
+    BOOST_CHECK(db.UpgradeAddressIndex());
+    BOOST_CHECK(db.UpgradeSpentIndex());
+    BOOST_CHECK(!db.Exists(std::make_pair('a', key)));
+    BOOST_CHECK(!db.Exists(std::make_pair('u', unspentKey)));
+    BOOST_CHECK(!db.Exists(std::make_pair('p', spentKey)));
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vRead;
+    BOOST_CHECK(db.ReadAddressIndex(hashAddress, 2, "ASSET", vRead));
+    BOOST_CHECK_EQUAL(vRead.size(), 1U);
+    BOOST_CHECK(vRead[0].first == key);
+    BOOST_CHECK_EQUAL(vRead[0].second, -42);
+
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vUnspent;
+    BOOST_CHECK(db.ReadAddressUnspentIndex(hashAddress, 2, vUnspent));
+    BOOST_CHECK_EQUAL(vUnspent.size(), 1U);
+    BOOST_CHECK(vUnspent[0].first == unspentKey);
+    BOOST_CHECK_EQUAL(vUnspent[0].second.satoshis, 42);
+    BOOST_CHECK(vUnspent[0].second.script == unspentValue.script);
+    BOOST_CHECK_EQUAL(vUnspent[0].second.blockHeight, 900);
+
+    CSpentIndexValue spentRead;
+    BOOST_CHECK(db.ReadSpentIndex(spentKey, spentRead));
+    BOOST_CHECK(spentRead.txid == spentValue.txid);
+    BOOST_CHECK_EQUAL(spentRead.inputIndex, 1U);
+    BOOST_CHECK_EQUAL(spentRead.blockHeight, 1000);
+    BOOST_CHECK_EQUAL(spentRead.satoshis, 42);
+    BOOST_CHECK_EQUAL(spentRead.addressType, 2);
+    BOOST_CHECK(spentRead.addressHash == hashAddress);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
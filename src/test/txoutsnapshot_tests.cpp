@@ -0,0 +1,126 @@
+// Copyright (c) 2023-2024 The Aidp Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "txoutsnapshot.h"
+
+#include "chainparams.h"
+#include "coins.h"
+#include "fs.h"
+#include "script/script.h"
+#include "util.h"
+#include "validation.h"
+#include "assets/assetdb.h"
+#include "assets/assets.h"
+#include "assets/restricteddb.h"
+#include "test/test_aidp.h"
+
+#include <stdio.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(txoutsnapshot_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(txoutsnapshot_dump_load)
+{
+    // The fixture keeps its coin database in a member, the snapshot code uses the global
+    ::pcoinsdbview = pcoinsdbview;
+    passetsdb = new CAssetsDB(1 << 20, true);
+    prestricteddb = new CRestrictedDB(1 << 20, true);
+    passetsCache = new CLRUCache<std::string, CDatabasedAssetData>(MAX_CACHE_ASSETS_SIZE);
+    passetsVerifierCache = new CLRUCache<std::string, CNullAssetTxVerifierString>(MAX_CACHE_ASSETS_SIZE);
+    passetsQualifierCache = new CLRUCache<std::string, int8_t>(MAX_CACHE_ASSETS_SIZE);
+    passetsRestrictionCache = new CLRUCache<std::string, int8_t>(MAX_CACHE_ASSETS_SIZE);
+    passetsGlobalRestrictionCache = new CLRUCache<std::string, int8_t>(MAX_CACHE_ASSETS_SIZE);
+
+    // A chainstate at the genesis block, more coins than fit in one chunk of the file
+    const uint256 hashGenesis = chainActive.Genesis()->GetBlockHash();
+    std::vector<COutPoint> vOutpoints;
+    for (int i = 0; i < 5000; i++) {
+        COutPoint outpoint(InsecureRand256(), i % 3);
+        Coin coin(CTxOut(1000 + i, CScript() << OP_TRUE), 0, false);
+        pcoinsTip->AddCoin(outpoint, std::move(coin), false);
+        vOutpoints.push_back(outpoint);
+    }
+    BOOST_CHECK(prestricteddb->WriteGlobalRestriction("$RESTRICTED"));
+    FlushStateToDisk();
+
+    fs::path path = GetDataDir() / "utxo.dat";
+    CTxOutSnapshotMetadata metadata;
+    CTxOutSnapshotHashes hashes;
+    std::string strError;
+    BOOST_CHECK(DumpTxOutSnapshot(path, metadata, hashes, strError));
+    BOOST_CHECK_EQUAL(metadata.nHeight, 0);
+    BOOST_CHECK(metadata.hashBase == hashGenesis);
+    BOOST_CHECK_EQUAL(hashes.nCoins, vOutpoints.size());
+    BOOST_CHECK_EQUAL(hashes.nAssetRecords, 1U);
+
+    CTxOutSnapshotMetadata metadataRead;
+    CTxOutSnapshotHashes hashesRead;
+    BOOST_CHECK(VerifyTxOutSnapshot(path, metadataRead, hashesRead, strError));
+    BOOST_CHECK(metadataRead.hashBase == metadata.hashBase);
+    BOOST_CHECK_EQUAL(hashesRead.nCoins, hashes.nCoins);
+    BOOST_CHECK(hashesRead.GetSnapshotHash() == hashes.GetSnapshotHash());
+
+    // The blocks below the base are never downloaded, so only a pruned node loads a snapshot.
+    BOOST_CHECK(!LoadTxOutSnapshot(GetParams(), path, hashes.GetSnapshotHash(), metadataRead, hashesRead, strError));
+    BOOST_CHECK(strError.find("-prune") != std::string::npos);
+
+    // A chainstate that already has coins is never overwritten.
+    fPruneMode = true;
+    BOOST_CHECK(!LoadTxOutSnapshot(GetParams(), path, hashes.GetSnapshotHash(), metadataRead, hashesRead, strError));
+    BOOST_CHECK(strError.find("not empty") != std::string::npos);
+
+    // Empty the chainstate, keeping the genesis block as its tip.
+    for (const COutPoint& outpoint : vOutpoints)
+        pcoinsTip->SpendCoin(outpoint);
+    BOOST_CHECK(prestricteddb->EraseGlobalRestriction("$RESTRICTED"));
+    FlushStateToDisk();
+    BOOST_CHECK(pcoinsdbview->IsEmpty());
+
+    // A snapshot other than the expected one is refused before anything is written.
+    BOOST_CHECK(!LoadTxOutSnapshot(GetParams(), path, InsecureRand256(), metadataRead, hashesRead, strError));
+    BOOST_CHECK(strError.find("does not match") != std::string::npos);
+    BOOST_CHECK(pcoinsdbview->IsEmpty());
+
+    BOOST_CHECK(LoadTxOutSnapshot(GetParams(), path, hashes.GetSnapshotHash(), metadataRead, hashesRead, strError));
+    BOOST_CHECK_EQUAL(hashesRead.nCoins, hashes.nCoins);
+    BOOST_CHECK(pcoinsdbview->GetBestBlock() == hashGenesis);
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == hashGenesis);
+    for (size_t i = 0; i < vOutpoints.size(); i++) {
+        Coin coin;
+        BOOST_CHECK(pcoinsdbview->GetCoin(vOutpoints[i], coin));
+        BOOST_CHECK_EQUAL(coin.out.nValue, (CAmount)(1000 + i));
+    }
+    BOOST_CHECK(prestricteddb->ReadGlobalRestriction("$RESTRICTED"));
+    fPruneMode = false;
+    fHavePruned = false;
+
+    // Any corruption is caught by the checksum.
+    FILE* file = fsbridge::fopen(path, "rb+");
+    BOOST_CHECK(file != nullptr);
+    fseek(file, 200, SEEK_SET);
+    int ch = fgetc(file);
+    fseek(file, 200, SEEK_SET);
+    fputc(ch ^ 1, file);
+    fclose(file);
+    BOOST_CHECK(!VerifyTxOutSnapshot(path, metadataRead, hashesRead, strError));
+
+    delete passetsGlobalRestrictionCache;
+    passetsGlobalRestrictionCache = nullptr;
+    delete passetsRestrictionCache;
+    passetsRestrictionCache = nullptr;
+    delete passetsQualifierCache;
+    passetsQualifierCache = nullptr;
+    delete passetsVerifierCache;
+    passetsVerifierCache = nullptr;
+    delete passetsCache;
+    passetsCache = nullptr;
+    delete prestricteddb;
+    prestricteddb = nullptr;
+    delete passetsdb;
+    passetsdb = nullptr;
+    ::pcoinsdbview = nullptr;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -16,19 +16,34 @@
 #include "ui_interface.h"
 #include "init.h"
 #include "validation.h"
+#include "compressor.h"
 
 #include <stdint.h>
 
+#include <functional>
+#include <limits>
+#include <set>
+#include <tuple>
+
 #include <boost/thread.hpp>
 
-static const char DB_COIN = 'C';
+static const char DB_COIN = 'D';
+static const char DB_COIN_UNCOMPRESSED_ASSETS = 'C';
 static const char DB_COINS = 'c';
 static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
-static const char DB_ADDRESSINDEX = 'a';
-static const char DB_ADDRESSUNSPENTINDEX = 'u';
 static const char DB_TIMESTAMPINDEX = 's';
 static const char DB_BLOCKHASHINDEX = 'z';
+static const char DB_ADDRESSBALANCE = 'A';
+static const char DB_INDEX_BEST_BLOCK = 'I';
+static const char DB_ADDRESSINDEX_COMPACT = 'x';
+static const char DB_ADDRESSUNSPENTINDEX_COMPACT = 'w';
+static const char DB_SPENTINDEX_COMPACT = 'q';
+static const char DB_INDEX_TXPOS = 'y';
+static const char DB_INDEX_ASSET = 'n';
+// Index entries in the format before the compact one, upgraded by UpgradeAddressIndex and UpgradeSpentIndex
+static const char DB_ADDRESSINDEX = 'a';
+static const char DB_ADDRESSUNSPENTINDEX = 'u';
 static const char DB_SPENTINDEX = 'p';
 static const char DB_BLOCK_INDEX = 'b';
 
@@ -43,7 +58,7 @@ namespace {
 struct CoinEntry {
     COutPoint* outpoint;
     char key;
-    explicit CoinEntry(const COutPoint* ptr) : outpoint(const_cast<COutPoint*>(ptr)), key(DB_COIN)  {}
+    explicit CoinEntry(const COutPoint* ptr, char keyIn = DB_COIN) : outpoint(const_cast<COutPoint*>(ptr)), key(keyIn)  {}
 
     template<typename Stream>
     void Serialize(Stream &s) const {
@@ -60,6 +75,30 @@ struct CoinEntry {
     }
 };
 
+/** Chainstate encoding of a Coin. The same as Coin's own, but with asset scripts compressed too. */
+struct CoinValue {
+    Coin* coin;
+    explicit CoinValue(const Coin* ptr) : coin(const_cast<Coin*>(ptr)) {}
+
+    template<typename Stream>
+    void Serialize(Stream &s) const {
+        assert(!coin->IsSpent());
+        uint32_t code = coin->nHeight * 2 + coin->fCoinBase;
+        s << VARINT(code);
+        s << CTxOutCompressor(coin->out, true);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        uint32_t code = 0;
+        s >> VARINT(code);
+        coin->nHeight = code >> 1;
+        coin->fCoinBase = code & 1;
+        CTxOutCompressor compressor(coin->out, true);
+        s >> compressor;
+    }
+};
+
 }
 
 CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true, 2 << 20)
@@ -67,7 +106,8 @@ CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(Get
 }
 
 bool CCoinsViewDB::GetCoin(const COutPoint &outpoint, Coin &coin) const {
-    return db.Read(CoinEntry(&outpoint), coin);
+    CoinValue value(&coin);
+    return db.Read(CoinEntry(&outpoint), value);
 }
 
 bool CCoinsViewDB::HaveCoin(const COutPoint &outpoint) const {
@@ -90,6 +130,14 @@ std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
 }
 
 bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    return WriteCoins(mapCoins, hashBlock, true);
+}
+
+bool CCoinsViewDB::WriteSnapshot(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    return WriteCoins(mapCoins, hashBlock, false);
+}
+
+bool CCoinsViewDB::WriteCoins(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fEraseWritten) {
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
@@ -97,22 +145,12 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     int crash_simulate = gArgs.GetArg("-dbcrashratio", 0);
     assert(!hashBlock.IsNull());
 
-    uint256 old_tip = GetBestBlock();
-    if (old_tip.IsNull()) {
-        // We may be in the middle of replaying.
-        std::vector<uint256> old_heads = GetHeadBlocks();
-        if (old_heads.size() == 2) {
-            assert(old_heads[0] == hashBlock);
-            old_tip = old_heads[1];
-        }
-    }
-
     // In the first batch, mark the database as being in the middle of a
     // transition from old_tip to hashBlock.
     // A vector is used for future extensibility, as we may want to support
     // interrupting after partial writes from multiple independent reorgs.
     batch.Erase(DB_BEST_BLOCK);
-    batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, old_tip});
+    batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, GetTransitionBase(hashBlock)});
 
     for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
@@ -120,12 +158,13 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
             if (it->second.coin.IsSpent())
                 batch.Erase(entry);
             else
-                batch.Write(entry, it->second.coin);
+                batch.Write(entry, CoinValue(&it->second.coin));
             changed++;
         }
         count++;
         CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
+        if (fEraseWritten)
+            mapCoins.erase(itOld);
         if (batch.SizeEstimate() > batch_size) {
             LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
             db.WriteBatch(batch);
@@ -150,11 +189,227 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     return ret;
 }
 
+uint256 CCoinsViewDB::GetTransitionBase(const uint256 &hashBlock) const {
+    uint256 old_tip = GetBestBlock();
+    if (old_tip.IsNull()) {
+        // We may be in the middle of replaying.
+        std::vector<uint256> old_heads = GetHeadBlocks();
+        if (old_heads.size() == 2) {
+            assert(old_heads[0] == hashBlock);
+            old_tip = old_heads[1];
+        }
+    }
+    return old_tip;
+}
+
+bool CCoinsViewDB::StartWrite(const uint256 &hashBlock) {
+    assert(!hashBlock.IsNull());
+    CDBBatch batch(db);
+    batch.Erase(DB_BEST_BLOCK);
+    batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, GetTransitionBase(hashBlock)});
+    return db.WriteBatch(batch, true);
+}
+
+bool CCoinsViewDB::IsEmpty() const {
+    std::unique_ptr<CDBIterator> pcursor(const_cast<CDBWrapper&>(db).NewIterator());
+    pcursor->Seek(DB_COIN);
+    COutPoint outpoint;
+    CoinEntry entry(&outpoint);
+    return !(pcursor->Valid() && pcursor->GetKey(entry) && entry.key == DB_COIN);
+}
+
+bool CCoinsViewDB::StartBulkLoad(const uint256 &hashBlock) {
+    CDBBatch batch(db);
+    batch.Erase(DB_BEST_BLOCK);
+    batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, uint256()});
+    return db.WriteBatch(batch, true);
+}
+
+bool CCoinsViewDB::BulkLoadCoins(const std::vector<std::pair<COutPoint, Coin> > &coins) {
+    CDBBatch batch(db);
+    for (const auto& coin : coins) {
+        if (!coin.second.IsSpent())
+            batch.Write(CoinEntry(&coin.first), CoinValue(&coin.second));
+    }
+    return db.WriteBatch(batch);
+}
+
+bool CCoinsViewDB::FinishBulkLoad(const uint256 &hashBlock) {
+    CDBBatch batch(db);
+    batch.Erase(DB_HEAD_BLOCKS);
+    batch.Write(DB_BEST_BLOCK, hashBlock);
+    return db.WriteBatch(batch, true);
+}
+
 size_t CCoinsViewDB::EstimateSize() const
 {
     return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
 }
 
+CCoinsViewBackgroundFlush::CCoinsViewBackgroundFlush(CCoinsViewDB *dbIn) : CCoinsViewBacked(dbIn), db(dbIn),
+    fWriting(false), fWriteFailed(false), fStop(false), fTakeSnapshot(false)
+{
+    threadWriter = std::thread(&TraceThread<std::function<void()> >, "coinsflush",
+        std::function<void()>(std::bind(&CCoinsViewBackgroundFlush::ThreadWrite, this)));
+}
+
+CCoinsViewBackgroundFlush::~CCoinsViewBackgroundFlush()
+{
+    {
+        std::lock_guard<std::mutex> lock(cs_snapshot);
+        fStop = true;
+    }
+    condSnapshot.notify_all();
+    // The writer finishes the snapshot in flight before it exits.
+    if (threadWriter.joinable())
+        threadWriter.join();
+}
+
+bool CCoinsViewBackgroundFlush::GetCoin(const COutPoint &outpoint, Coin &coin) const
+{
+    {
+        std::lock_guard<std::mutex> lock(cs_snapshot);
+        if (snapshot) {
+            CCoinsMap::const_iterator it = snapshot->mapCoins.find(outpoint);
+            if (it != snapshot->mapCoins.end()) {
+                coin = it->second.coin;
+                return !coin.IsSpent();
+            }
+        }
+    }
+    // Entries missing from the snapshot are not touched by the writer, so the database is current for them.
+    return base->GetCoin(outpoint, coin);
+}
+
+bool CCoinsViewBackgroundFlush::HaveCoin(const COutPoint &outpoint) const
+{
+    {
+        std::lock_guard<std::mutex> lock(cs_snapshot);
+        if (snapshot) {
+            CCoinsMap::const_iterator it = snapshot->mapCoins.find(outpoint);
+            if (it != snapshot->mapCoins.end())
+                return !it->second.coin.IsSpent();
+        }
+    }
+    return base->HaveCoin(outpoint);
+}
+
+uint256 CCoinsViewBackgroundFlush::GetBestBlock() const
+{
+    {
+        std::lock_guard<std::mutex> lock(cs_snapshot);
+        if (snapshot)
+            return snapshot->hashBlock;
+    }
+    return base->GetBestBlock();
+}
+
+CCoinsViewCursor *CCoinsViewBackgroundFlush::Cursor() const
+{
+    // A database cursor only makes sense once the snapshot is on disk.
+    std::unique_lock<std::mutex> lock(cs_snapshot);
+    WaitForIdle(lock);
+    return base->Cursor();
+}
+
+void CCoinsViewBackgroundFlush::WaitForIdle(std::unique_lock<std::mutex> &lock) const
+{
+    condSnapshot.wait(lock, [this] { return !fWriting; });
+}
+
+bool CCoinsViewBackgroundFlush::WaitForIdle()
+{
+    std::unique_lock<std::mutex> lock(cs_snapshot);
+    WaitForIdle(lock);
+    return !fWriteFailed;
+}
+
+bool CCoinsViewBackgroundFlush::FlushInBackground(CCoinsViewCache &cache)
+{
+    fTakeSnapshot = true;
+    bool fOk = cache.Flush();
+    fTakeSnapshot = false;
+    return fOk;
+}
+
+bool CCoinsViewBackgroundFlush::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock)
+{
+    {
+        std::unique_lock<std::mutex> lock(cs_snapshot);
+        WaitForIdle(lock);
+        if (fWriteFailed)
+            return false;
+    }
+
+    if (!fTakeSnapshot)
+        return db->BatchWrite(mapCoins, hashBlock);
+
+    assert(!hashBlock.IsNull());
+    // The caller flushes the asset state at hashBlock as soon as this returns, so the coin
+    // database has to be marked as moving there before anything else reaches disk.
+    if (!db->StartWrite(hashBlock))
+        return false;
+
+    int64_t nStart = GetTimeMicros();
+    std::unique_ptr<Snapshot> next(new Snapshot());
+    next->hashBlock = hashBlock;
+    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end(); ++it) {
+        if (!(it->second.flags & CCoinsCacheEntry::DIRTY))
+            continue;
+        // Nothing is in flight, so a fresh spent coin is in neither the snapshot nor the database.
+        if ((it->second.flags & CCoinsCacheEntry::FRESH) && it->second.coin.IsSpent())
+            continue;
+        CCoinsCacheEntry entry(std::move(it->second.coin));
+        entry.flags = CCoinsCacheEntry::DIRTY;
+        next->mapCoins.emplace(it->first, std::move(entry));
+    }
+    mapCoins.clear();
+    LogPrint(BCLog::COINDB, "Handed %u changed transaction outputs to the background writer in %.2fms\n",
+        (unsigned int)next->mapCoins.size(), (GetTimeMicros() - nStart) * 0.001);
+
+    {
+        std::lock_guard<std::mutex> lock(cs_snapshot);
+        snapshot = std::move(next);
+        fWriting = true;
+    }
+    condSnapshot.notify_all();
+    return true;
+}
+
+void CCoinsViewBackgroundFlush::ThreadWrite()
+{
+    std::unique_lock<std::mutex> lock(cs_snapshot);
+    while (true) {
+        condSnapshot.wait(lock, [this] { return fStop || fWriting; });
+        if (!fWriting)
+            return;
+
+        Snapshot *pending = snapshot.get();
+        lock.unlock();
+
+        int64_t nStart = GetTimeMicros();
+        bool fOk = false;
+        try {
+            fOk = db->WriteSnapshot(pending->mapCoins, pending->hashBlock);
+        } catch (const std::exception& e) {
+            LogPrintf("%s: %s\n", __func__, e.what());
+        }
+        LogPrint(BCLog::COINDB, "Background write of %u transaction outputs finished in %.2fms\n",
+            (unsigned int)pending->mapCoins.size(), (GetTimeMicros() - nStart) * 0.001);
+
+        lock.lock();
+        if (fOk) {
+            snapshot.reset();
+        } else {
+            // Keep the snapshot so reads stay correct; the next flush reports the failure.
+            LogPrintf("Error: background write to the coin database failed\n");
+            fWriteFailed = true;
+        }
+        fWriting = false;
+        condSnapshot.notify_all();
+    }
+}
+
 CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe, size_t maxFileSize) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe, false, maxFileSize) {
 }
 
@@ -208,7 +463,8 @@ bool CCoinsViewDBCursor::GetKey(COutPoint &key) const
 
 bool CCoinsViewDBCursor::GetValue(Coin &coin) const
 {
-    return pcursor->GetValue(coin);
+    CoinValue value(&coin);
+    return pcursor->GetValue(value);
 }
 
 unsigned int CCoinsViewDBCursor::GetValueSize() const
@@ -255,49 +511,413 @@ bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos>
     return WriteBatch(batch);
 }
 
+namespace {
+
+/**
+ * Unsigned integers in index keys: one byte below 128 and at most five bytes, sorting like the
+ * numbers they encode. The leading one bits of the first byte count the bytes that follow.
+ */
+template<typename Stream>
+void WriteKeyUInt(Stream& s, uint32_t n)
+{
+    if (n < 0x80) {
+        ser_writedata8(s, n);
+    } else if (n < 0x4000) {
+        ser_writedata8(s, 0x80 | (n >> 8));
+        ser_writedata8(s, n & 0xff);
+    } else if (n < 0x200000) {
+        ser_writedata8(s, 0xc0 | (n >> 16));
+        ser_writedata8(s, (n >> 8) & 0xff);
+        ser_writedata8(s, n & 0xff);
+    } else if (n < 0x10000000) {
+        ser_writedata8(s, 0xe0 | (n >> 24));
+        ser_writedata8(s, (n >> 16) & 0xff);
+        ser_writedata8(s, (n >> 8) & 0xff);
+        ser_writedata8(s, n & 0xff);
+    } else {
+        ser_writedata8(s, 0xf0);
+        ser_writedata32be(s, n);
+    }
+}
+
+template<typename Stream>
+uint32_t ReadKeyUInt(Stream& s)
+{
+    uint32_t n = ser_readdata8(s);
+    if (n < 0x80)
+        return n;
+    if (n < 0xc0)
+        return ((n & 0x3f) << 8) | ser_readdata8(s);
+    if (n < 0xe0) {
+        n = (n & 0x1f) << 16;
+        n |= ser_readdata8(s) << 8;
+        return n | ser_readdata8(s);
+    }
+    if (n < 0xf0) {
+        n = (n & 0x0f) << 24;
+        n |= ser_readdata8(s) << 16;
+        n |= ser_readdata8(s) << 8;
+        return n | ser_readdata8(s);
+    }
+    return ser_readdata32be(s);
+}
+
+/**
+ * Address index entry as stored. The asset is referred to by its id, and the transaction by
+ * its position in the block, as its txid is stored once under DB_INDEX_TXPOS.
+ */
+struct AddressIndexEntry {
+    char key;
+    unsigned int type;
+    uint160 hashBytes;
+    uint32_t assetId;
+    uint32_t blockHeight;
+    uint32_t txindex;
+    uint32_t index;
+    bool spending;
+
+    AddressIndexEntry() : key(DB_ADDRESSINDEX_COMPACT), type(0), assetId(0), blockHeight(0), txindex(0), index(0), spending(false) {}
+    AddressIndexEntry(const CAddressIndexKey& entry, uint32_t assetIdIn) :
+        key(DB_ADDRESSINDEX_COMPACT), type(entry.type), hashBytes(entry.hashBytes), assetId(assetIdIn), blockHeight(entry.blockHeight),
+        txindex(entry.txindex), index(entry.index), spending(entry.spending) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        s << key;
+        ser_writedata8(s, type);
+        hashBytes.Serialize(s);
+        WriteKeyUInt(s, assetId);
+        WriteKeyUInt(s, blockHeight);
+        WriteKeyUInt(s, txindex);
+        WriteKeyUInt(s, index);
+        ser_writedata8(s, spending);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        s >> key;
+        type = ser_readdata8(s);
+        hashBytes.Unserialize(s);
+        assetId = ReadKeyUInt(s);
+        blockHeight = ReadKeyUInt(s);
+        txindex = ReadKeyUInt(s);
+        index = ReadKeyUInt(s);
+        spending = ser_readdata8(s);
+    }
+
+    bool operator==(const AddressIndexEntry& other) const {
+        return key == other.key && type == other.type && hashBytes == other.hashBytes && assetId == other.assetId &&
+               blockHeight == other.blockHeight && txindex == other.txindex && index == other.index && spending == other.spending;
+    }
+};
+
+/** Address index amount as stored: its sign follows from the entry being a spend */
+struct AddressIndexAmount {
+    CAmount* amount;
+    bool spending;
+    AddressIndexAmount(const CAmount* ptr, bool spendingIn) : amount(const_cast<CAmount*>(ptr)), spending(spendingIn) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        uint64_t nValue = CTxOutCompressor::CompressAmount(spending ? -*amount : *amount);
+        s << VARINT(nValue);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        uint64_t nValue = 0;
+        s >> VARINT(nValue);
+        *amount = CTxOutCompressor::DecompressAmount(nValue);
+        if (spending)
+            *amount = -*amount;
+    }
+};
+
+/** Unspent output of an address as stored, with its asset referred to by id */
+struct AddressUnspentEntry {
+    char key;
+    unsigned int type;
+    uint160 hashBytes;
+    uint32_t assetId;
+    uint256 txhash;
+    uint32_t index;
+
+    AddressUnspentEntry() : key(DB_ADDRESSUNSPENTINDEX_COMPACT), type(0), assetId(0), index(0) {}
+    AddressUnspentEntry(const CAddressUnspentKey& entry, uint32_t assetIdIn) :
+        key(DB_ADDRESSUNSPENTINDEX_COMPACT), type(entry.type), hashBytes(entry.hashBytes), assetId(assetIdIn), txhash(entry.txhash), index(entry.index) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        s << key;
+        ser_writedata8(s, type);
+        hashBytes.Serialize(s);
+        WriteKeyUInt(s, assetId);
+        txhash.Serialize(s);
+        WriteKeyUInt(s, index);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        s >> key;
+        type = ser_readdata8(s);
+        hashBytes.Unserialize(s);
+        assetId = ReadKeyUInt(s);
+        txhash.Unserialize(s);
+        index = ReadKeyUInt(s);
+    }
+
+    bool operator==(const AddressUnspentEntry& other) const {
+        return key == other.key && type == other.type && hashBytes == other.hashBytes && assetId == other.assetId &&
+               txhash == other.txhash && index == other.index;
+    }
+};
+
+/** Unspent output value as stored: amount and script compressed as in the chainstate */
+struct AddressUnspentValue {
+    CAddressUnspentValue* value;
+    explicit AddressUnspentValue(const CAddressUnspentValue* ptr) : value(const_cast<CAddressUnspentValue*>(ptr)) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        CTxOut txout(value->satoshis, value->script);
+        s << CTxOutCompressor(txout, true);
+        s << VARINT(value->blockHeight);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        CTxOut txout;
+        CTxOutCompressor compressor(txout, true);
+        s >> compressor;
+        value->satoshis = txout.nValue;
+        value->script = txout.scriptPubKey;
+        s >> VARINT(value->blockHeight);
+    }
+};
+
+/** Start of the entries of an address, optionally of one asset, from some key number on */
+struct AddressSeekKey {
+    char key;
+    unsigned int type;
+    uint160 hashBytes;
+    std::vector<uint32_t> vNumbers;
+
+    AddressSeekKey(char keyIn, unsigned int typeIn, const uint160& hashBytesIn, std::vector<uint32_t> vNumbersIn = std::vector<uint32_t>()) :
+        key(keyIn), type(typeIn), hashBytes(hashBytesIn), vNumbers(std::move(vNumbersIn)) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        s << key;
+        ser_writedata8(s, type);
+        hashBytes.Serialize(s);
+        for (uint32_t n : vNumbers)
+            WriteKeyUInt(s, n);
+    }
+};
+
+/** The txid of the transaction at a position in the blocks the address index is built from */
+struct IndexTxPosKey {
+    char key;
+    uint32_t blockHeight;
+    uint32_t txindex;
+    IndexTxPosKey(uint32_t blockHeightIn, uint32_t txindexIn) : key(DB_INDEX_TXPOS), blockHeight(blockHeightIn), txindex(txindexIn) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        s << key;
+        WriteKeyUInt(s, blockHeight);
+        WriteKeyUInt(s, txindex);
+    }
+};
+
+struct IndexAssetKey {
+    char key;
+    uint32_t assetId;
+    IndexAssetKey() : key(DB_INDEX_ASSET), assetId(0) {}
+    explicit IndexAssetKey(uint32_t assetIdIn) : key(DB_INDEX_ASSET), assetId(assetIdIn) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        s << key;
+        WriteKeyUInt(s, assetId);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        s >> key;
+        assetId = ReadKeyUInt(s);
+    }
+};
+
+struct SpentIndexEntry {
+    char key;
+    CSpentIndexKey* outpoint;
+    explicit SpentIndexEntry(const CSpentIndexKey* ptr) : key(DB_SPENTINDEX_COMPACT), outpoint(const_cast<CSpentIndexKey*>(ptr)) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        s << key;
+        s << outpoint->txid;
+        WriteKeyUInt(s, outpoint->outputIndex);
+    }
+};
+
+/** Spending input as stored; the address hash is left out when there is no address */
+struct SpentIndexValue {
+    CSpentIndexValue* value;
+    explicit SpentIndexValue(const CSpentIndexValue* ptr) : value(const_cast<CSpentIndexValue*>(ptr)) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        s << value->txid;
+        s << VARINT(value->inputIndex);
+        s << VARINT(value->blockHeight);
+        uint64_t nSatoshis = CTxOutCompressor::CompressAmount(value->satoshis);
+        s << VARINT(nSatoshis);
+        ser_writedata8(s, value->addressType);
+        if (value->addressType != 0)
+            value->addressHash.Serialize(s);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        s >> value->txid;
+        s >> VARINT(value->inputIndex);
+        s >> VARINT(value->blockHeight);
+        uint64_t nSatoshis = 0;
+        s >> VARINT(nSatoshis);
+        value->satoshis = CTxOutCompressor::DecompressAmount(nSatoshis);
+        value->addressType = ser_readdata8(s);
+        if (value->addressType != 0)
+            value->addressHash.Unserialize(s);
+        else
+            value->addressHash.SetNull();
+    }
+};
+
+}
+
+bool CBlockTreeDB::LoadIndexAssets() {
+    AssertLockHeld(cs_index_assets);
+    if (!vIndexAssets.empty())
+        return true;
+
+    // Id 0 is AIDP and not stored.
+    vIndexAssets.push_back(AIDP);
+    mapIndexAssetIds[AIDP] = 0;
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(IndexAssetKey(1));
+    IndexAssetKey key;
+    while (pcursor->Valid() && pcursor->GetKey(key) && key.key == DB_INDEX_ASSET) {
+        std::string name;
+        if (!pcursor->GetValue(name) || key.assetId != vIndexAssets.size()) {
+            vIndexAssets.clear();
+            mapIndexAssetIds.clear();
+            return error("%s: address index asset %u is inconsistent", __func__, key.assetId);
+        }
+        mapIndexAssetIds[name] = key.assetId;
+        vIndexAssets.push_back(name);
+        pcursor->Next();
+    }
+    return true;
+}
+
+bool CBlockTreeDB::FindIndexAsset(const std::string &name, uint32_t &assetId) {
+    LOCK(cs_index_assets);
+    if (!LoadIndexAssets())
+        return false;
+    std::map<std::string, uint32_t>::const_iterator it = mapIndexAssetIds.find(name);
+    if (it == mapIndexAssetIds.end())
+        return false;
+    assetId = it->second;
+    return true;
+}
+
+bool CBlockTreeDB::GetIndexAssetName(uint32_t assetId, std::string &name) {
+    LOCK(cs_index_assets);
+    if (!LoadIndexAssets() || assetId >= vIndexAssets.size())
+        return false;
+    name = vIndexAssets[assetId];
+    return true;
+}
+
+uint32_t CBlockTreeDB::AddIndexAsset(CDBBatch &batch, const std::string &name) {
+    LOCK(cs_index_assets);
+    if (!LoadIndexAssets())
+        throw std::runtime_error("failed to load the address index assets");
+    std::map<std::string, uint32_t>::const_iterator it = mapIndexAssetIds.find(name);
+    if (it != mapIndexAssetIds.end())
+        return it->second;
+    // Only one thread writes the address index, and a batch that fails to be written ends the node.
+    uint32_t assetId = vIndexAssets.size();
+    batch.Write(IndexAssetKey(assetId), name);
+    mapIndexAssetIds[name] = assetId;
+    vIndexAssets.push_back(name);
+    return assetId;
+}
+
 bool CBlockTreeDB::ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value) {
-    return Read(std::make_pair(DB_SPENTINDEX, key), value);
+    SpentIndexValue entry(&value);
+    return Read(SpentIndexEntry(&key), entry);
 }
 
-bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect) {
-    CDBBatch batch(*this);
+void CBlockTreeDB::UpdateSpentIndex(CDBBatch &batch, const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect) {
     for (std::vector<std::pair<CSpentIndexKey,CSpentIndexValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
         if (it->second.IsNull()) {
-            batch.Erase(std::make_pair(DB_SPENTINDEX, it->first));
+            batch.Erase(SpentIndexEntry(&it->first));
         } else {
-            batch.Write(std::make_pair(DB_SPENTINDEX, it->first), it->second);
+            batch.Write(SpentIndexEntry(&it->first), SpentIndexValue(&it->second));
         }
     }
-    return WriteBatch(batch);
 }
 
-bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect) {
-    CDBBatch batch(*this);
+void CBlockTreeDB::UpdateAddressUnspentIndex(CDBBatch &batch, const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect) {
     for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
         if (it->second.IsNull()) {
-            batch.Erase(std::make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
+            uint32_t assetId;
+            if (FindIndexAsset(it->first.asset, assetId))
+                batch.Erase(AddressUnspentEntry(it->first, assetId));
         } else {
-            batch.Write(std::make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
+            batch.Write(AddressUnspentEntry(it->first, AddIndexAsset(batch, it->first.asset)), AddressUnspentValue(&it->second));
         }
     }
-    return WriteBatch(batch);
 }
 
 bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type, std::string assetName,
-                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
+                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                                           size_t nLimit, const CAddressUnspentKey *pAfter) {
+
+    uint32_t assetId;
+    if (!FindIndexAsset(assetName, assetId))
+        return true;
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
-    pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorAssetKey(type, addressHash, assetName)));
+    AddressUnspentEntry after;
+    if (pAfter) {
+        after = AddressUnspentEntry(*pAfter, assetId);
+        pcursor->Seek(after);
+    } else {
+        pcursor->Seek(AddressSeekKey(DB_ADDRESSUNSPENTINDEX_COMPACT, type, addressHash, {assetId}));
+    }
 
+    size_t nFound = 0;
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
-        std::pair<char,CAddressUnspentKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash
-                && (assetName.empty() || key.second.asset == assetName)) {
-            CAddressUnspentValue nValue;
-            if (pcursor->GetValue(nValue)) {
-                unspentOutputs.push_back(std::make_pair(key.second, nValue));
+        AddressUnspentEntry key;
+        if (pcursor->GetKey(key) && key.key == DB_ADDRESSUNSPENTINDEX_COMPACT && key.type == (unsigned int)type
+                && key.hashBytes == addressHash && key.assetId == assetId) {
+            if (pAfter && key == after) {
+                pcursor->Next();
+                continue;
+            }
+            CAddressUnspentValue value;
+            AddressUnspentValue entry(&value);
+            if (pcursor->GetValue(entry)) {
+                unspentOutputs.push_back(std::make_pair(CAddressUnspentKey(type, addressHash, assetName, key.txhash, key.index), value));
+                if (nLimit > 0 && ++nFound >= nLimit)
+                    break;
                 pcursor->Next();
             } else {
                 return error("failed to get address unspent value");
@@ -311,21 +931,50 @@ bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type, std::s
 }
 
 bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
-                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
+                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                                           size_t nLimit, const CAddressUnspentKey *pAfter) {
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
-    pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    AddressUnspentEntry after;
+    if (pAfter) {
+        uint32_t assetId;
+        if (!FindIndexAsset(pAfter->asset, assetId))
+            return true;
+        after = AddressUnspentEntry(*pAfter, assetId);
+        pcursor->Seek(after);
+    } else {
+        // AIDP has id 0 and comes first: start at the assets.
+        pcursor->Seek(AddressSeekKey(DB_ADDRESSUNSPENTINDEX_COMPACT, type, addressHash, {1}));
+    }
 
+    size_t nFound = 0;
+    std::string assetName;
+    uint32_t lastAssetId = std::numeric_limits<uint32_t>::max();
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
-        std::pair<char,CAddressUnspentKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
-            CAddressUnspentValue nValue;
-            if (pcursor->GetValue(nValue)) {
-                if (key.second.asset != "AIDP") {
-                    unspentOutputs.push_back(std::make_pair(key.second, nValue));
-                }
+        AddressUnspentEntry key;
+        if (pcursor->GetKey(key) && key.key == DB_ADDRESSUNSPENTINDEX_COMPACT && key.type == (unsigned int)type
+                && key.hashBytes == addressHash) {
+            if (key.assetId == 0) {
+                pcursor->Seek(AddressSeekKey(DB_ADDRESSUNSPENTINDEX_COMPACT, type, addressHash, {1}));
+                continue;
+            }
+            if (pAfter && key == after) {
+                pcursor->Next();
+                continue;
+            }
+            if (key.assetId != lastAssetId) {
+                if (!GetIndexAssetName(key.assetId, assetName))
+                    return error("%s: unknown address index asset %u", __func__, key.assetId);
+                lastAssetId = key.assetId;
+            }
+            CAddressUnspentValue value;
+            AddressUnspentValue entry(&value);
+            if (pcursor->GetValue(entry)) {
+                unspentOutputs.push_back(std::make_pair(CAddressUnspentKey(type, addressHash, assetName, key.txhash, key.index), value));
+                if (nLimit > 0 && ++nFound >= nLimit)
+                    break;
                 pcursor->Next();
             } else {
                 return error("failed to get address unspent value");
@@ -338,46 +987,215 @@ bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
     return true;
 }
 
-bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Write(std::make_pair(DB_ADDRESSINDEX, it->first), it->second);
-    return WriteBatch(batch);
+void CBlockTreeDB::ApplyAddressBalances(CDBBatch &batch, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool fConnect) {
+    typedef std::tuple<unsigned int, uint160, std::string> BalanceKey;
+    std::map<BalanceKey, CAddressBalanceValue> mapDeltas;
+    std::set<std::pair<BalanceKey, uint256> > setTxs;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        BalanceKey key(it->first.type, it->first.hashBytes, it->first.asset);
+        CAddressBalanceValue& delta = mapDeltas[key];
+        delta.balance += it->second;
+        if (it->second > 0)
+            delta.received += it->second;
+        if (setTxs.insert(std::make_pair(key, it->first.txhash)).second)
+            delta.txCount++;
+    }
+
+    int nSign = fConnect ? 1 : -1;
+    for (const auto& delta : mapDeltas) {
+        std::pair<char, CAddressIndexIteratorAssetKey> key(DB_ADDRESSBALANCE,
+            CAddressIndexIteratorAssetKey(std::get<0>(delta.first), std::get<1>(delta.first), std::get<2>(delta.first)));
+        CAddressBalanceValue value;
+        Read(key, value);
+        value.balance += nSign * delta.second.balance;
+        value.received += nSign * delta.second.received;
+        value.txCount += nSign * delta.second.txCount;
+        if (value.IsNull()) {
+            batch.Erase(key);
+        } else {
+            batch.Write(key, value);
+        }
+    }
+}
+
+void CBlockTreeDB::WriteAddressIndex(CDBBatch &batch, const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
+    std::set<std::pair<uint32_t, uint32_t> > setTxPos;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        batch.Write(AddressIndexEntry(it->first, AddIndexAsset(batch, it->first.asset)), AddressIndexAmount(&it->second, it->first.spending));
+        if (setTxPos.insert(std::make_pair(it->first.blockHeight, it->first.txindex)).second)
+            batch.Write(IndexTxPosKey(it->first.blockHeight, it->first.txindex), it->first.txhash);
+    }
+    ApplyAddressBalances(batch, vect, true);
+}
+
+void CBlockTreeDB::EraseAddressIndex(CDBBatch &batch, const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        uint32_t assetId;
+        if (FindIndexAsset(it->first.asset, assetId))
+            batch.Erase(AddressIndexEntry(it->first, assetId));
+        batch.Erase(IndexTxPosKey(it->first.blockHeight, it->first.txindex));
+    }
+    ApplyAddressBalances(batch, vect, false);
+}
+
+bool CBlockTreeDB::ReadAddressBalance(uint160 addressHash, int type, std::string assetName, CAddressBalanceValue &value) {
+    value.SetNull();
+    // A missing entry is an address that never saw this asset.
+    Read(std::make_pair(DB_ADDRESSBALANCE, CAddressIndexIteratorAssetKey(type, addressHash, assetName)), value);
+    return true;
+}
+
+bool CBlockTreeDB::ReadAddressBalances(uint160 addressHash, int type, std::map<std::string, CAddressBalanceValue> &balances) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(std::make_pair(DB_ADDRESSBALANCE, CAddressIndexIteratorKey(type, addressHash)));
+
+    while (pcursor->Valid()) {
+        std::pair<char, CAddressIndexIteratorAssetKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_ADDRESSBALANCE && key.second.type == (unsigned int)type
+                && key.second.hashBytes == addressHash) {
+            CAddressBalanceValue value;
+            if (pcursor->GetValue(value)) {
+                balances[key.second.asset] = value;
+                pcursor->Next();
+            } else {
+                return error("failed to get address balance value");
+            }
+        } else {
+            break;
+        }
+    }
+
+    return true;
 }
 
-bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
+bool CBlockTreeDB::BuildAddressBalances() {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    // Entries of one address and asset are adjacent, and within them those of one transaction.
     CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Erase(std::make_pair(DB_ADDRESSINDEX, it->first));
-    return WriteBatch(batch);
+    std::pair<char, CAddressIndexIteratorAssetKey> keyBalance(DB_ADDRESSBALANCE, CAddressIndexIteratorAssetKey());
+    AddressIndexEntry keyLast;
+    CAddressBalanceValue value;
+    bool fHave = false;
+    size_t nBalances = 0;
+
+    pcursor->Seek(DB_ADDRESSINDEX_COMPACT);
+
+    while (true) {
+        boost::this_thread::interruption_point();
+        AddressIndexEntry key;
+        bool fValid = pcursor->Valid() && pcursor->GetKey(key) && key.key == DB_ADDRESSINDEX_COMPACT;
+        if (fHave && (!fValid || key.type != keyLast.type || key.hashBytes != keyLast.hashBytes || key.assetId != keyLast.assetId)) {
+            if (!value.IsNull())
+                batch.Write(keyBalance, value);
+            nBalances++;
+            fHave = false;
+            if (batch.SizeEstimate() > (size_t)16 << 20) {
+                if (!WriteBatch(batch))
+                    return false;
+                batch.Clear();
+            }
+        }
+        if (!fValid)
+            break;
+
+        CAmount nValue;
+        AddressIndexAmount amount(&nValue, key.spending);
+        if (!pcursor->GetValue(amount))
+            return error("failed to get address index value");
+        if (!fHave) {
+            std::string assetName;
+            if (!GetIndexAssetName(key.assetId, assetName))
+                return error("%s: unknown address index asset %u", __func__, key.assetId);
+            keyBalance.second = CAddressIndexIteratorAssetKey(key.type, key.hashBytes, assetName);
+            value.SetNull();
+            fHave = true;
+            value.txCount++;
+        } else if (key.blockHeight != keyLast.blockHeight || key.txindex != keyLast.txindex) {
+            value.txCount++;
+        }
+        value.balance += nValue;
+        if (nValue > 0)
+            value.received += nValue;
+        keyLast = key;
+        pcursor->Next();
+    }
+
+    LogPrintf("%s: %u address balances\n", __func__, nBalances);
+    return WriteBatch(batch, true);
 }
 
 bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type, std::string assetName,
                                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                                    int start, int end) {
+                                    int start, int end, size_t nLimit, const CAddressIndexKey *pAfter) {
+
+    uint32_t assetId = 0;
+    if (!assetName.empty() && !FindIndexAsset(assetName, assetId))
+        return true;
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
-    if (!assetName.empty() && start > 0 && end > 0) {
-        pcursor->Seek(std::make_pair(DB_ADDRESSINDEX,
-                                     CAddressIndexIteratorHeightKey(type, addressHash, assetName, start)));
+    AddressIndexEntry after;
+    if (pAfter) {
+        uint32_t afterAssetId;
+        if (!FindIndexAsset(pAfter->asset, afterAssetId))
+            return true;
+        after = AddressIndexEntry(*pAfter, afterAssetId);
+        pcursor->Seek(after);
+    } else if (!assetName.empty() && start > 0) {
+        pcursor->Seek(AddressSeekKey(DB_ADDRESSINDEX_COMPACT, type, addressHash, {assetId, (uint32_t)start}));
     } else if (!assetName.empty()) {
-        pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorAssetKey(type, addressHash, assetName)));
+        pcursor->Seek(AddressSeekKey(DB_ADDRESSINDEX_COMPACT, type, addressHash, {assetId}));
     } else {
-        pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
+        pcursor->Seek(AddressSeekKey(DB_ADDRESSINDEX_COMPACT, type, addressHash));
     }
 
+    size_t nFound = 0;
+    std::string entryAssetName;
+    uint32_t lastAssetId = std::numeric_limits<uint32_t>::max();
+    std::pair<uint32_t, uint32_t> lastTxPos(0, 0);
+    uint256 txhash;
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
-        std::pair<char,CAddressIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX && key.second.hashBytes == addressHash
-                && (assetName.empty() || key.second.asset == assetName)) {
-            if (end > 0 && key.second.blockHeight > end) {
-                break;
+        AddressIndexEntry key;
+        if (pcursor->GetKey(key) && key.key == DB_ADDRESSINDEX_COMPACT && key.type == (unsigned int)type
+                && key.hashBytes == addressHash && (assetName.empty() || key.assetId == assetId)) {
+            // Entries are sorted by asset, then height, so the part of each asset outside
+            // [start, end] is skipped with a seek rather than read.
+            if (start > 0 && key.blockHeight < (uint32_t)start) {
+                pcursor->Seek(AddressSeekKey(DB_ADDRESSINDEX_COMPACT, type, addressHash, {key.assetId, (uint32_t)start}));
+                continue;
+            }
+            if (end > 0 && key.blockHeight > (uint32_t)end) {
+                if (!assetName.empty())
+                    break;
+                pcursor->Seek(AddressSeekKey(DB_ADDRESSINDEX_COMPACT, type, addressHash, {key.assetId + 1}));
+                continue;
+            }
+            if (pAfter && key == after) {
+                pcursor->Next();
+                continue;
+            }
+            if (key.assetId != lastAssetId) {
+                if (!GetIndexAssetName(key.assetId, entryAssetName))
+                    return error("%s: unknown address index asset %u", __func__, key.assetId);
+                lastAssetId = key.assetId;
+            }
+            std::pair<uint32_t, uint32_t> txpos(key.blockHeight, key.txindex);
+            if (txhash.IsNull() || txpos != lastTxPos) {
+                if (!Read(IndexTxPosKey(key.blockHeight, key.txindex), txhash))
+                    return error("%s: no txid for transaction %u of block %u", __func__, key.txindex, key.blockHeight);
+                lastTxPos = txpos;
             }
             CAmount nValue;
-            if (pcursor->GetValue(nValue)) {
-                addressIndex.push_back(std::make_pair(key.second, nValue));
+            AddressIndexAmount amount(&nValue, key.spending);
+            if (pcursor->GetValue(amount)) {
+                addressIndex.push_back(std::make_pair(CAddressIndexKey(type, addressHash, entryAssetName, key.blockHeight, key.txindex, txhash, key.index, key.spending), nValue));
+                if (nLimit > 0 && ++nFound >= nLimit)
+                    break;
                 pcursor->Next();
             } else {
                 return error("failed to get address index value");
@@ -392,15 +1210,92 @@ bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type, std::string a
 
 bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
                                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                                    int start, int end) {
+                                    int start, int end, size_t nLimit, const CAddressIndexKey *pAfter) {
 
-    return CBlockTreeDB::ReadAddressIndex(addressHash, type, "", addressIndex, start, end);
+    return CBlockTreeDB::ReadAddressIndex(addressHash, type, "", addressIndex, start, end, nLimit, pAfter);
 }
 
-bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex) {
-    CDBBatch batch(*this);
+/**
+ * Rewrite the entries stored under chOld in the compact format with convert, erasing the old
+ * ones in the same batches. Stops on shutdown, to go on from there at the next start.
+ */
+template<typename OldKey, typename OldValue, typename Convert>
+static bool UpgradeIndexEntries(CBlockTreeDB& db, char chOld, const char* pszName, Convert convert)
+{
+    boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
+    pcursor->Seek(chOld);
+    std::pair<char, OldKey> key;
+    if (!pcursor->Valid() || !pcursor->GetKey(key) || key.first != chOld)
+        return true;
+
+    LogPrintf("Upgrading the %s to the compact format (%u MiB)...\n", pszName, db.EstimateSize(chOld, (char)(chOld + 1)) >> 20);
+    CDBBatch batch(db);
+    size_t nEntries = 0;
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        if (ShutdownRequested())
+            break;
+        if (!pcursor->GetKey(key) || key.first != chOld)
+            break;
+        OldValue value;
+        if (!pcursor->GetValue(value))
+            return error("%s: cannot parse %s entry", __func__, pszName);
+        convert(batch, key.second, value);
+        batch.Erase(key);
+        if (++nEntries % 1000000 == 0)
+            LogPrintf("[%u]...", nEntries);
+        if (batch.SizeEstimate() > (size_t)1 << 24) {
+            if (!db.WriteBatch(batch))
+                return error("%s: failed to write %s entries", __func__, pszName);
+            batch.Clear();
+        }
+        pcursor->Next();
+    }
+    if (!db.WriteBatch(batch))
+        return error("%s: failed to write %s entries", __func__, pszName);
+    db.CompactRange(chOld, (char)(chOld + 1));
+    LogPrintf("%u entries [%s].\n", nEntries, ShutdownRequested() ? "CANCELLED" : "DONE");
+    return true;
+}
+
+bool CBlockTreeDB::UpgradeAddressIndex() {
+    bool fOk = UpgradeIndexEntries<CAddressIndexKey, CAmount>(*this, DB_ADDRESSINDEX, "address index",
+        [this](CDBBatch& batch, const CAddressIndexKey& key, const CAmount& value) {
+            batch.Write(AddressIndexEntry(key, AddIndexAsset(batch, key.asset)), AddressIndexAmount(&value, key.spending));
+            batch.Write(IndexTxPosKey(key.blockHeight, key.txindex), key.txhash);
+        });
+    return fOk && UpgradeIndexEntries<CAddressUnspentKey, CAddressUnspentValue>(*this, DB_ADDRESSUNSPENTINDEX, "address unspent index",
+        [this](CDBBatch& batch, const CAddressUnspentKey& key, const CAddressUnspentValue& value) {
+            batch.Write(AddressUnspentEntry(key, AddIndexAsset(batch, key.asset)), AddressUnspentValue(&value));
+        });
+}
+
+bool CBlockTreeDB::UpgradeSpentIndex() {
+    return UpgradeIndexEntries<CSpentIndexKey, CSpentIndexValue>(*this, DB_SPENTINDEX, "spent index",
+        [](CDBBatch& batch, const CSpentIndexKey& key, const CSpentIndexValue& value) {
+            batch.Write(SpentIndexEntry(&key), SpentIndexValue(&value));
+        });
+}
+
+uint64_t CBlockTreeDB::EstimateIndexSize(const std::string &name) {
+    std::vector<char> vKeys;
+    if (name == "addressindex") {
+        vKeys = {DB_ADDRESSINDEX_COMPACT, DB_ADDRESSUNSPENTINDEX_COMPACT, DB_INDEX_TXPOS, DB_INDEX_ASSET, DB_ADDRESSBALANCE,
+                 DB_ADDRESSINDEX, DB_ADDRESSUNSPENTINDEX};
+    } else if (name == "spentindex") {
+        vKeys = {DB_SPENTINDEX_COMPACT, DB_SPENTINDEX};
+    } else if (name == "timestampindex") {
+        vKeys = {DB_TIMESTAMPINDEX, DB_BLOCKHASHINDEX};
+    }
+
+    uint64_t nSize = 0;
+    for (char ch : vKeys)
+        nSize += EstimateSize(ch, (char)(ch + 1));
+    return nSize;
+}
+
+void CBlockTreeDB::WriteTimestampIndex(CDBBatch &batch, const CTimestampIndexKey &timestampIndex) {
     batch.Write(std::make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
-    return WriteBatch(batch);
 }
 
 bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned int &low, const bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &hashes) {
@@ -430,10 +1325,8 @@ bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned i
     return true;
 }
 
-bool CBlockTreeDB::WriteTimestampBlockIndex(const CTimestampBlockIndexKey &blockhashIndex, const CTimestampBlockIndexValue &logicalts) {
-    CDBBatch batch(*this);
+void CBlockTreeDB::WriteTimestampBlockIndex(CDBBatch &batch, const CTimestampBlockIndexKey &blockhashIndex, const CTimestampBlockIndexValue &logicalts) {
     batch.Write(std::make_pair(DB_BLOCKHASHINDEX, blockhashIndex), logicalts);
-    return WriteBatch(batch);
 }
 
 bool CBlockTreeDB::ReadTimestampBlockIndex(const uint256 &hash, unsigned int &ltimestamp) {
@@ -446,6 +1339,14 @@ bool CBlockTreeDB::ReadTimestampBlockIndex(const uint256 &hash, unsigned int &lt
     return true;
 }
 
+bool CBlockTreeDB::ReadIndexBestBlock(const std::string &name, CBlockLocator &locator) {
+    return Read(std::make_pair(DB_INDEX_BEST_BLOCK, name), locator);
+}
+
+void CBlockTreeDB::WriteIndexBestBlock(CDBBatch &batch, const std::string &name, const CBlockLocator &locator) {
+    batch.Write(std::make_pair(DB_INDEX_BEST_BLOCK, name), locator);
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
     return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
 }
@@ -561,13 +1462,14 @@ public:
 
 /** Upgrade the database from older formats.
  *
- * Currently implemented: from the per-tx utxo model (0.8..0.14.x) to per-txout.
+ * Currently implemented: from the per-tx utxo model (0.8..0.14.x) to per-txout,
+ * and from per-txout coins with uncompressed asset scripts to compressed ones.
  */
 bool CCoinsViewDB::Upgrade() {
     std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
     pcursor->Seek(std::make_pair(DB_COINS, uint256()));
     if (!pcursor->Valid()) {
-        return true;
+        return UpgradeAssetScripts();
     }
 
     int64_t count = 0;
@@ -605,7 +1507,7 @@ bool CCoinsViewDB::Upgrade() {
                     Coin newcoin(std::move(old_coins.vout[i]), old_coins.nHeight, old_coins.fCoinBase);
                     outpoint.n = i;
                     CoinEntry entry(&outpoint);
-                    batch.Write(entry, newcoin);
+                    batch.Write(entry, CoinValue(&newcoin));
                 }
             }
             batch.Erase(key);
@@ -624,5 +1526,67 @@ bool CCoinsViewDB::Upgrade() {
     db.CompactRange({DB_COINS, uint256()}, key);
     uiInterface.ShowProgress("", 100, false);
     LogPrintf("[%s].\n", ShutdownRequested() ? "CANCELLED" : "DONE");
+    return !ShutdownRequested() && UpgradeAssetScripts();
+}
+
+/** Rewrite coins stored before asset scripts were compressed under the new key */
+bool CCoinsViewDB::UpgradeAssetScripts() {
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+    pcursor->Seek(DB_COIN_UNCOMPRESSED_ASSETS);
+    if (!pcursor->Valid()) {
+        return true;
+    }
+
+    COutPoint outpoint;
+    CoinEntry entry(&outpoint);
+    if (!pcursor->GetKey(entry) || entry.key != DB_COIN_UNCOMPRESSED_ASSETS) {
+        return true;
+    }
+
+    int64_t count = 0;
+    LogPrintf("Compressing asset scripts in the utxo-set database...\n");
+    LogPrintf("[0%%]...");
+    uiInterface.ShowProgress(_("Upgrading UTXO database"), 0, true);
+    size_t batch_size = 1 << 24;
+    CDBBatch batch(db);
+    int reportDone = 0;
+    std::pair<unsigned char, uint256> prev_key = {DB_COIN_UNCOMPRESSED_ASSETS, uint256()};
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        if (ShutdownRequested()) {
+            break;
+        }
+        if (pcursor->GetKey(entry) && entry.key == DB_COIN_UNCOMPRESSED_ASSETS) {
+            if (count++ % 256 == 0) {
+                uint32_t high = 0x100 * *outpoint.hash.begin() + *(outpoint.hash.begin() + 1);
+                int percentageDone = (int)(high * 100.0 / 65536.0 + 0.5);
+                uiInterface.ShowProgress(_("Upgrading UTXO database"), percentageDone, true);
+                if (reportDone < percentageDone/10) {
+                    // report max. every 10% step
+                    LogPrintf("[%d%%]...", percentageDone);
+                    reportDone = percentageDone/10;
+                }
+            }
+            Coin coin;
+            if (!pcursor->GetValue(coin)) {
+                return error("%s: cannot parse Coin record", __func__);
+            }
+            batch.Write(CoinEntry(&outpoint), CoinValue(&coin));
+            batch.Erase(entry);
+            if (batch.SizeEstimate() > batch_size) {
+                db.WriteBatch(batch);
+                batch.Clear();
+                db.CompactRange(prev_key, std::make_pair((unsigned char)DB_COIN_UNCOMPRESSED_ASSETS, outpoint.hash));
+                prev_key = std::make_pair((unsigned char)DB_COIN_UNCOMPRESSED_ASSETS, outpoint.hash);
+            }
+            pcursor->Next();
+        } else {
+            break;
+        }
+    }
+    db.WriteBatch(batch);
+    db.CompactRange(prev_key, std::make_pair((unsigned char)DB_COIN_UNCOMPRESSED_ASSETS, outpoint.hash));
+    uiInterface.ShowProgress("", 100, false);
+    LogPrintf("[%s].\n", ShutdownRequested() ? "CANCELLED" : "DONE");
     return !ShutdownRequested();
 }
@@ -11,12 +11,17 @@
 #include "coins.h"
 #include "dbwrapper.h"
 #include "chain.h"
+#include "sync.h"
 #include "addressindex.h"
 #include "spentindex.h"
 #include "timestampindex.h"
 
+#include <condition_variable>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -42,6 +47,8 @@ static const int64_t nMaxBlockDBCache = 2;
 static const int64_t nMaxBlockDBAndTxIndexCache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! -backgroundflush default
+static const bool DEFAULT_BACKGROUND_FLUSH = true;
 
 struct CDiskTxPos : public CDiskBlockPos
 {
@@ -83,9 +90,91 @@ public:
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
     CCoinsViewCursor *Cursor() const override;
 
+    //! Like BatchWrite, but leaves mapCoins untouched so it can be read concurrently.
+    bool WriteSnapshot(CCoinsMap &mapCoins, const uint256 &hashBlock);
+
+    //! Mark the database as being in transition to hashBlock, synchronously, ahead of a write
+    //! that finishes later. ReplayBlocks completes the transition if that write never lands.
+    bool StartWrite(const uint256 &hashBlock);
+
+    //! Whether the database holds no coins at all.
+    bool IsEmpty() const;
+    //! Start loading a UTXO snapshot at hashBlock. Until FinishBulkLoad the database is marked as being
+    //! in transition from nothing to hashBlock, which ReplayBlocks refuses without the block data.
+    bool StartBulkLoad(const uint256 &hashBlock);
+    //! Write a batch of coins during a bulk load.
+    bool BulkLoadCoins(const std::vector<std::pair<COutPoint, Coin> > &coins);
+    //! Mark the database as consistent with hashBlock.
+    bool FinishBulkLoad(const uint256 &hashBlock);
+
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
+
+private:
+    bool WriteCoins(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fEraseWritten);
+    //! The best block a write to hashBlock starts from, also while a transition is pending.
+    uint256 GetTransitionBase(const uint256 &hashBlock) const;
+    bool UpgradeAssetScripts();
+};
+
+/**
+ * CCoinsView between the coins cache and the coin database that can write a flush to
+ * LevelDB from a background thread.
+ *
+ * FlushInBackground() moves the dirty entries of a cache into a snapshot and returns; the
+ * cache is empty again and validation carries on while the writer thread commits the
+ * snapshot. Until it is committed the snapshot shadows the database for reads. Only one
+ * snapshot is in flight at a time: any flush arriving while one is being written first
+ * waits for it.
+ *
+ * The head blocks marker is written synchronously before the snapshot is handed over, so
+ * state flushed after FlushInBackground() returns (the asset databases, the block index)
+ * never gets ahead of a coin database that still looks consistent. If the process dies
+ * before the writer commits, ReplayBlocks rolls the coins forward on the next start.
+ */
+class CCoinsViewBackgroundFlush final : public CCoinsViewBacked
+{
+public:
+    explicit CCoinsViewBackgroundFlush(CCoinsViewDB *dbIn);
+    ~CCoinsViewBackgroundFlush();
+
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    bool HaveCoin(const COutPoint &outpoint) const override;
+    uint256 GetBestBlock() const override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    CCoinsViewCursor *Cursor() const override;
+
+    //! Flush cache (which must sit on top of this view) and write the result on the writer thread.
+    bool FlushInBackground(CCoinsViewCache &cache);
+
+    //! Wait for the snapshot in flight, if any. Returns false if a background write failed.
+    bool WaitForIdle();
+
+private:
+    struct Snapshot {
+        CCoinsMapMemoryResource resource;
+        CCoinsMap mapCoins{0, SaltedOutpointHasher(), CCoinsMap::key_equal(), &resource};
+        uint256 hashBlock;
+    };
+
+    CCoinsViewDB *db;
+
+    mutable std::mutex cs_snapshot;
+    mutable std::condition_variable condSnapshot;
+    //! Snapshot being written (guarded by cs_snapshot, read without it by the writer thread).
+    std::unique_ptr<Snapshot> snapshot;
+    bool fWriting;
+    bool fWriteFailed;
+    bool fStop;
+
+    //! Set by FlushInBackground for the duration of the cache flush (protected by cs_main).
+    bool fTakeSnapshot;
+
+    std::thread threadWriter;
+
+    void WaitForIdle(std::unique_lock<std::mutex> &lock) const;
+    void ThreadWrite();
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
@@ -127,27 +216,59 @@ public:
     bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &vect);
     bool ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
-    bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect);
-    bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect);
+    void UpdateSpentIndex(CDBBatch &batch, const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect);
+    void UpdateAddressUnspentIndex(CDBBatch &batch, const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect);
+    //! Read at most nLimit (0: all) unspent outputs of an address, in key order, starting after *pAfter if given
     bool ReadAddressUnspentIndex(uint160 addressHash, int type, std::string assetName,
-                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
+                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect,
+                                 size_t nLimit = 0, const CAddressUnspentKey *pAfter = nullptr);
     bool ReadAddressUnspentIndex(uint160 addressHash, int type,
-                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
-    bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
-    bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
+                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect,
+                                 size_t nLimit = 0, const CAddressUnspentKey *pAfter = nullptr);
+    void WriteAddressIndex(CDBBatch &batch, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
+    void EraseAddressIndex(CDBBatch &batch, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
+    bool ReadAddressBalance(uint160 addressHash, int type, std::string assetName, CAddressBalanceValue &value);
+    bool ReadAddressBalances(uint160 addressHash, int type, std::map<std::string, CAddressBalanceValue> &balances);
+    //! Recompute every address balance from the address index
+    bool BuildAddressBalances();
+    //! Rewrite address and spent index entries of the format before the compact one
+    bool UpgradeAddressIndex();
+    bool UpgradeSpentIndex();
+    //! Approximate disk space taken by the index called name
+    uint64_t EstimateIndexSize(const std::string &name);
+    //! Read at most nLimit (0: all) entries of an address between heights start and end (0: unbounded),
+    //! in key order, starting after *pAfter if given
     bool ReadAddressIndex(uint160 addressHash, int type, std::string assetName,
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                          int start = 0, int end = 0);
+                          int start = 0, int end = 0, size_t nLimit = 0, const CAddressIndexKey *pAfter = nullptr);
     bool ReadAddressIndex(uint160 addressHash, int type,
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                          int start = 0, int end = 0);
-    bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
+                          int start = 0, int end = 0, size_t nLimit = 0, const CAddressIndexKey *pAfter = nullptr);
+    void WriteTimestampIndex(CDBBatch &batch, const CTimestampIndexKey &timestampIndex);
     bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, const bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &vect);
-    bool WriteTimestampBlockIndex(const CTimestampBlockIndexKey &blockhashIndex, const CTimestampBlockIndexValue &logicalts);
+    void WriteTimestampBlockIndex(CDBBatch &batch, const CTimestampBlockIndexKey &blockhashIndex, const CTimestampBlockIndexValue &logicalts);
     bool ReadTimestampBlockIndex(const uint256 &hash, unsigned int &logicalTS);
+    //! The block up to which the index called name has been built
+    bool ReadIndexBestBlock(const std::string &name, CBlockLocator &locator);
+    void WriteIndexBestBlock(CDBBatch &batch, const std::string &name, const CBlockLocator &locator);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
     bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+
+private:
+    //! Address index assets by id, as keys refer to them; id 0 is AIDP
+    CCriticalSection cs_index_assets;
+    std::vector<std::string> vIndexAssets;
+    std::map<std::string, uint32_t> mapIndexAssetIds;
+
+    bool LoadIndexAssets();
+    bool FindIndexAsset(const std::string &name, uint32_t &assetId);
+    bool GetIndexAssetName(uint32_t assetId, std::string &name);
+    //! The id of an asset, given a new one (written through batch) if it has none yet
+    uint32_t AddIndexAsset(CDBBatch &batch, const std::string &name);
+
+    //! Add (or with fConnect false, take back) the address index entries of a block to the address balances
+    void ApplyAddressBalances(CDBBatch &batch, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool fConnect);
 };
 
 #endif // AIDP_TXDB_H
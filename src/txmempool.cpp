@@ -21,6 +21,8 @@
 #include "utiltime.h"
 #include "hash.h"
 
+#include <algorithm>
+
 CTxMemPoolEntry::CTxMemPoolEntry(const CTransactionRef& _tx, const CAmount& _nFee,
                                  int64_t _nTime, unsigned int _entryHeight,
                                  bool _spendsCoinbase, int64_t _sigOpsCost, LockPoints lp):
@@ -40,6 +42,8 @@ CTxMemPoolEntry::CTxMemPoolEntry(const CTransactionRef& _tx, const CAmount& _nFe
     nSizeWithAncestors = GetTxSize();
     nModFeesWithAncestors = nFee;
     nSigOpCostWithAncestors = sigOpCost;
+
+    m_epoch = 0;
 }
 
 void CTxMemPoolEntry::UpdateFeeDelta(int64_t newFeeDelta)
@@ -64,13 +68,18 @@ size_t CTxMemPoolEntry::GetTxSize() const
 // descendants.
 void CTxMemPool::UpdateForDescendants(txiter updateIt, cacheMap &cachedDescendants, const std::set<uint256> &setExclude)
 {
-    setEntries stageEntries, setAllDescendants;
-    stageEntries = GetMemPoolChildren(updateIt);
+    const EpochGuard epoch(*this);
+    std::vector<txiter> vStageEntries, vAllDescendants;
+    for (const txiter childEntry : GetMemPoolChildren(updateIt)) {
+        if (!visited(childEntry)) {
+            vStageEntries.push_back(childEntry);
+        }
+    }
 
-    while (!stageEntries.empty()) {
-        const txiter cit = *stageEntries.begin();
-        setAllDescendants.insert(cit);
-        stageEntries.erase(cit);
+    while (!vStageEntries.empty()) {
+        const txiter cit = vStageEntries.back();
+        vStageEntries.pop_back();
+        vAllDescendants.push_back(cit);
         const setEntries &setChildren = GetMemPoolChildren(cit);
         for (const txiter childEntry : setChildren) {
             cacheMap::iterator cacheIt = cachedDescendants.find(childEntry);
@@ -78,20 +87,22 @@ void CTxMemPool::UpdateForDescendants(txiter updateIt, cacheMap &cachedDescendan
                 // We've already calculated this one, just add the entries for this set
                 // but don't traverse again.
                 for (const txiter cacheEntry : cacheIt->second) {
-                    setAllDescendants.insert(cacheEntry);
+                    if (!visited(cacheEntry)) {
+                        vAllDescendants.push_back(cacheEntry);
+                    }
                 }
-            } else if (!setAllDescendants.count(childEntry)) {
+            } else if (!visited(childEntry)) {
                 // Schedule for later processing
-                stageEntries.insert(childEntry);
+                vStageEntries.push_back(childEntry);
             }
         }
     }
-    // setAllDescendants now contains all in-mempool descendants of updateIt.
+    // vAllDescendants now contains all in-mempool descendants of updateIt, once each.
     // Update and add to cached descendant map
     int64_t modifySize = 0;
     CAmount modifyFee = 0;
     int64_t modifyCount = 0;
-    for (txiter cit : setAllDescendants) {
+    for (txiter cit : vAllDescendants) {
         if (!setExclude.count(cit->GetTx().GetHash())) {
             modifySize += cit->GetTxSize();
             modifyFee += cit->GetModifiedFee();
@@ -156,7 +167,13 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
 {
     LOCK(cs);
 
-    setEntries parentHashes;
+    const EpochGuard epoch(*this);
+    // Entries already in setAncestors are not walked again
+    for (const txiter &ancestorIt : setAncestors) {
+        visited(ancestorIt);
+    }
+
+    std::vector<txiter> vStage;
     const CTransaction &tx = entry.GetTx();
 
     if (fSearchForParents) {
@@ -165,9 +182,9 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
         // iterate mapTx to find parents.
         for (unsigned int i = 0; i < tx.vin.size(); i++) {
             txiter piter = mapTx.find(tx.vin[i].prevout.hash);
-            if (piter != mapTx.end()) {
-                parentHashes.insert(piter);
-                if (parentHashes.size() + 1 > limitAncestorCount) {
+            if (piter != mapTx.end() && !visited(piter)) {
+                vStage.push_back(piter);
+                if (vStage.size() + 1 > limitAncestorCount) {
                     errString = strprintf("too many unconfirmed parents [limit: %u]", limitAncestorCount);
                     return false;
                 }
@@ -177,16 +194,20 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
         // If we're not searching for parents, we require this to be an
         // entry in the mempool already.
         txiter it = mapTx.iterator_to(entry);
-        parentHashes = GetMemPoolParents(it);
+        for (const txiter &piter : GetMemPoolParents(it)) {
+            if (!visited(piter)) {
+                vStage.push_back(piter);
+            }
+        }
     }
 
     size_t totalSizeWithAncestors = entry.GetTxSize();
 
-    while (!parentHashes.empty()) {
-        txiter stageit = *parentHashes.begin();
+    while (!vStage.empty()) {
+        txiter stageit = vStage.back();
 
         setAncestors.insert(stageit);
-        parentHashes.erase(stageit);
+        vStage.pop_back();
         totalSizeWithAncestors += stageit->GetTxSize();
 
         if (stageit->GetSizeWithDescendants() + entry.GetTxSize() > limitDescendantSize) {
@@ -203,10 +224,10 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
         const setEntries & setMemPoolParents = GetMemPoolParents(stageit);
         for (const txiter &phash : setMemPoolParents) {
             // If this is a new ancestor, add it.
-            if (setAncestors.count(phash) == 0) {
-                parentHashes.insert(phash);
+            if (!visited(phash)) {
+                vStage.push_back(phash);
             }
-            if (parentHashes.size() + setAncestors.size() + 1 > limitAncestorCount) {
+            if (vStage.size() + setAncestors.size() + 1 > limitAncestorCount) {
                 errString = strprintf("too many unconfirmed ancestors [limit: %u]", limitAncestorCount);
                 return false;
             }
@@ -218,9 +239,8 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
 
 void CTxMemPool::UpdateAncestorsOf(bool add, txiter it, setEntries &setAncestors)
 {
-    setEntries parentIters = GetMemPoolParents(it);
     // add or remove this tx as a child of each parent
-    for (txiter piter : parentIters) {
+    for (txiter piter : GetMemPoolParents(it)) {
         UpdateChild(piter, it, add);
     }
     const int64_t updateCount = (add ? 1 : -1);
@@ -253,11 +273,32 @@ void CTxMemPool::UpdateChildrenForRemoval(txiter it)
     }
 }
 
+namespace {
+/** The sum of the changes to the state of an entry as transactions related to it are removed */
+struct RemovedStateDelta
+{
+    int64_t nSize = 0;
+    CAmount nModFees = 0;
+    int64_t nCount = 0;
+    int64_t nSigOpCost = 0;
+
+    void Subtract(const CTxMemPoolEntry& entry)
+    {
+        nSize -= entry.GetTxSize();
+        nModFees -= entry.GetModifiedFee();
+        nCount--;
+        nSigOpCost -= entry.GetSigOpCost();
+    }
+};
+} // namespace
+
 void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove, bool updateDescendants)
 {
-    // For each entry, walk back all ancestors and decrement size associated with this
-    // transaction
-    const uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+    // The changes to the state of the entries that stay in the mempool, summed over all the
+    // transactions being removed, so that each entry is modified once however many of them
+    // it is related to. The state of the entries being removed is left as it is.
+    std::map<txiter, RemovedStateDelta, CompareIteratorByHash> mapAncestorStateDeltas, mapDescendantStateDeltas;
+
     if (updateDescendants) {
         // updateDescendants should be true whenever we're not recursively
         // removing a tx and all its descendants, eg when a transaction is
@@ -266,42 +307,68 @@ void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove, b
         // we need to preserve until we're finished with all operations that
         // need to traverse the mempool).
         for (txiter removeIt : entriesToRemove) {
-            setEntries setDescendants;
-            CalculateDescendants(removeIt, setDescendants);
-            setDescendants.erase(removeIt); // don't update state for self
-            int64_t modifySize = -((int64_t)removeIt->GetTxSize());
-            CAmount modifyFee = -removeIt->GetModifiedFee();
-            int modifySigOps = -removeIt->GetSigOpCost();
-            for (txiter dit : setDescendants) {
-                mapTx.modify(dit, update_ancestor_state(modifySize, modifyFee, -1, modifySigOps));
+            const EpochGuard epoch(*this);
+            std::vector<txiter> vStage(1, removeIt);
+            visited(removeIt);
+            while (!vStage.empty()) {
+                const txiter it = vStage.back();
+                vStage.pop_back();
+                for (const txiter &childIt : GetMemPoolChildren(it)) {
+                    if (visited(childIt)) {
+                        continue;
+                    }
+                    vStage.push_back(childIt);
+                    if (!entriesToRemove.count(childIt)) {
+                        mapAncestorStateDeltas[childIt].Subtract(*removeIt);
+                    }
+                }
             }
         }
     }
     for (txiter removeIt : entriesToRemove) {
-        setEntries setAncestors;
-        const CTxMemPoolEntry &entry = *removeIt;
-        std::string dummy;
-        // Since this is a tx that is already in the mempool, we can call CMPA
-        // with fSearchForParents = false.  If the mempool is in a consistent
-        // state, then using true or false should both be correct, though false
-        // should be a bit faster.
-        // However, if we happen to be in the middle of processing a reorg, then
-        // the mempool can be in an inconsistent state.  In this case, the set
-        // of ancestors reachable via mapLinks will be the same as the set of
-        // ancestors whose packages include this transaction, because when we
-        // add a new transaction to the mempool in addUnchecked(), we assume it
-        // has no children, and in the case of a reorg where that assumption is
-        // false, the in-mempool children aren't linked to the in-block tx's
-        // until UpdateTransactionsFromBlock() is called.
+        // Walk back all ancestors and decrement size associated with this transaction.
+        // The ancestors are those reachable through mapLinks rather than those found by
+        // searching the inputs: in the middle of processing a reorg, the mempool can be in
+        // an inconsistent state.  In this case, the set of ancestors reachable via
+        // mapLinks will be the same as the set of ancestors whose packages include this
+        // transaction, because when we add a new transaction to the mempool in
+        // addUnchecked(), we assume it has no children, and in the case of a reorg where
+        // that assumption is false, the in-mempool children aren't linked to the
+        // in-block tx's until UpdateTransactionsFromBlock() is called.
         // So if we're being called during a reorg, ie before
         // UpdateTransactionsFromBlock() has been called, then mapLinks[] will
         // differ from the set of mempool parents we'd calculate by searching,
         // and it's important that we use the mapLinks[] notion of ancestor
         // transactions as the set of things to update for removal.
-        CalculateMemPoolAncestors(entry, setAncestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
-        // Note that UpdateAncestorsOf severs the child links that point to
-        // removeIt in the entries for the parents of removeIt.
-        UpdateAncestorsOf(false, removeIt, setAncestors);
+        {
+            const EpochGuard epoch(*this);
+            std::vector<txiter> vStage(1, removeIt);
+            visited(removeIt);
+            while (!vStage.empty()) {
+                const txiter it = vStage.back();
+                vStage.pop_back();
+                for (const txiter &parentIt : GetMemPoolParents(it)) {
+                    if (visited(parentIt)) {
+                        continue;
+                    }
+                    vStage.push_back(parentIt);
+                    if (!entriesToRemove.count(parentIt)) {
+                        mapDescendantStateDeltas[parentIt].Subtract(*removeIt);
+                    }
+                }
+            }
+        }
+        // Sever the child links that point to removeIt in the entries for the
+        // parents of removeIt.
+        for (const txiter &parentIt : GetMemPoolParents(removeIt)) {
+            UpdateChild(parentIt, removeIt, false);
+        }
+    }
+    for (const auto& delta : mapDescendantStateDeltas) {
+        mapTx.modify(delta.first, update_descendant_state(delta.second.nSize, delta.second.nModFees, delta.second.nCount));
+    }
+    for (const auto& delta : mapAncestorStateDeltas) {
+        mapTx.modify(delta.first, update_ancestor_state(delta.second.nSize, delta.second.nModFees, delta.second.nCount, delta.second.nSigOpCost));
     }
     // After updating all the ancestor sizes, we can now sever the link between each
     // transaction being removed and any mempool children (ie, update setMemPoolParents
@@ -332,7 +399,9 @@ void CTxMemPoolEntry::UpdateAncestorState(int64_t modifySize, CAmount modifyFee,
 }
 
 CTxMemPool::CTxMemPool(CBlockPolicyEstimator* estimator) :
-    nTransactionsUpdated(0), minerPolicyEstimator(estimator)
+    nTransactionsUpdated(0), minerPolicyEstimator(estimator),
+    mapRestricted(indexed_restricted_set::ctor_args_list(), indexed_restricted_set::allocator_type(&m_restricted_memory_resource)),
+    nAddressDeltaSequence(0), m_epoch(0), m_has_epoch_guard(false)
 {
     _clear(); //lock free clear
 
@@ -342,6 +411,20 @@ CTxMemPool::CTxMemPool(CBlockPolicyEstimator* estimator) :
     nCheckFrequency = 0;
 }
 
+CTxMemPool::EpochGuard::EpochGuard(const CTxMemPool& in) : pool(in)
+{
+    assert(!pool.m_has_epoch_guard);
+    ++pool.m_epoch;
+    pool.m_has_epoch_guard = true;
+}
+
+CTxMemPool::EpochGuard::~EpochGuard()
+{
+    // Entries touched by this traversal are older than the next one
+    ++pool.m_epoch;
+    pool.m_has_epoch_guard = false;
+}
+
 bool CTxMemPool::isSpent(const COutPoint& outpoint)
 {
     LOCK(cs);
@@ -423,30 +506,29 @@ void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewC
 {
     LOCK(cs);
     const CTransaction& tx = entry.GetTx();
-    std::vector<CMempoolAddressDeltaKey> inserted;
+    std::vector<std::pair<uint160, int> > inserted;
 
     uint256 txhash = tx.GetHash();
+    uint64_t nSequence = nAddressDeltaSequence++;
+    auto addDelta = [&](int type, const uint160& hashBytes, const std::string& assetName, unsigned int index, int spending, const CMempoolAddressDelta& delta) {
+        std::pair<uint160, int> address(hashBytes, type);
+        mapAddress[address][nSequence].emplace_back(txhash, assetName, index, spending, delta);
+        if (std::find(inserted.begin(), inserted.end(), address) == inserted.end())
+            inserted.push_back(address);
+    };
+
     for (unsigned int j = 0; j < tx.vin.size(); j++) {
         const CTxIn input = tx.vin[j];
         const CTxOut &prevout = view.AccessCoin(input.prevout).out;
         if (prevout.scriptPubKey.IsPayToScriptHash()) {
             std::vector<unsigned char> hashBytes(prevout.scriptPubKey.begin()+2, prevout.scriptPubKey.begin()+22);
-            CMempoolAddressDeltaKey key(2, uint160(hashBytes), AIDP, txhash, j, 1);
-            CMempoolAddressDelta delta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n);
-            mapAddress.insert(std::make_pair(key, delta));
-            inserted.push_back(key);
+            addDelta(2, uint160(hashBytes), AIDP, j, 1, CMempoolAddressDelta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n));
         } else if (prevout.scriptPubKey.IsPayToPublicKeyHash()) {
             std::vector<unsigned char> hashBytes(prevout.scriptPubKey.begin()+3, prevout.scriptPubKey.begin()+23);
-            CMempoolAddressDeltaKey key(1, uint160(hashBytes), AIDP, txhash, j, 1);
-            CMempoolAddressDelta delta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n);
-            mapAddress.insert(std::make_pair(key, delta));
-            inserted.push_back(key);
+            addDelta(1, uint160(hashBytes), AIDP, j, 1, CMempoolAddressDelta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n));
         } else if (prevout.scriptPubKey.IsPayToPublicKey()) {
             uint160 hashBytes(Hash160(prevout.scriptPubKey.begin()+1, prevout.scriptPubKey.end()-1));
-            CMempoolAddressDeltaKey key(1, hashBytes, AIDP, txhash, j, 1);
-            CMempoolAddressDelta delta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n);
-            mapAddress.insert(std::make_pair(key, delta));
-            inserted.push_back(key);
+            addDelta(1, hashBytes, AIDP, j, 1, CMempoolAddressDelta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n));
         } else {
             /** AIDP START */
             if (AreAssetsDeployed()) {
@@ -454,10 +536,7 @@ void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewC
                 std::string assetName;
                 CAmount assetAmount;
                 if (ParseAssetScript(prevout.scriptPubKey, hashBytes, assetName, assetAmount)) {
-                    CMempoolAddressDeltaKey key(1, hashBytes, assetName, txhash, j, 1);
-                    CMempoolAddressDelta delta(entry.GetTime(), assetAmount * -1, input.prevout.hash, input.prevout.n);
-                    mapAddress.insert(std::make_pair(key, delta));
-                    inserted.push_back(key);
+                    addDelta(1, hashBytes, assetName, j, 1, CMempoolAddressDelta(entry.GetTime(), assetAmount * -1, input.prevout.hash, input.prevout.n));
                 }
             }
             /** AIDP END */
@@ -468,21 +547,13 @@ void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewC
         const CTxOut &out = tx.vout[k];
         if (out.scriptPubKey.IsPayToScriptHash()) {
             std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+2, out.scriptPubKey.begin()+22);
-            CMempoolAddressDeltaKey key(2, uint160(hashBytes), AIDP, txhash, k, 0);
-            mapAddress.insert(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
-            inserted.push_back(key);
+            addDelta(2, uint160(hashBytes), AIDP, k, 0, CMempoolAddressDelta(entry.GetTime(), out.nValue));
         } else if (out.scriptPubKey.IsPayToPublicKeyHash()) {
             std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+3, out.scriptPubKey.begin()+23);
-            std::pair<addressDeltaMap::iterator,bool> ret;
-            CMempoolAddressDeltaKey key(1, uint160(hashBytes), AIDP, txhash, k, 0);
-            mapAddress.insert(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
-            inserted.push_back(key);
+            addDelta(1, uint160(hashBytes), AIDP, k, 0, CMempoolAddressDelta(entry.GetTime(), out.nValue));
         } else if (out.scriptPubKey.IsPayToPublicKey()) {
             uint160 hashBytes(Hash160(out.scriptPubKey.begin()+1, out.scriptPubKey.end()-1));
-            std::pair<addressDeltaMap::iterator,bool> ret;
-            CMempoolAddressDeltaKey key(1, hashBytes, AIDP, txhash, k, 0);
-            mapAddress.insert(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
-            inserted.push_back(key);
+            addDelta(1, hashBytes, AIDP, k, 0, CMempoolAddressDelta(entry.GetTime(), out.nValue));
         } else {
             /** AIDP START */
             if (AreAssetsDeployed()) {
@@ -490,17 +561,14 @@ void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewC
                 std::string assetName;
                 CAmount assetAmount;
                 if (ParseAssetScript(out.scriptPubKey, hashBytes, assetName, assetAmount)) {
-                    std::pair<addressDeltaMap::iterator, bool> ret;
-                    CMempoolAddressDeltaKey key(1, hashBytes, assetName, txhash, k, 0);
-                    mapAddress.insert(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), assetAmount)));
-                    inserted.push_back(key);
+                    addDelta(1, hashBytes, assetName, k, 0, CMempoolAddressDelta(entry.GetTime(), assetAmount));
                 }
             }
             /** AIDP END */
         }
     }
 
-    mapAddressInserted.insert(std::make_pair(txhash, inserted));
+    mapAddressInserted.insert(std::make_pair(txhash, std::make_pair(nSequence, inserted)));
 }
 
 bool CTxMemPool::getAddressIndex(std::vector<std::pair<uint160, int> > &addresses, std::string assetName,
@@ -508,12 +576,15 @@ bool CTxMemPool::getAddressIndex(std::vector<std::pair<uint160, int> > &addresse
 {
     LOCK(cs);
     for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        addressDeltaMap::iterator ait = mapAddress.lower_bound(CMempoolAddressDeltaKey((*it).second, (*it).first,
-                                                                                       assetName));
-        while (ait != mapAddress.end() && (*ait).first.addressBytes == (*it).first && (*ait).first.type == (*it).second
-                && (*ait).first.asset == assetName) {
-            results.push_back(*ait);
-            ait++;
+        addressDeltaMap::const_iterator ait = mapAddress.find(*it);
+        if (ait == mapAddress.end())
+            continue;
+        for (const auto& txdeltas : ait->second) {
+            for (const CMempoolAddressDeltaEntry& entry : txdeltas.second) {
+                if (entry.asset != assetName)
+                    continue;
+                results.push_back(std::make_pair(CMempoolAddressDeltaKey((*it).second, (*it).first, entry.asset, entry.txhash, entry.index, entry.spending), entry.delta));
+            }
         }
     }
     return true;
@@ -524,10 +595,13 @@ bool CTxMemPool::getAddressIndex(std::vector<std::pair<uint160, int> > &addresse
 {
     LOCK(cs);
     for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        addressDeltaMap::iterator ait = mapAddress.lower_bound(CMempoolAddressDeltaKey((*it).second, (*it).first));
-        while (ait != mapAddress.end() && (*ait).first.addressBytes == (*it).first && (*ait).first.type == (*it).second) {
-            results.push_back(*ait);
-            ait++;
+        addressDeltaMap::const_iterator ait = mapAddress.find(*it);
+        if (ait == mapAddress.end())
+            continue;
+        for (const auto& txdeltas : ait->second) {
+            for (const CMempoolAddressDeltaEntry& entry : txdeltas.second) {
+                results.push_back(std::make_pair(CMempoolAddressDeltaKey((*it).second, (*it).first, entry.asset, entry.txhash, entry.index, entry.spending), entry.delta));
+            }
         }
     }
     return true;
@@ -539,9 +613,13 @@ bool CTxMemPool::removeAddressIndex(const uint256 txhash)
     addressDeltaMapInserted::iterator it = mapAddressInserted.find(txhash);
 
     if (it != mapAddressInserted.end()) {
-        std::vector<CMempoolAddressDeltaKey> keys = (*it).second;
-        for (std::vector<CMempoolAddressDeltaKey>::iterator mit = keys.begin(); mit != keys.end(); mit++) {
-            mapAddress.erase(*mit);
+        for (const std::pair<uint160, int>& address : it->second.second) {
+            addressDeltaMap::iterator ait = mapAddress.find(address);
+            if (ait == mapAddress.end())
+                continue;
+            ait->second.erase(it->second.first);
+            if (ait->second.empty())
+                mapAddress.erase(ait);
         }
         mapAddressInserted.erase(it);
     }
@@ -607,8 +685,8 @@ bool CTxMemPool::removeSpentIndex(const uint256 txhash)
     mapSpentIndexInserted::iterator it = mapSpentInserted.find(txhash);
 
     if (it != mapSpentInserted.end()) {
-        std::vector<CSpentIndexKey> keys = (*it).second;
-        for (std::vector<CSpentIndexKey>::iterator mit = keys.begin(); mit != keys.end(); mit++) {
+        const std::vector<CSpentIndexKey>& keys = (*it).second;
+        for (std::vector<CSpentIndexKey>::const_iterator mit = keys.begin(); mit != keys.end(); mit++) {
             mapSpent.erase(*mit);
         }
         mapSpentInserted.erase(it);
@@ -617,6 +695,46 @@ bool CTxMemPool::removeSpentIndex(const uint256 txhash)
     return true;
 }
 
+void CTxMemPool::addRestrictedEntry(const uint256& txid, MempoolRestrictedType type, const std::string& assetName, const std::string& address)
+{
+    LOCK(cs);
+    mapRestricted.emplace(txid, type, assetName, address);
+}
+
+bool CTxMemPool::hasRestrictedEntry(MempoolRestrictedType type, const std::string& assetName) const
+{
+    LOCK(cs);
+    return mapRestricted.get<restricted_asset>().count(boost::make_tuple(type, assetName)) > 0;
+}
+
+bool CTxMemPool::hasRestrictedAddressEntry(MempoolRestrictedType type, const std::string& address, const std::string& assetName) const
+{
+    LOCK(cs);
+    return mapRestricted.get<restricted_address>().count(boost::make_tuple(type, address, assetName)) > 0;
+}
+
+void CTxMemPool::getRestrictedTxids(MempoolRestrictedType type, const std::string& assetName, std::vector<uint256>& txids) const
+{
+    LOCK(cs);
+    auto range = mapRestricted.get<restricted_asset>().equal_range(boost::make_tuple(type, assetName));
+    for (auto it = range.first; it != range.second; ++it)
+        txids.push_back(it->txid);
+}
+
+void CTxMemPool::getRestrictedAddressTxids(MempoolRestrictedType type, const std::string& address, const std::string& assetName, std::vector<uint256>& txids) const
+{
+    LOCK(cs);
+    auto range = mapRestricted.get<restricted_address>().equal_range(boost::make_tuple(type, address, assetName));
+    for (auto it = range.first; it != range.second; ++it)
+        txids.push_back(it->txid);
+}
+
+bool CTxMemPool::removeRestrictedEntries(const uint256& txid)
+{
+    LOCK(cs);
+    return mapRestricted.erase(txid) > 0;
+}
+
 void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
 {
     NotifyEntryRemoved(it->GetSharedTx(), reason);
@@ -658,72 +776,8 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
         mapHashToAsset.erase(hash);
     }
 
-    // Erase from the restricted asset mempool maps if they match txids
-    if (mapHashToAddressMarkedFrozen.count(hash)) {
-        for (auto item : mapHashToAddressMarkedFrozen.at(hash))
-            mapAddressesMarkedFrozen.at(item).erase(hash);
-        mapHashToAddressMarkedFrozen.erase(hash);
-    }
-
-    if (mapHashMarkedGlobalFrozen.count(hash)) {
-        for (auto item : mapHashMarkedGlobalFrozen.at(hash))
-            mapAssetMarkedGlobalFrozen.at(item).erase(hash);
-        mapHashMarkedGlobalFrozen.erase(hash);
-    }
-
-    if (mapHashQualifiersChanged.count(hash)) {
-        for (auto item : mapHashQualifiersChanged.at(hash))
-            mapAddressesQualifiersChanged.at(item).erase(hash);
-        mapHashQualifiersChanged.erase(hash);
-    }
-
-    if (mapHashVerifierChanged.count(hash)) {
-        for (auto item : mapHashVerifierChanged.at(hash))
-            mapAssetVerifierChanged.at(item).erase(hash);
-        mapHashVerifierChanged.erase(hash);
-    }
-
-    if (mapHashGlobalFreezingAssetTransactions.count(hash)) {
-        for (auto item : mapHashGlobalFreezingAssetTransactions.at(hash)) {
-            if (mapGlobalFreezingAssetTransactions.count(item)) {
-                mapGlobalFreezingAssetTransactions.at(item).erase(hash);
-                if (mapGlobalFreezingAssetTransactions.at(item).size() == 0)
-                    mapGlobalFreezingAssetTransactions.erase(item);
-            }
-        }
-        mapHashGlobalFreezingAssetTransactions.erase(hash);
-    }
-
-    if (mapHashGlobalUnFreezingAssetTransactions.count(hash)) {
-        for (auto item : mapHashGlobalUnFreezingAssetTransactions.at(hash)) {
-            if (mapGlobalUnFreezingAssetTransactions.count(item)) {
-                mapGlobalUnFreezingAssetTransactions.at(item).erase(hash);
-                if (mapGlobalUnFreezingAssetTransactions.at(item).size() == 0)
-                    mapGlobalUnFreezingAssetTransactions.erase(item);
-            }
-        }
-        mapHashGlobalUnFreezingAssetTransactions.erase(hash);
-    }
-
-    if (mapHashToAddressAddedTag.count(hash)) {
-        for (auto item : mapHashToAddressAddedTag.at(hash)) {
-            if (mapAddressAddedTag.count(item)) {
-                mapAddressAddedTag.at(item).erase(hash);
-                if (mapAddressAddedTag.at(item).size() == 0)
-                    mapAddressAddedTag.erase(item);
-            }
-        }
-    }
-
-    if (mapHashToAddressRemoveTag.count(hash)) {
-        for (auto item : mapHashToAddressRemoveTag.at(hash)) {
-            if (mapAddressRemoveTag.count(item)) {
-                mapAddressRemoveTag.at(item).erase(hash);
-                if (mapAddressRemoveTag.at(item).size() == 0)
-                    mapAddressRemoveTag.erase(item);
-            }
-        }
-    }
+    // Erase from the restricted asset mempool records if they match txid
+    removeRestrictedEntries(hash);
     /** AIDP END */
 }
 
@@ -735,22 +789,21 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
 // can save time by not iterating over those entries.
 void CTxMemPool::CalculateDescendants(txiter entryit, setEntries& setDescendants) const
 {
-    setEntries stage;
-    if (setDescendants.count(entryit) == 0) {
-        stage.insert(entryit);
+    std::vector<txiter> vStage;
+    if (setDescendants.insert(entryit).second) {
+        vStage.push_back(entryit);
     }
     // Traverse down the children of entry, only adding children that are not
     // accounted for in setDescendants already (because those children have either
     // already been walked, or will be walked in this iteration).
-    while (!stage.empty()) {
-        txiter it = *stage.begin();
-        setDescendants.insert(it);
-        stage.erase(it);
+    while (!vStage.empty()) {
+        txiter it = vStage.back();
+        vStage.pop_back();
 
         const setEntries &setChildren = GetMemPoolChildren(it);
         for (const txiter &childiter : setChildren) {
-            if (!setDescendants.count(childiter)) {
-                stage.insert(childiter);
+            if (setDescendants.insert(childiter).second) {
+                vStage.push_back(childiter);
             }
         }
     }
@@ -885,32 +938,32 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigne
     }
 
     for (auto it : connectedBlockData.newVerifiersToAdd) {
-        if (mapAssetVerifierChanged.count(it.assetName)) {
-            for (auto hash : mapAssetVerifierChanged.at(it.assetName)) {
-                indexed_transaction_set::iterator i = mapTx.find(hash);
-                if (i != mapTx.end()) {
-                    CValidationState state;
-                    if (!setAlreadyRemoving.count(hash) && !CheckTransaction(i->GetTx(), state, passets)) {
-                        entries.push_back(&*i);
-                        trans.emplace_back(i->GetTx());
-                        setAlreadyRemoving.insert(hash);
-                    }
+        std::vector<uint256> txids;
+        getRestrictedTxids(MempoolRestrictedType::VERIFIER_CHANGED, it.assetName, txids);
+        for (auto hash : txids) {
+            indexed_transaction_set::iterator i = mapTx.find(hash);
+            if (i != mapTx.end()) {
+                CValidationState state;
+                if (!setAlreadyRemoving.count(hash) && !CheckTransaction(i->GetTx(), state, passets)) {
+                    entries.push_back(&*i);
+                    trans.emplace_back(i->GetTx());
+                    setAlreadyRemoving.insert(hash);
                 }
             }
         }
     }
 
     for (auto it : connectedBlockData.newQualifiersToAdd) {
-        if (mapAddressesQualifiersChanged.count(it.address)) {
-            for (auto hash : mapAddressesQualifiersChanged.at(it.address)) {
-                indexed_transaction_set::iterator i = mapTx.find(hash);
-                if (i != mapTx.end()) {
-                    CValidationState state;
-                    if (!setAlreadyRemoving.count(hash) && !CheckTransaction(i->GetTx(), state, passets)) {
-                        entries.push_back(&*i);
-                        trans.emplace_back(i->GetTx());
-                        setAlreadyRemoving.insert(hash);
-                    }
+        std::vector<uint256> txids;
+        getRestrictedAddressTxids(MempoolRestrictedType::QUALIFIERS_CHANGED, it.address, "", txids);
+        for (auto hash : txids) {
+            indexed_transaction_set::iterator i = mapTx.find(hash);
+            if (i != mapTx.end()) {
+                CValidationState state;
+                if (!setAlreadyRemoving.count(hash) && !CheckTransaction(i->GetTx(), state, passets)) {
+                    entries.push_back(&*i);
+                    trans.emplace_back(i->GetTx());
+                    setAlreadyRemoving.insert(hash);
                 }
             }
         }
@@ -918,44 +971,42 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigne
 
     for (auto it : connectedBlockData.newGlobalRestrictionsToAdd) {
         if (it.type == RestrictedType::GLOBAL_FREEZE) {
-            if (mapAssetMarkedGlobalFrozen.count(it.assetName)) {
-                for (auto hash : mapAssetMarkedGlobalFrozen.at(it.assetName)) {
-                    indexed_transaction_set::iterator i = mapTx.find(hash);
-                    if (i != mapTx.end()) {
-                        CValidationState state;
-                        if (!setAlreadyRemoving.count(hash) && !CheckTransaction(i->GetTx(), state, passets)) {
-                            entries.push_back(&*i);
-                            trans.emplace_back(i->GetTx());
-                            setAlreadyRemoving.insert(hash);
-                        }
+            std::vector<uint256> txids;
+            getRestrictedTxids(MempoolRestrictedType::ASSET_GLOBAL_FROZEN, it.assetName, txids);
+            for (auto hash : txids) {
+                indexed_transaction_set::iterator i = mapTx.find(hash);
+                if (i != mapTx.end()) {
+                    CValidationState state;
+                    if (!setAlreadyRemoving.count(hash) && !CheckTransaction(i->GetTx(), state, passets)) {
+                        entries.push_back(&*i);
+                        trans.emplace_back(i->GetTx());
+                        setAlreadyRemoving.insert(hash);
                     }
                 }
             }
 
-            if (mapGlobalFreezingAssetTransactions.count(it.assetName)) {
-                for (auto hash : mapGlobalFreezingAssetTransactions.at(it.assetName)) {
-                    indexed_transaction_set::iterator i = mapTx.find(hash);
-                    if (i != mapTx.end()) {
-                        CValidationState state;
-                        if (!setAlreadyRemoving.count(hash)) {
-                            entries.push_back(&*i);
-                            trans.emplace_back(i->GetTx());
-                            setAlreadyRemoving.insert(hash);
-                        }
+            txids.clear();
+            getRestrictedTxids(MempoolRestrictedType::GLOBAL_FREEZING, it.assetName, txids);
+            for (auto hash : txids) {
+                indexed_transaction_set::iterator i = mapTx.find(hash);
+                if (i != mapTx.end()) {
+                    if (!setAlreadyRemoving.count(hash)) {
+                        entries.push_back(&*i);
+                        trans.emplace_back(i->GetTx());
+                        setAlreadyRemoving.insert(hash);
                     }
                 }
             }
         } else if (it.type == RestrictedType::GLOBAL_UNFREEZE) {
-            if (mapGlobalUnFreezingAssetTransactions.count(it.assetName)) {
-                for (auto hash : mapGlobalUnFreezingAssetTransactions.at(it.assetName)) {
-                    indexed_transaction_set::iterator i = mapTx.find(hash);
-                    if (i != mapTx.end()) {
-                        CValidationState state;
-                        if (!setAlreadyRemoving.count(hash)) {
-                            entries.push_back(&*i);
-                            trans.emplace_back(i->GetTx());
-                            setAlreadyRemoving.insert(hash);
-                        }
+            std::vector<uint256> txids;
+            getRestrictedTxids(MempoolRestrictedType::GLOBAL_UNFREEZING, it.assetName, txids);
+            for (auto hash : txids) {
+                indexed_transaction_set::iterator i = mapTx.find(hash);
+                if (i != mapTx.end()) {
+                    if (!setAlreadyRemoving.count(hash)) {
+                        entries.push_back(&*i);
+                        trans.emplace_back(i->GetTx());
+                        setAlreadyRemoving.insert(hash);
                     }
                 }
             }
@@ -964,18 +1015,17 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigne
 
     for (auto it : connectedBlockData.newAddressRestrictionsToAdd) {
         if (it.type == RestrictedType::FREEZE_ADDRESS) {
-            auto pair = std::make_pair(it.address, it.assetName);
-            if (mapAddressesMarkedFrozen.count(pair)) {
-                for (auto hash : mapAddressesMarkedFrozen.at(pair)) {
-                    indexed_transaction_set::iterator i = mapTx.find(hash);
-                    if (i != mapTx.end()) {
-                        CValidationState state;
-                        std::vector<std::pair<std::string, uint256>> vReissueAssets;
-                        if (!setAlreadyRemoving.count(hash) && !Consensus::CheckTxAssets(i->GetTx(), state, pcoinsTip, passets, false, vReissueAssets)) {
-                            entries.push_back(&*i);
-                            trans.emplace_back(i->GetTx());
-                            setAlreadyRemoving.insert(hash);
-                        }
+            std::vector<uint256> txids;
+            getRestrictedAddressTxids(MempoolRestrictedType::ADDRESS_FROZEN, it.address, it.assetName, txids);
+            for (auto hash : txids) {
+                indexed_transaction_set::iterator i = mapTx.find(hash);
+                if (i != mapTx.end()) {
+                    CValidationState state;
+                    std::vector<std::pair<std::string, uint256>> vReissueAssets;
+                    if (!setAlreadyRemoving.count(hash) && !Consensus::CheckTxAssets(i->GetTx(), state, pcoinsTip, passets, false, vReissueAssets)) {
+                        entries.push_back(&*i);
+                        trans.emplace_back(i->GetTx());
+                        setAlreadyRemoving.insert(hash);
                     }
                 }
             }
@@ -985,14 +1035,19 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigne
 
     // Before the txs in the new block have been removed from the mempool, update policy estimates
     if (minerPolicyEstimator) {minerPolicyEstimator->processBlock(nBlockHeight, entries);}
+    // The block's transactions are removed together, so that the state of a chain of them
+    // and of what depends on it is updated once rather than once per transaction.
+    setEntries stageBlock;
     for (const auto& tx : vtx)
     {
         txiter it = mapTx.find(tx->GetHash());
         if (it != mapTx.end()) {
-            setEntries stage;
-            stage.insert(it);
-            RemoveStaged(stage, true, MemPoolRemovalReason::BLOCK);
+            stageBlock.insert(it);
         }
+    }
+    RemoveStaged(stageBlock, true, MemPoolRemovalReason::BLOCK);
+    for (const auto& tx : vtx)
+    {
         removeConflicts(*tx);
         ClearPrioritisation(tx->GetHash());
     }
@@ -1030,25 +1085,7 @@ void CTxMemPool::_clear()
     mapAssetToHash.clear();
     mapHashToAsset.clear();
 
-    mapAddressesMarkedFrozen.clear();
-    mapHashToAddressMarkedFrozen.clear();
-    mapAssetMarkedGlobalFrozen.clear();
-    mapHashMarkedGlobalFrozen.clear();
-    mapAddressesQualifiersChanged.clear();
-    mapHashQualifiersChanged.clear();
-    mapAssetVerifierChanged.clear();
-    mapHashVerifierChanged.clear();
-
-    mapHashToAddressAddedTag.clear();
-    mapAddressAddedTag.clear();
-    mapHashToAddressRemoveTag.clear();
-    mapAddressRemoveTag.clear();
-
-    mapGlobalFreezingAssetTransactions.clear();
-    mapHashGlobalFreezingAssetTransactions.clear();
-
-    mapGlobalUnFreezingAssetTransactions.clear();
-    mapHashGlobalUnFreezingAssetTransactions.clear();
+    mapRestricted.clear();
 }
 
 void CTxMemPool::clear()
@@ -1253,7 +1290,7 @@ void CTxMemPool::queryHashes(std::vector<uint256>& vtxid)
 }
 
 static TxMempoolInfo GetInfo(CTxMemPool::indexed_transaction_set::const_iterator it) {
-    return TxMempoolInfo{it->GetSharedTx(), it->GetTime(), CFeeRate(it->GetFee(), it->GetTxSize()), it->GetModifiedFee() - it->GetFee()};
+    return TxMempoolInfo{it->GetSharedTx(), it->GetTime(), CFeeRate(it->GetFee(), it->GetTxSize()), it->GetModifiedFee() - it->GetFee(), it->GetFee(), it->GetSigOpCost()};
 }
 
 std::vector<TxMempoolInfo> CTxMemPool::infoAll() const
@@ -1519,3 +1556,13 @@ bool CTxMemPool::TransactionWithinChainLimit(const uint256& txid, size_t chainLi
 }
 
 SaltedTxidHasher::SaltedTxidHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+SaltedAddressHasher::SaltedAddressHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+size_t SaltedAddressHasher::operator()(const std::pair<uint160, int>& address) const
+{
+    // The whole words go first: CSipHasher takes no word after a byte count that is not a multiple of 8
+    return CSipHasher(k0, k1).Write(address.second).Write(address.first.begin(), address.first.size()).Finalize();
+}
+
+SaltedSpentIndexKeyHasher::SaltedSpentIndexKeyHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
@@ -8,12 +8,15 @@
 #ifndef AIDP_TXMEMPOOL_H
 #define AIDP_TXMEMPOOL_H
 
+#include <algorithm>
+#include <assert.h>
 #include <memory>
 #include <set>
 #include <map>
 #include <vector>
 #include <utility>
 #include <string>
+#include <unordered_map>
 
 #include "addressindex.h"
 #include "spentindex.h"
@@ -24,9 +27,12 @@
 #include "primitives/transaction.h"
 #include "sync.h"
 #include "random.h"
+#include "support/allocators/pool.h"
 
 #include <boost/multi_index_container.hpp>
+#include <boost/multi_index/composite_key.hpp>
 #include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/sequenced_index.hpp>
 #include <boost/signals2/signal.hpp>
@@ -133,6 +139,7 @@ public:
     int64_t GetSigOpCostWithAncestors() const { return nSigOpCostWithAncestors; }
 
     mutable size_t vTxHashesIdx; //!< Index in mempool's vTxHashes
+    mutable uint64_t m_epoch; //!< Last traversal of the mempool that reached this entry, see CTxMemPool::visited
 };
 
 // Helpers for modifying CTxMemPool::mapTx, which is a boost multi_index.
@@ -313,6 +320,12 @@ struct TxMempoolInfo
 
     /** The fee delta. */
     int64_t nFeeDelta;
+
+    /** The fee paid, without the fee delta. */
+    CAmount nFee;
+
+    /** Signature operation cost of the transaction. */
+    int64_t nSigOpCost;
 };
 
 /** Reason why a transaction was removed from the mempool,
@@ -342,6 +355,130 @@ public:
     }
 };
 
+/** Hasher for the (hash, type) addresses of the mempool address index */
+class SaltedAddressHasher
+{
+private:
+    /** Salt */
+    const uint64_t k0, k1;
+
+public:
+    SaltedAddressHasher();
+
+    size_t operator()(const std::pair<uint160, int>& address) const;
+};
+
+/** Hasher for the outpoints of the mempool spent index */
+class SaltedSpentIndexKeyHasher
+{
+private:
+    /** Salt */
+    const uint64_t k0, k1;
+
+public:
+    SaltedSpentIndexKeyHasher();
+
+    size_t operator()(const CSpentIndexKey& key) const {
+        return SipHashUint256Extra(k0, k1, key.txid, key.outputIndex);
+    }
+};
+
+/**
+ * A mempool address delta, kept in the bucket of its address so the address and its type are
+ * not repeated in every entry.
+ */
+struct CMempoolAddressDeltaEntry
+{
+    uint256 txhash;
+    std::string asset;
+    unsigned int index;
+    int spending;
+    CMempoolAddressDelta delta;
+
+    CMempoolAddressDeltaEntry(const uint256& hash, const std::string& assetName, unsigned int i, int s, const CMempoolAddressDelta& d)
+        : txhash(hash), asset(assetName), index(i), spending(s), delta(d) {}
+};
+
+/** AIDP START */
+/**
+ * Kinds of restricted asset bookkeeping kept for mempool transactions. Each kind
+ * is keyed either by asset name, by address, or by an (address, asset) pair.
+ */
+enum class MempoolRestrictedType : uint8_t {
+    ADDRESS_FROZEN,      //!< Spends a restricted asset from (address, asset), invalidated if the address is frozen
+    ASSET_GLOBAL_FROZEN, //!< Spends a restricted asset, invalidated if the asset is globally frozen
+    QUALIFIERS_CHANGED,  //!< Sends a restricted asset to address, invalidated if the address qualifiers change
+    VERIFIER_CHANGED,    //!< Sends a restricted asset, invalidated if its verifier string changes
+    GLOBAL_FREEZING,     //!< Globally freezes the asset
+    GLOBAL_UNFREEZING,   //!< Globally unfreezes the asset
+    ADDED_TAG,           //!< Adds the qualifier asset to (address, qualifier)
+    REMOVED_TAG,         //!< Removes the qualifier asset from (address, qualifier)
+};
+
+/**
+ * One restricted asset record of a mempool transaction. Kinds keyed only by asset
+ * leave address empty, kinds keyed only by address leave assetName empty.
+ */
+struct CMempoolRestrictedEntry
+{
+    uint256 txid;
+    MempoolRestrictedType type;
+    std::string assetName;
+    std::string address;
+
+    CMempoolRestrictedEntry(const uint256& txidIn, MempoolRestrictedType typeIn, const std::string& assetNameIn, const std::string& addressIn)
+        : txid(txidIn), type(typeIn), assetName(assetNameIn), address(addressIn) {}
+};
+
+// Multi_index tag names
+struct restricted_txid {};
+struct restricted_asset {};
+struct restricted_address {};
+
+/**
+ * All restricted asset records of the mempool in a single container, so every
+ * record is one allocation and removing a transaction is a single txid lookup.
+ * The nodes come from a PoolResource owned by the mempool, so the records a block
+ * removes are reused by the transactions that arrive next instead of going back to
+ * the heap. The block size covers the record plus the links of the three indexes.
+ */
+typedef boost::multi_index_container<
+    CMempoolRestrictedEntry,
+    boost::multi_index::indexed_by<
+        // hashed by txid, used when the transaction leaves the mempool
+        boost::multi_index::hashed_non_unique<
+            boost::multi_index::tag<restricted_txid>,
+            boost::multi_index::member<CMempoolRestrictedEntry, uint256, &CMempoolRestrictedEntry::txid>,
+            SaltedTxidHasher
+        >,
+        // sorted by kind and asset name, also deduplicates records
+        boost::multi_index::ordered_unique<
+            boost::multi_index::tag<restricted_asset>,
+            boost::multi_index::composite_key<
+                CMempoolRestrictedEntry,
+                boost::multi_index::member<CMempoolRestrictedEntry, MempoolRestrictedType, &CMempoolRestrictedEntry::type>,
+                boost::multi_index::member<CMempoolRestrictedEntry, std::string, &CMempoolRestrictedEntry::assetName>,
+                boost::multi_index::member<CMempoolRestrictedEntry, std::string, &CMempoolRestrictedEntry::address>,
+                boost::multi_index::member<CMempoolRestrictedEntry, uint256, &CMempoolRestrictedEntry::txid>
+            >
+        >,
+        // sorted by kind, address and asset name
+        boost::multi_index::ordered_non_unique<
+            boost::multi_index::tag<restricted_address>,
+            boost::multi_index::composite_key<
+                CMempoolRestrictedEntry,
+                boost::multi_index::member<CMempoolRestrictedEntry, MempoolRestrictedType, &CMempoolRestrictedEntry::type>,
+                boost::multi_index::member<CMempoolRestrictedEntry, std::string, &CMempoolRestrictedEntry::address>,
+                boost::multi_index::member<CMempoolRestrictedEntry, std::string, &CMempoolRestrictedEntry::assetName>
+            >
+        >
+    >,
+    PoolAllocator<CMempoolRestrictedEntry, sizeof(CMempoolRestrictedEntry) + sizeof(void*) * 8>
+> indexed_restricted_set;
+
+typedef indexed_restricted_set::allocator_type::ResourceType CMempoolRestrictedMemoryResource;
+/** AIDP END */
+
 /**
  * CTxMemPool stores valid-according-to-the-current-best-chain transactions
  * that may be included in the next block.
@@ -472,37 +609,9 @@ public:
     std::map<std::string, uint256> mapAssetToHash;
     std::map<uint256, std::string> mapHashToAsset;
 
-    /** Restricted assets maps */
-    // Helper maps for when addresses are marked as frozen
-    std::map<std::pair<std::string, std::string>, std::set<uint256> > mapAddressesMarkedFrozen;
-    std::map<uint256, std::set<std::pair<std::string, std::string>>> mapHashToAddressMarkedFrozen;
-
-    // Helper maps for when restricted assets are globally frozen
-    std::map<std::string, std::set<uint256>> mapAssetMarkedGlobalFrozen;
-    std::map<uint256, std::set<std::string>> mapHashMarkedGlobalFrozen;
-
-    // Helper maps for when qualifiers are added or removed from addresses
-    std::map<std::string, std::set<uint256>> mapAddressesQualifiersChanged;
-    std::map<uint256, std::set<std::string>> mapHashQualifiersChanged;
-
-    // Helper maps for when verifier string are changed
-    std::map<std::string, std::set<uint256>> mapAssetVerifierChanged;
-    std::map<uint256, std::set<std::string>> mapHashVerifierChanged;
-
-    // Helper map for when an asset already in mempool that is globally freezing
-    std::map<std::string, std::set<uint256>> mapGlobalFreezingAssetTransactions;
-    std::map<uint256, std::set<std::string>> mapHashGlobalFreezingAssetTransactions;
-
-    // Helper map for when a qualfier is added to an address
-    std::map<std::pair<std::string, std::string>, std::set<uint256> > mapAddressAddedTag;
-    std::map<uint256, std::set<std::pair<std::string, std::string>>> mapHashToAddressAddedTag;
-
-    // Helper map for when a qualfier is added to an address
-    std::map<std::pair<std::string, std::string>, std::set<uint256> > mapAddressRemoveTag;
-    std::map<uint256, std::set<std::pair<std::string, std::string>>> mapHashToAddressRemoveTag;
-
-    std::map<std::string, std::set<uint256>> mapGlobalUnFreezingAssetTransactions;
-    std::map<uint256, std::set<std::string>> mapHashGlobalUnFreezingAssetTransactions;
+    /** Restricted assets records, see MempoolRestrictedType */
+    CMempoolRestrictedMemoryResource m_restricted_memory_resource;
+    indexed_restricted_set mapRestricted;
 
     typedef indexed_transaction_set::nth_index<0>::type::iterator txiter;
     std::vector<std::pair<uint256, txiter> > vTxHashes; //!< All tx witness hashes/entries in mapTx, in random order
@@ -527,16 +636,21 @@ private:
     typedef std::map<txiter, TxLinks, CompareIteratorByHash> txlinksMap;
     txlinksMap mapLinks;
 
-    typedef std::map<CMempoolAddressDeltaKey, CMempoolAddressDelta, CMempoolAddressDeltaKeyCompare> addressDeltaMap;
+    //! Deltas of each (hash, type) address, by the order their transactions entered the pool in,
+    //! so those of a transaction are taken out without going through the others
+    typedef std::map<uint64_t, std::vector<CMempoolAddressDeltaEntry> > addressDeltaBucket;
+    typedef std::unordered_map<std::pair<uint160, int>, addressDeltaBucket, SaltedAddressHasher> addressDeltaMap;
     addressDeltaMap mapAddress;
 
-    typedef std::map<uint256, std::vector<CMempoolAddressDeltaKey> > addressDeltaMapInserted;
+    //! The order each transaction entered the address index in, and the addresses it has deltas for
+    typedef std::unordered_map<uint256, std::pair<uint64_t, std::vector<std::pair<uint160, int> > >, SaltedTxidHasher> addressDeltaMapInserted;
     addressDeltaMapInserted mapAddressInserted;
+    uint64_t nAddressDeltaSequence;
 
-    typedef std::map<CSpentIndexKey, CSpentIndexValue, CSpentIndexKeyCompare> mapSpentIndex;
+    typedef std::unordered_map<CSpentIndexKey, CSpentIndexValue, SaltedSpentIndexKeyHasher> mapSpentIndex;
     mapSpentIndex mapSpent;
 
-    typedef std::map<uint256, std::vector<CSpentIndexKey> > mapSpentIndexInserted;
+    typedef std::unordered_map<uint256, std::vector<CSpentIndexKey>, SaltedTxidHasher> mapSpentIndexInserted;
     mapSpentIndexInserted mapSpentInserted;
 
     void UpdateParent(txiter entry, txiter parent, bool add);
@@ -544,6 +658,34 @@ private:
 
     std::vector<indexed_transaction_set::const_iterator> GetSortedDepthAndScore() const;
 
+    //! Traversals of the mempool graph so far, and whether one is under way
+    mutable uint64_t m_epoch;
+    mutable bool m_has_epoch_guard;
+
+    /**
+     * Starts a traversal of the mempool graph for as long as it is in scope. Entries reached
+     * during the traversal are marked with visited() rather than collected in a set, which
+     * saves a lookup and an allocation per entry on long chains. Traversals do not nest.
+     */
+    class EpochGuard
+    {
+    public:
+        explicit EpochGuard(const CTxMemPool& in);
+        ~EpochGuard();
+
+    private:
+        const CTxMemPool& pool;
+    };
+
+    /** Whether the current traversal reached it before; marks it as reached. Requires an EpochGuard. */
+    bool visited(txiter it) const
+    {
+        assert(m_has_epoch_guard);
+        bool ret = it->m_epoch >= m_epoch;
+        it->m_epoch = std::max(it->m_epoch, m_epoch);
+        return ret;
+    }
+
 public:
     indirectmap<COutPoint, const CTransaction*> mapNextTx;
     std::map<uint256, CAmount> mapDeltas;
@@ -579,6 +721,13 @@ public:
     bool getSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
     bool removeSpentIndex(const uint256 txhash);
 
+    void addRestrictedEntry(const uint256& txid, MempoolRestrictedType type, const std::string& assetName, const std::string& address = "");
+    bool hasRestrictedEntry(MempoolRestrictedType type, const std::string& assetName) const;
+    bool hasRestrictedAddressEntry(MempoolRestrictedType type, const std::string& address, const std::string& assetName = "") const;
+    void getRestrictedTxids(MempoolRestrictedType type, const std::string& assetName, std::vector<uint256>& txids) const;
+    void getRestrictedAddressTxids(MempoolRestrictedType type, const std::string& address, const std::string& assetName, std::vector<uint256>& txids) const;
+    bool removeRestrictedEntries(const uint256& txid);
+
     void removeRecursive(const CTransaction &tx, MemPoolRemovalReason reason = MemPoolRemovalReason::UNKNOWN);
     void removeForReorg(const CCoinsViewCache *pcoins, unsigned int nMemPoolHeight, int flags);
     void removeConflicts(const CTransaction &tx);
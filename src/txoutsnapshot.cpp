@@ -0,0 +1,542 @@
+// Copyright (c) 2023-2024 The Aidp Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "txoutsnapshot.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "clientversion.h"
+#include "coins.h"
+#include "coinsprefetch.h"
+#include "dbwrapper.h"
+#include "hash.h"
+#include "streams.h"
+#include "txdb.h"
+#include "util.h"
+#include "validation.h"
+#include "assets/assetdb.h"
+#include "assets/restricteddb.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+static const unsigned char TXOUT_SNAPSHOT_MAGIC[5] = {'a', 'u', 't', 'x', 0xff};
+
+//! Coins per chunk in the file
+static const size_t TXOUT_SNAPSHOT_CHUNK_COINS = 4096;
+//! Asset records per chunk in the file
+static const size_t TXOUT_SNAPSHOT_CHUNK_RECORDS = 1024;
+//! Chunks parsed ahead of the database writers while loading
+static const size_t TXOUT_SNAPSHOT_LOAD_QUEUE = 8;
+//! Most threads writing a snapshot into the databases
+static const int TXOUT_SNAPSHOT_LOAD_THREADS = 4;
+
+enum SnapshotDatabase : uint8_t {
+    SNAPSHOT_DB_ASSETS = 1,
+    SNAPSHOT_DB_RESTRICTED = 2,
+};
+
+// Key prefixes of the chain derived records copied into a snapshot (see assets/assetdb.cpp and
+// assets/restricteddb.cpp). The rest of those databases (wallet assets, undo data, mempool
+// state, flags) is local to a node.
+static const std::string ASSETS_DB_PREFIXES = "A";
+static const std::string ASSET_INDEX_PREFIXES = "BC";
+static const std::string RESTRICTED_DB_PREFIXES = "VTQRG";
+
+/** A raw record of one of the asset databases. */
+struct CTxOutSnapshotRecord
+{
+    uint8_t nDatabase;
+    std::vector<unsigned char> vchKey;
+    std::vector<unsigned char> vchValue;
+
+    CTxOutSnapshotRecord() : nDatabase(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nDatabase);
+        READWRITE(vchKey);
+        READWRITE(vchValue);
+    }
+};
+
+typedef std::vector<std::pair<COutPoint, Coin> > CoinsChunk;
+typedef std::vector<CTxOutSnapshotRecord> RecordsChunk;
+
+uint256 CTxOutSnapshotHashes::GetSnapshotHash() const
+{
+    return Hash(hashSerialized.begin(), hashSerialized.end(), hashAssets.begin(), hashAssets.end());
+}
+
+static bool IsAssetIndexRecord(const CTxOutSnapshotRecord& record)
+{
+    return record.nDatabase == SNAPSHOT_DB_ASSETS && !record.vchKey.empty() &&
+           ASSET_INDEX_PREFIXES.find((char)record.vchKey[0]) != std::string::npos;
+}
+
+//! Whether db holds any record under one of prefixes, leaving out the asset undo version marker
+static bool HaveRecords(CDBWrapper& db, const std::string& prefixes)
+{
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+    for (char prefix : prefixes) {
+        for (pcursor->Seek(prefix); pcursor->Valid(); pcursor->Next()) {
+            CDBRawData key;
+            if (!pcursor->GetKey(key) || key.data.empty() || key.data[0] != (unsigned char)prefix)
+                break;
+            if (!CAssetsDB::IsUndoVersionKey(key.data))
+                return true;
+        }
+    }
+    return false;
+}
+
+template <typename Stream>
+static void DumpRecords(Stream& file, CHashWriter& ssAssets, CDBIterator* pcursor, uint8_t nDatabase,
+                        const std::string& prefixes, uint64_t& nRecords)
+{
+    RecordsChunk chunk;
+    for (char prefix : prefixes) {
+        for (pcursor->Seek(prefix); pcursor->Valid(); pcursor->Next()) {
+            boost::this_thread::interruption_point();
+            CDBRawData key;
+            if (!pcursor->GetKey(key) || key.data.empty() || key.data[0] != (unsigned char)prefix)
+                break;
+            // A format marker of the database, not asset state
+            if (CAssetsDB::IsUndoVersionKey(key.data))
+                continue;
+            CDBRawData value;
+            if (!pcursor->GetValue(value))
+                throw std::runtime_error("unable to read asset database value");
+
+            CTxOutSnapshotRecord record;
+            record.nDatabase = nDatabase;
+            record.vchKey = std::move(key.data);
+            record.vchValue = std::move(value.data);
+            ssAssets << record;
+            chunk.push_back(std::move(record));
+            nRecords++;
+            if (chunk.size() == TXOUT_SNAPSHOT_CHUNK_RECORDS) {
+                file << chunk;
+                chunk.clear();
+            }
+        }
+    }
+    if (!chunk.empty())
+        file << chunk;
+}
+
+bool DumpTxOutSnapshot(const fs::path& path, CTxOutSnapshotMetadata& metadata, CTxOutSnapshotHashes& hashes, std::string& strError)
+{
+    int64_t nStart = GetTimeMillis();
+
+    std::unique_ptr<CCoinsViewCursor> pcursor;
+    std::unique_ptr<CDBIterator> passetscursor;
+    std::unique_ptr<CDBIterator> prestrictedcursor;
+    {
+        LOCK(cs_main);
+        if (!passetsdb || !prestricteddb) {
+            strError = "asset databases are not loaded";
+            return false;
+        }
+
+        // Put all caches on disk, then take point-in-time iterators over the databases. The
+        // dump itself then runs without cs_main while the node keeps processing blocks.
+        FlushStateToDisk();
+        pcursor.reset(pcoinsdbview->Cursor());
+        passetscursor.reset(passetsdb->NewIterator());
+        prestrictedcursor.reset(prestricteddb->NewIterator());
+
+        metadata.SetNull();
+        memcpy(metadata.pchMessageStart, GetParams().MessageStart(), sizeof(metadata.pchMessageStart));
+        metadata.hashBase = pcursor->GetBestBlock();
+        BlockMap::iterator mi = mapBlockIndex.find(metadata.hashBase);
+        if (mi == mapBlockIndex.end()) {
+            strError = "coin database best block is not in the block index";
+            return false;
+        }
+        metadata.nHeight = mi->second->nHeight;
+        metadata.fAssetIndex = fAssetIndex;
+    }
+
+    fs::path pathTemp = path.string() + ".incomplete";
+    CAutoFile afile(fsbridge::fopen(pathTemp, "wb"), SER_DISK, CLIENT_VERSION);
+    if (afile.IsNull()) {
+        strError = strprintf("unable to open %s for writing", pathTemp.string());
+        return false;
+    }
+
+    try {
+        CHashedWriter<CAutoFile> file(&afile);
+        file << FLATDATA(TXOUT_SNAPSHOT_MAGIC);
+        file << metadata;
+
+        hashes = CTxOutSnapshotHashes();
+        CCoinsSetHasher hasher(metadata.hashBase);
+        CoinsChunk chunk;
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            COutPoint key;
+            Coin coin;
+            if (!pcursor->GetKey(key) || !pcursor->GetValue(coin))
+                throw std::runtime_error("unable to read coin database");
+            hasher.Add(key, coin);
+            chunk.emplace_back(key, std::move(coin));
+            hashes.nCoins++;
+            if (chunk.size() == TXOUT_SNAPSHOT_CHUNK_COINS) {
+                file << chunk;
+                chunk.clear();
+            }
+            pcursor->Next();
+        }
+        if (!chunk.empty())
+            file << chunk;
+        file << CoinsChunk();
+        hashes.hashSerialized = hasher.GetHash();
+
+        CHashWriter ssAssets(SER_GETHASH, PROTOCOL_VERSION);
+        DumpRecords(file, ssAssets, passetscursor.get(), SNAPSHOT_DB_ASSETS, ASSETS_DB_PREFIXES, hashes.nAssetRecords);
+        if (metadata.fAssetIndex)
+            DumpRecords(file, ssAssets, passetscursor.get(), SNAPSHOT_DB_ASSETS, ASSET_INDEX_PREFIXES, hashes.nAssetRecords);
+        DumpRecords(file, ssAssets, prestrictedcursor.get(), SNAPSHOT_DB_RESTRICTED, RESTRICTED_DB_PREFIXES, hashes.nAssetRecords);
+        file << RecordsChunk();
+        hashes.hashAssets = ssAssets.GetHash();
+
+        afile << file.GetHash();
+        FileCommit(afile.Get());
+        afile.fclose();
+    } catch (const std::exception& e) {
+        afile.fclose();
+        fs::remove(pathTemp);
+        strError = strprintf("failed to write snapshot: %s", e.what());
+        return false;
+    }
+
+    if (!RenameOver(pathTemp, path)) {
+        fs::remove(pathTemp);
+        strError = strprintf("unable to rename %s to %s", pathTemp.string(), path.string());
+        return false;
+    }
+
+    LogPrintf("Dumped %u coins and %u asset records at %s (%d) to %s in %dms\n", hashes.nCoins, hashes.nAssetRecords,
+              metadata.hashBase.ToString(), metadata.nHeight, path.string(), GetTimeMillis() - nStart);
+    return true;
+}
+
+/**
+ * Read a snapshot file, computing its hashes and checking its checksum. Chunks are handed to the
+ * sinks (if any) as they are read; a sink returning false stops the read.
+ */
+static bool ReadTxOutSnapshot(const fs::path& path, CTxOutSnapshotMetadata& metadata, CTxOutSnapshotHashes& hashes,
+                              const std::function<bool(CoinsChunk&)>& coinsSink,
+                              const std::function<bool(RecordsChunk&)>& recordsSink, std::string& strError)
+{
+    CAutoFile afile(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (afile.IsNull()) {
+        strError = strprintf("unable to open %s", path.string());
+        return false;
+    }
+
+    try {
+        CHashVerifier<CAutoFile> file(&afile);
+        unsigned char magic[sizeof(TXOUT_SNAPSHOT_MAGIC)];
+        file >> FLATDATA(magic);
+        if (memcmp(magic, TXOUT_SNAPSHOT_MAGIC, sizeof(magic)) != 0) {
+            strError = "not a UTXO snapshot file";
+            return false;
+        }
+        file >> metadata;
+        if (metadata.nVersion != TXOUT_SNAPSHOT_VERSION) {
+            strError = strprintf("unsupported snapshot version %u", metadata.nVersion);
+            return false;
+        }
+        if (memcmp(metadata.pchMessageStart, GetParams().MessageStart(), sizeof(metadata.pchMessageStart)) != 0) {
+            strError = "snapshot is for a different network";
+            return false;
+        }
+
+        hashes = CTxOutSnapshotHashes();
+        CCoinsSetHasher hasher(metadata.hashBase);
+        while (true) {
+            boost::this_thread::interruption_point();
+            CoinsChunk chunk;
+            file >> chunk;
+            if (chunk.empty())
+                break;
+            for (const auto& coin : chunk) {
+                if (coin.second.IsSpent())
+                    throw std::runtime_error("spent coin in snapshot");
+                hasher.Add(coin.first, coin.second);
+            }
+            hashes.nCoins += chunk.size();
+            if (coinsSink && !coinsSink(chunk)) {
+                strError = "failed to write coins";
+                return false;
+            }
+        }
+        hashes.hashSerialized = hasher.GetHash();
+
+        CHashWriter ssAssets(SER_GETHASH, PROTOCOL_VERSION);
+        while (true) {
+            boost::this_thread::interruption_point();
+            RecordsChunk chunk;
+            file >> chunk;
+            if (chunk.empty())
+                break;
+            for (const auto& record : chunk) {
+                if (record.nDatabase != SNAPSHOT_DB_ASSETS && record.nDatabase != SNAPSHOT_DB_RESTRICTED)
+                    throw std::runtime_error("unknown database in snapshot");
+                ssAssets << record;
+            }
+            hashes.nAssetRecords += chunk.size();
+            if (recordsSink && !recordsSink(chunk)) {
+                strError = "failed to write asset records";
+                return false;
+            }
+        }
+        hashes.hashAssets = ssAssets.GetHash();
+
+        uint256 hashChecksum = file.GetHash();
+        uint256 hashStored;
+        afile >> hashStored;
+        if (hashChecksum != hashStored) {
+            strError = "snapshot checksum mismatch";
+            return false;
+        }
+    } catch (const std::exception& e) {
+        strError = strprintf("failed to read snapshot: %s", e.what());
+        return false;
+    }
+    return true;
+}
+
+bool VerifyTxOutSnapshot(const fs::path& path, CTxOutSnapshotMetadata& metadata, CTxOutSnapshotHashes& hashes, std::string& strError)
+{
+    return ReadTxOutSnapshot(path, metadata, hashes, nullptr, nullptr, strError);
+}
+
+/**
+ * Runs database writes on threads of their own, so parsing the file overlaps with LevelDB. Every
+ * key in a snapshot is written once, so the chunks can go in in any order and the writers share
+ * one queue; LevelDB then builds and compresses their batches in parallel and commits them in groups.
+ */
+class CBulkLoadWriter
+{
+public:
+    explicit CBulkLoadWriter(int nThreads) : fDone(false), fFailed(false)
+    {
+        for (int i = 0; i < nThreads; i++) {
+            threadWriters.emplace_back(&TraceThread<std::function<void()> >, "loadsnapshot",
+                std::function<void()>(std::bind(&CBulkLoadWriter::ThreadWrite, this)));
+        }
+    }
+
+    ~CBulkLoadWriter()
+    {
+        Finish();
+    }
+
+    //! Queue a write, waiting while the queue is full. Returns false once a write has failed.
+    bool Push(std::function<bool()> job)
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        cond.wait(lock, [this] { return fFailed || queue.size() < TXOUT_SNAPSHOT_LOAD_QUEUE; });
+        if (fFailed)
+            return false;
+        queue.push_back(std::move(job));
+        cond.notify_all();
+        return true;
+    }
+
+    //! Wait for all queued writes. Returns whether they all succeeded.
+    bool Finish()
+    {
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            fDone = true;
+        }
+        cond.notify_all();
+        for (std::thread& thread : threadWriters) {
+            if (thread.joinable())
+                thread.join();
+        }
+        return !fFailed;
+    }
+
+private:
+    std::mutex cs;
+    std::condition_variable cond;
+    std::deque<std::function<bool()> > queue;
+    bool fDone;
+    bool fFailed;
+    std::vector<std::thread> threadWriters;
+
+    void ThreadWrite()
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        while (true) {
+            cond.wait(lock, [this] { return fDone || !queue.empty(); });
+            if (queue.empty())
+                return;
+            std::function<bool()> job = std::move(queue.front());
+            queue.pop_front();
+            cond.notify_all();
+            lock.unlock();
+
+            bool fOk = false;
+            try {
+                fOk = job();
+            } catch (const std::exception& e) {
+                LogPrintf("%s: %s\n", __func__, e.what());
+            }
+
+            lock.lock();
+            if (!fOk) {
+                fFailed = true;
+                queue.clear();
+                cond.notify_all();
+            }
+        }
+    }
+};
+
+bool LoadTxOutSnapshot(const CChainParams& chainparams, const fs::path& path, const uint256& hashExpected,
+                       CTxOutSnapshotMetadata& metadata, CTxOutSnapshotHashes& hashes, std::string& strError)
+{
+    int64_t nStart = GetTimeMillis();
+
+    // First pass: check the file against the expected hash before touching any database. This
+    // reads the file twice, but a bad or unexpected snapshot is then refused while the node still
+    // has its empty chainstate, rather than after it has been half written and must be reindexed.
+    if (!VerifyTxOutSnapshot(path, metadata, hashes, strError))
+        return false;
+
+    uint256 hashCommitted = hashExpected;
+    if (hashCommitted.IsNull()) {
+        const MapTxOutSnapshotHashes& mapHashes = chainparams.TxOutSnapshotHashes();
+        MapTxOutSnapshotHashes::const_iterator it = mapHashes.find(metadata.nHeight);
+        if (it == mapHashes.end()) {
+            strError = strprintf("no snapshot hash is known for height %d, the expected hash must be given", metadata.nHeight);
+            return false;
+        }
+        hashCommitted = it->second;
+    }
+    if (hashes.GetSnapshotHash() != hashCommitted) {
+        strError = strprintf("snapshot hash %s does not match the expected %s", hashes.GetSnapshotHash().ToString(), hashCommitted.ToString());
+        return false;
+    }
+    if (fAssetIndex && !metadata.fAssetIndex) {
+        strError = "-assetindex is enabled but the snapshot was made without it";
+        return false;
+    }
+    if (fTxIndex || fAddressIndex || fSpentIndex || fTimestampIndex) {
+        strError = "-txindex, -addressindex, -spentindex and -timestampindex cannot be built from a snapshot";
+        return false;
+    }
+    if (!fPruneMode) {
+        // The chain is marked as pruned below the base, which a node without -prune refuses to start with
+        strError = "a snapshot can only be loaded with -prune, the blocks below its base are never downloaded";
+        return false;
+    }
+
+    // The node must not connect blocks while its chainstate is replaced.
+    LOCK(cs_main);
+
+    BlockMap::iterator mi = mapBlockIndex.find(metadata.hashBase);
+    if (mi == mapBlockIndex.end() || !mi->second->IsValid(BLOCK_VALID_TREE) || mi->second->nHeight != metadata.nHeight) {
+        strError = strprintf("the snapshot base block %s is not a known header, sync headers first", metadata.hashBase.ToString());
+        return false;
+    }
+    CBlockIndex* pindexBase = mi->second;
+    if (chainActive.Height() != 0) {
+        strError = "a snapshot can only be loaded while the chain is at the genesis block";
+        return false;
+    }
+
+    FlushStateToDisk();
+    if (!pcoinsdbview->IsEmpty() || HaveRecords(*passetsdb, ASSETS_DB_PREFIXES + ASSET_INDEX_PREFIXES) ||
+        HaveRecords(*prestricteddb, RESTRICTED_DB_PREFIXES)) {
+        strError = "the chainstate is not empty";
+        return false;
+    }
+
+    // Second pass: stream the file into the databases. From here on a failure leaves the coin
+    // database marked as mid-transition, which makes the next start refuse it.
+    if (!pcoinsdbview->StartBulkLoad(metadata.hashBase)) {
+        strError = "failed to write to coin database";
+        return false;
+    }
+
+    CBulkLoadWriter writer(std::max(1, std::min(GetNumCores(), TXOUT_SNAPSHOT_LOAD_THREADS)));
+    CTxOutSnapshotMetadata metadataLoaded;
+    CTxOutSnapshotHashes hashesLoaded;
+    bool fLoadAssetIndex = fAssetIndex;
+    bool fOk = ReadTxOutSnapshot(path, metadataLoaded, hashesLoaded,
+        [&writer](CoinsChunk& chunk) {
+            std::shared_ptr<CoinsChunk> coins = std::make_shared<CoinsChunk>(std::move(chunk));
+            return writer.Push([coins] { return pcoinsdbview->BulkLoadCoins(*coins); });
+        },
+        [&writer, fLoadAssetIndex](RecordsChunk& chunk) {
+            std::shared_ptr<RecordsChunk> records = std::make_shared<RecordsChunk>(std::move(chunk));
+            return writer.Push([records, fLoadAssetIndex] {
+                CDBBatch batchAssets(*passetsdb);
+                CDBBatch batchRestricted(*prestricteddb);
+                for (const CTxOutSnapshotRecord& record : *records) {
+                    if (!fLoadAssetIndex && IsAssetIndexRecord(record))
+                        continue;
+                    CDBRawData key;
+                    CDBRawData value;
+                    key.data = record.vchKey;
+                    value.data = record.vchValue;
+                    if (record.nDatabase == SNAPSHOT_DB_ASSETS)
+                        batchAssets.Write(key, value);
+                    else
+                        batchRestricted.Write(key, value);
+                }
+                return passetsdb->WriteBatch(batchAssets) && prestricteddb->WriteBatch(batchRestricted);
+            });
+        },
+        strError);
+    fOk = writer.Finish() && fOk;
+    if (!fOk || hashesLoaded.GetSnapshotHash() != hashes.GetSnapshotHash()) {
+        if (fOk)
+            strError = "snapshot changed while it was loaded";
+        strError += ", restart with -reindex-chainstate";
+        return false;
+    }
+    if (!pcoinsdbview->FinishBulkLoad(metadata.hashBase)) {
+        strError = "failed to write to coin database, restart with -reindex-chainstate";
+        return false;
+    }
+
+    // The in-memory asset caches only ever saw the empty state.
+    if (pcoinsprefetcher)
+        pcoinsprefetcher->Invalidate();
+    passetsCache->Clear();
+    passetsVerifierCache->Clear();
+    passetsQualifierCache->Clear();
+    passetsRestrictionCache->Clear();
+    passetsGlobalRestrictionCache->Clear();
+    if (!passetsdb->LoadAssets()) {
+        strError = "failed to load assets database";
+        return false;
+    }
+
+    if (!ActivateTxOutSnapshot(chainparams, pindexBase, strError))
+        return false;
+    FlushStateToDisk();
+
+    LogPrintf("Loaded %u coins and %u asset records at %s (%d) from %s in %dms\n", hashes.nCoins, hashes.nAssetRecords,
+              metadata.hashBase.ToString(), metadata.nHeight, path.string(), GetTimeMillis() - nStart);
+    return true;
+}
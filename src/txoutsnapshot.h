@@ -0,0 +1,99 @@
+// Copyright (c) 2023-2024 The Aidp Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef AIDP_TXOUTSNAPSHOT_H
+#define AIDP_TXOUTSNAPSHOT_H
+
+#include "fs.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+
+class CChainParams;
+
+//! Version of the UTXO snapshot file format written by dumptxoutset
+static const uint16_t TXOUT_SNAPSHOT_VERSION = 1;
+
+/**
+ * Header of a UTXO snapshot file.
+ *
+ * The file is: magic, this header, the coins in chainstate order (in chunks, ended by an empty
+ * chunk), the asset, restricted asset and asset index records (same), and a double SHA256 of
+ * everything before it.
+ */
+class CTxOutSnapshotMetadata
+{
+public:
+    uint16_t nVersion;
+    unsigned char pchMessageStart[4];
+    uint256 hashBase;
+    int32_t nHeight;
+    //! Whether the asset index (-assetindex) records are included
+    bool fAssetIndex;
+
+    CTxOutSnapshotMetadata()
+    {
+        SetNull();
+    }
+
+    void SetNull()
+    {
+        nVersion = TXOUT_SNAPSHOT_VERSION;
+        memset(pchMessageStart, 0, sizeof(pchMessageStart));
+        hashBase.SetNull();
+        nHeight = -1;
+        fAssetIndex = false;
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nVersion);
+        READWRITE(FLATDATA(pchMessageStart));
+        READWRITE(hashBase);
+        READWRITE(nHeight);
+        READWRITE(fAssetIndex);
+    }
+};
+
+/** What a UTXO snapshot commits to. */
+class CTxOutSnapshotHashes
+{
+public:
+    //! The coins, hashed as gettxoutsetinfo's hash_serialized_2
+    uint256 hashSerialized;
+    //! The asset, restricted asset and asset index records
+    uint256 hashAssets;
+    uint64_t nCoins;
+    uint64_t nAssetRecords;
+
+    CTxOutSnapshotHashes() : nCoins(0), nAssetRecords(0) {}
+
+    //! The hash loadtxoutset checks against the operator or chainparams
+    uint256 GetSnapshotHash() const;
+};
+
+/**
+ * Write the coin database and the chain derived asset state at the current tip to path.
+ * Takes cs_main only to flush and open point-in-time database iterators.
+ */
+bool DumpTxOutSnapshot(const fs::path& path, CTxOutSnapshotMetadata& metadata, CTxOutSnapshotHashes& hashes, std::string& strError);
+
+/** Read a snapshot file end to end, checking its format and checksum, and compute its hashes. */
+bool VerifyTxOutSnapshot(const fs::path& path, CTxOutSnapshotMetadata& metadata, CTxOutSnapshotHashes& hashes, std::string& strError);
+
+/**
+ * Load a snapshot into a node whose chain is still at the genesis block and make its base block
+ * the chain tip. hashExpected is the snapshot hash to accept; if null, the hash committed in
+ * chainparams for the snapshot's height is used. The block headers up to the base must be known.
+ */
+bool LoadTxOutSnapshot(const CChainParams& chainparams, const fs::path& path, const uint256& hashExpected,
+                       CTxOutSnapshotMetadata& metadata, CTxOutSnapshotHashes& hashes, std::string& strError);
+
+#endif // AIDP_TXOUTSNAPSHOT_H
@@ -805,6 +805,13 @@ void AllocateFileRange(FILE *file, unsigned int offset, unsigned int length)
 #endif
 }
 
+void FileReadAhead(FILE *file)
+{
+#if defined(__linux__)
+    posix_fadvise(fileno(file), 0, 0, POSIX_FADV_SEQUENTIAL); // advisory, failure is harmless
+#endif
+}
+
 void ShrinkDebugFile()
 {
     // Amount of debug.log to save at end when shrinking (must fit in memory)
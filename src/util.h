@@ -183,6 +183,9 @@ int RaiseFileDescriptorLimit(int nMinFD);
 
 void AllocateFileRange(FILE *file, unsigned int offset, unsigned int length);
 
+/** Hint that file will be read sequentially from start to end, so the OS reads ahead further. */
+void FileReadAhead(FILE *file);
+
 bool RenameOver(fs::path src, fs::path dest);
 
 bool TryCreateDirectories(const fs::path &p);
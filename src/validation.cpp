@@ -8,17 +8,21 @@
 #include "validation.h"
 
 #include "arith_uint256.h"
+#include "blockfilemap.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
+#include "coinsprefetch.h"
 #include "consensus/consensus.h"
 #include "consensus/merkle.h"
 #include "consensus/tx_verify.h"
 #include "consensus/validation.h"
+#include "crypto/hmac_sha256.h"
 #include "cuckoocache.h"
 #include "fs.h"
 #include "hash.h"
+#include "index/chainindexes.h"
 #include "init.h"
 #include "policy/fees.h"
 #include "policy/policy.h"
@@ -46,7 +50,12 @@
 #include "net.h"
 
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
 #include <sstream>
+#include <thread>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/join.hpp>
@@ -106,6 +115,7 @@ bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
 bool fRequireStandard = true;
 bool fCheckBlockIndex = false;
 bool fCheckpointsEnabled = DEFAULT_CHECKPOINTS_ENABLED;
+bool fMmapBlocks = DEFAULT_MMAP_BLOCKS;
 size_t nCoinCacheUsage = 5000 * 300;
 uint64_t nPruneTarget = 0;
 int64_t nMaxTipAge = DEFAULT_MAX_TIP_AGE;
@@ -169,6 +179,8 @@ namespace {
     CCriticalSection cs_LastBlockFile;
     std::vector<CBlockFileInfo> vinfoBlockFile;
     int nLastBlockFile = 0;
+    /** Memory mappings of block files before nLastBlockFile, used for reading (see -mmapblocks) */
+    CBlockFileMapCache blockFileMaps(MAX_MAPPED_BLOCK_FILES);
     /** Global flag to indicate we should check to see if there are
      *  block/undo files that should be deleted.  Set on startup
      *  or if we allocate more file space when we're in prune mode
@@ -233,6 +245,7 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 }
 
 CCoinsViewDB *pcoinsdbview = nullptr;
+CCoinsViewBackgroundFlush *pcoinsflushview = nullptr;
 CCoinsViewCache *pcoinsTip = nullptr;
 CBlockTreeDB *pblocktree = nullptr;
 
@@ -240,7 +253,6 @@ CAssetsDB *passetsdb = nullptr;
 CAssetsCache *passets = nullptr;
 CLRUCache<std::string, CDatabasedAssetData> *passetsCache = nullptr;
 CLRUCache<std::string, CMessage> *pMessagesCache = nullptr;
-CLRUCache<std::string, int> *pMessageSubscribedChannelsCache = nullptr;
 CLRUCache<std::string, int> *pMessagesSeenAddressCache = nullptr;
 CMessageDB *pmessagedb = nullptr;
 CMessageChannelDB *pmessagechanneldb = nullptr;
@@ -515,6 +527,8 @@ static bool CheckInputsFromMempoolAndCache(const CTransaction& tx, CValidationSt
     return CheckInputs(tx, state, view, true, flags, cacheSigStore, true, txdata);
 }
 
+static bool CheckInputsForMempool(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& view, unsigned int flags, PrecomputedTransactionData& txdata);
+
 static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool& pool, CValidationState& state, const CTransactionRef& ptx,
                               bool* pfMissingInputs, int64_t nAcceptTime, std::list<CTransactionRef>* plTxnReplaced,
                               bool bypass_limits, const CAmount& nAbsurdFee, std::vector<COutPoint>& coins_to_uncache, bool test_accept)
@@ -890,7 +904,7 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
         // Check against previous transactions
         // This is done last to help prevent CPU exhaustion denial-of-service attacks.
         PrecomputedTransactionData txdata(tx);
-        if (!CheckInputs(tx, state, view, true, scriptVerifyFlags, true, false, txdata)) {
+        if (!CheckInputsForMempool(tx, state, view, scriptVerifyFlags, txdata)) {
             // SCRIPT_VERIFY_CLEANSTACK requires SCRIPT_VERIFY_WITNESS, so we
             // need to turn both off, and compare against just turning off CLEANSTACK
             // to see if the failure is specifically due to witness validation.
@@ -1002,29 +1016,24 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
                     if (AreRestrictedAssetsDeployed()) {
                         if (IsAssetNameAnRestricted(data.assetName)) {
                             std::string address = EncodeDestination(data.destination);
-                            pool.mapAddressesQualifiersChanged[address].insert(hash);
-                            pool.mapHashQualifiersChanged[hash].insert(address);
-
-                            pool.mapAssetVerifierChanged[data.assetName].insert(hash);
-                            pool.mapHashVerifierChanged[hash].insert(data.assetName);
+                            pool.addRestrictedEntry(hash, MempoolRestrictedType::QUALIFIERS_CHANGED, "", address);
+                            pool.addRestrictedEntry(hash, MempoolRestrictedType::VERIFIER_CHANGED, data.assetName);
                         }
                     }
                 } else if (out.scriptPubKey.IsNullGlobalRestrictionAssetTxDataScript()) {
                     CNullAssetTxData globalNullData;
                     if (GlobalAssetNullDataFromScript(out.scriptPubKey, globalNullData)) {
                         if (globalNullData.flag == 1) {
-                            if (pool.mapGlobalFreezingAssetTransactions.count(globalNullData.asset_name)) {
+                            if (pool.hasRestrictedEntry(MempoolRestrictedType::GLOBAL_FREEZING, globalNullData.asset_name)) {
                                 return state.DoS(0, false, REJECT_INVALID, "bad-txns-global-freeze-already-in-mempool");
                             } else {
-                                pool.mapGlobalFreezingAssetTransactions[globalNullData.asset_name].insert(tx.GetHash());
-                                pool.mapHashGlobalFreezingAssetTransactions[tx.GetHash()].insert(globalNullData.asset_name);
+                                pool.addRestrictedEntry(tx.GetHash(), MempoolRestrictedType::GLOBAL_FREEZING, globalNullData.asset_name);
                             }
                         } else if (globalNullData.flag == 0) {
-                            if (pool.mapGlobalUnFreezingAssetTransactions.count(globalNullData.asset_name)) {
+                            if (pool.hasRestrictedEntry(MempoolRestrictedType::GLOBAL_UNFREEZING, globalNullData.asset_name)) {
                                 return state.DoS(0, false, REJECT_INVALID, "bad-txns-global-unfreeze-already-in-mempool");
                             } else {
-                                pool.mapGlobalUnFreezingAssetTransactions[globalNullData.asset_name].insert(tx.GetHash());
-                                pool.mapHashGlobalUnFreezingAssetTransactions[tx.GetHash()].insert(globalNullData.asset_name);
+                                pool.addRestrictedEntry(tx.GetHash(), MempoolRestrictedType::GLOBAL_UNFREEZING, globalNullData.asset_name);
                             }
                         }
                     }
@@ -1036,21 +1045,19 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
                     if (AssetNullDataFromScript(out.scriptPubKey, addressNullData, address)) {
                         if (IsAssetNameAQualifier(addressNullData.asset_name)) {
                             if (addressNullData.flag == (int) QualifierType::ADD_QUALIFIER) {
-                                if (pool.mapAddressAddedTag.count(std::make_pair(address, addressNullData.asset_name))) {
+                                if (pool.hasRestrictedAddressEntry(MempoolRestrictedType::ADDED_TAG, address, addressNullData.asset_name)) {
                                     return state.DoS(0, false, REJECT_INVALID,
                                                      "bad-txns-adding-tag-already-in-mempool");
                                 }
                                 // Adding a qualifier to an address
-                                pool.mapAddressAddedTag[std::make_pair(address, addressNullData.asset_name)].insert(tx.GetHash());
-                                pool.mapHashToAddressAddedTag[tx.GetHash()].insert(std::make_pair(address, addressNullData.asset_name));
+                                pool.addRestrictedEntry(tx.GetHash(), MempoolRestrictedType::ADDED_TAG, addressNullData.asset_name, address);
                             } else {
-                                    if (pool.mapAddressRemoveTag.count(std::make_pair(address, addressNullData.asset_name))) {
+                                    if (pool.hasRestrictedAddressEntry(MempoolRestrictedType::REMOVED_TAG, address, addressNullData.asset_name)) {
                                         return state.DoS(0, false, REJECT_INVALID,
                                                          "bad-txns-remove-tag-already-in-mempool");
                                     }
 
-                                pool.mapAddressRemoveTag[std::make_pair(address, addressNullData.asset_name)].insert(tx.GetHash());
-                                pool.mapHashToAddressRemoveTag[tx.GetHash()].insert(std::make_pair(address, addressNullData.asset_name));
+                                pool.addRestrictedEntry(tx.GetHash(), MempoolRestrictedType::REMOVED_TAG, addressNullData.asset_name, address);
                             }
                         }
                     }
@@ -1070,12 +1077,8 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
                 if (GetAssetData(coin.out.scriptPubKey, data)) {
 
                     if (IsAssetNameAnRestricted(data.assetName)) {
-                        pool.mapAssetMarkedGlobalFrozen[data.assetName].insert(hash);
-                        pool.mapHashMarkedGlobalFrozen[hash].insert(data.assetName);
-
-                        auto pair = std::make_pair(EncodeDestination(data.destination), data.assetName);
-                        pool.mapAddressesMarkedFrozen[pair].insert(hash);
-                        pool.mapHashToAddressMarkedFrozen[hash].insert(pair);
+                        pool.addRestrictedEntry(hash, MempoolRestrictedType::ASSET_GLOBAL_FROZEN, data.assetName);
+                        pool.addRestrictedEntry(hash, MempoolRestrictedType::ADDRESS_FROZEN, data.assetName, EncodeDestination(data.destination));
                     }
                 }
             }
@@ -1116,6 +1119,13 @@ bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, const
 {
     if (!fTimestampIndex)
         return error("Timestamp index not enabled");
+    if (ptimestampindexer && !ptimestampindexer->IsSynced())
+        return error("Timestamp index is still being built");
+
+    if (ptimestampindexer) {
+        ptimestampindexer->GetBlockHashes(high, low, fActiveOnly, hashes);
+        return true;
+    }
 
     if (!pblocktree->ReadTimestampIndex(high, low, fActiveOnly, hashes))
         return error("Unable to get hashes for timestamps");
@@ -1131,6 +1141,12 @@ bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
     if (mempool.getSpentIndex(key, value))
         return true;
 
+    if (pspentindexer) {
+        if (!pspentindexer->IsSynced())
+            return false;
+        return pspentindexer->Lookup(key, value);
+    }
+
     if (!pblocktree->ReadSpentIndex(key, value))
         return false;
 
@@ -1149,53 +1165,107 @@ bool HashOnchainActive(const uint256 &hash)
 }
 
 bool GetAddressIndex(uint160 addressHash, int type, std::string assetName,
-                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, int start, int end)
+                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, int start, int end,
+                     size_t nLimit, const CAddressIndexKey *pAfter)
 {
     if (!fAddressIndex)
         return error("address index not enabled");
+    if (paddressindexer && !paddressindexer->IsSynced())
+        return error("address index is still being built");
 
-    if (!pblocktree->ReadAddressIndex(addressHash, type, assetName, addressIndex, start, end))
+    if (!pblocktree->ReadAddressIndex(addressHash, type, assetName, addressIndex, start, end, nLimit, pAfter))
         return error("unable to get txids for address");
 
     return true;
 }
 
 bool GetAddressIndex(uint160 addressHash, int type,
-                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, int start, int end)
+                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, int start, int end,
+                     size_t nLimit, const CAddressIndexKey *pAfter)
 {
     if (!fAddressIndex)
         return error("address index not enabled");
+    if (paddressindexer && !paddressindexer->IsSynced())
+        return error("address index is still being built");
 
-    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end))
+    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end, nLimit, pAfter))
         return error("unable to get txids for address");
 
     return true;
 }
 
+bool GetAddressBalance(uint160 addressHash, int type, std::string assetName, CAddressBalanceValue &balance)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+    if (paddressindexer && !paddressindexer->IsSynced())
+        return error("address index is still being built");
+
+    if (!pblocktree->ReadAddressBalance(addressHash, type, assetName, balance))
+        return error("unable to get balance for address");
+
+    return true;
+}
+
+bool GetAddressBalances(uint160 addressHash, int type, std::map<std::string, CAddressBalanceValue> &balances)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+    if (paddressindexer && !paddressindexer->IsSynced())
+        return error("address index is still being built");
+
+    if (!pblocktree->ReadAddressBalances(addressHash, type, balances))
+        return error("unable to get balances for address");
+
+    return true;
+}
+
 bool GetAddressUnspent(uint160 addressHash, int type, std::string assetName,
-                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs)
+                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                       size_t nLimit, const CAddressUnspentKey *pAfter)
 {
     if (!fAddressIndex)
         return error("address index not enabled");
+    if (paddressindexer && !paddressindexer->IsSynced())
+        return error("address index is still being built");
 
-    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, assetName, unspentOutputs))
+    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, assetName, unspentOutputs, nLimit, pAfter))
         return error("unable to get txids for address");
 
     return true;
 }
 
 bool GetAddressUnspent(uint160 addressHash, int type,
-                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs)
+                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                       size_t nLimit, const CAddressUnspentKey *pAfter)
 {
     if (!fAddressIndex)
         return error("address index not enabled");
+    if (paddressindexer && !paddressindexer->IsSynced())
+        return error("address index is still being built");
 
-    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs))
+    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs, nLimit, pAfter))
         return error("unable to get txids for address");
 
     return true;
 }
 
+/**
+ * The mapping of a block file, for reading. Only files that are no longer written to are
+ * mapped: the last one is still being appended to and is truncated when it is left.
+ */
+static std::shared_ptr<const CMappedBlockFile> GetMappedBlockFile(int nFile)
+{
+    if (!fMmapBlocks || fReindex || fImporting)
+        return nullptr;
+    {
+        LOCK(cs_LastBlockFile);
+        if (nFile >= nLastBlockFile)
+            return nullptr;
+    }
+    return blockFileMaps.Get(nFile, GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk"));
+}
+
 /** Return transaction in txOut, and if it was found inside a block, its hash is placed in hashBlock */
 bool GetTransaction(const uint256 &hash, CTransactionRef &txOut, const Consensus::Params& consensusParams, uint256 &hashBlock, bool fAllowSlow)
 {
@@ -1213,16 +1283,28 @@ bool GetTransaction(const uint256 &hash, CTransactionRef &txOut, const Consensus
     if (fTxIndex) {
         CDiskTxPos postx;
         if (pblocktree->ReadTxIndex(hash, postx)) {
-            CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-            if (file.IsNull())
-                return error("%s: OpenBlockFile failed", __func__);
             CBlockHeader header;
-            try {
-                file >> header;
-                fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                file >> txOut;
-            } catch (const std::exception& e) {
-                return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+            std::shared_ptr<const CMappedBlockFile> mapped = GetMappedBlockFile(postx.nFile);
+            if (mapped && postx.nPos < mapped->size()) {
+                try {
+                    CSpanReader span(SER_DISK, CLIENT_VERSION, mapped->data() + postx.nPos, mapped->data() + mapped->size());
+                    span >> header;
+                    span.ignore(postx.nTxOffset);
+                    span >> txOut;
+                } catch (const std::exception& e) {
+                    return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+                }
+            } else {
+                CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
+                if (file.IsNull())
+                    return error("%s: OpenBlockFile failed", __func__);
+                try {
+                    file >> header;
+                    fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
+                    file >> txOut;
+                } catch (const std::exception& e) {
+                    return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+                }
             }
             hashBlock = header.GetHash();
             if (txOut->GetHash() != hash)
@@ -1286,40 +1368,111 @@ static bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMes
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
+static bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams, bool fCheckPOW)
 {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+    std::shared_ptr<const CMappedBlockFile> mapped = GetMappedBlockFile(pos.nFile);
+    if (mapped && pos.nPos < mapped->size()) {
+        // Read block straight from the mapping
+        try {
+            CSpanReader span(SER_DISK, CLIENT_VERSION, mapped->data() + pos.nPos, mapped->data() + mapped->size());
+            UnserializeBlockInArena(span, block);
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        }
+    } else {
+        // Open history file to read
+        CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
 
-    // Read block
-    try {
-        filein >> block;
-    }
-    catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        // Read block
+        try {
+            UnserializeBlockInArena(filein, block);
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        }
     }
 
     // Check the header
-    if (!CheckProofOfWork(block.GetHash(), block.nBits, consensusParams))
+    if (fCheckPOW && !CheckProofOfWork(block.GetHash(), block.nBits, consensusParams))
         return error("ReadBlockFromDisk: Errors in block header at %s", pos.ToString());
 
     return true;
 }
 
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
+{
+    return ReadBlockFromDisk(block, pos, consensusParams, true);
+}
+
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
 {
-    if (!ReadBlockFromDisk(block, pindex->GetBlockPos(), consensusParams))
+    // nStatus is updated under cs_main while blocks are read without it, take a copy
+    CDiskBlockPos blockPos;
+    bool fValidated;
+    {
+        LOCK(cs_main);
+        blockPos = pindex->GetBlockPos();
+        fValidated = pindex->IsValid(BLOCK_VALID_SCRIPTS);
+    }
+
+    // A fully validated block had its proof of work checked when it was accepted. Damage to the
+    // header on disk is still caught by comparing its hash with the index below.
+    if (!ReadBlockFromDisk(block, blockPos, consensusParams, !fValidated))
         return false;
     if (block.GetHash() != pindex->GetBlockHash())
         return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): GetHash() doesn't match index for %s at %s",
-                pindex->ToString(), pindex->GetBlockPos().ToString());
+                pindex->ToString(), blockPos.ToString());
     return true;
 }
 
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& vchBlock, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
+{
+    // The block is preceded by the message start and its size, see WriteBlockToDisk
+    if (pos.nPos < CMessageHeader::MESSAGE_START_SIZE + sizeof(unsigned int))
+        return error("%s: Invalid position %s", __func__, pos.ToString());
+    CDiskBlockPos posHeader(pos.nFile, pos.nPos - CMessageHeader::MESSAGE_START_SIZE - sizeof(unsigned int));
+
+    CMessageHeader::MessageStartChars blkStart;
+    unsigned int nSize;
+    std::shared_ptr<const CMappedBlockFile> mapped = GetMappedBlockFile(pos.nFile);
+    try {
+        if (mapped && pos.nPos < mapped->size()) {
+            CSpanReader span(SER_DISK, CLIENT_VERSION, mapped->data() + posHeader.nPos, mapped->data() + mapped->size());
+            span >> FLATDATA(blkStart) >> nSize;
+            if (memcmp(blkStart, messageStart, CMessageHeader::MESSAGE_START_SIZE) || nSize > span.size())
+                return error("%s: Invalid block header at %s", __func__, pos.ToString());
+            vchBlock.assign(span.data(), span.data() + nSize);
+        } else {
+            CAutoFile filein(OpenBlockFile(posHeader, true), SER_DISK, CLIENT_VERSION);
+            if (filein.IsNull())
+                return error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
+            filein >> FLATDATA(blkStart) >> nSize;
+            if (memcmp(blkStart, messageStart, CMessageHeader::MESSAGE_START_SIZE) || nSize > GetMaxBlockSerializedSize())
+                return error("%s: Invalid block header at %s", __func__, pos.ToString());
+            vchBlock.resize(nSize);
+            filein.read((char*)vchBlock.data(), nSize);
+        }
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+    }
+    return true;
+}
+
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& vchBlock, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart)
+{
+    CDiskBlockPos blockPos;
+    {
+        LOCK(cs_main);
+        blockPos = pindex->GetBlockPos();
+    }
+    return ReadRawBlockFromDisk(vchBlock, blockPos, messageStart);
+}
+
 CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams)
 {
     int halvings = nHeight / consensusParams.nSubsidyHalvingInterval;
@@ -1727,6 +1880,32 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
     return true;
 }
 
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock)
+{
+    // Open history file to read
+    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s: OpenUndoFile failed", __func__);
+
+    // Read block
+    uint256 hashChecksum;
+    CHashVerifier<CAutoFile> verifier(&filein); // We need a CHashVerifier as reserializing may lose data
+    try {
+        verifier << hashBlock;
+        verifier >> blockundo;
+        filein >> hashChecksum;
+    }
+    catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+
+    // Verify checksum
+    if (hashChecksum != verifier.GetHash())
+        return error("%s: Checksum mismatch", __func__);
+
+    return true;
+}
+
 namespace {
 
 bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint256& hashBlock, const CMessageHeader::MessageStartChars& messageStart)
@@ -1756,32 +1935,6 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
     return true;
 }
 
-bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock)
-{
-    // Open history file to read
-    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("%s: OpenUndoFile failed", __func__);
-
-    // Read block
-    uint256 hashChecksum;
-    CHashVerifier<CAutoFile> verifier(&filein); // We need a CHashVerifier as reserializing may lose data
-    try {
-        verifier << hashBlock;
-        verifier >> blockundo;
-        filein >> hashChecksum;
-    }
-    catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
-    }
-
-    // Verify checksum
-    if (hashChecksum != verifier.GetHash())
-        return error("%s: Checksum mismatch", __func__);
-
-    return true;
-}
-
 /** Abort with a message */
 bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
 {
@@ -1865,7 +2018,7 @@ int ApplyTxInUndo(Coin&& undo, CCoinsViewCache& view, const COutPoint& out, CAss
 
 /** Undo the effects of this block (with given index) on the UTXO set represented by coins.
  *  When FAILED is returned, view is left in an indeterminate state. */
-static DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view, CAssetsCache* assetsCache = nullptr, bool ignoreAddressIndex = false, bool databaseMessaging = true)
+static DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view, CAssetsCache* assetsCache = nullptr, bool databaseMessaging = true)
 {
     bool fClean = true;
 
@@ -1891,10 +2044,6 @@ static DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex*
         return DISCONNECT_FAILED;
     }
     
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
-    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
-
     // undo transactions in reverse order
     CAssetsCache tempCache(*assetsCache);
     for (int i = block.vtx.size() - 1; i >= 0; i--) {
@@ -1904,60 +2053,6 @@ static DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex*
 
         std::vector<int> vAssetTxIndex;
         std::vector<int> vNullAssetTxIndex;
-        if (fAddressIndex) {
-            for (unsigned int k = tx.vout.size(); k-- > 0;) {
-                const CTxOut &out = tx.vout[k];
-
-                if (out.scriptPubKey.IsPayToScriptHash()) {
-                    std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+2, out.scriptPubKey.begin()+22);
-
-                    // undo receiving activity
-                    addressIndex.push_back(std::make_pair(CAddressIndexKey(2, uint160(hashBytes), pindex->nHeight, i, hash, k, false), out.nValue));
-
-                    // undo unspent index
-                    addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(2, uint160(hashBytes), hash, k), CAddressUnspentValue()));
-
-                } else if (out.scriptPubKey.IsPayToPublicKeyHash()) {
-                    std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+3, out.scriptPubKey.begin()+23);
-
-                    // undo receiving activity
-                    addressIndex.push_back(std::make_pair(CAddressIndexKey(1, uint160(hashBytes), pindex->nHeight, i, hash, k, false), out.nValue));
-
-                    // undo unspent index
-                    addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(1, uint160(hashBytes), hash, k), CAddressUnspentValue()));
-
-                } else if (out.scriptPubKey.IsPayToPublicKey()) {
-                    uint160 hashBytes(Hash160(out.scriptPubKey.begin()+1, out.scriptPubKey.end()-1));
-                    addressIndex.push_back(std::make_pair(CAddressIndexKey(1, hashBytes, pindex->nHeight, i, hash, k, false), out.nValue));
-                    addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(1, hashBytes, hash, k), CAddressUnspentValue()));
-                } else {
-                    /** AIDP START */
-                    if (AreAssetsDeployed()) {
-                        std::string assetName;
-                        CAmount assetAmount;
-                        uint160 hashBytes;
-
-                        if (ParseAssetScript(out.scriptPubKey, hashBytes, assetName, assetAmount)) {
-//                            std::cout << "ConnectBlock(): pushing assets onto addressIndex: " << "1" << ", " << hashBytes.GetHex() << ", " << assetName << ", " << pindex->nHeight
-//                                      << ", " << i << ", " << hash.GetHex() << ", " << k << ", " << "true" << ", " << assetAmount << std::endl;
-
-                            // undo receiving activity
-                            addressIndex.push_back(std::make_pair(
-                                    CAddressIndexKey(1, uint160(hashBytes), assetName, pindex->nHeight, i, hash, k,
-                                                     false), assetAmount));
-
-                            // undo unspent index
-                            addressUnspentIndex.push_back(
-                                    std::make_pair(CAddressUnspentKey(1, uint160(hashBytes), assetName, hash, k),
-                                                   CAddressUnspentValue()));
-                        } else {
-                            continue;
-                        }
-                    }
-                    /** AIDP END */
-                }
-            }
-        }
 
         // Check that all outputs are available and match the outputs in the block itself
         // exactly.
@@ -2226,67 +2321,6 @@ static DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex*
                 int res = ApplyTxInUndo(std::move(undo), view, out, assetsCache); /** AIDP START */ /* Pass assetsCache into ApplyTxInUndo function */ /** AIDP END */
                 if (res == DISCONNECT_FAILED) return DISCONNECT_FAILED;
                 fClean = fClean && res != DISCONNECT_UNCLEAN;
-
-                const CTxIn input = tx.vin[j];
-
-                if (fSpentIndex) {
-                    // undo and delete the spent index
-                    spentIndex.push_back(std::make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n), CSpentIndexValue()));
-                }
-
-                if (fAddressIndex) {
-                    const CTxOut &prevout = view.AccessCoin(tx.vin[j].prevout).out;
-                    if (prevout.scriptPubKey.IsPayToScriptHash()) {
-                        std::vector<unsigned char> hashBytes(prevout.scriptPubKey.begin()+2, prevout.scriptPubKey.begin()+22);
-
-                        // undo spending activity
-                        addressIndex.push_back(std::make_pair(CAddressIndexKey(2, uint160(hashBytes), pindex->nHeight, i, hash, j, true), prevout.nValue * -1));
-
-                        // restore unspent index
-                        addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(2, uint160(hashBytes), input.prevout.hash, input.prevout.n), CAddressUnspentValue(prevout.nValue, prevout.scriptPubKey, undo.nHeight)));
-
-
-                    } else if (prevout.scriptPubKey.IsPayToPublicKeyHash()) {
-                        std::vector<unsigned char> hashBytes(prevout.scriptPubKey.begin()+3, prevout.scriptPubKey.begin()+23);
-
-                        // undo spending activity
-                        addressIndex.push_back(std::make_pair(CAddressIndexKey(1, uint160(hashBytes), pindex->nHeight, i, hash, j, true), prevout.nValue * -1));
-
-                        // restore unspent index
-                        addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(1, uint160(hashBytes), input.prevout.hash, input.prevout.n), CAddressUnspentValue(prevout.nValue, prevout.scriptPubKey, undo.nHeight)));
-
-                    } else if (prevout.scriptPubKey.IsPayToPublicKey()) {
-                        uint160 hashBytes(Hash160(prevout.scriptPubKey.begin()+1, prevout.scriptPubKey.end()-1));
-                        addressIndex.push_back(std::make_pair(CAddressIndexKey(1, hashBytes, pindex->nHeight, i, hash, j, false), prevout.nValue));
-                        addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(1, hashBytes, hash, j), CAddressUnspentValue()));
-                    } else {
-                        /** AIDP START */
-                        if (AreAssetsDeployed()) {
-                            std::string assetName;
-                            CAmount assetAmount;
-                            uint160 hashBytes;
-
-                            if (ParseAssetScript(prevout.scriptPubKey, hashBytes, assetName, assetAmount)) {
-//                                std::cout << "ConnectBlock(): pushing assets onto addressIndex: " << "1" << ", " << hashBytes.GetHex() << ", " << assetName << ", " << pindex->nHeight
-//                                          << ", " << i << ", " << hash.GetHex() << ", " << j << ", " << "true" << ", " << assetAmount * -1 << std::endl;
-
-                                // undo spending activity
-                                addressIndex.push_back(std::make_pair(
-                                        CAddressIndexKey(1, uint160(hashBytes), assetName, pindex->nHeight, i, hash, j,
-                                                         true), assetAmount * -1));
-
-                                // restore unspent index
-                                addressUnspentIndex.push_back(std::make_pair(
-                                        CAddressUnspentKey(1, uint160(hashBytes), assetName, input.prevout.hash,
-                                                           input.prevout.n),
-                                        CAddressUnspentValue(assetAmount, prevout.scriptPubKey, undo.nHeight)));
-                            } else {
-                                continue;
-                            }
-                        }
-                        /** AIDP END */
-                    }
-                }
             }
             // At this point, all of txundo.vprevout should have been moved out.
         }
@@ -2296,17 +2330,6 @@ static DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex*
     // move best block pointer to prevout block
     view.SetBestBlock(pindex->pprev->GetBlockHash());
 
-    if (!ignoreAddressIndex && fAddressIndex) {
-        if (!pblocktree->EraseAddressIndex(addressIndex)) {
-            error("Failed to delete address index");
-            return DISCONNECT_FAILED;
-        }
-        if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
-            error("Failed to write address unspent index");
-            return DISCONNECT_FAILED;
-        }
-    }
-
     return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
 }
 
@@ -2342,6 +2365,25 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+/**
+ * CheckInputs for AcceptToMemoryPool, spreading the script checks of transactions with many
+ * inputs over the script check threads. Requires cs_main, which keeps ConnectBlock off the queue.
+ */
+static bool CheckInputsForMempool(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& view, unsigned int flags, PrecomputedTransactionData& txdata)
+{
+    if (nScriptCheckThreads && tx.vin.size() >= MEMPOOL_PARALLEL_CHECK_MIN_INPUTS) {
+        std::vector<CScriptCheck> vChecks;
+        if (!CheckInputs(tx, state, view, true, flags, true, false, txdata, &vChecks))
+            return false;
+        CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+        control.Add(vChecks);
+        if (control.Wait())
+            return true;
+        // Check again one input at a time, which stops at the failing input and fills in state.
+    }
+    return CheckInputs(tx, state, view, true, flags, true, false, txdata);
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -2439,7 +2481,7 @@ static int64_t nBlocksTotal = 0;
  *  Validity checks that depend on the UTXO set are also done; ConnectBlock()
  *  can fail if those validity checks fail (among other reasons). */
 static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex,
-                  CCoinsViewCache& view, const CChainParams& chainparams, CAssetsCache* assetsCache = nullptr, bool fJustCheck = false, bool ignoreAddressIndex = false)
+                  CCoinsViewCache& view, const CChainParams& chainparams, CAssetsCache* assetsCache = nullptr, bool fJustCheck = false)
 {
 
     AssertLockHeld(cs_main);
@@ -2562,16 +2604,11 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     std::vector<PrecomputedTransactionData> txdata;
     txdata.reserve(block.vtx.size()); // Required so that pointers to individual PrecomputedTransactionData don't get invalidated
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
-    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
-
     std::set<CMessage> setMessages;
     std::vector<std::pair<std::string, CNullAssetTxData>> myNullAssetData;
     for (unsigned int i = 0; i < block.vtx.size(); i++)
     {
         const CTransaction &tx = *(block.vtx[i]);
-        const uint256 txhash = tx.GetHash();
 
         nInputs += tx.vin.size();
 
@@ -2620,72 +2657,6 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
                 return state.DoS(100, error("%s: contains a non-BIP68-final transaction", __func__),
                                  REJECT_INVALID, "bad-txns-nonfinal");
             }
-
-            if (fAddressIndex || fSpentIndex)
-            {
-                for (size_t j = 0; j < tx.vin.size(); j++) {
-
-                    const CTxIn input = tx.vin[j];
-                    const CTxOut &prevout = view.AccessCoin(tx.vin[j].prevout).out;
-                    uint160 hashBytes;
-                    int addressType = 0;
-                    bool isAsset = false;
-                    std::string assetName;
-                    CAmount assetAmount;
-
-                    if (prevout.scriptPubKey.IsPayToScriptHash()) {
-                        hashBytes = uint160(std::vector <unsigned char>(prevout.scriptPubKey.begin()+2, prevout.scriptPubKey.begin()+22));
-                        addressType = 2;
-                    } else if (prevout.scriptPubKey.IsPayToPublicKeyHash()) {
-                        hashBytes = uint160(std::vector <unsigned char>(prevout.scriptPubKey.begin()+3, prevout.scriptPubKey.begin()+23));
-                        addressType = 1;
-                    } else if (prevout.scriptPubKey.IsPayToPublicKey()) {
-                        hashBytes = Hash160(prevout.scriptPubKey.begin() + 1, prevout.scriptPubKey.end() - 1);
-                        addressType = 1;
-                    } else {
-                        /** AIDP START */
-                        if (AreAssetsDeployed()) {
-                            hashBytes.SetNull();
-                            addressType = 0;
-
-                            if (ParseAssetScript(prevout.scriptPubKey, hashBytes, assetName, assetAmount)) {
-                                addressType = 1;
-                                isAsset = true;
-                            }
-                        }
-                        /** AIDP END */
-                    }
-
-                    if (fAddressIndex && addressType > 0) {
-                        /** AIDP START */
-                        if (isAsset) {
-//                            std::cout << "ConnectBlock(): pushing assets onto addressIndex: " << "1" << ", " << hashBytes.GetHex() << ", " << assetName << ", " << pindex->nHeight
-//                                      << ", " << i << ", " << txhash.GetHex() << ", " << j << ", " << "true" << ", " << assetAmount * -1 << std::endl;
-
-                            // record spending activity
-                            addressIndex.push_back(std::make_pair(CAddressIndexKey(addressType, hashBytes, assetName, pindex->nHeight, i, txhash, j, true), assetAmount * -1));
-
-                            // remove address from unspent index
-                            addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(addressType, hashBytes, assetName, input.prevout.hash, input.prevout.n), CAddressUnspentValue()));
-                        /** AIDP END */
-                        } else {
-                            // record spending activity
-                            addressIndex.push_back(std::make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, txhash, j, true), prevout.nValue * -1));
-
-                            // remove address from unspent index
-                            addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(addressType, hashBytes, input.prevout.hash, input.prevout.n), CAddressUnspentValue()));
-                        }
-                    }
-                    /** AIDP END */
-
-                    if (fSpentIndex) {
-                        // add the spent index to determine the txid and input that spent an output
-                        // and to find the amount and address from an input
-                        spentIndex.push_back(std::make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n), CSpentIndexValue(txhash, j, pindex->nHeight, prevout.nValue, addressType, hashBytes)));
-                    }
-                }
-
-            }
         }
 
         // GetTransactionSigOpCost counts 3 types of sigops:
@@ -2708,66 +2679,6 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
             control.Add(vChecks);
         }
 
-        if (fAddressIndex) {
-            for (unsigned int k = 0; k < tx.vout.size(); k++) {
-                const CTxOut &out = tx.vout[k];
-
-                if (out.scriptPubKey.IsPayToScriptHash()) {
-                    std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+2, out.scriptPubKey.begin()+22);
-
-                    // record receiving activity
-                    addressIndex.push_back(std::make_pair(CAddressIndexKey(2, uint160(hashBytes), pindex->nHeight, i, txhash, k, false), out.nValue));
-
-                    // record unspent output
-                    addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(2, uint160(hashBytes), txhash, k), CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight)));
-
-                } else if (out.scriptPubKey.IsPayToPublicKeyHash()) {
-                    std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+3, out.scriptPubKey.begin()+23);
-
-                    // record receiving activity
-                    addressIndex.push_back(std::make_pair(CAddressIndexKey(1, uint160(hashBytes), pindex->nHeight, i, txhash, k, false), out.nValue));
-
-                    // record unspent output
-                    addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(1, uint160(hashBytes), txhash, k), CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight)));
-
-                } else if (out.scriptPubKey.IsPayToPublicKey()) {
-                    uint160 hashBytes(Hash160(out.scriptPubKey.begin() + 1, out.scriptPubKey.end() - 1));
-                    addressIndex.push_back(
-                            std::make_pair(CAddressIndexKey(1, hashBytes, pindex->nHeight, i, txhash, k, false),
-                                           out.nValue));
-                    addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(1, hashBytes, txhash, k),
-                                                                 CAddressUnspentValue(out.nValue, out.scriptPubKey,
-                                                                                      pindex->nHeight)));
-                } else {
-                    /** AIDP START */
-                    if (AreAssetsDeployed()) {
-                        std::string assetName;
-                        CAmount assetAmount;
-                        uint160 hashBytes;
-
-                        if (ParseAssetScript(out.scriptPubKey, hashBytes, assetName, assetAmount)) {
-//                            std::cout << "ConnectBlock(): pushing assets onto addressIndex: " << "1" << ", " << hashBytes.GetHex() << ", " << assetName << ", " << pindex->nHeight
-//                                      << ", " << i << ", " << txhash.GetHex() << ", " << k << ", " << "true" << ", " << assetAmount << std::endl;
-
-                            // record receiving activity
-                            addressIndex.push_back(std::make_pair(
-                                    CAddressIndexKey(1, hashBytes, assetName, pindex->nHeight, i, txhash, k, false),
-                                    assetAmount));
-
-                            // record unspent output
-                            addressUnspentIndex.push_back(
-                                    std::make_pair(CAddressUnspentKey(1, hashBytes, assetName, txhash, k),
-                                                   CAddressUnspentValue(assetAmount, out.scriptPubKey,
-                                                                        pindex->nHeight)));
-                        }
-                    } else {
-                        continue;
-                    }
-                    /** AIDP END */
-                }
-            }
-        }
-
         CTxUndo undoDummy;
         if (i > 0) {
             blockundo.vtxundo.push_back(CTxUndo());
@@ -2869,41 +2780,6 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
         if (!pblocktree->WriteTxIndex(vPos))
             return AbortNode(state, "Failed to write transaction index");
 
-    if (!ignoreAddressIndex && fAddressIndex) {
-        if (!pblocktree->WriteAddressIndex(addressIndex)) {
-            return AbortNode(state, "Failed to write address index");
-        }
-
-        if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
-            return AbortNode(state, "Failed to write address unspent index");
-        }
-    }
-
-    if (!ignoreAddressIndex && fSpentIndex)
-        if (!pblocktree->UpdateSpentIndex(spentIndex))
-            return AbortNode(state, "Failed to write transaction index");
-
-    if (!ignoreAddressIndex && fTimestampIndex) {
-        unsigned int logicalTS = pindex->nTime;
-        unsigned int prevLogicalTS = 0;
-
-        // retrieve logical timestamp of the previous block
-        if (pindex->pprev)
-            if (!pblocktree->ReadTimestampBlockIndex(pindex->pprev->GetBlockHash(), prevLogicalTS))
-                LogPrintf("%s: Failed to read previous block's logical timestamp\n", __func__);
-
-        if (logicalTS <= prevLogicalTS) {
-            logicalTS = prevLogicalTS + 1;
-            LogPrintf("%s: Previous logical timestamp is newer Actual[%d] prevLogical[%d] Logical[%d]\n", __func__, pindex->nTime, prevLogicalTS, logicalTS);
-        }
-
-        if (!pblocktree->WriteTimestampIndex(CTimestampIndexKey(logicalTS, pindex->GetBlockHash())))
-            return AbortNode(state, "Failed to write timestamp index");
-
-        if (!pblocktree->WriteTimestampBlockIndex(CTimestampBlockIndexKey(pindex->GetBlockHash()), CTimestampBlockIndexValue(logicalTS)))
-            return AbortNode(state, "Failed to write blockhash index");
-    }
-
     if (AreMessagesDeployed() && fMessaging && setMessages.size()) {
         LOCK(cs_messaging);
         for (auto message : setMessages) {
@@ -2948,9 +2824,37 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     int64_t nTime6 = GetTimeMicros(); nTimeCallbacks += nTime6 - nTime5;
     LogPrint(BCLog::BENCH, "    - Callbacks: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime6 - nTime5), nTimeCallbacks * MICRO, nTimeCallbacks * MILLI / nBlocksTotal);
 
+    // The indexes build their entries from the undo data when the block is signalled connected
+    if (pindexchainfollower)
+        pindexchainfollower->KeepBlockUndo(pindex, std::move(blockundo));
+
     return true;
 }
 
+/**
+ * Whether the coins cache can be handed to the background writer instead of being written
+ * inline. Replaying an interrupted write only rolls the coin database forward, while the
+ * asset state is flushed synchronously at the new tip, so only flushes that extend the chain
+ * already on (or on its way to) disk qualify. Reorgs across the flushed tip flush inline.
+ */
+static bool CanFlushCoinsInBackground()
+{
+    AssertLockHeld(cs_main);
+    if (!pcoinsflushview || !gArgs.GetBoolArg("-backgroundflush", DEFAULT_BACKGROUND_FLUSH))
+        return false;
+
+    BlockMap::iterator itNew = mapBlockIndex.find(pcoinsTip->GetBestBlock());
+    if (itNew == mapBlockIndex.end())
+        return false;
+    uint256 hashOld = pcoinsflushview->GetBestBlock();
+    if (hashOld.IsNull())
+        return true;
+    BlockMap::iterator itOld = mapBlockIndex.find(hashOld);
+    if (itOld == mapBlockIndex.end())
+        return false;
+    return itNew->second->GetAncestor(itOld->second->nHeight) == itOld->second;
+}
+
 /**
  * Update the on-disk chain state.
  * The caches and indexes are flushed depending on the mode we're called with
@@ -3079,9 +2983,19 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             if (!CheckDiskSpace((48 * 2 * 2 * pcoinsTip->GetCacheSize()) + assetDirtyCacheSize * 2)) /** AIDP START */ /** AIDP END */
                 return state.Error("out of disk space");
 
-            // Flush the chainstate (which may refer to block index entries).
-            if (!pcoinsTip->Flush())
+            // Anything prefetched so far may be overwritten by this flush
+            if (pcoinsprefetcher)
+                pcoinsprefetcher->Invalidate();
+
+            // Flush the chainstate (which may refer to block index entries). Outside of shutdown
+            // and pruning, the write itself can go to the background so cs_main is released sooner.
+            bool fBackground = mode != FLUSH_STATE_ALWAYS && !fFlushForPrune && CanFlushCoinsInBackground();
+            if (fBackground) {
+                if (!pcoinsflushview->FlushInBackground(*pcoinsTip))
+                    return AbortNode(state, "Failed to write to coin database");
+            } else if (!pcoinsTip->Flush()) {
                 return AbortNode(state, "Failed to write to coin database");
+            }
 
             /** AIDP START */
             // Flush the assetstate
@@ -3372,6 +3286,9 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
     ConnectedBlockAssetData assetDataFromBlock;
     /** AIDP END */
 
+    if (pcoinsprefetcher)
+        pcoinsprefetcher->Apply(blockConnecting.GetHash(), *pcoinsTip);
+
     {
         CCoinsViewCache view(pcoinsTip);
         /** AIDP START */
@@ -3894,6 +3811,31 @@ static CBlockIndex* AddToBlockIndex(const CBlockHeader& block)
     return pindexNew;
 }
 
+/** Set nChainTx for blocks whose parents all have their transactions, and for their waiting descendants. */
+static void LinkProcessedBlocks(std::deque<CBlockIndex*>& queue)
+{
+    // Recursively process any descendant blocks that now may be eligible to be connected.
+    while (!queue.empty()) {
+        CBlockIndex *pindex = queue.front();
+        queue.pop_front();
+        pindex->nChainTx = (pindex->pprev ? pindex->pprev->nChainTx : 0) + pindex->nTx;
+        {
+            LOCK(cs_nBlockSequenceId);
+            pindex->nSequenceId = nBlockSequenceId++;
+        }
+        if (chainActive.Tip() == nullptr || !setBlockIndexCandidates.value_comp()(pindex, chainActive.Tip())) {
+            setBlockIndexCandidates.insert(pindex);
+        }
+        std::pair<std::multimap<CBlockIndex*, CBlockIndex*>::iterator, std::multimap<CBlockIndex*, CBlockIndex*>::iterator> range = mapBlocksUnlinked.equal_range(pindex);
+        while (range.first != range.second) {
+            std::multimap<CBlockIndex*, CBlockIndex*>::iterator it = range.first;
+            queue.push_back(it->second);
+            range.first++;
+            mapBlocksUnlinked.erase(it);
+        }
+    }
+}
+
 /** Mark a block as having its data received and checked (up to BLOCK_VALID_TRANSACTIONS). */
 static bool ReceivedBlockTransactions(const CBlock &block, CValidationState& state, CBlockIndex *pindexNew, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
 {
@@ -3913,27 +3855,7 @@ static bool ReceivedBlockTransactions(const CBlock &block, CValidationState& sta
         // If pindexNew is the genesis block or all parents are BLOCK_VALID_TRANSACTIONS.
         std::deque<CBlockIndex*> queue;
         queue.push_back(pindexNew);
-
-        // Recursively process any descendant blocks that now may be eligible to be connected.
-        while (!queue.empty()) {
-            CBlockIndex *pindex = queue.front();
-            queue.pop_front();
-            pindex->nChainTx = (pindex->pprev ? pindex->pprev->nChainTx : 0) + pindex->nTx;
-            {
-                LOCK(cs_nBlockSequenceId);
-                pindex->nSequenceId = nBlockSequenceId++;
-            }
-            if (chainActive.Tip() == nullptr || !setBlockIndexCandidates.value_comp()(pindex, chainActive.Tip())) {
-                setBlockIndexCandidates.insert(pindex);
-            }
-            std::pair<std::multimap<CBlockIndex*, CBlockIndex*>::iterator, std::multimap<CBlockIndex*, CBlockIndex*>::iterator> range = mapBlocksUnlinked.equal_range(pindex);
-            while (range.first != range.second) {
-                std::multimap<CBlockIndex*, CBlockIndex*>::iterator it = range.first;
-                queue.push_back(it->second);
-                range.first++;
-                mapBlocksUnlinked.erase(it);
-            }
-        }
+        LinkProcessedBlocks(queue);
     } else {
         if (pindexNew->pprev && pindexNew->pprev->IsValid(BLOCK_VALID_TREE)) {
             mapBlocksUnlinked.insert(std::make_pair(pindexNew->pprev, pindexNew));
@@ -4352,7 +4274,7 @@ static bool ContextualCheckBlock(const CBlock& block, CValidationState& state, c
     return true;
 }
 
-static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fCheckPOW = true)
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
@@ -4371,7 +4293,7 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
             return true;
         }
 
-        if (!CheckBlockHeader(block, state, chainparams.GetConsensus()))
+        if (!CheckBlockHeader(block, state, chainparams.GetConsensus(), fCheckPOW))
             return error("%s: Consensus::CheckBlockHeader: %s, %s", __func__, hash.ToString(), FormatStateMessage(state));
 
         // Get prev block index
@@ -4443,7 +4365,8 @@ static bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidation
     CBlockIndex *pindexDummy = nullptr;
     CBlockIndex *&pindex = ppindex ? *ppindex : pindexDummy;
 
-    if (!AcceptBlockHeader(block, state, chainparams, &pindex))
+    // A block that already passed CheckBlock (fChecked) had its proof of work checked with it
+    if (!AcceptBlockHeader(block, state, chainparams, &pindex, !block.fChecked))
         return false;
 
     // Try to process all requested blocks that we don't have, but only
@@ -4520,6 +4443,10 @@ static bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidation
         return AbortNode(state, std::string("System error: ") + e.what());
     }
 
+    // Start reading the coins the block spends while it waits to be connected
+    if (pcoinsprefetcher && fHasMoreWork)
+        pcoinsprefetcher->Prefetch(block, *pcoinsTip);
+
     if (fCheckForPruning)
         FlushStateToDisk(chainparams, state, FLUSH_STATE_NONE); // we just allocated more disk space for block files
 
@@ -4641,6 +4568,7 @@ void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune)
 {
     for (std::set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
+        blockFileMaps.Erase(*it);
         fs::remove(GetBlockPosFilename(pos, "blk"));
         fs::remove(GetBlockPosFilename(pos, "rev"));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
@@ -5020,7 +4948,7 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
         // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
         if (nCheckLevel >= 3 && pindex == pindexState && (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) <= nCoinCacheUsage) {
             assert(coins.GetBestBlock() == pindex->GetBlockHash());
-            DisconnectResult res = DisconnectBlock(block, pindex, coins, &assetCache, true, false);
+            DisconnectResult res = DisconnectBlock(block, pindex, coins, &assetCache, false);
             if (res == DISCONNECT_FAILED) {
                 return error("VerifyDB(): *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
             }
@@ -5048,7 +4976,7 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
             CBlock block;
             if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
                 return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
-            if (!ConnectBlock(block, state, pindex, coins, chainparams, &assetCache, false, true))
+            if (!ConnectBlock(block, state, pindex, coins, chainparams, &assetCache))
                 return error("VerifyDB(): *** found unconnectable block at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
         }
     }
@@ -5148,6 +5076,57 @@ bool ReplayBlocks(const CChainParams& params, CCoinsView* view)
     return true;
 }
 
+bool ActivateTxOutSnapshot(const CChainParams& chainparams, CBlockIndex* pindexBase, std::string& strError)
+{
+    AssertLockHeld(cs_main);
+    assert(pindexBase);
+
+    if (pcoinsdbview->GetBestBlock() != pindexBase->GetBlockHash()) {
+        strError = "coin database is not at the snapshot base block";
+        return false;
+    }
+
+    std::vector<CBlockIndex*> vChain;
+    for (CBlockIndex* pindex = pindexBase; pindex->pprev; pindex = pindex->pprev) {
+        if (pindex->nStatus & BLOCK_FAILED_MASK) {
+            strError = strprintf("block %s below the snapshot base is marked invalid", pindex->GetBlockHash().ToString());
+            return false;
+        }
+        vChain.push_back(pindex);
+    }
+    std::reverse(vChain.begin(), vChain.end());
+
+    // The creator of the snapshot validated everything up to the base. As on a pruned node,
+    // the block data is simply not there: a placeholder nTx keeps nChainTx meaningful.
+    for (CBlockIndex* pindex : vChain) {
+        if (pindex->nTx == 0)
+            pindex->nTx = 1;
+        pindex->RaiseValidity(BLOCK_VALID_SCRIPTS);
+        setDirtyBlockIndex.insert(pindex);
+    }
+    for (std::multimap<CBlockIndex*, CBlockIndex*>::iterator it = mapBlocksUnlinked.begin(); it != mapBlocksUnlinked.end(); ) {
+        if (pindexBase->GetAncestor(it->second->nHeight) == it->second)
+            it = mapBlocksUnlinked.erase(it);
+        else
+            ++it;
+    }
+
+    pcoinsTip->SetBestBlock(pindexBase->GetBlockHash());
+    chainActive.SetTip(pindexBase);
+    std::deque<CBlockIndex*> queue(vChain.begin(), vChain.end());
+    LinkProcessedBlocks(queue);
+    PruneBlockIndexCandidates();
+
+    if (!fHavePruned) {
+        pblocktree->WriteFlag("prunedblockfiles", true);
+        fHavePruned = true;
+    }
+
+    LogPrintf("%s: chain tip set to snapshot base %s (%d)\n", __func__, pindexBase->GetBlockHash().ToString(), pindexBase->nHeight);
+    CheckBlockIndex(chainparams.GetConsensus());
+    return true;
+}
+
 bool RewindBlockIndex(const CChainParams& params)
 {
     LOCK(cs_main);
@@ -5255,6 +5234,7 @@ void UnloadBlockIndex()
     mapBlocksUnlinked.clear();
     vinfoBlockFile.clear();
     nLastBlockFile = 0;
+    blockFileMaps.Clear();
     nBlockSequenceId = 1;
     setDirtyBlockIndex.clear();
     g_failed_blocks.clear();
@@ -5303,6 +5283,7 @@ bool LoadBlockIndex(const CChainParams& chainparams)
         // Use the provided setting for -addressindex in the new database
         fAddressIndex = gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
         pblocktree->WriteFlag("addressindex", fAddressIndex);
+        pblocktree->WriteFlag("addressbalances", fAddressIndex);
         LogPrintf("%s: address index %s\n", __func__, fAddressIndex ? "enabled" : "disabled");
 
         // Use the provided setting for -timestampindex in the new database
@@ -5350,54 +5331,237 @@ bool LoadGenesisBlock(const CChainParams& chainparams)
     return true;
 }
 
+namespace {
+
+/** A block read from a block file by LoadExternalBlockFile. */
+struct CBlockFileEntry
+{
+    //! Where to resume scanning if the block is unreadable: just past its message start
+    uint64_t nRewind;
+    uint64_t nBlockPos;
+    unsigned int nSize;
+    std::vector<char> vchBlock;
+
+    // Set by the parser
+    std::shared_ptr<CBlock> pblock;
+    uint256 hash;
+    //! Bytes the block was deserialized from, which can be less than nSize
+    uint64_t nConsumed;
+    std::string strError;
+    bool fDone;
+
+    CBlockFileEntry() : nRewind(0), nBlockPos(0), nSize(0), nConsumed(0), fDone(false) {}
+};
+
+/**
+ * Deserializes, hashes and checks (CheckBlock: proof of work, merkle root, transactions) the
+ * blocks read by LoadExternalBlockFile on worker threads, while the loading thread reads ahead
+ * and hands the finished blocks to AcceptBlock in file order. CheckBlock caches its success in
+ * CBlock::fChecked, so AcceptBlock does not repeat that work; failures are left for AcceptBlock
+ * to report.
+ */
+class CBlockFileParser
+{
+public:
+    CBlockFileParser(const Consensus::Params& paramsIn, int nThreads) : params(paramsIn), fStop(false), nParseTime(0), nParsed(0)
+    {
+        for (int i = 0; i < nThreads; i++) {
+            threads.emplace_back(&TraceThread<std::function<void()> >, "blkparse",
+                std::function<void()>(std::bind(&CBlockFileParser::ThreadParse, this)));
+        }
+    }
+
+    ~CBlockFileParser()
+    {
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            fStop = true;
+        }
+        condWork.notify_all();
+        for (std::thread& thread : threads)
+            thread.join();
+    }
+
+    void Push(const std::shared_ptr<CBlockFileEntry>& entry)
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        queue.push_back(entry);
+        condWork.notify_one();
+    }
+
+    void Wait(const CBlockFileEntry& entry)
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        condDone.wait(lock, [&entry] { return entry.fDone; });
+    }
+
+    //! Time spent parsing, summed over the threads (microseconds)
+    int64_t GetParseTime() const { return nParseTime; }
+    int GetParsed() const { return nParsed; }
+
+private:
+    const Consensus::Params& params;
+    std::mutex cs;
+    std::condition_variable condWork;
+    std::condition_variable condDone;
+    std::deque<std::shared_ptr<CBlockFileEntry> > queue;
+    bool fStop;
+    std::atomic<int64_t> nParseTime;
+    std::atomic<int> nParsed;
+    std::vector<std::thread> threads;
+
+    void Parse(CBlockFileEntry& entry)
+    {
+        try {
+            CDataStream ss(entry.vchBlock, SER_DISK, CLIENT_VERSION);
+            std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+            UnserializeBlockInArena(ss, *pblock);
+            entry.nConsumed = entry.nSize - ss.size();
+            entry.hash = pblock->GetHash();
+            CValidationState state;
+            CheckBlock(*pblock, state, params, true, true);
+            entry.pblock = pblock;
+        } catch (const std::exception& e) {
+            entry.strError = e.what();
+        }
+        std::vector<char>().swap(entry.vchBlock);
+    }
+
+    void ThreadParse()
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        while (true) {
+            condWork.wait(lock, [this] { return fStop || !queue.empty(); });
+            if (fStop)
+                return;
+            std::shared_ptr<CBlockFileEntry> entry = queue.front();
+            queue.pop_front();
+            lock.unlock();
+
+            int64_t nTimeStart = GetTimeMicros();
+            Parse(*entry);
+            nParseTime += GetTimeMicros() - nTimeStart;
+            nParsed++;
+
+            lock.lock();
+            entry->fDone = true;
+            condDone.notify_all();
+        }
+    }
+};
+
+} // namespace
+
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp)
 {
     // Map of disk positions for blocks with unknown parent (only used for reindex)
     static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
-    int64_t nStart = GetTimeMillis();
+    int64_t nStart = GetTimeMicros();
 
     int nLoaded = 0;
+    int nThreads = std::max(nScriptCheckThreads, 1);
+    int64_t nReadTime = 0;
+    int64_t nWaitTime = 0;
+    uint64_t nBytesRead = 0;
+    int64_t nParseTime = 0;
+    int nParsed = 0;
     try {
+        FileReadAhead(fileIn);
         // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
         CBufferedFile blkdat(fileIn, 2*GetMaxBlockSerializedSize(), GetMaxBlockSerializedSize()+8, SER_DISK, CLIENT_VERSION);
+        CBlockFileParser parser(chainparams.GetConsensus(), nThreads);
+        std::deque<std::shared_ptr<CBlockFileEntry> > queueEntries;
+        size_t nQueuedBytes = 0;
+        bool fEndOfFile = false;
         uint64_t nRewind = blkdat.GetPos();
-        while (!blkdat.eof()) {
+        while (true) {
             boost::this_thread::interruption_point();
 
-            blkdat.SetPos(nRewind);
-            nRewind++; // start one byte further next time, in case of failure
-            blkdat.SetLimit(); // remove former limit
-            unsigned int nSize = 0;
-            try {
-                // locate a header
-                unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
-                blkdat.FindByte(chainparams.MessageStart()[0]);
-                nRewind = blkdat.GetPos()+1;
-                blkdat >> FLATDATA(buf);
-                if (memcmp(buf, chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE))
-                    continue;
-                // read size
-                blkdat >> nSize;
-                if (nSize < 80 || nSize > GetMaxBlockSerializedSize())
+            // Keep the parser threads busy by reading ahead of the block handed to AcceptBlock
+            int64_t nTimeRead = GetTimeMicros();
+            while (!fEndOfFile && queueEntries.size() < REINDEX_PARSE_AHEAD_BLOCKS && nQueuedBytes < REINDEX_PARSE_AHEAD_BYTES) {
+                if (blkdat.eof()) {
+                    fEndOfFile = true;
+                    break;
+                }
+                blkdat.SetPos(nRewind);
+                nRewind++; // start one byte further next time, in case of failure
+                blkdat.SetLimit(); // remove former limit
+                unsigned int nSize = 0;
+                try {
+                    // locate a header
+                    unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
+                    blkdat.FindByte(chainparams.MessageStart()[0]);
+                    nRewind = blkdat.GetPos()+1;
+                    blkdat >> FLATDATA(buf);
+                    if (memcmp(buf, chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE))
+                        continue;
+                    // read size
+                    blkdat >> nSize;
+                    if (nSize < 80 || nSize > GetMaxBlockSerializedSize())
+                        continue;
+                } catch (const std::exception&) {
+                    // no valid block header found; don't complain
+                    fEndOfFile = true;
+                    break;
+                }
+                std::shared_ptr<CBlockFileEntry> entry = std::make_shared<CBlockFileEntry>();
+                entry->nRewind = nRewind;
+                entry->nSize = nSize;
+                try {
+                    // read block
+                    entry->nBlockPos = blkdat.GetPos();
+                    blkdat.SetLimit(entry->nBlockPos + nSize);
+                    entry->vchBlock.resize(nSize);
+                    blkdat.read(entry->vchBlock.data(), nSize);
+                    nRewind = blkdat.GetPos();
+                } catch (const std::exception& e) {
+                    LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
                     continue;
-            } catch (const std::exception&) {
-                // no valid block header found; don't complain
+                }
+                nBytesRead += nSize;
+                nQueuedBytes += nSize;
+                parser.Push(entry);
+                queueEntries.push_back(entry);
+            }
+            nReadTime += GetTimeMicros() - nTimeRead;
+            if (queueEntries.empty())
                 break;
+
+            std::shared_ptr<CBlockFileEntry> entry = queueEntries.front();
+            queueEntries.pop_front();
+            nQueuedBytes -= entry->nSize;
+            int64_t nTimeWait = GetTimeMicros();
+            parser.Wait(*entry);
+            nWaitTime += GetTimeMicros() - nTimeWait;
+
+            if (!entry->pblock || entry->nConsumed < entry->nSize) {
+                // Scan on from where reading the block one at a time would have: just past the
+                // message start of an unreadable block, or after the bytes the block used. The
+                // blocks read ahead from the old position are dropped.
+                nRewind = entry->pblock ? entry->nBlockPos + entry->nConsumed : entry->nRewind;
+                queueEntries.clear();
+                nQueuedBytes = 0;
+                fEndOfFile = false;
+                blkdat.SetLimit();
+                if (!blkdat.SetPos(nRewind) && !blkdat.Seek(nRewind)) {
+                    LogPrintf("%s: Unable to seek to position %u\n", __func__, nRewind);
+                    break;
+                }
+                if (!entry->pblock) {
+                    LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, entry->strError);
+                    continue;
+                }
             }
+
             try {
-                // read block
-                uint64_t nBlockPos = blkdat.GetPos();
                 if (dbp)
-                    dbp->nPos = nBlockPos;
-                blkdat.SetLimit(nBlockPos + nSize);
-                blkdat.SetPos(nBlockPos);
-                std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+                    dbp->nPos = entry->nBlockPos;
+                std::shared_ptr<CBlock> pblock = entry->pblock;
                 CBlock& block = *pblock;
-                blkdat >> block;
-                nRewind = blkdat.GetPos();
 
                 // detect out of order blocks, and store them for later
-                uint256 hash = block.GetHash();
+                uint256 hash = entry->hash;
                 if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
                     LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
                             block.hashPrevBlock.ToString());
@@ -5461,11 +5625,21 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
                 LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
             }
         }
+        nParseTime = parser.GetParseTime();
+        nParsed = parser.GetParsed();
     } catch (const std::runtime_error& e) {
         AbortNode(std::string("System error: ") + e.what());
     }
-    if (nLoaded > 0)
-        LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
+    if (nLoaded > 0) {
+        int64_t nTotalTime = GetTimeMicros() - nStart;
+        int64_t nAcceptTime = nTotalTime - nReadTime - nWaitTime;
+        LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, nTotalTime / 1000);
+        LogPrintf("  read %.2fMB in %.2fs (%.2fMB/s), parsed %d blocks on %d threads in %.2fs of thread time (%.2f blocks/s), "
+                  "accepted %d blocks in %.2fs (%.2f blocks/s), waited for the parser %.2fs\n",
+                  nBytesRead / 1048576.0, nReadTime * MICRO, nBytesRead / 1048576.0 / std::max(nReadTime * MICRO, 0.001),
+                  nParsed, nThreads, nParseTime * MICRO, nParsed / std::max(nParseTime * MICRO / nThreads, 0.001),
+                  nLoaded, nAcceptTime * MICRO, nLoaded / std::max(nAcceptTime * MICRO, 0.001), nWaitTime * MICRO);
+    }
     return nLoaded > 0;
 }
 
@@ -5683,7 +5857,75 @@ int VersionBitsTipStateSinceHeight(const Consensus::Params& params, Consensus::D
     return VersionBitsStateSinceHeight(chainActive.Tip(), params, pos, versionbitscache);
 }
 
-static const uint64_t MEMPOOL_DUMP_VERSION = 1;
+//! mempool.dat without the fee and signature operation cost of each transaction
+static const uint64_t MEMPOOL_DUMP_VERSION_NO_HINTS = 1;
+static const uint64_t MEMPOOL_DUMP_VERSION = 2;
+//! Transactions LoadMempool reads and checks the scripts of at once
+static const unsigned int MEMPOOL_LOAD_BATCH_SIZE = 100;
+
+//! A transaction in mempool.dat
+struct MempoolDumpEntry
+{
+    CTransactionRef tx;
+    int64_t nTime;
+    int64_t nFeeDelta;
+    //! Fee and signature operation cost it was accepted with, -1 if the file does not have them
+    CAmount nFee;
+    int64_t nSigOpCost;
+};
+
+/**
+ * Check the scripts of transactions read from mempool.dat on the script check threads, before
+ * AcceptToMemoryPool takes them one at a time in the order of the file. It then finds their
+ * signatures in the signature cache. The outcome is not used otherwise, and the checks stop at
+ * the first failing script, leaving the rest to AcceptToMemoryPool. The locks are only held
+ * while the spent outputs are looked up, not while the scripts run.
+ *
+ * Transactions that expired, that spend outputs which are not there, or that AcceptToMemoryPool
+ * turns down before checking scripts according to the fee and signature operation cost in the
+ * file are left out.
+ */
+static void CheckMempoolDumpScripts(const std::vector<MempoolDumpEntry>& vEntries, int64_t nExpiryTime)
+{
+    if (!nScriptCheckThreads)
+        return;
+
+    // CScriptCheck keeps a pointer to the data of its transaction
+    std::deque<PrecomputedTransactionData> txdatas;
+    std::vector<CScriptCheck> vChecks;
+    {
+        LOCK2(cs_main, mempool.cs);
+        const CFeeRate minFeeRate = std::max(::minRelayTxFee, mempool.GetMinFee(gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000));
+        CCoinsViewMemPool viewMemPool(pcoinsTip, mempool);
+        CCoinsViewCache view(&viewMemPool);
+        for (const MempoolDumpEntry& entry : vEntries) {
+            const CTransaction& tx = *entry.tx;
+            if (entry.nTime <= nExpiryTime || tx.IsCoinBase() || mempool.exists(tx.GetHash()))
+                continue;
+            if (entry.nSigOpCost >= 0) {
+                if (entry.nSigOpCost > MAX_STANDARD_TX_SIGOPS_COST)
+                    continue;
+                if (entry.nFee + entry.nFeeDelta < minFeeRate.GetFee(GetVirtualTransactionSize(tx, entry.nSigOpCost)))
+                    continue;
+            }
+            if (!view.HaveInputs(tx))
+                continue;
+
+            txdatas.emplace_back(tx);
+            CValidationState state;
+            CheckInputs(tx, state, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, true, false, txdatas.back(), &vChecks);
+
+            // Later transactions may spend its outputs, but not its inputs
+            for (const CTxIn& txin : tx.vin)
+                view.SpendCoin(txin.prevout);
+            AddCoins(view, tx, MEMPOOL_HEIGHT, uint256(), true);
+        }
+    }
+
+    CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+    control.Add(vChecks);
+    control.Wait();
+}
 
 bool LoadMempool(void)
 {
@@ -5701,51 +5943,84 @@ bool LoadMempool(void)
     int64_t failed = 0;
     int64_t already_there = 0;
     int64_t nNow = GetTime();
+    int64_t nStart = GetTimeMillis();
 
     try {
         uint64_t version;
         file >> version;
-        if (version != MEMPOOL_DUMP_VERSION) {
+        if (version != MEMPOOL_DUMP_VERSION && version != MEMPOOL_DUMP_VERSION_NO_HINTS) {
             return false;
         }
         uint64_t num;
         file >> num;
-        while (num--) {
-            CTransactionRef tx;
-            int64_t nTime;
-            int64_t nFeeDelta;
-            file >> tx;
-            file >> nTime;
-            file >> nFeeDelta;
-
-            CAmount amountdelta = nFeeDelta;
-            if (amountdelta) {
-                mempool.PrioritiseTransaction(tx->GetHash(), amountdelta);
+        std::string strReadError;
+        while (num) {
+            // Transactions come parents first, which AcceptToMemoryPool keeps to within and
+            // across the batches.
+            std::vector<MempoolDumpEntry> vEntries;
+            vEntries.reserve(std::min<uint64_t>(num, MEMPOOL_LOAD_BATCH_SIZE));
+            try {
+                while (num && vEntries.size() < MEMPOOL_LOAD_BATCH_SIZE) {
+                    MempoolDumpEntry entry;
+                    file >> entry.tx;
+                    file >> entry.nTime;
+                    file >> entry.nFeeDelta;
+                    if (version == MEMPOOL_DUMP_VERSION) {
+                        file >> entry.nFee;
+                        file >> entry.nSigOpCost;
+                    } else {
+                        entry.nFee = -1;
+                        entry.nSigOpCost = -1;
+                    }
+                    vEntries.push_back(entry);
+                    --num;
+                }
+            } catch (const std::exception& e) {
+                // Still take the transactions of the batch read before the damaged one
+                strReadError = e.what();
+                num = 0;
             }
-            CValidationState state;
-            if (nTime + nExpiryTimeout > nNow) {
-                LOCK(cs_main);
-                AcceptToMemoryPoolWithTime(chainparams, mempool, state, tx, nullptr /* pfMissingInputs */, nTime,
-                                           nullptr /* plTxnReplaced */, false /* bypass_limits */, 0 /* nAbsurdFee */,
-                                           false /* test_accept */);
-                if (state.IsValid()) {
-                    ++count;
-                } else {
-                    // mempool may contain the transaction already, e.g. from
-                    // wallet(s) having loaded it while we were processing
-                    // mempool transactions; consider these as valid, instead of
-                    // failed, but mark them as 'already there'
-                    if (mempool.exists(tx->GetHash())) {
-                        ++already_there;
+
+            for (const MempoolDumpEntry& entry : vEntries) {
+                CAmount amountdelta = entry.nFeeDelta;
+                if (amountdelta) {
+                    mempool.PrioritiseTransaction(entry.tx->GetHash(), amountdelta);
+                }
+            }
+            CheckMempoolDumpScripts(vEntries, nNow - nExpiryTimeout);
+
+            for (const MempoolDumpEntry& entry : vEntries) {
+                const CTransactionRef& tx = entry.tx;
+                CValidationState state;
+                if (entry.nTime + nExpiryTimeout > nNow) {
+                    LOCK(cs_main);
+                    AcceptToMemoryPoolWithTime(chainparams, mempool, state, tx, nullptr /* pfMissingInputs */, entry.nTime,
+                                               nullptr /* plTxnReplaced */, false /* bypass_limits */, 0 /* nAbsurdFee */,
+                                               false /* test_accept */);
+                    if (state.IsValid()) {
+                        ++count;
                     } else {
-                        ++failed;
+                        // mempool may contain the transaction already, e.g. from
+                        // wallet(s) having loaded it while we were processing
+                        // mempool transactions; consider these as valid, instead of
+                        // failed, but mark them as 'already there'
+                        if (mempool.exists(tx->GetHash())) {
+                            ++already_there;
+                        } else {
+                            ++failed;
+                        }
                     }
+                } else {
+                    ++expired;
                 }
-            } else {
-                ++expired;
+                if (ShutdownRequested())
+                    return false;
             }
-            if (ShutdownRequested())
-                return false;
+        }
+        if (!strReadError.empty()) {
+            LogPrintf("Failed to deserialize mempool data on disk: %s. Continuing anyway.\n", strReadError);
+            LogPrintf("Imported mempool transactions from disk: %i succeeded, %i failed, %i expired, %i already there: %dms\n", count, failed, expired, already_there, GetTimeMillis() - nStart);
+            return false;
         }
         std::map<uint256, CAmount> mapDeltas;
         file >> mapDeltas;
@@ -5758,7 +6033,7 @@ bool LoadMempool(void)
         return false;
     }
 
-    LogPrintf("Imported mempool transactions from disk: %i succeeded, %i failed, %i expired, %i already there\n", count, failed, expired, already_there);
+    LogPrintf("Imported mempool transactions from disk: %i succeeded, %i failed, %i expired, %i already there: %dms\n", count, failed, expired, already_there, GetTimeMillis() - nStart);
     return true;
 }
 
@@ -5795,6 +6070,8 @@ bool DumpMempool(void)
             file << *(i.tx);
             file << (int64_t)i.nTime;
             file << (int64_t)i.nFeeDelta;
+            file << (int64_t)i.nFee;
+            file << (int64_t)i.nSigOpCost;
             mapDeltas.erase(i.tx->GetHash());
         }
 
@@ -5811,6 +6088,176 @@ bool DumpMempool(void)
     return true;
 }
 
+static const uint64_t SIGCACHE_DUMP_VERSION = 2;
+
+/**
+ * Get the secret that authenticates sigcache.dat, creating it if asked to. It lives in a file of
+ * its own, so a sigcache.dat copied from elsewhere or written by anything without access to the
+ * secret cannot slip unchecked signatures into the caches.
+ */
+static bool GetSignatureCacheKey(std::vector<unsigned char>& vchKey, bool fCreate)
+{
+    vchKey.assign(32, 0);
+    {
+        CAutoFile file(fsbridge::fopen(GetDataDir() / "sigcache.key", "rb"), SER_DISK, CLIENT_VERSION);
+        try {
+            if (!file.IsNull()) {
+                file.read((char*)vchKey.data(), vchKey.size());
+                return true;
+            }
+        } catch (const std::exception& e) {
+            LogPrintf("Failed to read signature cache key: %s\n", e.what());
+        }
+    }
+    if (!fCreate)
+        return false;
+
+    GetStrongRandBytes(vchKey.data(), vchKey.size());
+    CAutoFile file(fsbridge::fopen(GetDataDir() / "sigcache.key.new", "wb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull())
+        return false;
+    try {
+        file.write((const char*)vchKey.data(), vchKey.size());
+        FileCommit(file.Get());
+        file.fclose();
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to write signature cache key: %s\n", e.what());
+        return false;
+    }
+    return RenameOver(GetDataDir() / "sigcache.key.new", GetDataDir() / "sigcache.key");
+}
+
+//! The trailer of sigcache.dat: an HMAC-SHA256 of the double SHA256 of everything before it
+static uint256 SignatureCacheChecksum(const std::vector<unsigned char>& vchKey, const uint256& hash)
+{
+    uint256 checksum;
+    CHMAC_SHA256(vchKey.data(), vchKey.size()).Write(hash.begin(), hash.size()).Finalize(checksum.begin());
+    return checksum;
+}
+
+static void WriteCacheEntries(CHashedWriter<CAutoFile>& file, const uint256& nonce, const std::vector<uint256>& entries)
+{
+    file << nonce;
+    file << (uint64_t)entries.size();
+    for (const uint256& entry : entries)
+        file << entry;
+}
+
+static void ReadCacheEntries(CHashVerifier<CAutoFile>& file, uint256& nonce, std::vector<uint256>& entries)
+{
+    uint64_t num;
+    file >> nonce;
+    file >> num;
+    entries.reserve(std::min<uint64_t>(num, 1 << 20));
+    while (num--) {
+        uint256 entry;
+        file >> entry;
+        entries.push_back(entry);
+    }
+}
+
+bool LoadSignatureCaches(void)
+{
+    int64_t nStart = GetTimeMillis();
+    FILE* filestr = fsbridge::fopen(GetDataDir() / "sigcache.dat", "rb");
+    CAutoFile afile(filestr, SER_DISK, CLIENT_VERSION);
+    if (afile.IsNull()) {
+        LogPrintf("Failed to open signature cache file from disk. Continuing anyway.\n");
+        return false;
+    }
+
+    std::vector<unsigned char> vchKey;
+    if (!GetSignatureCacheKey(vchKey, false)) {
+        LogPrintf("Ignoring signature cache file without its key\n");
+        return false;
+    }
+
+    uint256 nonceSig, nonceScript;
+    std::vector<uint256> vSig, vScript;
+    try {
+        CHashVerifier<CAutoFile> file(&afile);
+        uint64_t version;
+        int nClientVersion;
+        file >> version;
+        file >> nClientVersion;
+        // Entries only vouch for the script rules of the version that checked them.
+        if (version != SIGCACHE_DUMP_VERSION || nClientVersion != CLIENT_VERSION) {
+            LogPrintf("Ignoring signature cache file from another version\n");
+            return false;
+        }
+        ReadCacheEntries(file, nonceSig, vSig);
+        ReadCacheEntries(file, nonceScript, vScript);
+
+        uint256 hashChecksum;
+        afile >> hashChecksum;
+        if (hashChecksum != SignatureCacheChecksum(vchKey, file.GetHash()))
+            throw std::runtime_error("checksum mismatch");
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to deserialize signature cache data on disk: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
+
+    LoadSignatureCacheEntries(nonceSig, vSig);
+    {
+        LOCK(cs_main);
+        scriptExecutionCacheNonce = nonceScript;
+        for (const uint256& entry : vScript)
+            scriptExecutionCache.insert(entry);
+    }
+
+    LogPrintf("Imported %u signature cache and %u script execution cache entries from disk: %dms\n",
+              vSig.size(), vScript.size(), GetTimeMillis() - nStart);
+    return true;
+}
+
+bool DumpSignatureCaches(void)
+{
+    int64_t nStart = GetTimeMillis();
+
+    uint256 nonceSig, nonceScript;
+    std::vector<uint256> vSig, vScript;
+    GetSignatureCacheEntries(nonceSig, vSig);
+    {
+        LOCK(cs_main);
+        nonceScript = scriptExecutionCacheNonce;
+        scriptExecutionCache.for_each([&vScript](const uint256& entry) { vScript.push_back(entry); });
+    }
+
+    std::vector<unsigned char> vchKey;
+    if (!GetSignatureCacheKey(vchKey, true)) {
+        LogPrintf("Failed to write signature cache key. Continuing anyway.\n");
+        return false;
+    }
+
+    try {
+        FILE* filestr = fsbridge::fopen(GetDataDir() / "sigcache.dat.new", "wb");
+        if (!filestr) {
+            return false;
+        }
+
+        CAutoFile afile(filestr, SER_DISK, CLIENT_VERSION);
+        CHashedWriter<CAutoFile> file(&afile);
+
+        file << SIGCACHE_DUMP_VERSION;
+        file << CLIENT_VERSION;
+        // The entries are hashes salted with these nonces, so the nonces go along with them;
+        // the trailing checksum, keyed with sigcache.key, covers both.
+        WriteCacheEntries(file, nonceSig, vSig);
+        WriteCacheEntries(file, nonceScript, vScript);
+        afile << SignatureCacheChecksum(vchKey, file.GetHash());
+
+        FileCommit(afile.Get());
+        afile.fclose();
+        RenameOver(GetDataDir() / "sigcache.dat.new", GetDataDir() / "sigcache.dat");
+        LogPrintf("Dumped %u signature cache and %u script execution cache entries: %dms\n",
+                  vSig.size(), vScript.size(), GetTimeMillis() - nStart);
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to dump signature cache: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
+    return true;
+}
+
 //! Guess how far we are in the verification process at the given block index
 double GuessVerificationProgress(const ChainTxData& data, CBlockIndex *pindex) {
     if (pindex == nullptr)
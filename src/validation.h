@@ -45,6 +45,7 @@
 class CBlockIndex;
 class CBlockTreeDB;
 class CChainParams;
+class CCoinsViewBackgroundFlush;
 class CCoinsViewDB;
 class CInv;
 class CConnman;
@@ -52,6 +53,7 @@ class CScriptCheck;
 class CBlockPolicyEstimator;
 class CTxMemPool;
 class CValidationState;
+class CBlockUndo;
 class CTxUndo;
 struct ChainTxData;
 
@@ -93,8 +95,15 @@ static const unsigned int BLOCKFILE_CHUNK_SIZE = 0x1000000; // 16 MiB
 /** The pre-allocation chunk size for rev?????.dat files (since 0.8) */
 static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 
+/** Blocks read from a block file ahead of the one being accepted, while reindexing or importing */
+static const size_t REINDEX_PARSE_AHEAD_BLOCKS = 256;
+/** Bytes of blocks read from a block file ahead of the one being accepted */
+static const size_t REINDEX_PARSE_AHEAD_BYTES = 64 << 20;
+
 /** Maximum number of script-checking threads allowed */
-static const int MAX_SCRIPTCHECK_THREADS = 16;
+static const int MAX_SCRIPTCHECK_THREADS = 64;
+/** Transactions with at least this many inputs have their scripts checked on the script check threads when entering the mempool */
+static const unsigned int MEMPOOL_PARALLEL_CHECK_MIN_INPUTS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
 /** Number of blocks that can be requested at any given time from a single peer. */
@@ -160,6 +169,8 @@ static const int64_t DEFAULT_DB_MAX_FILE_SIZE = 2;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 /** Default for -persistmempool */
 static const bool DEFAULT_PERSIST_MEMPOOL = true;
+/** Default for -persistsigcache */
+static const bool DEFAULT_PERSIST_SIGCACHE = true;
 /** Default for -mempoolreplacement */
 static const bool DEFAULT_ENABLE_REPLACEMENT = false;
 /** Default for using fee filter */
@@ -205,6 +216,8 @@ extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern bool fCheckBlockIndex;
 extern bool fCheckpointsEnabled;
+/** Whether finished block files are read through memory mappings (-mmapblocks) */
+extern bool fMmapBlocks;
 extern size_t nCoinCacheUsage;
 /** A fee rate smaller than this is considered zero fee (for relaying, mining and transaction creation) */
 extern CFeeRate minRelayTxFee;
@@ -436,18 +449,26 @@ bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
 bool HashOnchainActive(const uint256 &hash);
 bool GetAddressIndex(uint160 addressHash, int type, std::string assetName,
                      std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                     int start = 0, int end = 0);
+                     int start = 0, int end = 0, size_t nLimit = 0, const CAddressIndexKey *pAfter = nullptr);
 bool GetAddressIndex(uint160 addressHash, int type,
                      std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                     int start = 0, int end = 0);
+                     int start = 0, int end = 0, size_t nLimit = 0, const CAddressIndexKey *pAfter = nullptr);
+bool GetAddressBalance(uint160 addressHash, int type, std::string assetName, CAddressBalanceValue &balance);
+bool GetAddressBalances(uint160 addressHash, int type, std::map<std::string, CAddressBalanceValue> &balances);
 bool GetAddressUnspent(uint160 addressHash, int type, std::string assetName,
-                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs);
+                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                       size_t nLimit = 0, const CAddressUnspentKey *pAfter = nullptr);
 bool GetAddressUnspent(uint160 addressHash, int type,
-                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs);
+                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                       size_t nLimit = 0, const CAddressUnspentKey *pAfter = nullptr);
 
 /** Functions for disk access for blocks */
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/** Read a block's serialization (with witness data) as stored on disk, without deserializing or checking it */
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& vchBlock, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& vchBlock, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -480,6 +501,12 @@ public:
 /** Replay blocks that aren't fully applied to the database. */
 bool ReplayBlocks(const CChainParams& params, CCoinsView* view);
 
+/**
+ * Make pindexBase the chain tip once a UTXO snapshot at that block has been loaded into the
+ * coin database. Blocks up to the base count as validated but, as on a pruned node, have no data.
+ */
+bool ActivateTxOutSnapshot(const CChainParams& chainparams, CBlockIndex* pindexBase, std::string& strError);
+
 /** Find the last common block between the parameter chain and a locator. */
 CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& locator);
 
@@ -498,6 +525,9 @@ extern CChain chainActive;
 /** Global variable that points to the coins database (protected by cs_main) */
 extern CCoinsViewDB *pcoinsdbview;
 
+/** Global variable that points to the view writing coin flushes in the background, if any (protected by cs_main) */
+extern CCoinsViewBackgroundFlush *pcoinsflushview;
+
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache *pcoinsTip;
 
@@ -518,9 +548,6 @@ extern CLRUCache<std::string, CDatabasedAssetData> *passetsCache;
 /** Global variable that points to the subscribed channel LRU Cache (protected by cs_main) */
 extern CLRUCache<std::string, CMessage> *pMessagesCache;
 
-/** Global variable that points to the subscribed channel LRU Cache (protected by cs_main) */
-extern CLRUCache<std::string, int> *pMessageSubscribedChannelsCache;
-
 /** Global variable that points to the address seen LRU Cache (protected by cs_main) */
 extern CLRUCache<std::string, int> *pMessagesSeenAddressCache;
 
@@ -589,6 +616,15 @@ bool DumpMempool();
 /** Load the mempool from disk. */
 bool LoadMempool();
 
+/** Dump the signature and script execution caches to disk, keyed with the secret in sigcache.key. */
+bool DumpSignatureCaches();
+
+/**
+ * Load the signature and script execution caches from disk. Call before any script is checked.
+ * A file that does not match the key in sigcache.key is ignored.
+ */
+bool LoadSignatureCaches();
+
 /** AIDP START */
 bool AreAssetsDeployed();
 
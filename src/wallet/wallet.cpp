@@ -1165,7 +1165,9 @@ bool CWallet::AddToWalletIfInvolvingMe(const CTransactionRef& ptx, const CBlockI
                 }
             }
 
-            CWalletTx wtx(this, ptx);
+            // Transactions of a block read from disk or the network share the block's arena
+            // (UnserializeBlockInArena); keep a copy so the wallet does not pin the whole block.
+            CWalletTx wtx(this, pIndex != nullptr ? MakeTransactionRef(*ptx) : ptx);
 
             // Get merkle branch if transaction was found in a block
             if (pIndex != nullptr)
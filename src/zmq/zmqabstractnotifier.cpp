@@ -27,3 +27,8 @@ bool CZMQAbstractNotifier::NotifyMessage(const CMessage &/*message*/)
 {
     return true;
 }
+
+bool CZMQAbstractNotifier::NotifyBlockConnected(const CBlock &/*block*/, const CBlockIndex * /*pindex*/)
+{
+    return true;
+}
@@ -17,7 +17,7 @@ void zmqError(const char *str)
     LogPrint(BCLog::ZMQ, "zmq: Error: %s, errno=%s\n", str, zmq_strerror(errno));
 }
 
-CZMQNotificationInterface::CZMQNotificationInterface() : pcontext(nullptr)
+CZMQNotificationInterface::CZMQNotificationInterface() : pcontext(nullptr), nMaxQueueSize(DEFAULT_ZMQ_QUEUE_SIZE), nDropped(0), fStopPublish(false)
 {
 }
 
@@ -42,6 +42,10 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
     factories["pubrawblock"] = CZMQAbstractNotifier::Create<CZMQPublishRawBlockNotifier>;
     factories["pubrawtx"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionNotifier>;
     factories["pubrawmessage"] = CZMQAbstractNotifier::Create<CZMQPublishNewAssetMessageNotifier>;
+    factories["pubassetissue"] = CZMQAbstractNotifier::Create<CZMQPublishAssetIssueNotifier>;
+    factories["pubassetreissue"] = CZMQAbstractNotifier::Create<CZMQPublishAssetReissueNotifier>;
+    factories["pubassettransfer"] = CZMQAbstractNotifier::Create<CZMQPublishAssetTransferNotifier>;
+    factories["pubassetrestriction"] = CZMQAbstractNotifier::Create<CZMQPublishAssetRestrictionNotifier>;
 
     for (std::map<std::string, CZMQNotifierFactory>::const_iterator i=factories.begin(); i!=factories.end(); ++i)
     {
@@ -53,6 +57,7 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
             CZMQAbstractNotifier *notifier = factory();
             notifier->SetType(i->first);
             notifier->SetAddress(address);
+            notifier->SetOutboundMessageHighWaterMark(static_cast<int>(gArgs.GetArg(arg + "hwm", gArgs.GetArg("-zmqpubhwm", DEFAULT_ZMQ_SNDHWM))));
             notifiers.push_back(notifier);
         }
     }
@@ -61,6 +66,7 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
     {
         notificationInterface = new CZMQNotificationInterface();
         notificationInterface->notifiers = notifiers;
+        notificationInterface->nMaxQueueSize = std::max<int64_t>(1, gArgs.GetArg("-zmqqueuesize", DEFAULT_ZMQ_QUEUE_SIZE));
 
         if (!notificationInterface->Initialize())
         {
@@ -106,6 +112,8 @@ bool CZMQNotificationInterface::Initialize()
         return false;
     }
 
+    threadPublish = std::thread(&TraceThread<std::function<void()> >, "zmqpub", std::function<void()>(std::bind(&CZMQNotificationInterface::ThreadPublish, this)));
+
     return true;
 }
 
@@ -113,6 +121,17 @@ bool CZMQNotificationInterface::Initialize()
 void CZMQNotificationInterface::Shutdown()
 {
     LogPrint(BCLog::ZMQ, "zmq: Shutdown notification interface\n");
+    if (threadPublish.joinable())
+    {
+        // Let the publisher send whatever is still queued before the sockets close
+        {
+            std::lock_guard<std::mutex> lock(cs_queue);
+            fStopPublish = true;
+        }
+        condQueue.notify_one();
+        threadPublish.join();
+    }
+
     if (pcontext)
     {
         for (std::list<CZMQAbstractNotifier*>::iterator i=notifiers.begin(); i!=notifiers.end(); ++i)
@@ -127,62 +146,70 @@ void CZMQNotificationInterface::Shutdown()
     }
 }
 
-void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+void CZMQNotificationInterface::QueueJob(NotifyJob job)
 {
-    if (fInitialDownload || pindexNew == pindexFork) // In IBD or blocks were disconnected without any new ones
-        return;
-
-    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
-        CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyBlock(pindexNew))
-        {
-            i++;
-        }
-        else
-        {
-            notifier->Shutdown();
-            i = notifiers.erase(i);
+        std::lock_guard<std::mutex> lock(cs_queue);
+        if (queue.size() >= nMaxQueueSize) {
+            // Never block the validation thread on a slow subscriber
+            if (nDropped++ % 1000 == 0)
+                LogPrint(BCLog::ZMQ, "zmq: Publisher queue full (%u), dropped %u notifications\n", queue.size(), nDropped);
+            return;
         }
+        queue.push_back(std::move(job));
     }
+    condQueue.notify_one();
 }
 
-void CZMQNotificationInterface::NewAssetMessage(const CMessage& message)
+void CZMQNotificationInterface::ThreadPublish()
 {
-    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+    while (true)
     {
-        CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyMessage(message))
+        NotifyJob job;
         {
-            i++;
+            std::unique_lock<std::mutex> lock(cs_queue);
+            condQueue.wait(lock, [this] { return fStopPublish || !queue.empty(); });
+            if (queue.empty())
+                return;
+            job = std::move(queue.front());
+            queue.pop_front();
         }
-        else
+
+        // notifiers is only touched by this thread until it is joined
+        for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
         {
-            notifier->Shutdown();
-            i = notifiers.erase(i);
+            CZMQAbstractNotifier *notifier = *i;
+            if (job(notifier))
+            {
+                i++;
+            }
+            else
+            {
+                notifier->Shutdown();
+                i = notifiers.erase(i);
+            }
         }
     }
 }
 
+void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    if (fInitialDownload || pindexNew == pindexFork) // In IBD or blocks were disconnected without any new ones
+        return;
+
+    QueueJob([pindexNew](CZMQAbstractNotifier *notifier) { return notifier->NotifyBlock(pindexNew); });
+}
+
+void CZMQNotificationInterface::NewAssetMessage(const CMessage& message)
+{
+    QueueJob([message](CZMQAbstractNotifier *notifier) { return notifier->NotifyMessage(message); });
+}
+
 void CZMQNotificationInterface::TransactionAddedToMempool(const CTransactionRef& ptx)
 {
     // Used by BlockConnected and BlockDisconnected as well, because they're
     // all the same external callback.
-    const CTransaction& tx = *ptx;
-
-    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
-    {
-        CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyTransaction(tx))
-        {
-            i++;
-        }
-        else
-        {
-            notifier->Shutdown();
-            i = notifiers.erase(i);
-        }
-    }
+    QueueJob([ptx](CZMQAbstractNotifier *notifier) { return notifier->NotifyTransaction(*ptx); });
 }
 
 void CZMQNotificationInterface::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexConnected, const std::vector<CTransactionRef>& vtxConflicted)
@@ -191,6 +218,9 @@ void CZMQNotificationInterface::BlockConnected(const std::shared_ptr<const CBloc
         // Do a normal notify for each transaction added in the block
         TransactionAddedToMempool(ptx);
     }
+
+    // The asset topics parse the whole block once on the publisher thread
+    QueueJob([pblock, pindexConnected](CZMQAbstractNotifier *notifier) { return notifier->NotifyBlockConnected(*pblock, pindexConnected); });
 }
 
 void CZMQNotificationInterface::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock)
@@ -11,10 +11,18 @@
 #include <string>
 #include <map>
 #include <list>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
 
 class CBlockIndex;
 class CZMQAbstractNotifier;
 
+/** Default for -zmqqueuesize, the number of notifications waiting for the publisher thread */
+static const unsigned int DEFAULT_ZMQ_QUEUE_SIZE = 10000;
+
 class CZMQNotificationInterface final : public CValidationInterface
 {
 public:
@@ -36,8 +44,24 @@ protected:
 private:
     CZMQNotificationInterface();
 
+    /** A notification, run against every notifier on the publisher thread. Returns false if the notifier failed. */
+    typedef std::function<bool(CZMQAbstractNotifier*)> NotifyJob;
+
+    void QueueJob(NotifyJob job);
+    void ThreadPublish();
+
     void *pcontext;
     std::list<CZMQAbstractNotifier*> notifiers;
+
+    // Notifications are queued by the validation callbacks and serialized and
+    // sent by threadPublish, so a slow subscriber never stalls block connection.
+    std::mutex cs_queue;
+    std::condition_variable condQueue;
+    std::deque<NotifyJob> queue;
+    size_t nMaxQueueSize;
+    uint64_t nDropped;
+    bool fStopPublish;
+    std::thread threadPublish;
 };
 
 #endif // AIDP_ZMQ_ZMQNOTIFICATIONINTERFACE_H
@@ -6,11 +6,16 @@
 
 #include "chain.h"
 #include "chainparams.h"
+#include "core_io.h"
 #include "streams.h"
 #include "zmqpublishnotifier.h"
 #include "validation.h"
 #include "util.h"
 #include "rpc/server.h"
+#include "base58.h"
+#include "assets/assets.h"
+
+#include <univalue.h>
 
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
@@ -19,6 +24,10 @@ static const char *MSG_HASHTX      = "hashtx";
 static const char *MSG_RAWBLOCK    = "rawblock";
 static const char *MSG_RAWTX       = "rawtx";
 static const char *MSG_RAWASSETMSG = "rawmessage";
+static const char *MSG_ASSETISSUE  = "assetissue";
+static const char *MSG_ASSETREISSUE = "assetreissue";
+static const char *MSG_ASSETTRANSFER = "assettransfer";
+static const char *MSG_ASSETRESTRICTION = "assetrestriction";
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -79,7 +88,17 @@ bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
             return false;
         }
 
-        int rc = zmq_bind(psocket, address.c_str());
+        LogPrint(BCLog::ZMQ, "zmq: Outbound message high water mark for %s at %s is %d\n", type, address, outbound_message_high_water_mark);
+
+        int rc = zmq_setsockopt(psocket, ZMQ_SNDHWM, &outbound_message_high_water_mark, sizeof(outbound_message_high_water_mark));
+        if (rc != 0)
+        {
+            zmqError("Failed to set outbound message high water mark");
+            zmq_close(psocket);
+            return false;
+        }
+
+        rc = zmq_bind(psocket, address.c_str());
         if (rc!=0)
         {
             zmqError("Failed to bind address");
@@ -207,3 +226,177 @@ bool CZMQPublishNewAssetMessageNotifier::NotifyMessage(const CMessage &message)
     std::string str = zmqmessage.createJsonString();
     return SendMessage(MSG_RAWASSETMSG, &(*str.begin()), str.size());
 }
+
+// Fields common to every asset notification of an output in a connected block
+static UniValue AssetOutputToJSON(const CTransaction &tx, unsigned int n, const CBlockIndex *pindex, const std::string &assetName, const std::string &address)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("txid", tx.GetHash().GetHex()));
+    obj.push_back(Pair("vout", (int)n));
+    obj.push_back(Pair("blockhash", pindex->GetBlockHash().GetHex()));
+    obj.push_back(Pair("height", pindex->nHeight));
+    obj.push_back(Pair("asset_name", assetName));
+    if (!address.empty())
+        obj.push_back(Pair("address", address));
+    return obj;
+}
+
+static bool SendJSON(CZMQAbstractPublishNotifier *notifier, const char *command, const UniValue &obj)
+{
+    std::string str = obj.write();
+    return notifier->SendMessage(command, str.data(), str.size());
+}
+
+bool CZMQPublishAssetIssueNotifier::NotifyBlockConnected(const CBlock &block, const CBlockIndex *pindex)
+{
+    for (const auto &tx : block.vtx) {
+        for (unsigned int i = 0; i < tx->vout.size(); i++) {
+            const CScript &script = tx->vout[i].scriptPubKey;
+            int nType = 0;
+            bool fIsOwner = false;
+            if (!script.IsAssetScript(nType, fIsOwner) || nType != TX_NEW_ASSET)
+                continue;
+
+            CNewAsset asset;
+            std::string address;
+            if (fIsOwner) {
+                if (!OwnerAssetFromScript(script, asset.strName, address))
+                    continue;
+                asset.nAmount = OWNER_ASSET_AMOUNT;
+                asset.units = OWNER_UNITS;
+            } else if (!AssetFromScript(script, asset, address) && !MsgChannelAssetFromScript(script, asset, address) &&
+                       !QualifierAssetFromScript(script, asset, address) && !RestrictedAssetFromScript(script, asset, address)) {
+                continue;
+            }
+
+            LogPrint(BCLog::ZMQ, "zmq: Publish assetissue %s\n", asset.strName);
+            UniValue obj = AssetOutputToJSON(*tx, i, pindex, asset.strName, address);
+            obj.push_back(Pair("amount", ValueFromAmount(asset.nAmount, asset.units)));
+            obj.push_back(Pair("units", asset.units));
+            obj.push_back(Pair("reissuable", asset.nReissuable ? true : false));
+            if (asset.nHasIPFS)
+                obj.push_back(Pair("ipfs_hash", EncodeAssetData(asset.strIPFSHash)));
+            if (!SendJSON(this, MSG_ASSETISSUE, obj))
+                return false;
+        }
+    }
+    return true;
+}
+
+bool CZMQPublishAssetReissueNotifier::NotifyBlockConnected(const CBlock &block, const CBlockIndex *pindex)
+{
+    for (const auto &tx : block.vtx) {
+        for (unsigned int i = 0; i < tx->vout.size(); i++) {
+            const CScript &script = tx->vout[i].scriptPubKey;
+            int nType = 0;
+            bool fIsOwner = false;
+            if (!script.IsAssetScript(nType, fIsOwner) || nType != TX_REISSUE_ASSET)
+                continue;
+
+            CReissueAsset reissue;
+            std::string address;
+            if (!ReissueAssetFromScript(script, reissue, address))
+                continue;
+
+            LogPrint(BCLog::ZMQ, "zmq: Publish assetreissue %s\n", reissue.strName);
+            UniValue obj = AssetOutputToJSON(*tx, i, pindex, reissue.strName, address);
+            obj.push_back(Pair("amount", ValueFromAmount(reissue.nAmount)));
+            // -1 keeps the current units
+            obj.push_back(Pair("units", reissue.nUnits));
+            obj.push_back(Pair("reissuable", reissue.nReissuable ? true : false));
+            if (!reissue.strIPFSHash.empty())
+                obj.push_back(Pair("ipfs_hash", EncodeAssetData(reissue.strIPFSHash)));
+            if (!SendJSON(this, MSG_ASSETREISSUE, obj))
+                return false;
+        }
+    }
+    return true;
+}
+
+bool CZMQPublishAssetTransferNotifier::NotifyBlockConnected(const CBlock &block, const CBlockIndex *pindex)
+{
+    for (const auto &tx : block.vtx) {
+        for (unsigned int i = 0; i < tx->vout.size(); i++) {
+            const CScript &script = tx->vout[i].scriptPubKey;
+            int nType = 0;
+            bool fIsOwner = false;
+            if (!script.IsAssetScript(nType, fIsOwner) || nType != TX_TRANSFER_ASSET)
+                continue;
+
+            CAssetTransfer transfer;
+            std::string address;
+            if (!TransferAssetFromScript(script, transfer, address))
+                continue;
+
+            LogPrint(BCLog::ZMQ, "zmq: Publish assettransfer %s\n", transfer.strName);
+            UniValue obj = AssetOutputToJSON(*tx, i, pindex, transfer.strName, address);
+            obj.push_back(Pair("amount", ValueFromAmount(transfer.nAmount)));
+            if (!transfer.message.empty())
+                obj.push_back(Pair("message", EncodeAssetData(transfer.message)));
+            if (transfer.nExpireTime)
+                obj.push_back(Pair("expire_time", transfer.nExpireTime));
+            if (!SendJSON(this, MSG_ASSETTRANSFER, obj))
+                return false;
+        }
+    }
+    return true;
+}
+
+bool CZMQPublishAssetRestrictionNotifier::NotifyBlockConnected(const CBlock &block, const CBlockIndex *pindex)
+{
+    for (const auto &tx : block.vtx) {
+        for (unsigned int i = 0; i < tx->vout.size(); i++) {
+            const CScript &script = tx->vout[i].scriptPubKey;
+            UniValue obj;
+
+            if (script.IsNullAssetTxDataScript()) {
+                CNullAssetTxData data;
+                std::string address;
+                if (!AssetNullDataFromScript(script, data, address))
+                    continue;
+
+                std::string change;
+                if (IsAssetNameAQualifier(data.asset_name))
+                    change = data.flag == (int)QualifierType::ADD_QUALIFIER ? "tag_address" : "untag_address";
+                else
+                    change = data.flag == (int)RestrictedType::FREEZE_ADDRESS ? "freeze_address" : "unfreeze_address";
+
+                obj = AssetOutputToJSON(*tx, i, pindex, data.asset_name, address);
+                obj.push_back(Pair("change", change));
+            } else if (script.IsNullGlobalRestrictionAssetTxDataScript()) {
+                CNullAssetTxData data;
+                if (!GlobalAssetNullDataFromScript(script, data))
+                    continue;
+
+                obj = AssetOutputToJSON(*tx, i, pindex, data.asset_name, "");
+                obj.push_back(Pair("change", data.flag == 1 ? "global_freeze" : "global_unfreeze"));
+            } else if (script.IsNullAssetVerifierTxDataScript()) {
+                CNullAssetTxVerifierString verifier;
+                if (!AssetNullVerifierDataFromScript(script, verifier))
+                    continue;
+
+                // The verifier applies to the restricted asset issued or reissued by the same transaction
+                std::string assetName;
+                for (const auto &out : tx->vout) {
+                    std::string strName;
+                    CAmount nAmount;
+                    if (GetAssetInfoFromScript(out.scriptPubKey, strName, nAmount) && IsAssetNameAnRestricted(strName)) {
+                        assetName = strName;
+                        break;
+                    }
+                }
+
+                obj = AssetOutputToJSON(*tx, i, pindex, assetName, "");
+                obj.push_back(Pair("change", "verifier"));
+                obj.push_back(Pair("verifier_string", verifier.verifier_string));
+            } else {
+                continue;
+            }
+
+            LogPrint(BCLog::ZMQ, "zmq: Publish assetrestriction %s\n", obj["asset_name"].get_str());
+            if (!SendJSON(this, MSG_ASSETRESTRICTION, obj))
+                return false;
+        }
+    }
+    return true;
+}
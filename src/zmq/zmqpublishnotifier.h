@@ -61,4 +61,28 @@ public:
     bool NotifyMessage(const CMessage& message) override;
 };
 
+class CZMQPublishAssetIssueNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyBlockConnected(const CBlock &block, const CBlockIndex *pindex) override;
+};
+
+class CZMQPublishAssetReissueNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyBlockConnected(const CBlock &block, const CBlockIndex *pindex) override;
+};
+
+class CZMQPublishAssetTransferNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyBlockConnected(const CBlock &block, const CBlockIndex *pindex) override;
+};
+
+class CZMQPublishAssetRestrictionNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyBlockConnected(const CBlock &block, const CBlockIndex *pindex) override;
+};
+
 #endif // AIDP_ZMQ_ZMQPUBLISHNOTIFIER_H
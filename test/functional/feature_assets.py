@@ -52,6 +52,12 @@ class AssetTest(AidpTestFramework):
         assert_equal(assetdata["has_ipfs"], 1)
         assert_equal(assetdata["ipfs_hash"], ipfs_hash)
 
+        self.log.info("Checkout getassetdatamulti()...")
+        assetdatamulti = n0.getassetdatamulti(["MY_ASSET", "NOT_AN_ASSET", "MY_ASSET"])
+        assert_equal(sorted(assetdatamulti), ["MY_ASSET", "NOT_AN_ASSET"])
+        assert_equal(assetdatamulti["MY_ASSET"], assetdata)
+        assert_equal(assetdatamulti["NOT_AN_ASSET"], None)
+
         self.log.info("Checking listmyassets()...")
         myassets = n0.listmyassets(asset="MY_ASSET*", verbose=True)
         assert_equal(len(myassets), 2)
@@ -73,6 +79,12 @@ class AssetTest(AidpTestFramework):
         assert_equal(n0.listassetbalancesbyaddress(address0)["MY_ASSET"], 1000)
         assert_equal(n0.listassetbalancesbyaddress(address0)["MY_ASSET!"], 1)
 
+        self.log.info("Checking listassetbalancesbyaddresses()...")
+        unused_address = n0.getnewaddress()
+        balances = n0.listassetbalancesbyaddresses([address0, unused_address])
+        assert_equal(balances[address0], n0.listassetbalancesbyaddress(address0))
+        assert_equal(balances[unused_address], {})
+
         self.log.info("Checking listassetbalancesbyaddress()...")
         assert_equal(n0.listaddressesbyasset("MY_ASSET"), n1.listaddressesbyasset("MY_ASSET"))
 
@@ -93,6 +93,13 @@ class MessagingTest(AidpTestFramework):
         message = n1_messages[0]
         assert_contains_pair("Asset Name", channel_one, message)
         assert_contains_pair("Message", ipfs_hash, message)
+
+        # paged and filtered views
+        page = n1.viewallmessages(channel_one, 0, 0, 1)
+        assert_equal(1, len(page["messages"]))
+        assert "next" not in page
+        assert_equal(0, len(n1.viewallmessages(channel_two)))
+        assert_equal(0, len(n1.viewallmessages(channel_one, 0, 1)))
         n1.clearmessages()
         n1_messages = n1.viewallmessages()
         assert_equal(0, len(n1_messages))
@@ -319,6 +319,9 @@ class RestrictedAssetsTest(AidpTestFramework):
         assert_contains(address, n0.listaddressesfortag(tag))
         assert_contains(tag, n0.listtagsforaddress(address))
         assert n0.checkaddresstag(address, tag)
+        assert_equal([True, False, True], n0.checkaddresstags([{"address": address, "tag_name": tag},
+                                                              {"address": change_address, "tag_name": tag},
+                                                              {"address": address, "tag_name": tag}]))
 
         # viewmytaggedaddresses
         tagged = viewmytaggedaddresses()
@@ -441,6 +444,8 @@ class RestrictedAssetsTest(AidpTestFramework):
         # post-freezing verification
         assert_contains(asset_name, n0.listaddressrestrictions(address))
         assert n0.checkaddressrestriction(address, asset_name)
+        assert_equal([False, True], n0.checkaddressrestrictions([{"address": safe_address, "restricted_name": asset_name},
+                                                                {"address": address, "restricted_name": asset_name}]))
 
         # viewmyrestrictedaddresses
         restrictions = viewmyrestrictedaddresses()
@@ -9,6 +9,7 @@
 """Test the ZMQ notification interface."""
 
 import configparser
+import json
 import os
 import struct
 from test_framework.test_framework import AidpTestFramework, SkipTest
@@ -73,7 +74,16 @@ class ZMQTest(AidpTestFramework):
         self.rawblock = ZMQSubscriber(socket, b"rawblock")
         self.rawtx = ZMQSubscriber(socket, b"rawtx")
 
-        self.extra_args = [["-zmqpub%s=%s" % (sub.topic.decode(), address) for sub in [self.hashblock, self.hashtx, self.rawblock, self.rawtx]], []]
+        # Asset topics are published on their own socket so they don't change
+        # the order of the messages above.
+        asset_address = "tcp://127.0.0.1:28767"
+        asset_socket = self.zmq_context.socket(zmq.SUB)
+        asset_socket.set(zmq.RCVTIMEO, 60000)
+        asset_socket.connect(asset_address)
+        self.assetissue = ZMQSubscriber(asset_socket, b"assetissue")
+
+        self.extra_args = [["-zmqpub%s=%s" % (sub.topic.decode(), address) for sub in [self.hashblock, self.hashtx, self.rawblock, self.rawtx]] +
+                           ["-zmqpubassetissue=%s" % asset_address], []]
         self.add_nodes(self.num_nodes, self.extra_args)
         self.start_nodes()
 
@@ -121,6 +131,25 @@ class ZMQTest(AidpTestFramework):
         hex_data = self.rawtx.receive()
         assert_equal(payment_txid, hash256(hex_data).hex())
 
+        self.log.info("Issue an asset and wait for the assetissue notifications")
+        issue_txid = self.nodes[0].issue("ZMQ_ASSET", 1000, "", "", 2, True, False)[0]
+        block_hash = self.nodes[0].generate(1)[0]
+        height = self.nodes[0].getblockcount()
+
+        # One notification for the asset and one for its owner token
+        issued = {}
+        for _ in range(2):
+            body = json.loads(self.assetissue.receive().decode())
+            assert_equal(body["txid"], issue_txid)
+            assert_equal(body["blockhash"], block_hash)
+            assert_equal(body["height"], height)
+            issued[body["asset_name"]] = body
+        assert_equal(sorted(issued), ["ZMQ_ASSET", "ZMQ_ASSET!"])
+        assert_equal(issued["ZMQ_ASSET"]["amount"], 1000)
+        assert_equal(issued["ZMQ_ASSET"]["units"], 2)
+        assert_equal(issued["ZMQ_ASSET"]["reissuable"], True)
+        assert_equal(issued["ZMQ_ASSET!"]["amount"], 1)
+
 
 if __name__ == '__main__':
     ZMQTest().main()
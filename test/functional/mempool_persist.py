@@ -20,9 +20,9 @@ Test is as follows:
     them to be saved in the wallet.
   - check that node0 and node1 have 5 transactions in their mempools
   - shutdown all nodes.
-  - startup node0. Verify that it still has 5 transactions
-    in its mempool. Shutdown node0. This tests that by default the
-    mempool is persistent.
+  - startup node0. Verify that it still has 5 transactions,
+    with the same fees, in its mempool. Shutdown node0. This tests
+    that by default the mempool is persistent.
   - startup node1. Verify that its mempool is empty. Shutdown node1.
     This tests that with -persistmempool=0, the mempool is not
     dumped to disk when the node is shut down.
@@ -65,6 +65,7 @@ class MempoolPersistTest(AidpTestFramework):
         self.log.debug("Verify that node0 and node1 have 5 transactions in their mempools")
         assert_equal(len(self.nodes[0].getrawmempool()), 5)
         assert_equal(len(self.nodes[1].getrawmempool()), 5)
+        fees = {txid: entry['fee'] for txid, entry in self.nodes[0].getrawmempool(True).items()}
 
         self.log.debug("Stop-start node0 and node1. Verify that node0 has the transactions in its mempool and node1 does not.")
         self.stop_nodes()
@@ -74,6 +75,8 @@ class MempoolPersistTest(AidpTestFramework):
         time.sleep(1)
         wait_until(lambda: len(self.nodes[0].getrawmempool()) == 5, err_msg="Wait for getRawMempool")
         assert_equal(len(self.nodes[1].getrawmempool()), 0)
+        # The transactions spend each other's change, which has to load in order
+        assert_equal({txid: entry['fee'] for txid, entry in self.nodes[0].getrawmempool(True).items()}, fees)
 
         self.log.debug("Stop-start node0 with -persistmempool=0. Verify that it doesn't load its mempool.dat file.")
         self.stop_nodes()
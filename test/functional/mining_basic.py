@@ -133,5 +133,14 @@ class MiningTest(AidpTestFramework):
         bad_block.hashPrevBlock = 123
         assert_template(node, bad_block, 'inconclusive-not-best-prevblk')
 
+        self.log.info("getblocktemplate: Test transactions are added to the template as they arrive")
+        tmpl = node.getblocktemplate()
+        txid = node.sendtoaddress(node.getnewaddress(), 1)
+        fee = int(node.getmempoolentry(txid)['fee'] * 100000000)
+        new_tmpl = node.getblocktemplate()
+        assert_equal([tx['txid'] for tx in new_tmpl['transactions']], [tx['txid'] for tx in tmpl['transactions']] + [txid])
+        assert_equal(new_tmpl['transactions'][-1]['fee'], fee)
+        assert_equal(new_tmpl['coinbasevalue'], tmpl['coinbasevalue'] + fee)
+
 if __name__ == '__main__':
     MiningTest().main()
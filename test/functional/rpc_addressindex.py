@@ -10,7 +10,7 @@
 import binascii
 import time
 from test_framework.test_framework import AidpTestFramework
-from test_framework.util import connect_nodes_bi, assert_equal
+from test_framework.util import connect_nodes_bi, assert_equal, wait_until
 from test_framework.script import CScript, OP_HASH160, OP_EQUAL, OP_DUP, OP_EQUALVERIFY, OP_CHECKSIG
 from test_framework.mininode import CTransaction, CTxIn, CTxOut, COutPoint
 
@@ -131,6 +131,19 @@ class AddressIndexTest(AidpTestFramework):
         assert_equal(len(tx_ids_many), 4)
         assert_equal(tx_ids_many[3], sent_txid)
 
+        # Check that txids can be read page by page
+        self.log.info("Testing paginated txids...")
+        paged_txids = []
+        request = {"addresses": ["2N2JD6wb56AfK4tfmM6PwdVmoYk2dCKf4Br"], "limit": 3}
+        while True:
+            page = self.nodes[1].getaddresstxids(request)
+            assert(len(page["txids"]) <= 3)
+            paged_txids += page["txids"]
+            if "cursor" not in page:
+                break
+            request["cursor"] = page["cursor"]
+        assert_equal(paged_txids, tx_ids_many)
+
         # Check that balances are correct
         self.log.info("Testing balances...")
         balance0 = self.nodes[1].getaddressbalance("2N2JD6wb56AfK4tfmM6PwdVmoYk2dCKf4Br")
@@ -155,6 +168,7 @@ class AddressIndexTest(AidpTestFramework):
         self.sync_all()
         balance1 = self.nodes[1].getaddressbalance(address2)
         assert_equal(balance1["balance"], amount)
+        assert_equal(balance1["txcount"], 1)
 
         tx = CTransaction()
         tx.vin = [CTxIn(COutPoint(int(spending_txid, 16), 0))]
@@ -170,6 +184,8 @@ class AddressIndexTest(AidpTestFramework):
 
         balance2 = self.nodes[1].getaddressbalance(address2)
         assert_equal(balance2["balance"], change_amount)
+        assert_equal(balance2["received"], amount + change_amount)
+        assert_equal(balance2["txcount"], 2)
 
         # Check that deltas are returned correctly
         deltas = self.nodes[1].getaddressdeltas({"addresses": [address2], "start": 1, "end": 200})
@@ -188,6 +204,14 @@ class AddressIndexTest(AidpTestFramework):
         deltas = self.nodes[1].getaddressdeltas({"addresses": [address2], "start": 113, "end": 113})
         assert_equal(len(deltas), 1)
 
+        # Check that deltas can be read page by page
+        deltas_page = self.nodes[1].getaddressdeltas({"addresses": [address2], "limit": 1})
+        assert_equal(len(deltas_page["deltas"]), 1)
+        assert_equal(deltas_page["deltas"][0], deltas_all[0])
+        deltas_page = self.nodes[1].getaddressdeltas({"addresses": [address2], "limit": 10, "cursor": deltas_page["cursor"]})
+        assert_equal(deltas_page["deltas"], deltas_all[1:])
+        assert("cursor" not in deltas_page)
+
         # Check that unspent outputs can be queried
         self.log.info("Testing utxos...")
         utxos = self.nodes[1].getaddressutxos({"addresses": [address2]})
@@ -343,6 +367,17 @@ class AddressIndexTest(AidpTestFramework):
         assert_equal(utxos_with_info["height"], 267)
         assert_equal(utxos_with_info["hash"], expected_tip_block_hash)
 
+        self.log.info("Testing building the indexes in the background...")
+
+        self.restart_node(0, ["-relaypriority=0", "-addressindex", "-spentindex", "-timestampindex"])
+        wait_until(lambda: all(i["synced"] for i in self.nodes[0].getindexinfo().values()), err_msg="indexes synced", timeout=60)
+        index_info = self.nodes[0].getindexinfo()
+        assert_equal(sorted(index_info.keys()), ["addressindex", "spentindex", "timestampindex"])
+        assert_equal(index_info["addressindex"]["best_block_height"], 267)
+        assert_equal(self.nodes[0].getaddresstxids(address2), self.nodes[1].getaddresstxids(address2))
+        assert_equal(self.nodes[0].getaddressbalance(address2), self.nodes[1].getaddressbalance(address2))
+        assert_equal(self.nodes[0].getaddressutxos({"addresses": [address2]}), self.nodes[1].getaddressutxos({"addresses": [address2]}))
+
         self.log.info("All Tests Passed")
 
 